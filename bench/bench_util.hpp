@@ -0,0 +1,121 @@
+#pragma once
+
+/**
+ *  Small helpers shared by the benchmark executables. Nothing in here is
+ *  part of the engine, it only builds scenes and measures time.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "linalg.h"
+
+#include "scene.hpp"
+#include "circle.hpp"
+#include "obb.hpp"
+
+namespace bench
+{
+    typedef linalg::aliases::float2 float2;
+
+    class Timer
+    {
+    private:
+        typedef std::chrono::steady_clock m_clock;
+        m_clock::time_point m_start;
+
+    public:
+        Timer() : m_start(m_clock::now()) {}
+
+        void Reset() { m_start = m_clock::now(); }
+
+        double ElapsedMs() const
+        {
+            return std::chrono::duration<double, std::milli>(m_clock::now() - m_start).count();
+        }
+    };
+
+    // read "--name value" style integer options
+    inline long GetArg(int argc, char* argv[], const char* name, long fallback)
+    {
+        for(int i = 1; i + 1 < argc; ++i)
+        {
+            if(std::string(argv[i]) == name)
+                return std::atol(argv[i + 1]);
+        }
+        return fallback;
+    }
+
+    // read "--name value" style string options
+    inline std::string GetStringArg(int argc, char* argv[], const char* name, const std::string& fallback)
+    {
+        for(int i = 1; i + 1 < argc; ++i)
+        {
+            if(std::string(argv[i]) == name)
+                return argv[i + 1];
+        }
+        return fallback;
+    }
+
+    inline bool HasFlag(int argc, char* argv[], const char* name)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            if(std::string(argv[i]) == name)
+                return true;
+        }
+        return false;
+    }
+
+    // field by field, the padding of a manifold is not initialized
+    inline bool SameManifold(const Manifold& a, const Manifold& b)
+    {
+        if(a.m_body0 != b.m_body0 || a.m_body1 != b.m_body1 ||
+            a.m_contactPointCount != b.m_contactPointCount || a.m_isHit != b.m_isHit ||
+            a.m_normal != b.m_normal || a.m_penetration != b.m_penetration)
+            return false;
+        for(int i = 0; i < a.m_contactPointCount; ++i)
+        {
+            if(a.m_contactPoints[i] != b.m_contactPoints[i] || a.m_contactIds[i] != b.m_contactIds[i])
+                return false;
+        }
+        return true;
+    }
+
+    // scatter boxes and circles of size [1, 3) in a square region, the region
+    // grows with the body count so the density stays roughly the same
+    inline std::vector<std::shared_ptr<RigidBody2D>> AddRandomBodies(
+        SceneBase& scene, size_t count, float density, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> size(1.0f, 3.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        const float half_width = std::sqrt(count / density) * 0.5f;
+
+        std::vector<std::shared_ptr<RigidBody2D>> bodies;
+        bodies.reserve(count);
+        for(size_t i = 0; i < count; ++i)
+        {
+            float2 position(
+                (unit(rng) * 2.0f - 1.0f) * half_width,
+                (unit(rng) * 2.0f - 1.0f) * half_width);
+
+            std::shared_ptr<RigidBody2D> body;
+            if(i % 2 == 0)
+                body = scene.AddRigidBody(std::make_shared<OBB>(float2(size(rng), size(rng))), position);
+            else
+                body = scene.AddRigidBody(std::make_shared<Circle>(size(rng) * 0.5f), position);
+
+            body->SetOrientation(unit(rng) * 6.28f);
+            body->SetVelocity(float2(unit(rng) - 0.5f, unit(rng) - 0.5f) * 4.0f);
+            bodies.push_back(body);
+        }
+        return bodies;
+    }
+}
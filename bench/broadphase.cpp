@@ -0,0 +1,67 @@
+/**
+ *  Compare candidate pair counts and step time of each broadphase as the
+ *  body count grows.
+ *
+ *  usage : broadphase [--steps N] [--max-brute N]
+ */
+
+#include <cstdio>
+#include <functional>
+
+#include "bench_util.hpp"
+
+#include "broadphase.hpp"
+#include "integrator.hpp"
+
+namespace
+{
+    struct Result
+    {
+        size_t pairs;
+        double stepMs;
+    };
+
+    Result Run(size_t bodyCount, int steps, const std::shared_ptr<Broadphase>& broadphase)
+    {
+        auto scene = std::make_shared<Scene>(
+            1.0f / 60.0f, 10, std::make_shared<SymplecticEulerIntegrator>(), broadphase);
+        auto bodies = bench::AddRandomBodies(*scene, bodyCount, 0.05f, 1234u);
+
+        // the bounds come from the transform cache, which is empty until the
+        // first refresh
+        scene->UpdateTransforms();
+        std::vector<BodyPair> pairs;
+        broadphase->ComputePairs(scene->GetBodyStore(), pairs);
+
+        bench::Timer timer;
+        for(int i = 0; i < steps; ++i)
+            scene->Step();
+
+        return Result{ pairs.size(), timer.ElapsedMs() / steps };
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int steps = static_cast<int>(bench::GetArg(argc, argv, "--steps", 10));
+    const size_t max_brute = static_cast<size_t>(bench::GetArg(argc, argv, "--max-brute", 5000));
+    const size_t counts[] = { 100, 1000, 5000, 10000, 50000 };
+
+    std::printf("%-8s %-12s %12s %12s\n", "bodies", "broadphase", "pairs", "step(ms)");
+    for(size_t count : counts)
+    {
+        if(count <= max_brute)
+        {
+            Result r = Run(count, steps, std::make_shared<BruteForceBroadphase>());
+            std::printf("%-8zu %-12s %12zu %12.3f\n", count, "brute", r.pairs, r.stepMs);
+        }
+
+        Result r = Run(count, steps, std::make_shared<UniformGridBroadphase>());
+        std::printf("%-8zu %-12s %12zu %12.3f\n", count, "grid", r.pairs, r.stepMs);
+
+        r = Run(count, steps, std::make_shared<DynamicTreeBroadphase>());
+        std::printf("%-8zu %-12s %12zu %12.3f\n", count, "tree", r.pairs, r.stepMs);
+    }
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ *  Speedup of the graph colored solver over the serial Manifold::Resolve()
+ *  loop of ImpulseSolver. Rows of stacks are dropped onto a floor until
+ *  they touch, then the manifolds of one step are solved over and over on
+ *  a copy of the bodies. Every thread count has to end with the same bodies
+ *  as the colored solver without a job system.
+ *
+ *  usage : colored_solver [--stacks N] [--height N] [--iterations N] [--repeat N] [--max-threads N]
+ */
+
+#include <cstdio>
+
+#include "bench_util.hpp"
+
+#include "collision.hpp"
+#include "integrator.hpp"
+#include "solver.hpp"
+
+namespace
+{
+    typedef linalg::aliases::float2 float2;
+
+    double Measure(Solver& solver, const BodyStore& start, const std::vector<Manifold>& manifolds,
+        uint32_t iterations, int repeat, BodyStore& result)
+    {
+        PairCache pairs;
+        double ms = 0.0;
+        for(int r = 0; r < repeat; ++r)
+        {
+            result = start;
+            bench::Timer timer;
+            solver.Solve(result, manifolds, pairs, 1.0f / 60.0f, iterations);
+            ms += timer.ElapsedMs();
+        }
+        return ms / repeat;
+    }
+
+    bool SameBodies(const BodyStore& a, const BodyStore& b)
+    {
+        return a.m_velocityX == b.m_velocityX && a.m_velocityY == b.m_velocityY &&
+            a.m_angularVelocity == b.m_angularVelocity &&
+            a.m_positionX == b.m_positionX && a.m_positionY == b.m_positionY;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int stackCount = static_cast<int>(bench::GetArg(argc, argv, "--stacks", 1000));
+    const int height = static_cast<int>(bench::GetArg(argc, argv, "--height", 10));
+    const uint32_t iterations = static_cast<uint32_t>(bench::GetArg(argc, argv, "--iterations", 10));
+    const int repeat = static_cast<int>(bench::GetArg(argc, argv, "--repeat", 20));
+    const size_t maxThreads = static_cast<size_t>(bench::GetArg(argc, argv, "--max-threads", 16));
+
+    auto scene = std::make_shared<Scene>(
+        1.0f / 60.0f, iterations, std::make_shared<SymplecticEulerIntegrator>(),
+        std::make_shared<UniformGridBroadphase>());
+
+    const float width = stackCount * 1.5f;
+    auto floor = scene->AddRigidBody(std::make_shared<OBB>(float2(width + 10.0f, 2.0f)), float2(0.0f, -1.0f));
+    floor->SetStatic();
+    for(int x = 0; x < stackCount; ++x)
+    {
+        for(int y = 0; y < height; ++y)
+        {
+            const float2 position(x * 1.5f - width * 0.5f, y * 1.0f + 0.5f);
+            scene->AddRigidBody(std::make_shared<OBB>(float2(1.0f, 1.0f)), position);
+        }
+    }
+    for(int i = 0; i < 30; ++i)
+        scene->Step();
+    scene->UpdateTransforms();
+
+    // the manifolds of one step, like Scene::Solve() makes them
+    const BodyStore& start = scene->GetBodyStore();
+    std::vector<BodyPair> pairs, sorted;
+    std::array<size_t, CollisionHelper::k_shapePairCount + 1> offsets;
+    std::vector<Manifold> manifolds;
+    UniformGridBroadphase().ComputePairs(start, pairs);
+    CollisionHelper::SortPairsByShapeType(start, pairs, sorted, offsets);
+    for(size_t k = 0; k < CollisionHelper::k_shapePairCount; ++k)
+        CollisionHelper::CollideBatch(k, start, sorted.data() + offsets[k], offsets[k + 1] - offsets[k], manifolds);
+
+    BodyStore serialResult, coloredResult, result;
+    ImpulseSolver serial;
+    const double serialMs = Measure(serial, start, manifolds, iterations, repeat, serialResult);
+
+    GraphColoringSolver colored;
+    const double coloredMs = Measure(colored, start, manifolds, iterations, repeat, coloredResult);
+
+    std::printf("%zu bodies, %zu manifolds, %u colors, %zu overflow, %u hardware threads\n",
+        start.Size(), manifolds.size(), colored.GetColorCount(), colored.GetOverflowCount(),
+        std::thread::hardware_concurrency());
+    std::printf("  %-16s %10s %9s %10s\n", "solver", "ms", "speedup", "identical");
+    std::printf("  %-16s %10.3f %9.2f %10s\n", "impulse", serialMs, 1.0, "-");
+    std::printf("  %-16s %10.3f %9.2f %10s\n", "colored", coloredMs, serialMs / coloredMs, "-");
+
+    for(size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        GraphColoringSolver parallel;
+        parallel.SetJobSystem(std::make_shared<JobSystem>(threads));
+        const double ms = Measure(parallel, start, manifolds, iterations, repeat, result);
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "colored x%zu", threads);
+        std::printf("  %-16s %10.3f %9.2f %10s\n", name, ms, serialMs / ms, SameBodies(result, coloredResult) ? "yes" : "NO");
+    }
+
+    return 0;
+}
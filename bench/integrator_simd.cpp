@@ -0,0 +1,106 @@
+/**
+ *  Bodies integrated per second by the kernels of IntegratorKernels, for
+ *  every instruction set the cpu supports. A tenth of the bodies is static
+ *  and a sixteenth sleeps, so the masking is part of what is measured.
+ *  Every vector kernel has to end with exactly the bodies of the scalar
+ *  reference.
+ *
+ *  usage : integrator_simd [--bodies N] [--steps N]
+ */
+
+#include <cstdio>
+#include <random>
+
+#include "bench_util.hpp"
+
+#include "integrator.hpp"
+#include "integratorkernels.hpp"
+
+namespace
+{
+    typedef linalg::aliases::float2 float2;
+
+    bool SameBodies(const BodyStore& a, const BodyStore& b)
+    {
+        return a.m_positionX == b.m_positionX && a.m_positionY == b.m_positionY &&
+            a.m_velocityX == b.m_velocityX && a.m_velocityY == b.m_velocityY &&
+            a.m_forceX == b.m_forceX && a.m_forceY == b.m_forceY &&
+            a.m_orientation == b.m_orientation && a.m_angularVelocity == b.m_angularVelocity &&
+            a.m_torque == b.m_torque && a.m_transformDirty == b.m_transformDirty;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t bodyCount = static_cast<size_t>(bench::GetArg(argc, argv, "--bodies", 100000));
+    const int steps = static_cast<int>(bench::GetArg(argc, argv, "--steps", 200));
+
+    auto scene = std::make_shared<Scene>(1.0f / 60.0f, 10, std::make_shared<SymplecticEulerIntegrator>());
+    std::vector<std::shared_ptr<RigidBody2D>> bodies = bench::AddRandomBodies(*scene, bodyCount, 0.3f, 1234u);
+
+    std::mt19937 rng(99u);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for(size_t i = 0; i < bodies.size(); ++i)
+    {
+        if(i % 10 == 0)
+        {
+            bodies[i]->SetStatic();
+            continue;
+        }
+        bodies[i]->SetAngularVelocity(unit(rng));
+        bodies[i]->SetForce(float2(unit(rng), unit(rng)) * 10.0f);
+        bodies[i]->SetTorque(unit(rng));
+    }
+
+    BodyStore start = scene->GetBodyStore();
+    // any island id that is not k_awake makes a body sleep
+    for(size_t i = 3; i < start.Size(); i += 16)
+        start.m_sleepingIsland[i] = 0u;
+    std::fill(start.m_transformDirty.begin(), start.m_transformDirty.end(), 0u);
+
+    const IntegratorKernels::Method methods[] =
+    {
+        IntegratorKernels::Method::ExplicitEuler,
+        IntegratorKernels::Method::SymplecticEuler,
+        IntegratorKernels::Method::Newton
+    };
+    const char* const methodNames[] = { "explicit euler", "symplectic euler", "newton" };
+    const SimdLevel supported = IntegratorKernels::GetSupportedLevel();
+
+    std::printf("%zu bodies, %d steps, best supported level %s\n",
+        start.Size(), steps, IntegratorKernels::GetName(supported));
+    std::printf("  %-18s %-8s %10s %14s %9s %10s\n", "integrator", "level", "ms/step", "Mbodies/s", "speedup", "identical");
+
+    for(size_t m = 0; m < 3; ++m)
+    {
+        BodyStore reference;
+        double scalarMs = 0.0;
+        for(SimdLevel level = SimdLevel::Scalar; level <= supported;
+            level = static_cast<SimdLevel>(static_cast<int>(level) + 1))
+        {
+            const IntegratorKernels::Kernel kernel = IntegratorKernels::Get(methods[m], level);
+            BodyStore result = start;
+
+            bench::Timer timer;
+            for(int s = 0; s < steps; ++s)
+                kernel(result, 0u, static_cast<uint32_t>(result.Size()), 1.0f / 60.0f, float2(0.0f, -9.8f));
+            const double ms = timer.ElapsedMs() / steps;
+
+            const char* identical = "-";
+            if(level == SimdLevel::Scalar)
+            {
+                reference = result;
+                scalarMs = ms;
+            }
+            else
+            {
+                identical = SameBodies(result, reference) ? "yes" : "NO";
+            }
+
+            std::printf("  %-18s %-8s %10.3f %14.1f %9.2f %10s\n", methodNames[m], IntegratorKernels::GetName(level),
+                ms, start.Size() / (ms * 1000.0), scalarMs / ms, identical);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+/**
+ *  What the job system costs on top of the work it runs. First an empty
+ *  parallel loop, which is nothing but splitting, stealing and waiting,
+ *  then a full scene stepped on job systems of growing size, with the
+ *  stats of every stage : wall time of its loops, time spent inside the
+ *  loop bodies, and the overhead left when the work is split perfectly.
+ *  The scene is checked to end up the same for every thread count.
+ *
+ *  usage : jobsystem [--bodies N] [--steps N] [--max-threads N]
+ */
+
+#include <cstdio>
+
+#include "bench_util.hpp"
+
+#include "integrator.hpp"
+#include "jobsystem.hpp"
+#include "solver.hpp"
+
+namespace
+{
+    const char* const k_stageNames[] =
+    {
+        "transforms", "broadphase", "narrowphase", "solver", "joints", "integrate"
+    };
+
+    std::shared_ptr<Scene> Build(size_t bodyCount, const std::shared_ptr<JobSystem>& jobs)
+    {
+        auto scene = std::make_shared<Scene>(
+            1.0f / 60.0f, 10, std::make_shared<SymplecticEulerIntegrator>(),
+            std::make_shared<UniformGridBroadphase>(), std::make_shared<GraphColoringSolver>(), jobs);
+        bench::AddRandomBodies(*scene, bodyCount, 0.3f, 1234u);
+        return scene;
+    }
+
+    double Hash(const BodyStore& bodies)
+    {
+        double hash = 0.0;
+        for(size_t i = 0; i < bodies.Size(); ++i)
+            hash += bodies.m_positionX[i] * static_cast<double>(i % 7 + 1) + bodies.m_positionY[i];
+        return hash;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t bodyCount = static_cast<size_t>(bench::GetArg(argc, argv, "--bodies", 10000));
+    const int steps = static_cast<int>(bench::GetArg(argc, argv, "--steps", 60));
+    const size_t maxThreads = static_cast<size_t>(bench::GetArg(argc, argv, "--max-threads", 8));
+
+    std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+    // an empty loop of 64k items, the default grain cuts it into 8 pieces
+    // per thread
+    std::printf("empty ParallelFor of 65536 items\n");
+    std::printf("  %-8s %10s %9s %9s\n", "threads", "us/loop", "tasks", "steals");
+    for(size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        JobSystem jobs(threads);
+        JobStats stats;
+        const int loops = 2000;
+        {
+            JobSystem::ScopedStats scope(&jobs, &stats);
+            for(int r = 0; r < loops; ++r)
+                jobs.ParallelFor(65536u, [](size_t, size_t, size_t) {});
+        }
+        std::printf("  %-8zu %10.2f %9.1f %9.1f\n", threads,
+            stats.GetWallMs() * 1000.0 / loops,
+            static_cast<double>(stats.tasks.load()) / loops,
+            static_cast<double>(stats.steals.load()) / loops);
+    }
+
+    std::shared_ptr<Scene> serial = Build(bodyCount, nullptr);
+    bench::Timer timer;
+    for(int s = 0; s < steps; ++s)
+        serial->Step();
+    const double serialMs = timer.ElapsedMs() / steps;
+    const double serialHash = Hash(serial->GetBodyStore());
+
+    std::printf("%zu bodies, %d steps, no job system %.3f ms/step\n", bodyCount, steps, serialMs);
+    for(size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        auto jobs = std::make_shared<JobSystem>(threads);
+        std::shared_ptr<Scene> scene = Build(bodyCount, jobs);
+
+        scene->ResetStageStats();
+        timer.Reset();
+        for(int s = 0; s < steps; ++s)
+            scene->Step();
+        const double ms = timer.ElapsedMs() / steps;
+        const bool identical = Hash(scene->GetBodyStore()) == serialHash;
+
+        std::printf("threads %zu : %.3f ms/step, speedup %.2f, identical %s\n",
+            threads, ms, serialMs / ms, identical ? "yes" : "NO");
+        std::printf("  %-12s %8s %10s %10s %12s %9s %9s\n",
+            "stage", "loops", "wall ms", "work ms", "overhead ms", "tasks", "steals");
+        for(size_t k = 0; k < static_cast<size_t>(SceneStage::Count); ++k)
+        {
+            const JobStats& stats = scene->GetStageStats(static_cast<SceneStage>(k));
+            // per step, so that the numbers compare with the step time
+            std::printf("  %-12s %8.1f %10.3f %10.3f %12.3f %9.1f %9.1f\n", k_stageNames[k],
+                static_cast<double>(stats.loops.load()) / steps,
+                stats.GetWallMs() / steps, stats.GetWorkMs() / steps,
+                stats.GetOverheadMs(threads) / steps,
+                static_cast<double>(stats.tasks.load()) / steps,
+                static_cast<double>(stats.steals.load()) / steps);
+        }
+    }
+
+    return 0;
+}
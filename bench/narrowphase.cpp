@@ -0,0 +1,312 @@
+/**
+ *  Nanoseconds per pair of every narrowphase kernel on its own : box to
+ *  box (SAT and clipping), box to circle and circle to circle, the
+ *  GenerateManifold() overloads the visitors and the batches call. The
+ *  pairs are random but seeded, and sorted into three sets by what the
+ *  kernel makes of them : separated (the bounds overlap, the shapes do
+ *  not), touching (penetration under 5% of the smaller shape) and deep
+ *  (over 25%).
+ *
+ *  Each set alone is easy on the branch predictor. The 'mixed' rows run
+ *  all three sets shuffled together, which is what a real scene hands the
+ *  narrowphase, the 'grouped' rows the same pairs one set after the other.
+ *  The difference between the two is mostly branch misses.
+ *
+ *  With '--baseline FILE' every row is compared to the ns/pair stored in
+ *  the file, and the run fails (exit code 1) if a row got slower by more
+ *  than '--threshold' percent. '--save-baseline FILE' writes the rows of
+ *  this run as a new baseline. A baseline only means something on the
+ *  machine and build it was measured on.
+ *
+ *  usage : narrowphase [--pairs N] [--repeat N] [--seed N] [--threshold PCT]
+ *                      [--baseline FILE] [--save-baseline FILE]
+ *    --pairs is per set, --repeat how many times every row is timed (the
+ *    best time counts)
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+
+#include "bench_util.hpp"
+
+#include "collision.hpp"
+#include "integrator.hpp"
+
+namespace
+{
+    typedef linalg::aliases::float2 float2;
+
+    enum class Kernel { OBBOBB, OBBCircle, CircleCircle };
+    enum class Outcome { Separated, Touching, Deep, Count };
+
+    const char* const k_kernelNames[] = { "obb_obb", "obb_circle", "circle_circle" };
+    const char* const k_outcomeNames[] = { "separated", "touching", "deep" };
+
+    // the shapes and placement of one pair
+    struct PairConfig
+    {
+        float2 sizeA, sizeB;
+        float2 positionB;
+        float orientationA, orientationB;
+    };
+
+    std::shared_ptr<Shape> MakeShape(bool isBox, float2 size)
+    {
+        if(isBox)
+            return std::make_shared<OBB>(size);
+        return std::make_shared<Circle>(size.x);
+    }
+
+    // half the smallest dimension, what 'touching' and 'deep' are relative to
+    float GetScale(bool isBox, float2 size)
+    {
+        return isBox ? std::min(size.x, size.y) * 0.5f : size.x;
+    }
+
+    Manifold Run(Kernel kernel, const BodyStore& bodies, uint32_t a, uint32_t b)
+    {
+        const CollisionBody bodyA = CollisionHelper::GetCollisionBody(bodies, a);
+        const CollisionBody bodyB = CollisionHelper::GetCollisionBody(bodies, b);
+        switch(kernel)
+        {
+        case Kernel::OBBOBB:
+            return CollisionHelper::GenerateManifold(
+                static_cast<const OBB&>(*bodies.m_shapes[a]), bodyA, static_cast<const OBB&>(*bodies.m_shapes[b]), bodyB);
+        case Kernel::OBBCircle:
+            return CollisionHelper::GenerateManifold(
+                static_cast<const OBB&>(*bodies.m_shapes[a]), bodyA, static_cast<const Circle&>(*bodies.m_shapes[b]), bodyB);
+        default:
+            return CollisionHelper::GenerateManifold(
+                static_cast<const Circle&>(*bodies.m_shapes[a]), bodyA, static_cast<const Circle&>(*bodies.m_shapes[b]), bodyB);
+        }
+    }
+
+    // Random shapes, placed at random until the kernel puts the pair into
+    // the wanted set. The shapes of a slot are kept while only the
+    // placement is retried, so every set has the same mix of sizes.
+    std::vector<PairConfig> MakePairs(Kernel kernel, Outcome outcome, size_t count, std::mt19937& rng)
+    {
+        const bool isBoxA = kernel != Kernel::CircleCircle;
+        const bool isBoxB = kernel == Kernel::OBBOBB;
+        std::uniform_real_distribution<float> size(0.5f, 2.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        std::vector<PairConfig> pairs;
+        pairs.reserve(count);
+        while(pairs.size() < count)
+        {
+            PairConfig config;
+            config.sizeA = isBoxA ? float2(size(rng), size(rng)) : float2(size(rng) * 0.5f, 0.0f);
+            config.sizeB = isBoxB ? float2(size(rng), size(rng)) : float2(size(rng) * 0.5f, 0.0f);
+
+            // a scratch scene with just the pair
+            Scene scene(1.0f / 60.0f, 10, std::make_shared<SymplecticEulerIntegrator>());
+            auto a = scene.AddRigidBody(MakeShape(isBoxA, config.sizeA), float2(0.0f, 0.0f));
+            auto b = scene.AddRigidBody(MakeShape(isBoxB, config.sizeB), float2(0.0f, 0.0f));
+            const float scale = std::min(GetScale(isBoxA, config.sizeA), GetScale(isBoxB, config.sizeB));
+            // past the two bounding circles nothing touches, a bit further
+            // out the bounds still overlap for separated pairs
+            const float reach = 1.25f * (linalg::length(config.sizeA) * (isBoxA ? 0.5f : 1.0f) +
+                linalg::length(config.sizeB) * (isBoxB ? 0.5f : 1.0f));
+
+            for(int attempt = 0; attempt < 1000; ++attempt)
+            {
+                const float angle = unit(rng) * 6.2831853f;
+                config.positionB = float2(std::cos(angle), std::sin(angle)) * (unit(rng) * reach);
+                config.orientationA = isBoxA ? unit(rng) * 6.2831853f : 0.0f;
+                config.orientationB = isBoxB ? unit(rng) * 6.2831853f : 0.0f;
+
+                a->SetOrientation(config.orientationA);
+                b->SetOrientation(config.orientationB);
+                b->SetPosition(config.positionB);
+                scene.UpdateTransforms();
+
+                const BodyStore& bodies = scene.GetBodyStore();
+                if(bodies.m_transforms[0].bounds.Overlaps(bodies.m_transforms[1].bounds) == false)
+                    continue;
+
+                const Manifold manifold = Run(kernel, bodies, 0u, 1u);
+                Outcome found = Outcome::Count;
+                if(manifold.m_isHit == false)
+                    found = Outcome::Separated;
+                else if(manifold.m_penetration <= scale * 0.05f)
+                    found = Outcome::Touching;
+                else if(manifold.m_penetration >= scale * 0.25f)
+                    found = Outcome::Deep;
+
+                if(found == outcome)
+                {
+                    pairs.push_back(config);
+                    break;
+                }
+            }
+        }
+        return pairs;
+    }
+
+    struct Row
+    {
+        std::string name;
+        double nsPerPair;
+        size_t hits;
+    };
+
+    // best of 'repeat' passes over 'order', in ns per pair
+    Row Measure(const std::string& name, Kernel kernel, const BodyStore& bodies,
+        const std::vector<uint32_t>& order, int repeat)
+    {
+        double best = 1e30;
+        size_t hits = 0u;
+        float checksum = 0.0f;
+        for(int r = 0; r < repeat; ++r)
+        {
+            hits = 0u;
+            bench::Timer timer;
+            for(uint32_t pair : order)
+            {
+                const Manifold manifold = Run(kernel, bodies, pair * 2u, pair * 2u + 1u);
+                hits += manifold.m_isHit ? 1u : 0u;
+                checksum += manifold.m_penetration;
+            }
+            best = std::min(best, timer.ElapsedMs());
+        }
+        // keeps the results alive
+        if(checksum == -1.0f)
+            std::printf(" ");
+        return Row{ name, best * 1e6 / order.size(), hits };
+    }
+
+    std::map<std::string, double> LoadBaseline(const std::string& path)
+    {
+        std::ifstream file(path);
+        if(file.is_open() == false)
+        {
+            std::fprintf(stderr, "narrowphase : can not open %s\n", path.c_str());
+            std::exit(1);
+        }
+        std::stringstream text;
+        text << file.rdbuf();
+        const std::string json = text.str();
+
+        // a flat object of "row": ns
+        std::map<std::string, double> rows;
+        const std::regex entry("\"([^\"]+)\"\\s*:\\s*([-+0-9.eE]+)");
+        for(auto it = std::sregex_iterator(json.begin(), json.end(), entry); it != std::sregex_iterator(); ++it)
+            rows[(*it)[1].str()] = std::stod((*it)[2].str());
+        return rows;
+    }
+
+    void SaveBaseline(const std::string& path, const std::vector<Row>& rows)
+    {
+        FILE* file = std::fopen(path.c_str(), "w");
+        if(file == nullptr)
+        {
+            std::fprintf(stderr, "narrowphase : can not open %s\n", path.c_str());
+            std::exit(1);
+        }
+        std::fprintf(file, "{\n");
+        for(size_t i = 0; i < rows.size(); ++i)
+            std::fprintf(file, "  \"%s\": %.2f%s\n", rows[i].name.c_str(), rows[i].nsPerPair, (i + 1 < rows.size()) ? "," : "");
+        std::fprintf(file, "}\n");
+        std::fclose(file);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t pairCount = static_cast<size_t>(bench::GetArg(argc, argv, "--pairs", 4096));
+    const int repeat = static_cast<int>(bench::GetArg(argc, argv, "--repeat", 20));
+    const uint32_t seed = static_cast<uint32_t>(bench::GetArg(argc, argv, "--seed", 1234));
+    const double threshold = static_cast<double>(bench::GetArg(argc, argv, "--threshold", 15));
+    const std::string baselinePath = bench::GetStringArg(argc, argv, "--baseline", "");
+    const std::string savePath = bench::GetStringArg(argc, argv, "--save-baseline", "");
+
+    std::vector<Row> rows;
+    std::mt19937 rng(seed);
+    const Kernel kernels[] = { Kernel::OBBOBB, Kernel::OBBCircle, Kernel::CircleCircle };
+    for(Kernel kernel : kernels)
+    {
+        const bool isBoxA = kernel != Kernel::CircleCircle;
+        const bool isBoxB = kernel == Kernel::OBBOBB;
+        const std::string kernelName = k_kernelNames[static_cast<size_t>(kernel)];
+
+        std::vector<PairConfig> grouped;
+        for(size_t o = 0; o < static_cast<size_t>(Outcome::Count); ++o)
+        {
+            const std::vector<PairConfig> set = MakePairs(kernel, static_cast<Outcome>(o), pairCount, rng);
+            grouped.insert(grouped.end(), set.begin(), set.end());
+        }
+        std::vector<PairConfig> mixed = grouped;
+        std::shuffle(mixed.begin(), mixed.end(), rng);
+
+        // Every pair gets its own two bodies, pair i is bodies 2i and 2i + 1.
+        // The mixed pairs are a second copy laid out in their shuffled order,
+        // so both orders walk memory front to back and only differ in how
+        // well the branches are predicted.
+        Scene scene(1.0f / 60.0f, 10, std::make_shared<SymplecticEulerIntegrator>());
+        for(const std::vector<PairConfig>* configs : { &grouped, &mixed })
+        {
+            for(const PairConfig& config : *configs)
+            {
+                auto a = scene.AddRigidBody(MakeShape(isBoxA, config.sizeA), float2(0.0f, 0.0f));
+                auto b = scene.AddRigidBody(MakeShape(isBoxB, config.sizeB), config.positionB);
+                a->SetOrientation(config.orientationA);
+                b->SetOrientation(config.orientationB);
+            }
+        }
+        scene.UpdateTransforms();
+        const BodyStore& bodies = scene.GetBodyStore();
+
+        auto range = [](size_t begin, size_t count)
+        {
+            std::vector<uint32_t> pairs(count);
+            for(size_t i = 0; i < count; ++i)
+                pairs[i] = static_cast<uint32_t>(begin + i);
+            return pairs;
+        };
+        for(size_t o = 0; o < static_cast<size_t>(Outcome::Count); ++o)
+        {
+            rows.push_back(Measure(kernelName + "/" + k_outcomeNames[o], kernel, bodies,
+                range(o * pairCount, pairCount), repeat));
+        }
+        rows.push_back(Measure(kernelName + "/grouped", kernel, bodies, range(0u, grouped.size()), repeat));
+        rows.push_back(Measure(kernelName + "/mixed", kernel, bodies, range(grouped.size(), mixed.size()), repeat));
+    }
+
+    std::map<std::string, double> baseline;
+    if(baselinePath.empty() == false)
+        baseline = LoadBaseline(baselinePath);
+
+    std::printf("ns per pair, %zu pairs per set, best of %d, seed %u\n", pairCount, repeat, seed);
+    std::printf("  %-26s %8s %8s %10s %9s\n", "kernel/pairs", "ns", "hits", "baseline", "change");
+    bool isRegression = false;
+    for(const Row& row : rows)
+    {
+        std::printf("  %-26s %8.2f %8zu", row.name.c_str(), row.nsPerPair, row.hits);
+        const auto it = baseline.find(row.name);
+        if(it == baseline.end())
+        {
+            std::printf(" %10s %9s\n", "-", "-");
+            continue;
+        }
+
+        const double change = (row.nsPerPair / it->second - 1.0) * 100.0;
+        const bool isSlower = change > threshold;
+        isRegression = isRegression || isSlower;
+        std::printf(" %10.2f %+8.1f%%%s\n", it->second, change, isSlower ? "  REGRESSION" : "");
+    }
+
+    if(savePath.empty() == false)
+        SaveBaseline(savePath, rows);
+
+    if(isRegression)
+    {
+        std::printf("slower than %s by more than %.0f%%\n", baselinePath.c_str(), threshold);
+        return 1;
+    }
+    return 0;
+}
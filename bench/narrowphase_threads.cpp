@@ -0,0 +1,77 @@
+/**
+ *  Scaling of the parallel narrowphase with the number of threads. The
+ *  candidate pairs of a dense scene are collected once, then run through
+ *  the serial batches and through CollideParallel() on job systems of
+ *  growing size. Every parallel run is checked to produce exactly the
+ *  manifolds of the serial one, in the same order.
+ *
+ *  usage : narrowphase_threads [--bodies N] [--repeat N] [--max-threads N]
+ */
+
+#include <cstdio>
+
+#include "bench_util.hpp"
+
+#include "broadphase.hpp"
+#include "collision.hpp"
+#include "integrator.hpp"
+#include "jobsystem.hpp"
+
+int main(int argc, char* argv[])
+{
+    const size_t bodyCount = static_cast<size_t>(bench::GetArg(argc, argv, "--bodies", 20000));
+    const int repeat = static_cast<int>(bench::GetArg(argc, argv, "--repeat", 20));
+    const size_t maxThreads = static_cast<size_t>(bench::GetArg(argc, argv, "--max-threads", 16));
+
+    auto scene = std::make_shared<Scene>(
+        1.0f / 60.0f, 10, std::make_shared<SymplecticEulerIntegrator>(),
+        std::make_shared<UniformGridBroadphase>());
+    // dense enough that most candidate pairs really touch
+    bench::AddRandomBodies(*scene, bodyCount, 0.3f, 1234u);
+    scene->UpdateTransforms();
+
+    const BodyStore& bodies = scene->GetBodyStore();
+    std::vector<BodyPair> pairs, sorted;
+    std::array<size_t, CollisionHelper::k_shapePairCount + 1> offsets;
+    UniformGridBroadphase().ComputePairs(bodies, pairs);
+    CollisionHelper::SortPairsByShapeType(bodies, pairs, sorted, offsets);
+
+    std::vector<Manifold> serial;
+    serial.reserve(sorted.size());
+    bench::Timer timer;
+    for(int r = 0; r < repeat; ++r)
+    {
+        serial.clear();
+        for(size_t k = 0; k < CollisionHelper::k_shapePairCount; ++k)
+            CollisionHelper::CollideBatch(k, bodies, sorted.data() + offsets[k], offsets[k + 1] - offsets[k], serial);
+    }
+    const double serialMs = timer.ElapsedMs() / repeat;
+
+    std::printf("%zu bodies, %zu pairs, %zu hits, %u hardware threads\n",
+        bodyCount, sorted.size(), serial.size(), std::thread::hardware_concurrency());
+    std::printf("  %-8s %10s %9s %10s\n", "threads", "ms", "speedup", "identical");
+    std::printf("  %-8s %10.3f %9.2f %10s\n", "serial", serialMs, 1.0, "-");
+
+    std::vector<Manifold> parallel;
+    parallel.reserve(sorted.size());
+    OrderedBuffers<Manifold> buffers;
+    for(size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        JobSystem jobs(threads);
+
+        timer.Reset();
+        for(int r = 0; r < repeat; ++r)
+        {
+            parallel.clear();
+            CollisionHelper::CollideParallel(&jobs, bodies, sorted, offsets, buffers, parallel);
+        }
+        const double ms = timer.ElapsedMs() / repeat;
+
+        bool identical = parallel.size() == serial.size();
+        for(size_t i = 0; identical && i < serial.size(); ++i)
+            identical = bench::SameManifold(parallel[i], serial[i]);
+        std::printf("  %-8zu %10.3f %9.2f %10s\n", threads, ms, serialMs / ms, identical ? "yes" : "NO");
+    }
+
+    return 0;
+}
@@ -0,0 +1,229 @@
+/**
+ *  Stepping on a physics thread (see physicsthread.hpp) against stepping in
+ *  the render loop.
+ *
+ *  First the two lock free pieces on their own : a writer publishing
+ *  frames as fast as it can through the triple buffer while a reader takes
+ *  them, every frame read has to be whole (no mix of two publishes) and
+ *  newer than the one before, and a producer pushing numbers through the
+ *  input ring, every number has to come out once and in order.
+ *
+ *  Then the demo loop with a render that takes a given time (a sleep) : in
+ *  the render loop as main.cpp does it, and with a PhysicsThread while the
+ *  render loop reads its frames and posts a spawn every few frames. Reports
+ *  the steps per second of real time (60 is on time), how old a frame is
+ *  when it is drawn, and the spawns that did not make it into the scene.
+ *
+ *  usage : physics_thread [--publishes N] [--seconds N] [--size N]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "bench_util.hpp"
+
+#include "clock.hpp"
+#include "demoscenes.hpp"
+#include "integrator.hpp"
+#include "physicsthread.hpp"
+
+namespace
+{
+    typedef linalg::aliases::float2 float2;
+
+    const float deltaTime = 1.0f / 60.0f;
+    const float accumulateUpperBound = std::max(deltaTime, 0.1f);
+
+    void TripleBufferCheck(long publishes)
+    {
+        const size_t k_width = 256u;
+        TripleBuffer<std::vector<uint64_t>> buffer;
+        std::atomic<bool> isDone(false);
+
+        bench::Timer timer;
+        std::thread writer([&]()
+        {
+            for(long p = 1; p <= publishes; ++p)
+            {
+                std::vector<uint64_t>& slot = buffer.GetBack();
+                slot.assign(k_width, static_cast<uint64_t>(p));
+                buffer.Publish();
+            }
+            isDone.store(true, std::memory_order_release);
+        });
+
+        uint64_t acquires = 0u, newFrames = 0u, torn = 0u, outOfOrder = 0u, last = 0u;
+        bool isLast = false;
+        while(isLast == false)
+        {
+            // one more look after the writer is done, for its last publish
+            isLast = isDone.load(std::memory_order_acquire);
+            ++acquires;
+            if(buffer.Acquire() == false)
+                continue;
+            ++newFrames;
+            const std::vector<uint64_t>& frame = buffer.GetFront();
+            if(frame.size() != k_width || std::count(frame.begin(), frame.end(), frame[0]) != static_cast<long>(k_width))
+                ++torn;
+            if(frame[0] <= last)
+                ++outOfOrder;
+            last = frame[0];
+        }
+        writer.join();
+        const double ms = timer.ElapsedMs();
+
+        std::printf("triple buffer, %ld publishes of %zu values\n", publishes, k_width);
+        std::printf("  publishes/s %.0f  acquires %llu  new frames %llu  torn %llu  out of order %llu  last %s\n",
+            publishes / (ms * 1e-3), static_cast<unsigned long long>(acquires), static_cast<unsigned long long>(newFrames),
+            static_cast<unsigned long long>(torn), static_cast<unsigned long long>(outOfOrder),
+            last == static_cast<uint64_t>(publishes) ? "seen" : "MISSED");
+    }
+
+    void QueueCheck(long count)
+    {
+        SpscQueue<uint64_t> queue(256u);
+
+        bench::Timer timer;
+        uint64_t full = 0u;
+        std::thread producer([&]()
+        {
+            for(long i = 1; i <= count; ++i)
+            {
+                while(queue.TryPush(static_cast<uint64_t>(i)) == false)
+                {
+                    ++full;
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        uint64_t popped = 0u, wrong = 0u, value = 0u;
+        while(popped < static_cast<uint64_t>(count))
+        {
+            if(queue.TryPop(value) == false)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            ++popped;
+            if(value != popped)
+                ++wrong;
+        }
+        producer.join();
+        const double ms = timer.ElapsedMs();
+
+        std::printf("input ring, %ld values through %zu slots\n", count, queue.GetCapacity());
+        std::printf("  values/s %.0f  popped %llu  wrong %llu  pushes into a full ring %llu\n",
+            count / (ms * 1e-3), static_cast<unsigned long long>(popped),
+            static_cast<unsigned long long>(wrong), static_cast<unsigned long long>(full));
+    }
+
+    std::shared_ptr<Scene> MakeScene(int size)
+    {
+        std::shared_ptr<Scene> scene = std::make_shared<Scene>(deltaTime, 10, std::make_shared<SymplecticEulerIntegrator>(),
+            std::make_shared<DynamicTreeBroadphase>(), std::make_shared<SequentialImpulseSolver>());
+        DemoScenes::Build(*scene, "bridge", size, deltaTime);
+        return scene;
+    }
+
+    void Render(double frameMs)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(frameMs));
+    }
+
+    // the loop of main.cpp, stepping and drawing on one thread
+    void RunSerial(double frameMs, double seconds, int size)
+    {
+        std::shared_ptr<Scene> scene = MakeScene(size);
+        uint64_t steps = 0u, frames = 0u;
+        float accumulator = 0.0f;
+
+        bench::Timer timer;
+        uint64_t last = Clock::NowNs();
+        while(timer.ElapsedMs() < seconds * 1e3)
+        {
+            const uint64_t now = Clock::NowNs();
+            accumulator += static_cast<float>((now - last) * 1e-9);
+            last = now;
+            accumulator = std::clamp(accumulator, 0.0f, accumulateUpperBound);
+            while(accumulator >= deltaTime)
+            {
+                scene->Step();
+                ++steps;
+                accumulator -= deltaTime;
+            }
+            Render(frameMs);
+            ++frames;
+        }
+        const double elapsed = timer.ElapsedMs() * 1e-3;
+
+        std::printf("  %-10s %9.1f %11.1f %11.1f %13s %9s\n", "serial", frameMs,
+            steps / elapsed, frames / elapsed, "-", "-");
+    }
+
+    void RunThreaded(double frameMs, double seconds, int size)
+    {
+        std::shared_ptr<Scene> scene = MakeScene(size);
+        const size_t startCount = scene->GetBodyCount();
+        PhysicsThread physics(scene, accumulateUpperBound);
+        uint64_t frames = 0u, posted = 0u, badAlpha = 0u;
+        double ageMs = 0.0;
+
+        bench::Timer timer;
+        physics.Start();
+        while(timer.ElapsedMs() < seconds * 1e3)
+        {
+            const RenderFrame& frame = physics.GetLatestFrame();
+            const uint64_t now = Clock::NowNs();
+            const float alpha = frame.GetAlpha(now);
+            if((alpha >= 0.0f && alpha <= 1.0f) == false)
+                ++badAlpha;
+            ageMs += (now - frame.publishNs) * 1e-6;
+
+            // a spawn every few frames, high above the bridge
+            if(frames % 4u == 0u)
+            {
+                const float2 position(static_cast<float>(posted % 20u) * 2.0f - 20.0f, 40.0f);
+                if(physics.Post(InputEvent{ 0u, InputType::SpawnCircle, 0u, position, float2(0.5f, 0.0f), 0.0f }))
+                    ++posted;
+            }
+
+            Render(frameMs);
+            ++frames;
+        }
+        const double elapsed = timer.ElapsedMs() * 1e-3;
+        physics.Stop();
+        const uint64_t steps = physics.GetStepCount();
+
+        const size_t missing = startCount + posted - std::min(startCount + posted, scene->GetBodyCount());
+        std::printf("  %-10s %9.1f %11.1f %11.1f %13.2f %9llu%s\n", "threaded", frameMs,
+            steps / elapsed, frames / elapsed, frames > 0u ? ageMs / frames : 0.0,
+            static_cast<unsigned long long>(missing + physics.GetDroppedInputCount() + physics.GetFailedInputCount()),
+            badAlpha > 0u ? "  ALPHA OUT OF RANGE" : "");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const long publishes = bench::GetArg(argc, argv, "--publishes", 200000);
+    const double seconds = static_cast<double>(bench::GetArg(argc, argv, "--seconds", 2));
+    const int size = static_cast<int>(bench::GetArg(argc, argv, "--size", 8));
+
+    TripleBufferCheck(publishes);
+    QueueCheck(publishes);
+
+    const double frameMs[] = { 4.0, 16.0, 50.0, 150.0 };
+    std::printf("fixed steps at 60 per second against a render of a given time, bridge of size %d, %.0f s each\n",
+        size, seconds);
+    std::printf("  %-10s %9s %11s %11s %13s %9s\n", "loop", "frame ms", "steps/s", "frames/s", "frame age ms", "lost");
+    for(double ms : frameMs)
+    {
+        RunSerial(ms, seconds, size);
+        RunThreaded(ms, seconds, size);
+    }
+
+    return 0;
+}
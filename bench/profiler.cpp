@@ -0,0 +1,64 @@
+/**
+ *  What the profiler costs a step : the same scene stepped without a
+ *  profiler, with one, and with one streaming a trace. Built with
+ *  PROFILE=0 every row runs without scopes, which is the baseline for the
+ *  first row.
+ *
+ *  usage : profiler [--steps N] [--size N] [--threads N]
+ */
+
+#include <cstdio>
+#include <memory>
+
+#include "bench_util.hpp"
+
+#include "demoscenes.hpp"
+#include "integrator.hpp"
+#include "profiler.hpp"
+
+namespace
+{
+    enum class Mode { Off, Stats, Trace };
+
+    double MeasureMsPerStep(Mode mode, int steps, int size, const std::shared_ptr<JobSystem>& jobs)
+    {
+        const float dt = 1.0f / 60.0f;
+        Scene scene(dt, 10, std::make_shared<SymplecticEulerIntegrator>(),
+            std::make_shared<DynamicTreeBroadphase>(), std::make_shared<ImpulseSolver>(), jobs);
+        DemoScenes::Build(scene, "pyramids", size, dt);
+
+        auto profiler = std::make_shared<Profiler>();
+        if(mode != Mode::Off)
+            scene.SetProfiler(profiler);
+        if(mode == Mode::Trace)
+            profiler->StartTrace("/dev/null");
+
+        bench::Timer timer;
+        for(int s = 0; s < steps; ++s)
+            scene.Step();
+        return timer.ElapsedMs() / steps;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int steps = static_cast<int>(bench::GetArg(argc, argv, "--steps", 300));
+    const int size = static_cast<int>(bench::GetArg(argc, argv, "--size", 8));
+    const long threads = bench::GetArg(argc, argv, "--threads", 0);
+
+    std::shared_ptr<JobSystem> jobs;
+    if(threads > 0)
+        jobs = std::make_shared<JobSystem>(static_cast<size_t>(threads));
+
+    std::printf("ms per step of %d pyramids, %d steps, profiler %s\n", size, steps,
+        RIGIDBODY2D_PROFILE ? "compiled in" : "compiled out");
+
+    const double off = MeasureMsPerStep(Mode::Off, steps, size, jobs);
+    const double stats = MeasureMsPerStep(Mode::Stats, steps, size, jobs);
+    const double trace = MeasureMsPerStep(Mode::Trace, steps, size, jobs);
+
+    std::printf("  %-22s %10.4f\n", "no profiler", off);
+    std::printf("  %-22s %10.4f %+8.2f%%\n", "profiler", stats, (stats / off - 1.0) * 100.0);
+    std::printf("  %-22s %10.4f %+8.2f%%\n", "profiler and trace", trace, (trace / off - 1.0) * 100.0);
+    return 0;
+}
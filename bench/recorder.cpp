@@ -0,0 +1,137 @@
+/**
+ *  Size and cost of trajectory recording on the demo scenes. Every scene
+ *  is run three times : without a recorder, with one, and once more to
+ *  keep a raw copy of every step. Reports the bytes per step against the
+ *  raw 12 bytes per body, the ms per step with and without the recorder,
+ *  and the steps the recorder dropped. Every recorded step read back has
+ *  to be within half the precision of the raw copy, read in order and out
+ *  of order.
+ *
+ *  usage : recorder [--size N] [--steps N] [--path FILE]
+ */
+
+#include <cmath>
+#include <cstdio>
+
+#include "bench_util.hpp"
+
+#include "demoscenes.hpp"
+#include "integrator.hpp"
+#include "trajectory.hpp"
+
+namespace
+{
+    struct Pose
+    {
+        std::vector<float> positionX, positionY, orientation;
+    };
+
+    std::shared_ptr<Scene> MakeScene(const char* name, bool sleep, int size)
+    {
+        const float dt = 1.0f / 60.0f;
+        std::shared_ptr<Scene> scene = std::make_shared<Scene>(dt, 10, std::make_shared<SymplecticEulerIntegrator>(),
+            std::make_shared<DynamicTreeBroadphase>(), std::make_shared<SequentialImpulseSolver>());
+        DemoScenes::Build(*scene, name, size, dt);
+        SleepSettings settings = scene->GetSleepSettings();
+        settings.enabled = sleep;
+        scene->SetSleepSettings(settings);
+        return scene;
+    }
+
+    double RunMs(Scene& scene, int steps)
+    {
+        bench::Timer timer;
+        for(int s = 0; s < steps; ++s)
+            scene.Step();
+        return timer.ElapsedMs();
+    }
+
+    bool IsClose(float value, float raw, float precision)
+    {
+        // the float rounding of 'q * precision' on top of the quantization
+        return std::fabs(value - raw) <= precision * 0.5f + std::fabs(raw) * 1e-6f;
+    }
+
+    bool CheckFrame(TrajectoryReader& reader, size_t frame, const std::vector<Pose>& raw,
+        std::vector<TrajectoryPose>& poses)
+    {
+        reader.ReadFrame(frame, poses);
+        const Pose& pose = raw[reader.GetStep(frame)];
+        if(poses.size() != pose.positionX.size())
+            return false;
+        for(size_t i = 0; i < poses.size(); ++i)
+        {
+            if(IsClose(poses[i].position.x, pose.positionX[i], reader.GetPositionPrecision()) == false ||
+                IsClose(poses[i].position.y, pose.positionY[i], reader.GetPositionPrecision()) == false ||
+                IsClose(poses[i].orientation, pose.orientation[i], reader.GetAnglePrecision()) == false)
+                return false;
+        }
+        return true;
+    }
+
+    bool Measure(const char* name, bool sleep, int size, int steps, const std::string& path)
+    {
+        std::shared_ptr<Scene> plain = MakeScene(name, sleep, size);
+        const double plainMs = RunMs(*plain, steps);
+
+        std::shared_ptr<Scene> recorded = MakeScene(name, sleep, size);
+        std::shared_ptr<TrajectoryRecorder> recorder = std::make_shared<TrajectoryRecorder>(path);
+        recorded->SetRecorder(recorder);
+        const double recordedMs = RunMs(*recorded, steps);
+        recorder->Close();
+
+        // the scenes are deterministic, this one gives the raw poses the
+        // recorded run had
+        std::shared_ptr<Scene> reference = MakeScene(name, sleep, size);
+        std::vector<Pose> raw(steps);
+        for(int s = 0; s < steps; ++s)
+        {
+            reference->Step();
+            const BodyStore& store = reference->GetBodyStore();
+            raw[s].positionX = store.m_positionX;
+            raw[s].positionY = store.m_positionY;
+            raw[s].orientation = store.m_orientation;
+        }
+
+        TrajectoryReader reader(path);
+        std::vector<TrajectoryPose> poses;
+        bool isClose = recorder->IsGood() &&
+            reader.GetFrameCount() + recorder->GetDroppedCount() == static_cast<size_t>(steps);
+        for(size_t f = 0; f < reader.GetFrameCount() && isClose; ++f)
+            isClose = CheckFrame(reader, f, raw, poses);
+        // backwards, every frame rebuilt from its keyframe
+        for(size_t f = reader.GetFrameCount(); f > 0u && isClose; f -= std::min<size_t>(f, 37u))
+            isClose = CheckFrame(reader, f - 1u, raw, poses);
+
+        const size_t bodyCount = recorded->GetBodyCount();
+        const double bytesPerStep = static_cast<double>(recorder->GetByteCount()) / steps;
+        const double rawPerStep = bodyCount * 3.0 * sizeof(float);
+        std::printf("  %-9s %-5s %6zu %10.1f %10.0f %7.1fx %10.4f %10.4f %8.1f%% %8llu %7s\n",
+            name, sleep ? "on" : "off", bodyCount, bytesPerStep, rawPerStep, rawPerStep / bytesPerStep,
+            plainMs / steps, recordedMs / steps, (recordedMs / plainMs - 1.0) * 100.0,
+            static_cast<unsigned long long>(recorder->GetDroppedCount()), isClose ? "yes" : "NO");
+        return isClose;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int size = static_cast<int>(bench::GetArg(argc, argv, "--size", 10));
+    const int steps = static_cast<int>(bench::GetArg(argc, argv, "--steps", 600));
+    const std::string path = bench::GetStringArg(argc, argv, "--path", "recorder_bench.traj");
+
+    const RecorderSettings settings;
+    std::printf("%d steps, precision %g m and %g rad, a keyframe every %u steps\n",
+        steps, settings.positionPrecision, settings.anglePrecision, settings.keyframeInterval);
+    std::printf("  %-9s %-5s %6s %10s %10s %8s %10s %10s %9s %8s %7s\n", "scene", "sleep", "bodies",
+        "B/step", "raw B", "ratio", "ms plain", "ms record", "overhead", "dropped", "close");
+
+    bool isClose = true;
+    isClose = Measure("stacks", true, size, steps, path) && isClose;
+    isClose = Measure("pyramids", false, size, steps, path) && isClose;
+    isClose = Measure("bridge", false, size, steps, path) && isClose;
+    isClose = Measure("rain", false, size, steps, path) && isClose;
+
+    std::remove(path.c_str());
+    return isClose ? 0 : 1;
+}
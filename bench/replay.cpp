@@ -0,0 +1,219 @@
+/**
+ *  Records random inputs on a few scenes (bodies spawned and removed,
+ *  velocities set, forces added, sleeping switched) with the state hash of
+ *  every step, then replays them from a snapshot of where the recording
+ *  started with 0, 2 and 4 threads. Every replay has to give the hashes of
+ *  the recording. A replay with one input changed by a single ulp has to be
+ *  caught at the step after it. Also reports what hashing the state costs
+ *  next to a step.
+ *
+ *  usage : replay [--steps N] [--seed N] [--path FILE]
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "bench_util.hpp"
+
+#include "demoscenes.hpp"
+#include "integrator.hpp"
+#include "replay.hpp"
+#include "snapshot.hpp"
+
+namespace
+{
+    struct Config
+    {
+        const char* name;
+        const char* scene;
+        std::shared_ptr<Broadphase> (*makeBroadphase)();
+        std::shared_ptr<Solver> (*makeSolver)();
+    };
+
+    const Config k_configs[] =
+    {
+        { "pyramids, brute, impulse", "pyramids",
+            []() -> std::shared_ptr<Broadphase> { return std::make_shared<BruteForceBroadphase>(); },
+            []() -> std::shared_ptr<Solver> { return std::make_shared<ImpulseSolver>(); } },
+        { "stacks, grid, colored", "stacks",
+            []() -> std::shared_ptr<Broadphase> { return std::make_shared<UniformGridBroadphase>(); },
+            []() -> std::shared_ptr<Solver> { return std::make_shared<GraphColoringSolver>(); } },
+        { "bridge, tree, sequential", "bridge",
+            []() -> std::shared_ptr<Broadphase> { return std::make_shared<DynamicTreeBroadphase>(); },
+            []() -> std::shared_ptr<Solver> { return std::make_shared<SequentialImpulseSolver>(); } },
+        { "rain, sap, sequential", "rain",
+            []() -> std::shared_ptr<Broadphase> { return std::make_shared<SweepAndPruneBroadphase>(); },
+            []() -> std::shared_ptr<Solver> { return std::make_shared<SequentialImpulseSolver>(); } },
+    };
+
+    // a random dynamic body, null if there is none
+    std::shared_ptr<RigidBody2D> PickBody(Scene& scene, std::mt19937& random)
+    {
+        for(int attempt = 0; attempt < 16 && scene.GetBodyCount() > 0u; ++attempt)
+        {
+            const uint32_t index = static_cast<uint32_t>(random() % scene.GetBodyCount());
+            if(scene.GetBodyStore().m_invMass[index] > 0.0f)
+                return scene.GetBody(index);
+        }
+        return nullptr;
+    }
+
+    // only bodies spawned here are removed, joints of the scene would keep
+    // the others
+    void DoRandomInput(InputRecorder& recorder, Scene& scene, std::mt19937& random,
+        std::vector<std::shared_ptr<RigidBody2D>>& spawned)
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        const bench::float2 position(unit(random) * 20.0f, 25.0f + unit(random) * 5.0f);
+        const uint32_t kind = random() % 8u;
+        if(kind == 0u)
+        {
+            spawned.push_back(recorder.SpawnCircle(position, 0.5f + std::fabs(unit(random))));
+            return;
+        }
+        if(kind == 1u)
+        {
+            spawned.push_back(recorder.SpawnBox(position,
+                bench::float2(1.0f + std::fabs(unit(random)), 1.0f + std::fabs(unit(random)))));
+            return;
+        }
+        if(kind == 2u && random() % 8u == 0u)
+        {
+            recorder.SetSleeping(!scene.GetSleepSettings().enabled);
+            return;
+        }
+
+        if(kind == 3u)
+        {
+            if(spawned.empty() == false)
+            {
+                const size_t pick = random() % spawned.size();
+                recorder.RemoveBody(spawned[pick]);
+                spawned.erase(spawned.begin() + pick);
+            }
+            return;
+        }
+
+        std::shared_ptr<RigidBody2D> body = PickBody(scene, random);
+        if(body == nullptr)
+            return;
+        if(kind == 4u)
+            recorder.SetVelocity(body, bench::float2(unit(random), unit(random)) * 10.0f);
+        else if(kind == 5u)
+            recorder.SetAngularVelocity(body, unit(random) * 5.0f);
+        else
+            recorder.AddForce(body, bench::float2(unit(random), unit(random)) * 500.0f);
+    }
+
+    // replays the recording from the snapshot and checks every step
+    bool Replay(const std::string& snapshotPath, const InputRecording& recording,
+        const std::string& hashPath, size_t threads, std::string& report)
+    {
+        std::shared_ptr<JobSystem> jobs;
+        if(threads > 0u)
+            jobs = std::make_shared<JobSystem>(threads);
+        std::shared_ptr<Scene> scene = SceneSnapshot::Load(snapshotPath, jobs);
+
+        ReplayDriver driver(*scene, recording);
+        StateHashVerifier verifier(hashPath);
+        while(driver.IsDone() == false)
+        {
+            driver.Step();
+            if(verifier.Check(driver.GetStep(), scene->GetBodyStore()) == false)
+                break;
+        }
+        report = verifier.GetReport();
+        return verifier.HasDiverged() == false && verifier.GetCheckedCount() == recording.GetStepCount();
+    }
+
+    bool Check(const Config& config, int steps, uint32_t seed, const std::string& path)
+    {
+        const std::string snapshotPath = path + ".snapshot";
+        const std::string inputPath = path + ".inputs";
+        const std::string hashPath = path + ".hashes";
+
+        const float dt = 1.0f / 60.0f;
+        Scene scene(dt, 10, std::make_shared<SymplecticEulerIntegrator>(), config.makeBroadphase(), config.makeSolver());
+        DemoScenes::Build(scene, config.scene, 6, dt);
+        SceneSnapshot::Save(scene, snapshotPath);
+
+        // the recording, with the time of the steps and of hashing apart
+        std::mt19937 random(seed);
+        InputRecorder recorder(scene);
+        std::vector<std::shared_ptr<RigidBody2D>> spawned;
+        StateHashWriter writer(hashPath);
+        double stepMs = 0.0, hashMs = 0.0;
+        for(int s = 0; s < steps; ++s)
+        {
+            if(random() % 4u == 0u)
+                DoRandomInput(recorder, scene, random, spawned);
+
+            bench::Timer timer;
+            recorder.Step();
+            stepMs += timer.ElapsedMs();
+
+            timer.Reset();
+            writer.Add(recorder.GetStep(), scene.GetBodyStore());
+            hashMs += timer.ElapsedMs();
+        }
+        writer.Close();
+        recorder.GetRecording().Save(inputPath);
+        const InputRecording recording = InputRecording::Load(inputPath);
+
+        std::printf("  %-26s %5zu bodies %4zu inputs, step %.3f ms, hash %.4f ms (%.1f%%)\n", config.name,
+            scene.GetBodyCount(), recording.GetEvents().size(), stepMs / steps, hashMs / steps, hashMs / stepMs * 100.0);
+
+        bool isSame = true;
+        std::string report;
+        for(size_t threads : { 0u, 2u, 4u })
+        {
+            const bool isReplayed = Replay(snapshotPath, recording, hashPath, threads, report);
+            std::printf("    replay with %zu threads : %s%s\n", threads, isReplayed ? "identical" : "DIFFERENT at ",
+                report.c_str());
+            isSame = isReplayed && isSame;
+        }
+
+        // a velocity one ulp off has to show up right after its step
+        InputRecording changed;
+        uint64_t changedStep = 0u;
+        bool isChanged = false;
+        for(InputEvent event : recording.GetEvents())
+        {
+            if(isChanged == false && event.type == InputType::SetVelocity && event.step >= recording.GetStepCount() / 4u)
+            {
+                event.value.x = std::nextafter(event.value.x, 1e30f);
+                changedStep = event.step;
+                isChanged = true;
+            }
+            changed.Add(event);
+        }
+        changed.SetStepCount(recording.GetStepCount());
+        if(isChanged)
+        {
+            const bool isCaught = Replay(snapshotPath, changed, hashPath, 2u, report) == false &&
+                report.compare(0, report.find(' ', 5), "step " + std::to_string(changedStep + 1u)) == 0;
+            std::printf("    one ulp off at step %llu : %s %s\n", static_cast<unsigned long long>(changedStep),
+                isCaught ? "caught at" : "NOT CAUGHT,", report.c_str());
+            isSame = isCaught && isSame;
+        }
+
+        std::remove(snapshotPath.c_str());
+        std::remove(inputPath.c_str());
+        std::remove(hashPath.c_str());
+        return isSame;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int steps = static_cast<int>(bench::GetArg(argc, argv, "--steps", 600));
+    const uint32_t seed = static_cast<uint32_t>(bench::GetArg(argc, argv, "--seed", 1234));
+    const std::string path = bench::GetStringArg(argc, argv, "--path", "replay_bench");
+
+    std::printf("%d steps of random inputs, replayed from a snapshot and checked step by step\n", steps);
+    bool isSame = true;
+    for(const Config& config : k_configs)
+        isSame = Check(config, steps, seed, path) && isSame;
+    return isSame ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+/**
+ *  Cost of a step with the runge kutta integrator in each contact mode,
+ *  against the symplectic euler integrator. Rows of stacks are dropped on
+ *  a floor and simulated for a while before measuring. Heap allocations
+ *  are counted through a replaced operator new. Once the buffers grew to
+ *  their size the integrators add none of their own, what is left in every
+ *  row is the pair set of the tree broadphase.
+ *
+ *  usage : rk4 [--stacks N] [--height N] [--steps N]
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "bench_util.hpp"
+
+#include "integrator.hpp"
+
+namespace
+{
+    typedef linalg::aliases::float2 float2;
+
+    std::atomic<size_t> s_allocations{ 0u };
+
+    std::shared_ptr<Scene> Build(const std::shared_ptr<Integrator>& integrator, int stackCount, int height)
+    {
+        auto scene = std::make_shared<Scene>(
+            1.0f / 60.0f, 10, integrator, std::make_shared<DynamicTreeBroadphase>());
+
+        const float width = stackCount * 2.0f;
+        auto floor = scene->AddRigidBody(std::make_shared<OBB>(float2(width + 10.0f, 2.0f)), float2(0.0f, -1.0f));
+        floor->SetStatic();
+        for(int x = 0; x < stackCount; ++x)
+        {
+            for(int y = 0; y < height; ++y)
+            {
+                const float2 position(x * 2.0f - width * 0.5f, y * 1.05f + 0.6f);
+                scene->AddRigidBody(std::make_shared<OBB>(float2(1.0f, 1.0f)), position);
+            }
+        }
+        return scene;
+    }
+}
+
+void* operator new(size_t _size)
+{
+    s_allocations.fetch_add(1u, std::memory_order_relaxed);
+    if(void* memory = std::malloc(_size == 0u ? 1u : _size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* _memory) noexcept
+{
+    std::free(_memory);
+}
+
+void operator delete(void* _memory, size_t) noexcept
+{
+    std::free(_memory);
+}
+
+int main(int argc, char* argv[])
+{
+    const int stackCount = static_cast<int>(bench::GetArg(argc, argv, "--stacks", 300));
+    const int height = static_cast<int>(bench::GetArg(argc, argv, "--height", 5));
+    const int steps = static_cast<int>(bench::GetArg(argc, argv, "--steps", 200));
+
+    struct Row
+    {
+        const char* name;
+        std::shared_ptr<Integrator> integrator;
+    };
+    const Row rows[] =
+    {
+        { "symplectic euler", std::make_shared<SymplecticEulerIntegrator>() },
+        { "rk4 every stage", std::make_shared<RungeKuttaFourthIntegrator>(ContactMode::EveryStage) },
+        { "rk4 reuse pairs", std::make_shared<RungeKuttaFourthIntegrator>(ContactMode::ReusePairs) },
+        { "rk4 once per step", std::make_shared<RungeKuttaFourthIntegrator>(ContactMode::OncePerStep) },
+    };
+
+    std::printf("%d stacks of %d boxes, %d steps\n", stackCount, height, steps);
+    std::printf("  %-18s %10s %9s %14s %14s\n", "integrator", "ms/step", "relative", "allocs (warm)", "allocs/step");
+
+    double baseMs = 0.0;
+    for(const Row& row : rows)
+    {
+        std::shared_ptr<Scene> scene = Build(row.integrator, stackCount, height);
+
+        // the first steps grow every buffer to its size
+        s_allocations = 0u;
+        for(int s = 0; s < 30; ++s)
+            scene->Step();
+        const size_t warmAllocations = s_allocations.load();
+
+        s_allocations = 0u;
+        bench::Timer timer;
+        for(int s = 0; s < steps; ++s)
+            scene->Step();
+        const double ms = timer.ElapsedMs() / steps;
+        const double allocations = static_cast<double>(s_allocations.load()) / steps;
+
+        if(baseMs == 0.0)
+            baseMs = ms;
+        std::printf("  %-18s %10.3f %9.2f %14zu %14.2f\n", row.name, ms, ms / baseMs, warmAllocations, allocations);
+    }
+
+    return 0;
+}
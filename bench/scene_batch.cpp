@@ -0,0 +1,136 @@
+/**
+ *  World steps per second of many small independent worlds, one Scene per
+ *  world stepped one after the other against a SceneBatch holding all of
+ *  them, without and with a job system. Every world of the batch has to end
+ *  with exactly the bodies of its scene. Every batch row starts with a
+ *  Reset(), so the rows after the first also check that a reset gives the
+ *  worlds back as they were added. Also reports what a reset costs.
+ *
+ *  usage : scene_batch [--worlds N] [--steps N] [--seed N]
+ *    with 0 worlds the number of worlds is picked so that every row has
+ *    about 50000 bodies
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "bench_util.hpp"
+
+#include "integrator.hpp"
+#include "scenebatch.hpp"
+
+namespace
+{
+    // a floor and a loose pile of boxes and circles, different for every seed
+    void BuildWorld(SceneBase& scene, int bodyCount, uint32_t seed)
+    {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+
+        auto floor = scene.AddRigidBody(std::make_shared<OBB>(bench::float2(30.0f, 2.0f)), bench::float2(0.0f, -1.0f));
+        floor->SetStatic();
+        for(int i = 1; i < bodyCount; ++i)
+        {
+            const bench::float2 position((i % 8) * 1.6f - 5.6f + jitter(random), (i / 8) * 1.3f + 0.8f + jitter(random));
+            if(random() % 3u == 0u)
+                scene.AddRigidBody(std::make_shared<Circle>(0.5f), position);
+            else
+                scene.AddRigidBody(std::make_shared<OBB>(bench::float2(1.0f, 1.0f)), position);
+        }
+    }
+
+    bool SameRange(const std::vector<float>& batch, uint32_t offset, const std::vector<float>& scene)
+    {
+        return std::memcmp(batch.data() + offset, scene.data(), scene.size() * sizeof(float)) == 0;
+    }
+
+    bool SameWorld(const SceneBatch& batch, size_t world, const BodyStore& scene)
+    {
+        const BodyStore& store = batch.GetBodyStore();
+        const uint32_t offset = batch.GetWorldOffset(world);
+        return batch.GetWorldBodyCount(world) == scene.Size() &&
+            SameRange(store.m_positionX, offset, scene.m_positionX) && SameRange(store.m_positionY, offset, scene.m_positionY) &&
+            SameRange(store.m_velocityX, offset, scene.m_velocityX) && SameRange(store.m_velocityY, offset, scene.m_velocityY) &&
+            SameRange(store.m_orientation, offset, scene.m_orientation) &&
+            SameRange(store.m_angularVelocity, offset, scene.m_angularVelocity);
+    }
+
+    double MeasureBatch(SceneBatch& batch, int steps)
+    {
+        batch.Reset();
+        bench::Timer timer;
+        for(int s = 0; s < steps; ++s)
+            batch.Step();
+        return timer.ElapsedMs();
+    }
+
+    bool Compare(int bodyCount, size_t worldCount, int steps, uint32_t seed)
+    {
+        const float dt = 1.0f / 60.0f;
+        std::vector<std::unique_ptr<Scene>> scenes;
+        SceneBatch batch(dt, 10);
+        batch.Reserve(worldCount, worldCount * bodyCount);
+        for(size_t w = 0; w < worldCount; ++w)
+        {
+            scenes.emplace_back(new Scene(dt, 10, std::make_shared<SymplecticEulerIntegrator>(),
+                std::make_shared<BruteForceBroadphase>(), std::make_shared<ImpulseSolver>()));
+            BuildWorld(*scenes.back(), bodyCount, seed + static_cast<uint32_t>(w));
+            batch.AddWorld(*scenes.back());
+        }
+
+        bench::Timer timer;
+        for(int s = 0; s < steps; ++s)
+        {
+            for(std::unique_ptr<Scene>& scene : scenes)
+                scene->Step();
+        }
+        const double sceneMs = timer.ElapsedMs();
+
+        const double worldSteps = static_cast<double>(worldCount) * steps;
+        std::printf("  %6d %7zu %-16s %12.0f %8s %10s\n", bodyCount, worldCount, "Scene per world",
+            worldSteps / (sceneMs * 1e-3), "1.00", "");
+
+        bool isSame = true;
+        for(size_t threads : { 0u, 2u, 4u })
+        {
+            batch.SetJobSystem(threads > 0u ? std::make_shared<JobSystem>(threads) : nullptr);
+            const double batchMs = MeasureBatch(batch, steps);
+
+            bool isWorldSame = true;
+            for(size_t w = 0; w < worldCount && isWorldSame; ++w)
+                isWorldSame = SameWorld(batch, w, scenes[w]->GetBodyStore());
+            isSame = isSame && isWorldSame;
+
+            char name[32];
+            std::snprintf(name, sizeof(name), "batch, %zu threads", threads);
+            std::printf("  %6d %7zu %-16s %12.0f %8.2f %10s\n", bodyCount, worldCount, name,
+                worldSteps / (batchMs * 1e-3), sceneMs / batchMs, isWorldSame ? "yes" : "NO");
+        }
+
+        timer.Reset();
+        batch.Reset();
+        const double resetMs = timer.ElapsedMs();
+        std::printf("  %6d %7zu %-16s %12.3f us per world\n", bodyCount, worldCount, "reset", resetMs * 1e3 / worldCount);
+        return isSame;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t worlds = static_cast<size_t>(bench::GetArg(argc, argv, "--worlds", 0));
+    const int steps = static_cast<int>(bench::GetArg(argc, argv, "--steps", 120));
+    const uint32_t seed = static_cast<uint32_t>(bench::GetArg(argc, argv, "--seed", 1234));
+    const int bodyCounts[] = { 10, 50, 200 };
+
+    std::printf("world steps per second, %d steps, symplectic euler, impulse solver\n", steps);
+    std::printf("  %6s %7s %-16s %12s %8s %10s\n", "bodies", "worlds", "", "world steps/s", "speedup", "identical");
+
+    bool isSame = true;
+    for(int bodyCount : bodyCounts)
+    {
+        const size_t worldCount = (worlds > 0u) ? worlds : static_cast<size_t>(50000 / bodyCount);
+        isSame = Compare(bodyCount, worldCount, steps, seed) && isSame;
+    }
+    return isSame ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/**
+ *  Step time of a scene of settled bodies against the number of awake
+ *  ones. Stacks of boxes are dropped onto a floor and simulated until every
+ *  island sleeps, then a growing share of the stacks is woken (and kept
+ *  awake while measuring) to show that the cost of a step follows the
+ *  awake bodies. The same scene without sleeping is the baseline.
+ *  What is left with every body asleep is mostly the broadphase, which
+ *  still reports every pair of (fattened) bounds that overlap.
+ *
+ *  usage : sleeping [--stacks N] [--height N] [--steps N]
+ */
+
+#include <cstdio>
+
+#include "bench_util.hpp"
+
+#include "integrator.hpp"
+#include "solver.hpp"
+
+namespace
+{
+    typedef linalg::aliases::float2 float2;
+
+    struct World
+    {
+        std::shared_ptr<Scene> scene;
+        // bottom box of every stack, waking it wakes the stack
+        std::vector<std::shared_ptr<RigidBody2D>> stacks;
+    };
+
+    World Build(int stackCount, int height)
+    {
+        World world;
+        world.scene = std::make_shared<Scene>(
+            1.0f / 60.0f, 4, std::make_shared<SymplecticEulerIntegrator>(),
+            std::make_shared<DynamicTreeBroadphase>(), std::make_shared<SequentialImpulseSolver>());
+
+        const float width = stackCount * 3.0f;
+        auto floor = world.scene->AddRigidBody(std::make_shared<OBB>(float2(width + 10.0f, 2.0f)), float2(0.0f, -1.0f));
+        floor->SetStatic();
+
+        for(int x = 0; x < stackCount; ++x)
+        {
+            for(int y = 0; y < height; ++y)
+            {
+                const float2 position(x * 3.0f - width * 0.5f, y * 1.0f + 0.5f);
+                auto body = world.scene->AddRigidBody(std::make_shared<OBB>(float2(1.0f, 1.0f)), position);
+                if(y == 0)
+                    world.stacks.push_back(body);
+            }
+        }
+        return world;
+    }
+
+    double MeasureMs(Scene& scene, int steps)
+    {
+        bench::Timer timer;
+        for(int i = 0; i < steps; ++i)
+            scene.Step();
+        return timer.ElapsedMs() / steps;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int stackCount = static_cast<int>(bench::GetArg(argc, argv, "--stacks", 2000));
+    const int height = static_cast<int>(bench::GetArg(argc, argv, "--height", 5));
+    const int steps = static_cast<int>(bench::GetArg(argc, argv, "--steps", 60));
+
+    World world = Build(stackCount, height);
+    Scene& scene = *world.scene;
+
+    SleepSettings settings;
+    settings.enabled = true;
+    scene.SetSleepSettings(settings);
+
+    // the floor never sleeps
+    int settleSteps = 0;
+    while(scene.GetAwakeBodyCount() > 1u && settleSteps < 1200)
+    {
+        scene.Step();
+        ++settleSteps;
+    }
+    std::printf("%zu bodies, %zu asleep in %zu islands after %d steps\n",
+        scene.GetBodyCount(), scene.GetIslands().GetSleepingBodyCount(),
+        scene.GetIslands().GetSleepingIslandCount(), settleSteps);
+
+    // keep woken stacks awake while measuring
+    SleepSettings awake = settings;
+    awake.timeToSleep = 1e9f;
+
+    std::printf("  %-8s %8s %10s %14s\n", "woken", "awake", "ms/step", "us/awake body");
+    const int percents[] = { 0, 1, 10, 50, 100 };
+    for(int percent : percents)
+    {
+        const int woken = stackCount * percent / 100;
+        for(int i = 0; i < woken; ++i)
+            world.stacks[i]->Wake();
+
+        scene.SetSleepSettings(awake);
+        scene.Step();
+        const size_t awakeCount = scene.GetAwakeBodyCount();
+        const double ms = MeasureMs(scene, steps);
+        std::printf("  %6d %% %8zu %10.3f %14.3f\n", percent, awakeCount, ms, ms * 1e3 / awakeCount);
+
+        // let them fall asleep again before the next run
+        scene.SetSleepSettings(settings);
+        for(int i = 0; i < 600 && scene.GetAwakeBodyCount() > 1u; ++i)
+            scene.Step();
+    }
+
+    SleepSettings off = settings;
+    off.enabled = false;
+    scene.SetSleepSettings(off);
+    std::printf("  %-8s %8zu %10.3f\n", "no sleep", scene.GetBodyCount(), MeasureMs(scene, steps));
+
+    return 0;
+}
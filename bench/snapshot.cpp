@@ -0,0 +1,143 @@
+/**
+ *  Save and load throughput of scene snapshots in MB/s, on a large scene
+ *  of random bodies. The loaded scene has to hold exactly the body arrays
+ *  of the saved one, and saving it again has to give the same bytes.
+ *
+ *  Then a few demo scenes are stepped for a while, saved, loaded and both
+ *  copies stepped on. They have to stay identical : the impulse solver does
+ *  not warm start, so the pair cache left out of a snapshot does not
+ *  matter. The stacks with sleeping use the sequential impulse solver, the
+ *  only one they fall asleep with, and check that sleeping islands stay
+ *  asleep after loading.
+ *
+ *  usage : snapshot [--bodies N] [--repeat N] [--path FILE]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "bench_util.hpp"
+
+#include "demoscenes.hpp"
+#include "integrator.hpp"
+#include "joint.hpp"
+#include "snapshot.hpp"
+
+namespace
+{
+    bool SameBodies(const BodyStore& a, const BodyStore& b)
+    {
+        auto same = [](const std::vector<float>& x, const std::vector<float>& y)
+        {
+            return x.size() == y.size() && std::memcmp(x.data(), y.data(), x.size() * sizeof(float)) == 0;
+        };
+        return same(a.m_positionX, b.m_positionX) && same(a.m_positionY, b.m_positionY) &&
+            same(a.m_velocityX, b.m_velocityX) && same(a.m_velocityY, b.m_velocityY) &&
+            same(a.m_forceX, b.m_forceX) && same(a.m_forceY, b.m_forceY) &&
+            same(a.m_orientation, b.m_orientation) && same(a.m_angularVelocity, b.m_angularVelocity) &&
+            same(a.m_torque, b.m_torque) && same(a.m_mass, b.m_mass) && same(a.m_invMass, b.m_invMass) &&
+            same(a.m_inertia, b.m_inertia) && same(a.m_invInertia, b.m_invInertia) &&
+            same(a.m_restitution, b.m_restitution) && same(a.m_staticFriction, b.m_staticFriction) &&
+            same(a.m_dynamicFriction, b.m_dynamicFriction) && same(a.m_sleepTime, b.m_sleepTime);
+    }
+
+    std::vector<char> ReadFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // steps a demo scene, saves and loads it, then steps both copies on
+    bool CheckContinuation(const char* name, bool sleep, const std::string& path)
+    {
+        const float dt = 1.0f / 60.0f;
+        std::shared_ptr<Solver> solver = sleep ?
+            std::static_pointer_cast<Solver>(std::make_shared<SequentialImpulseSolver>()) :
+            std::static_pointer_cast<Solver>(std::make_shared<ImpulseSolver>());
+        Scene scene(dt, 10, std::make_shared<SymplecticEulerIntegrator>(),
+            std::make_shared<DynamicTreeBroadphase>(), solver);
+        DemoScenes::Build(scene, name, 6, dt);
+        SleepSettings settings = scene.GetSleepSettings();
+        settings.enabled = sleep;
+        scene.SetSleepSettings(settings);
+
+        // long enough for the stacks to fall asleep
+        for(int s = 0; s < (sleep ? 900 : 120); ++s)
+            scene.Step();
+        SceneSnapshot::Save(scene, path);
+        std::shared_ptr<Scene> loaded = SceneSnapshot::Load(path);
+
+        for(int s = 0; s < 240; ++s)
+        {
+            scene.Step();
+            loaded->Step();
+        }
+        const size_t asleep = scene.GetBodyCount() - scene.GetAwakeBodyCount();
+        const bool isSame = SameBodies(scene.GetBodyStore(), loaded->GetBodyStore()) &&
+            asleep == loaded->GetBodyCount() - loaded->GetAwakeBodyCount();
+        std::printf("  %-10s sleep %-3s %5zu bodies %3zu joints, %5zu asleep : %s\n", name, sleep ? "on" : "off",
+            scene.GetBodyCount(), scene.GetJoints().size(), asleep, isSame ? "identical" : "DIFFERENT");
+        return isSame;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t bodyCount = static_cast<size_t>(bench::GetArg(argc, argv, "--bodies", 1000000));
+    const int repeat = static_cast<int>(bench::GetArg(argc, argv, "--repeat", 3));
+    const std::string path = bench::GetStringArg(argc, argv, "--path", "snapshot_bench.bin");
+    const std::string copyPath = path + ".copy";
+
+    Scene scene(1.0f / 60.0f, 10, std::make_shared<RungeKuttaFourthIntegrator>(ContactMode::ReusePairs),
+        std::make_shared<UniformGridBroadphase>(), std::make_shared<SequentialImpulseSolver>(true, 0.1f, 0.02f));
+    std::vector<std::shared_ptr<RigidBody2D>> bodies = bench::AddRandomBodies(scene, bodyCount, 0.3f, 1234u);
+    for(size_t i = 0; i + 1 < bodies.size(); i += 97)
+    {
+        if(i % 2 == 0)
+            scene.AddJoint(std::make_shared<SpringJoint>(bodies[i], bodies[i + 1], 2.0f, 50.0f));
+        else
+            scene.AddJoint(std::make_shared<DistanceJoint>(bodies[i], bodies[i + 1], 3.0f, 1.0f / 60.0f));
+    }
+
+    const double megabytes = SceneSnapshot::GetSize(scene) / (1024.0 * 1024.0);
+    double saveMs = 1e30, loadMs = 1e30;
+    std::shared_ptr<Scene> loaded;
+    for(int r = 0; r < repeat; ++r)
+    {
+        bench::Timer timer;
+        SceneSnapshot::Save(scene, path);
+        saveMs = std::min(saveMs, timer.ElapsedMs());
+
+        loaded.reset();
+        timer.Reset();
+        loaded = SceneSnapshot::Load(path);
+        loadMs = std::min(loadMs, timer.ElapsedMs());
+    }
+
+    SceneSnapshot::Save(*loaded, copyPath);
+    const bool isSameBodies = SameBodies(scene.GetBodyStore(), loaded->GetBodyStore()) &&
+        loaded->GetJoints().size() == scene.GetJoints().size();
+    const bool isSameFile = ReadFile(path) == ReadFile(copyPath);
+
+    std::printf("%zu bodies, %zu joints, %.1f MB, best of %d (the file is in the page cache)\n",
+        bodyCount, scene.GetJoints().size(), megabytes, repeat);
+    std::printf("  %-6s %10s %10s\n", "", "ms", "MB/s");
+    std::printf("  %-6s %10.2f %10.1f\n", "save", saveMs, megabytes / (saveMs * 1e-3));
+    std::printf("  %-6s %10.2f %10.1f\n", "load", loadMs, megabytes / (loadMs * 1e-3));
+    std::printf("  bodies identical : %s, saved again identical : %s\n",
+        isSameBodies ? "yes" : "NO", isSameFile ? "yes" : "NO");
+
+    std::printf("stepping on after a save and load\n");
+    bool isSame = isSameBodies && isSameFile;
+    isSame = CheckContinuation("pyramids", false, copyPath) && isSame;
+    isSame = CheckContinuation("stacks", true, copyPath) && isSame;
+    isSame = CheckContinuation("bridge", false, copyPath) && isSame;
+    isSame = CheckContinuation("chain", false, copyPath) && isSame;
+
+    std::remove(path.c_str());
+    std::remove(copyPath.c_str());
+    return isSame ? 0 : 1;
+}
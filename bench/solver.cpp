@@ -0,0 +1,132 @@
+/**
+ *  Stack stability of the original impulse solver against the sequential
+ *  impulse solver with (and without) warm starting, at several iteration
+ *  counts. A column of boxes and a pyramid are dropped onto a static floor
+ *  and simulated for a while. Drift is how far the top box ended up from
+ *  where it started, jitter the mean speed of all boxes over the last
+ *  second, both should be close to 0 for a stable stack.
+ *
+ *  usage : solver [--height N] [--base N] [--steps N]
+ */
+
+#include <cstdio>
+
+#include "bench_util.hpp"
+
+#include "integrator.hpp"
+#include "solver.hpp"
+
+namespace
+{
+    typedef linalg::aliases::float2 float2;
+
+    struct Result
+    {
+        float drift;
+        float jitter;
+        float maxTilt;
+        double stepMs;
+    };
+
+    // boxes of '_size' resting exactly on each other, returns the top box
+    std::shared_ptr<RigidBody2D> BuildColumn(Scene& scene, int height, float x)
+    {
+        std::shared_ptr<RigidBody2D> top;
+        for(int i = 0; i < height; ++i)
+            top = scene.AddRigidBody(std::make_shared<OBB>(float2(1.0f, 1.0f)), float2(x, 0.5f + i * 1.0f));
+        return top;
+    }
+
+    std::shared_ptr<RigidBody2D> BuildPyramid(Scene& scene, int base, float x)
+    {
+        std::shared_ptr<RigidBody2D> top;
+        for(int row = 0; row < base; ++row)
+        {
+            const int count = base - row;
+            for(int i = 0; i < count; ++i)
+            {
+                const float2 position(x + (i - (count - 1) * 0.5f) * 1.05f, 0.5f + row * 1.0f);
+                top = scene.AddRigidBody(std::make_shared<OBB>(float2(1.0f, 1.0f)), position);
+            }
+        }
+        return top;
+    }
+
+    Result Run(const std::shared_ptr<Solver>& solver, uint32_t iterations, int height, int base, int steps)
+    {
+        auto scene = std::make_shared<Scene>(
+            1.0f / 60.0f, iterations, std::make_shared<SymplecticEulerIntegrator>(),
+            std::make_shared<UniformGridBroadphase>(), solver);
+
+        auto floor = scene->AddRigidBody(std::make_shared<OBB>(float2(60.0f, 2.0f)), float2(0.0f, -1.0f));
+        floor->SetStatic();
+
+        std::vector<std::shared_ptr<RigidBody2D>> tops = {
+            BuildColumn(*scene, height, -10.0f),
+            BuildPyramid(*scene, base, 10.0f),
+        };
+        std::vector<float2> start;
+        for(auto& top : tops)
+            start.push_back(top->GetPosition());
+
+        const BodyStore& bodies = scene->GetBodyStore();
+        const int measured = std::min(steps, 60);
+        double speedSum = 0.0;
+
+        bench::Timer timer;
+        for(int i = 0; i < steps; ++i)
+        {
+            scene->Step();
+            if(i < steps - measured)
+                continue;
+
+            for(uint32_t b = 1; b < bodies.Size(); ++b)
+                speedSum += linalg::length(bodies.GetVelocity(b));
+        }
+        const double elapsedMs = timer.ElapsedMs();
+
+        Result result{ 0.0f, 0.0f, 0.0f, elapsedMs / steps };
+        for(size_t i = 0; i < tops.size(); ++i)
+            result.drift = std::max(result.drift, linalg::length(tops[i]->GetPosition() - start[i]));
+        for(uint32_t b = 1; b < bodies.Size(); ++b)
+        {
+            const float tilt = std::remainder(bodies.m_orientation[b], 1.5707963f);
+            result.maxTilt = std::max(result.maxTilt, std::abs(tilt));
+        }
+        result.jitter = static_cast<float>(speedSum / (measured * (bodies.Size() - 1)));
+        return result;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int height = static_cast<int>(bench::GetArg(argc, argv, "--height", 8));
+    const int base = static_cast<int>(bench::GetArg(argc, argv, "--base", 8));
+    const int steps = static_cast<int>(bench::GetArg(argc, argv, "--steps", 600));
+
+    struct Candidate
+    {
+        const char* name;
+        std::shared_ptr<Solver> (*create)();
+    };
+    const Candidate candidates[] = {
+        { "impulse", []() -> std::shared_ptr<Solver> { return std::make_shared<ImpulseSolver>(); } },
+        { "si", []() -> std::shared_ptr<Solver> { return std::make_shared<SequentialImpulseSolver>(false); } },
+        { "si+warm", []() -> std::shared_ptr<Solver> { return std::make_shared<SequentialImpulseSolver>(true); } },
+    };
+    const uint32_t iterationCounts[] = { 3, 4, 10 };
+
+    std::printf("column of %d, pyramid of %d, %d steps\n", height, base, steps);
+    std::printf("%-10s %6s %10s %10s %10s %10s\n", "solver", "iters", "drift", "jitter", "max tilt", "step(ms)");
+    for(const Candidate& candidate : candidates)
+    {
+        for(uint32_t iterations : iterationCounts)
+        {
+            const Result r = Run(candidate.create(), iterations, height, base, steps);
+            std::printf("%-10s %6u %10.4f %10.4f %10.4f %10.3f\n",
+                candidate.name, iterations, r.drift, r.jitter, r.maxTilt, r.stepMs);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ *  Steps per second of small scenes, with the policies picked at runtime
+ *  (Scene) and fixed at compile time (BasicScene with concrete policies).
+ *  With a handful of bodies a step is mostly calls between the stages, so
+ *  this is where static dispatch can show. Both scenes have to end with
+ *  exactly the same bodies.
+ *
+ *  usage : static_dispatch [--work N]
+ *    every row runs about N body steps
+ */
+
+#include <algorithm>
+#include <cstdio>
+
+#include "bench_util.hpp"
+
+#include "integrator.hpp"
+
+namespace
+{
+    typedef linalg::aliases::float2 float2;
+
+    typedef BasicScene<SymplecticEulerIntegrator, BruteForceBroadphase, ImpulseSolver> StaticEulerScene;
+    typedef BasicScene<RungeKuttaFourthIntegrator, SweepAndPruneBroadphase, SequentialImpulseSolver> StaticRk4Scene;
+
+    // a floor with a stack on it, and the rest of the bodies falling onto
+    // the stack
+    template <typename SceneType>
+    void Fill(SceneType& scene, int bodyCount)
+    {
+        auto floor = scene.AddRigidBody(std::make_shared<OBB>(float2(40.0f, 2.0f)), float2(0.0f, -1.0f));
+        floor->SetStatic();
+        for(int i = 1; i < bodyCount; ++i)
+        {
+            const float2 position((i % 8) * 1.5f - 6.0f, (i / 8) * 1.2f + 0.6f);
+            if(i % 3 == 0)
+                scene.AddRigidBody(std::make_shared<Circle>(0.5f), position);
+            else
+                scene.AddRigidBody(std::make_shared<OBB>(float2(1.0f, 1.0f)), position);
+        }
+    }
+
+    template <typename SceneType>
+    double MeasureStepsPerSecond(SceneType& scene, int steps)
+    {
+        // the first steps grow the buffers
+        for(int s = 0; s < 30; ++s)
+            scene.Step();
+
+        bench::Timer timer;
+        for(int s = 0; s < steps; ++s)
+            scene.Step();
+        return steps / (timer.ElapsedMs() * 1e-3);
+    }
+
+    bool SameBodies(const BodyStore& a, const BodyStore& b)
+    {
+        return a.m_positionX == b.m_positionX && a.m_positionY == b.m_positionY &&
+            a.m_velocityX == b.m_velocityX && a.m_velocityY == b.m_velocityY &&
+            a.m_orientation == b.m_orientation && a.m_angularVelocity == b.m_angularVelocity;
+    }
+
+    template <typename StaticScene, typename IntegratorType, typename BroadphaseType, typename SolverType>
+    void Compare(const char* name, int bodyCount, long work)
+    {
+        const int steps = static_cast<int>(std::max(200L, work / bodyCount));
+
+        Scene dynamicScene(1.0f / 60.0f, 10, std::make_shared<IntegratorType>(),
+            std::make_shared<BroadphaseType>(), std::make_shared<SolverType>());
+        StaticScene staticScene(1.0f / 60.0f, 10, std::make_shared<IntegratorType>(),
+            std::make_shared<BroadphaseType>(), std::make_shared<SolverType>());
+        Fill(dynamicScene, bodyCount);
+        Fill(staticScene, bodyCount);
+
+        const double dynamicRate = MeasureStepsPerSecond(dynamicScene, steps);
+        const double staticRate = MeasureStepsPerSecond(staticScene, steps);
+        const bool isSame = SameBodies(dynamicScene.GetBodyStore(), staticScene.GetBodyStore());
+
+        std::printf("  %-28s %7d %8d %14.0f %14.0f %9.3f %10s\n", name, bodyCount, steps,
+            dynamicRate, staticRate, staticRate / dynamicRate, isSame ? "yes" : "NO");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const long work = bench::GetArg(argc, argv, "--work", 2000000);
+    const int bodyCounts[] = { 2, 8, 32, 128 };
+
+    std::printf("steps per second, runtime policies (Scene) against compile time ones (BasicScene)\n");
+    std::printf("  %-28s %7s %8s %14s %14s %9s %10s\n", "policies", "bodies", "steps", "Scene", "BasicScene", "speedup", "identical");
+
+    for(int bodyCount : bodyCounts)
+    {
+        Compare<StaticEulerScene, SymplecticEulerIntegrator, BruteForceBroadphase, ImpulseSolver>(
+            "symplectic, brute, impulse", bodyCount, work);
+    }
+    for(int bodyCount : bodyCounts)
+    {
+        Compare<StaticRk4Scene, RungeKuttaFourthIntegrator, SweepAndPruneBroadphase, SequentialImpulseSolver>(
+            "rk4, sweep, sequential", bodyCount, work);
+    }
+
+    return 0;
+}
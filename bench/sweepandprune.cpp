@@ -0,0 +1,118 @@
+/**
+ *  Compare the incremental sweep and prune against the brute force path
+ *  (and the uniform grid) on a settled pile and on an explosion.
+ *
+ *  Every broadphase is fed the same bodies after each step, so they see
+ *  exactly the same motion and should report the same pairs.
+ *
+ *  usage : sweepandprune [--bodies N] [--steps N]
+ */
+
+#include <cstdio>
+
+#include "bench_util.hpp"
+
+#include "broadphase.hpp"
+#include "integrator.hpp"
+
+namespace
+{
+    typedef linalg::aliases::float2 float2;
+
+    struct Candidate
+    {
+        const char* name;
+        std::shared_ptr<Broadphase> broadphase;
+        double totalMs;
+        size_t totalPairs;
+    };
+
+    // boxes on a static floor, stepped until they are mostly at rest
+    std::vector<std::shared_ptr<RigidBody2D>> BuildPile(Scene& scene, size_t count)
+    {
+        std::vector<std::shared_ptr<RigidBody2D>> bodies;
+
+        const size_t columns = std::max<size_t>(1u, static_cast<size_t>(std::sqrt(count)));
+        const float width = columns * 1.5f;
+
+        auto floor = scene.AddRigidBody(std::make_shared<OBB>(float2(width + 10.0f, 2.0f)), float2(0.0f, -1.0f));
+        floor->SetStatic();
+        bodies.push_back(floor);
+
+        for(size_t i = 0; i < count; ++i)
+        {
+            const float x = (i % columns) * 1.5f - width * 0.5f;
+            const float y = (i / columns) * 1.1f + 0.6f;
+            bodies.push_back(scene.AddRigidBody(std::make_shared<OBB>(float2(1.0f, 1.0f)), float2(x, y)));
+        }
+        return bodies;
+    }
+
+    // bodies packed around the origin flying outwards
+    std::vector<std::shared_ptr<RigidBody2D>> BuildExplosion(Scene& scene, size_t count)
+    {
+        auto bodies = bench::AddRandomBodies(scene, count, 0.5f, 42u);
+        for(auto& body : bodies)
+        {
+            float2 direction = body->GetPosition();
+            const float length = linalg::length(direction);
+            direction = (length > 0.0f) ? direction / length : float2(1.0f, 0.0f);
+            body->SetVelocity(direction * 40.0f);
+        }
+        return bodies;
+    }
+
+    void Run(const char* title, size_t count, int warmup, int steps, bool pile)
+    {
+        auto scene = std::make_shared<Scene>(
+            1.0f / 60.0f, 10, std::make_shared<SymplecticEulerIntegrator>(),
+            std::make_shared<UniformGridBroadphase>());
+        auto bodies = pile ? BuildPile(*scene, count) : BuildExplosion(*scene, count);
+
+        for(int i = 0; i < warmup; ++i)
+            scene->Step();
+
+        std::vector<Candidate> candidates = {
+            { "brute", std::make_shared<BruteForceBroadphase>(), 0.0, 0u },
+            { "grid", std::make_shared<UniformGridBroadphase>(), 0.0, 0u },
+            { "sap", std::make_shared<SweepAndPruneBroadphase>(), 0.0, 0u },
+            { "tree", std::make_shared<DynamicTreeBroadphase>(), 0.0, 0u },
+        };
+
+        // let the persistent broadphases build their initial state
+        std::vector<BodyPair> pairs;
+        for(Candidate& candidate : candidates)
+            candidate.broadphase->ComputePairs(scene->GetBodyStore(), pairs);
+
+        for(int i = 0; i < steps; ++i)
+        {
+            scene->Step();
+            for(Candidate& candidate : candidates)
+            {
+                bench::Timer timer;
+                candidate.broadphase->ComputePairs(scene->GetBodyStore(), pairs);
+                candidate.totalMs += timer.ElapsedMs();
+                candidate.totalPairs += pairs.size();
+            }
+        }
+
+        std::printf("%s, %zu bodies, %d steps\n", title, bodies.size(), steps);
+        for(const Candidate& candidate : candidates)
+        {
+            std::printf("  %-8s %10.3f ms/step %12.1f pairs/step\n",
+                candidate.name, candidate.totalMs / steps,
+                static_cast<double>(candidate.totalPairs) / steps);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t count = static_cast<size_t>(bench::GetArg(argc, argv, "--bodies", 2000));
+    const int steps = static_cast<int>(bench::GetArg(argc, argv, "--steps", 60));
+
+    Run("settled pile", count, 300, steps, true);
+    Run("explosion", count, 0, steps, false);
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ *  Narrowphase cost of box stacks with and without the per-step transform
+ *  cache. The uncached variant refreshes both bodies of a pair right before
+ *  testing it, which is what every pair used to pay for (rotation matrix,
+ *  vertex and normal transforms).
+ *
+ *  usage : transformcache [--stacks N] [--height N] [--repeat N]
+ */
+
+#include <cstdio>
+
+#include "bench_util.hpp"
+
+#include "broadphase.hpp"
+#include "integrator.hpp"
+#include "shape.hpp"
+
+int main(int argc, char* argv[])
+{
+    typedef linalg::aliases::float2 float2;
+
+    const int stacks = static_cast<int>(bench::GetArg(argc, argv, "--stacks", 20));
+    const int height = static_cast<int>(bench::GetArg(argc, argv, "--height", 20));
+    const int repeat = static_cast<int>(bench::GetArg(argc, argv, "--repeat", 200));
+
+    auto scene = std::make_shared<Scene>(
+        1.0f / 60.0f, 10, std::make_shared<SymplecticEulerIntegrator>(),
+        std::make_shared<UniformGridBroadphase>());
+
+    std::vector<std::shared_ptr<RigidBody2D>> bodies;
+    auto floor = scene->AddRigidBody(std::make_shared<OBB>(float2(stacks * 3.0f + 10.0f, 2.0f)), float2(0.0f, -1.0f));
+    floor->SetStatic();
+    bodies.push_back(floor);
+    for(int x = 0; x < stacks; ++x)
+    {
+        for(int y = 0; y < height; ++y)
+        {
+            const float2 position(x * 3.0f - stacks * 1.5f, y * 1.0f + 0.5f);
+            bodies.push_back(scene->AddRigidBody(std::make_shared<OBB>(float2(1.0f, 1.0f)), position));
+        }
+    }
+
+    // let the stacks settle so there is a realistic amount of contacts
+    for(int i = 0; i < 60; ++i)
+        scene->Step();
+    scene->UpdateTransforms();
+
+    std::vector<BodyPair> pairs;
+    UniformGridBroadphase().ComputePairs(scene->GetBodyStore(), pairs);
+
+    size_t hits = 0u;
+    bench::Timer timer;
+    for(int r = 0; r < repeat; ++r)
+    {
+        for(const BodyPair& pair : pairs)
+        {
+            bodies[pair.first]->UpdateTransformCache();
+            bodies[pair.second]->UpdateTransformCache();
+            hits += bodies[pair.first]->GetShape()->accept(*bodies[pair.second]->GetShape()).m_isHit;
+        }
+    }
+    const double uncachedMs = timer.ElapsedMs();
+
+    timer.Reset();
+    for(int r = 0; r < repeat; ++r)
+    {
+        for(auto& body : bodies)
+            body->UpdateTransformCache();
+        for(const BodyPair& pair : pairs)
+            hits += bodies[pair.first]->GetShape()->accept(*bodies[pair.second]->GetShape()).m_isHit;
+    }
+    const double cachedMs = timer.ElapsedMs();
+
+    const double pairCount = static_cast<double>(pairs.size()) * repeat;
+    std::printf("%zu bodies, %zu pairs, %zu hits\n", bodies.size(), pairs.size(), hits / (2 * repeat));
+    std::printf("  per pair transforms : %8.3f ms/step %8.1f ns/pair\n", uncachedMs / repeat, uncachedMs * 1e6 / pairCount);
+    std::printf("  once per step cache : %8.3f ms/step %8.1f ns/pair\n", cachedMs / repeat, cachedMs * 1e6 / pairCount);
+
+    return 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "linalg.h"
+
+#include <algorithm>
+
+// world space axis-aligned bounding box, used by the broadphase to
+// cheaply reject pairs before running the actual shape vs shape tests
+struct AABB
+{
+    typedef linalg::aliases::float2 float2;
+
+    float2 min;
+    float2 max;
+
+    inline bool Overlaps(const AABB& _other) const
+    {
+        return min.x <= _other.max.x && _other.min.x <= max.x
+            && min.y <= _other.max.y && _other.min.y <= max.y;
+    }
+
+    inline bool Contains(const AABB& _other) const
+    {
+        return min.x <= _other.min.x && min.y <= _other.min.y
+            && _other.max.x <= max.x && _other.max.y <= max.y;
+    }
+
+    inline float2 GetSize() const { return max - min; }
+    inline float2 GetCenter() const { return (min + max) * 0.5f; }
+    inline float GetPerimeter() const { return 2.0f * ((max.x - min.x) + (max.y - min.y)); }
+
+    static inline AABB Combine(const AABB& _a, const AABB& _b)
+    {
+        return AABB{ linalg::min(_a.min, _b.min), linalg::max(_a.max, _b.max) };
+    }
+};
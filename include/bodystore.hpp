@@ -0,0 +1,210 @@
+#pragma once
+
+/**
+ *  Structure of arrays storage for the bodies of a scene. Every field lives
+ *  in its own contiguous array indexed by the dense body index, so loops
+ *  over all bodies (integration, the solver, the broadphase) touch only the
+ *  fields they need. Vector fields are split into x and y arrays.
+ *
+ *  Dense indices change when a body is removed (the last body is moved into
+ *  the hole), so users hold a BodyHandle instead, which goes through a slot
+ *  table and carries a generation to detect use after removal.
+ */
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "linalg.h"
+#include "aabb.hpp"
+
+class Shape;
+
+// World space data derived from the position and orientation of a body.
+// It is refreshed once per step (before the broadphase) so that the
+// narrowphase does not recompute it for every pair the body is part of.
+struct BodyTransformCache
+{
+    linalg::aliases::float2x2 rotation;
+    // only filled by polygon shapes, in the order of the local space ones
+    std::array<linalg::aliases::float2, 4> vertices;
+    std::array<linalg::aliases::float2, 4> normals;
+    AABB bounds;
+};
+
+struct BodyHandle
+{
+    static constexpr uint32_t k_invalidIndex = 0xffffffffu;
+
+    // index into the slot table, not the dense index
+    uint32_t index = k_invalidIndex;
+    uint32_t generation = 0u;
+
+    inline bool operator==(const BodyHandle& _other) const
+    {
+        return index == _other.index && generation == _other.generation;
+    }
+    inline bool operator!=(const BodyHandle& _other) const { return !(*this == _other); }
+};
+
+class BodyStore
+{
+    typedef linalg::aliases::float2 float2;
+public:
+    // Hot data, indexed by the dense index in [0, Size()).
+    std::vector<float> m_positionX, m_positionY;
+    std::vector<float> m_velocityX, m_velocityY;
+    std::vector<float> m_forceX, m_forceY;
+    std::vector<float> m_orientation; // radians
+    std::vector<float> m_angularVelocity;
+    std::vector<float> m_torque;
+
+    std::vector<float> m_mass, m_invMass;
+    std::vector<float> m_inertia, m_invInertia;
+
+    // Cold data, only read by the narrowphase and the solver per contact.
+    std::vector<float> m_restitution;
+    std::vector<float> m_staticFriction, m_dynamicFriction;
+
+    std::vector<std::shared_ptr<Shape>> m_shapes;
+    std::vector<BodyTransformCache> m_transforms;
+    // set whenever position or orientation changes
+    std::vector<uint8_t> m_transformDirty;
+
+    // Sleeping, see IslandManager. How long the body has been slow enough
+    // to sleep, and the sleeping island it belongs to (k_awake if none).
+    std::vector<float> m_sleepTime;
+    std::vector<uint32_t> m_sleepingIsland;
+    // sleeping islands that a body was woken in by Wake(), the scene wakes
+    // the rest of each island at the start of the next step
+    std::vector<uint32_t> m_wokenIslands;
+
+    static constexpr uint32_t k_awake = 0xffffffffu;
+
+private:
+    struct Slot
+    {
+        // dense index of a live slot, next free slot of a dead one
+        uint32_t index;
+        uint32_t generation;
+    };
+
+    std::vector<Slot> m_slots;
+    // dense index -> slot, to fix up the slot of a moved body
+    std::vector<uint32_t> m_slotOfIndex;
+    uint32_t m_freeSlot;
+
+    // applies '_function' to every per body array
+    template <typename Function>
+    void ForEachArray(Function&& _function)
+    {
+        _function(m_positionX); _function(m_positionY);
+        _function(m_velocityX); _function(m_velocityY);
+        _function(m_forceX); _function(m_forceY);
+        _function(m_orientation);
+        _function(m_angularVelocity);
+        _function(m_torque);
+        _function(m_mass); _function(m_invMass);
+        _function(m_inertia); _function(m_invInertia);
+        _function(m_restitution);
+        _function(m_staticFriction); _function(m_dynamicFriction);
+        _function(m_shapes);
+        _function(m_transforms);
+        _function(m_transformDirty);
+        _function(m_sleepTime);
+        _function(m_sleepingIsland);
+        _function(m_slotOfIndex);
+    }
+
+public:
+    BodyStore() : m_wokenIslands(), m_slots(), m_slotOfIndex(), m_freeSlot(BodyHandle::k_invalidIndex) {}
+
+    BodyHandle Create(
+        const std::shared_ptr<Shape>& _shape, float2 _position, float _restitution,
+        float _mass, float _staticFriction, float _dynamicFriction);
+    // Removes the body by moving the last body into its place, returns the
+    // dense index the removed body had (which the last body now uses).
+    uint32_t Destroy(BodyHandle _handle);
+    void Reserve(size_t _count);
+    // Makes an empty store hold '_count' awake bodies with zeroed data and
+    // no shapes, handles are slots 0 to '_count' - 1. For filling whole
+    // arrays at once (see SceneSnapshot), the caller sets the shapes.
+    void Allocate(size_t _count);
+
+    inline size_t Size() const { return m_positionX.size(); }
+
+    inline bool IsValid(BodyHandle _handle) const
+    {
+        return _handle.index < m_slots.size() && m_slots[_handle.index].generation == _handle.generation;
+    }
+    // dense index of a live body, throws for stale handles
+    uint32_t GetIndex(BodyHandle _handle) const;
+    inline BodyHandle GetHandle(uint32_t _index) const
+    {
+        const uint32_t slot = m_slotOfIndex[_index];
+        return BodyHandle{ slot, m_slots[slot].generation };
+    }
+
+    // recompute the cached world space data of a body from its transform
+    void UpdateTransform(uint32_t _index);
+
+    inline bool IsAwake(uint32_t _index) const { return m_sleepingIsland[_index] == k_awake; }
+    // awake and not static, only these are integrated and start narrowphase
+    inline bool IsActive(uint32_t _index) const { return IsAwake(_index) && m_invMass[_index] != 0.0f; }
+    // asks for the island of a sleeping body to be woken, does nothing for
+    // an awake one (so forces applied every step do not keep it awake)
+    inline void Wake(uint32_t _index)
+    {
+        if(IsAwake(_index) == false)
+            m_wokenIslands.push_back(m_sleepingIsland[_index]);
+    }
+
+    // float2 accessors over the split arrays
+    inline float2 GetPosition(uint32_t _index) const { return float2(m_positionX[_index], m_positionY[_index]); }
+    inline float2 GetVelocity(uint32_t _index) const { return float2(m_velocityX[_index], m_velocityY[_index]); }
+    inline float2 GetForce(uint32_t _index) const { return float2(m_forceX[_index], m_forceY[_index]); }
+
+    inline void SetPosition(uint32_t _index, float2 _position)
+    {
+        m_positionX[_index] = _position.x;
+        m_positionY[_index] = _position.y;
+        m_transformDirty[_index] = 1u;
+    }
+    inline void AddPosition(uint32_t _index, float2 _position)
+    {
+        m_positionX[_index] += _position.x;
+        m_positionY[_index] += _position.y;
+        m_transformDirty[_index] = 1u;
+    }
+    inline void SetVelocity(uint32_t _index, float2 _velocity)
+    {
+        m_velocityX[_index] = _velocity.x;
+        m_velocityY[_index] = _velocity.y;
+    }
+    inline void AddVelocity(uint32_t _index, float2 _velocity)
+    {
+        m_velocityX[_index] += _velocity.x;
+        m_velocityY[_index] += _velocity.y;
+    }
+    inline void SetForce(uint32_t _index, float2 _force)
+    {
+        m_forceX[_index] = _force.x;
+        m_forceY[_index] = _force.y;
+    }
+    inline void AddForce(uint32_t _index, float2 _force)
+    {
+        m_forceX[_index] += _force.x;
+        m_forceY[_index] += _force.y;
+    }
+    inline void SetOrientation(uint32_t _index, float _orientation)
+    {
+        m_orientation[_index] = _orientation;
+        m_transformDirty[_index] = 1u;
+    }
+    inline void AddOrientation(uint32_t _index, float _orientation)
+    {
+        m_orientation[_index] += _orientation;
+        m_transformDirty[_index] = 1u;
+    }
+};
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <unordered_set>
+
+#include "aabb.hpp"
+#include "dynamictree.hpp"
+#include "bodystore.hpp"
+#include "jobsystem.hpp"
+
+// a candidate pair for narrowphase, indices are dense indices into the
+// body store of the scene, and 'first' is always lesser than 'second'
+struct BodyPair
+{
+    uint32_t first;
+    uint32_t second;
+
+    inline bool operator<(const BodyPair& _other) const
+    {
+        return (first != _other.first) ? (first < _other.first) : (second < _other.second);
+    }
+    inline bool operator==(const BodyPair& _other) const
+    {
+        return first == _other.first && second == _other.second;
+    }
+};
+
+// an interface for broadphase algorithms, the job of a broadphase is to
+// find pairs that might collide, so the narrowphase (shape visitors) only
+// run on pairs that are close to each other.
+// Pairs are always reported in ascending order, so the order that manifolds
+// are resolved in does not depend on the chosen broadphase.
+// The scene hands its job system to the broadphase, the per body passes
+// (and the brute force pair test) run on it.
+class Broadphase
+{
+protected:
+    typedef linalg::aliases::float2 float2;
+
+    std::shared_ptr<JobSystem> m_jobs;
+
+    // world space bounds of each body, refreshed by UpdateBounds()
+    std::vector<AABB> m_bounds;
+
+    void UpdateBounds(const BodyStore& _bodies);
+
+    static inline uint64_t PairKey(uint32_t _a, uint32_t _b)
+    {
+        return (_a < _b) ? 
+            ((static_cast<uint64_t>(_a) << 32) | _b) :
+            ((static_cast<uint64_t>(_b) << 32) | _a);
+    }
+
+    // drop the pairs of '_index' and relabel the ones of '_movedFrom' to
+    // '_index', see RemoveBody()
+    static void RemapPairs(std::unordered_set<uint64_t>& _pairs, uint32_t _index, uint32_t _movedFrom);
+
+public:
+    virtual ~Broadphase() = default;
+
+    inline void SetJobSystem(const std::shared_ptr<JobSystem>& _jobs) { m_jobs = _jobs; }
+    inline const std::shared_ptr<JobSystem>& GetJobSystem() const { return m_jobs; }
+
+    virtual void ComputePairs(
+        const BodyStore& _bodies,
+        std::vector<BodyPair>& _pairs) = 0;
+
+    // Called when the body at '_index' was removed from the store and the
+    // last body ('_movedFrom') took its dense index. Persistent broadphases
+    // relabel their proxies here instead of starting over.
+    virtual void RemoveBody(uint32_t _index, uint32_t _movedFrom);
+
+    // Spatial queries, answered from the state of the last ComputePairs().
+    // These only report candidates by their (possibly fattened) bounds, the
+    // caller is expected to run the exact test on them. By default the
+    // bounds of every body are scanned.
+    virtual void Query(const AABB& _region, std::vector<uint32_t>& _result) const;
+    virtual void RayCast(const float2& _from, const float2& _to, std::vector<uint32_t>& _result) const;
+};
+
+// test every body against every other body, this is what Scene used to do
+class BruteForceBroadphase final : public Broadphase
+{
+private:
+    // rows of the test run in parallel, their pairs are merged in row order
+    OrderedBuffers<BodyPair> m_pairBuffers;
+
+public:
+    virtual void ComputePairs(
+        const BodyStore& _bodies,
+        std::vector<BodyPair>& _pairs) override;
+};
+
+// bucket bodies into a uniform grid, only bodies sharing a cell are paired
+class UniformGridBroadphase final : public Broadphase
+{
+private:
+    struct CellEntry
+    {
+        uint64_t key;
+        uint32_t body;
+
+        inline bool operator<(const CellEntry& _other) const
+        {
+            return (key != _other.key) ? (key < _other.key) : (body < _other.body);
+        }
+    };
+
+    struct CellRange
+    {
+        int32_t minX, minY;
+        int32_t maxX, maxY;
+    };
+
+    // a cell size of 0 means it will be derived from the median body size
+    float m_cellSize;
+    float m_activeCellSize;
+
+    std::vector<CellRange> m_cellRanges;
+    std::vector<CellEntry> m_entries;
+    std::vector<float> m_sizeScratch;
+
+    float ComputeMedianCellSize();
+
+public:
+    explicit UniformGridBroadphase(float _cellSize = 0.0f)
+        : m_cellSize(_cellSize), m_activeCellSize(_cellSize)
+        {}
+
+    virtual void ComputePairs(
+        const BodyStore& _bodies,
+        std::vector<BodyPair>& _pairs) override;
+
+    inline float GetCellSize() const { return m_activeCellSize; }
+    // what it was made with, 0 if the cell size follows the bodies
+    inline float GetConfiguredCellSize() const { return m_cellSize; }
+};
+
+// incremental sweep and prune, the sorted endpoint lists are kept between
+// steps and fixed up with insertion sort, which is close to linear when
+// bodies only move a little. Overlapping pairs are added and removed as
+// endpoints swap, instead of being searched for again every step.
+class SweepAndPruneBroadphase final : public Broadphase
+{
+private:
+    struct Endpoint
+    {
+        float value;
+        // body index shifted left by one, lowest bit set for max endpoints
+        uint32_t data;
+
+        inline uint32_t GetBody() const { return data >> 1; }
+        inline bool IsMax() const { return (data & 1u) != 0u; }
+        // the order of the lists, min before max on ties so touching
+        // intervals count as overlapping (as in AABB::Overlaps)
+        inline bool IsBefore(const Endpoint& _other) const
+        {
+            return (value != _other.value) ? (value < _other.value) : (IsMax() < _other.IsMax());
+        }
+    };
+
+    // one sorted endpoint list per axis
+    std::vector<Endpoint> m_endpoints[2];
+    std::unordered_set<uint64_t> m_overlaps;
+    size_t m_proxyCount;
+
+    void Rebuild();
+    void InsertionSort(std::vector<Endpoint>& _endpoints);
+
+public:
+    SweepAndPruneBroadphase() : m_overlaps(), m_proxyCount(0u) {}
+
+    virtual void RemoveBody(uint32_t _index, uint32_t _movedFrom) override;
+
+    virtual void ComputePairs(
+        const BodyStore& _bodies,
+        std::vector<BodyPair>& _pairs) override;
+};
+
+// a dynamic AABB tree, static bodies (inverse mass of 0) live in a tree of
+// their own which is never tested against itself. The trees also back the
+// region and ray queries of the scene.
+// Like in Box2D, only proxies that left their fattened bounds query the
+// trees, pairs of fattened bounds are kept until they stop overlapping.
+class DynamicTreeBroadphase final : public Broadphase
+{
+private:
+    struct Proxy
+    {
+        int32_t id;
+        bool isStatic;
+    };
+
+    DynamicTree m_dynamicTree;
+    DynamicTree m_staticTree;
+    std::vector<Proxy> m_proxies;
+    // bodies whose proxy was (re-)inserted since the last pair update
+    std::vector<uint32_t> m_moveBuffer;
+    // pairs whose fattened bounds overlap
+    std::unordered_set<uint64_t> m_fatPairs;
+
+    void CreateProxy(uint32_t _body, bool _isStatic);
+    void Clear();
+    inline const AABB& GetFatBounds(uint32_t _body) const
+    {
+        const Proxy& proxy = m_proxies[_body];
+        return (proxy.isStatic ? m_staticTree : m_dynamicTree).GetFatBounds(proxy.id);
+    }
+
+public:
+    // '_margin' is how far a body can move before its proxy is re-inserted
+    explicit DynamicTreeBroadphase(float _margin = 0.2f)
+        : m_dynamicTree(_margin), m_staticTree(_margin), m_proxies(),
+          m_moveBuffer(), m_fatPairs()
+        {}
+
+    virtual void ComputePairs(
+        const BodyStore& _bodies,
+        std::vector<BodyPair>& _pairs) override;
+
+    virtual void RemoveBody(uint32_t _index, uint32_t _movedFrom) override;
+
+    virtual void Query(const AABB& _region, std::vector<uint32_t>& _result) const override;
+    virtual void RayCast(const float2& _from, const float2& _to, std::vector<uint32_t>& _result) const override;
+
+    inline const DynamicTree& GetDynamicTree() const { return m_dynamicTree; }
+    inline const DynamicTree& GetStaticTree() const { return m_staticTree; }
+    inline float GetMargin() const { return m_dynamicTree.GetMargin(); }
+};
\ No newline at end of file
@@ -11,14 +11,20 @@ private:
     float m_radius;
 
 public:
-    Circle(float _radius) : m_radius(_radius) {}
+    Circle(float _radius) : Shape(ShapeType::Circle), m_radius(_radius) {}
 
     virtual Manifold accept(const ShapeVisitor<Manifold>& visitor) const override;
 
     virtual Manifold visitAABB(const OBB& _shape) const override;
     virtual Manifold visitCircle(const Circle& _shape) const override;
 
-    virtual void Render() const override;
+    virtual AABB GetAABB() const override;
+    virtual void UpdateTransformCache(const float2& _position, BodyTransformCache& _cache) const override;
+    virtual bool RayCast(
+        const float2& _from, const float2& _to,
+        float& _fraction, float2& _normal) const override;
+
+    inline float GetRadius() const { return m_radius; }
 
     friend class CollisionHelper;
 };
\ No newline at end of file
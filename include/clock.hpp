@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 
 class Clock
 {
@@ -13,4 +14,12 @@ private:
 public:
     static void Reset();
     static double Elapsed();
+
+    // monotonic, in nanoseconds from an unspecified origin, for timing
+    // short scopes (see profiler.hpp)
+    static inline uint64_t NowNs()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<m_tickUnit>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
 };
\ No newline at end of file
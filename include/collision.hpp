@@ -1,19 +1,109 @@
-#pragma once
-
-/**
- *  This is where all the collision detection and manifold generation code
- *  lives. Classes that implements the shape visitor interface should be
- *  calling helper functions here, instead of implementing its own collision
- *  detection method.
- */
-
-#include "obb.hpp"
-#include "circle.hpp"
-
-#include "manifold.hpp"
-
-class CollisionHelper
-{
-public:// AABB to Circle
-    static Manifold GenerateManifold(const OBB& _a, const Circle& _b);
-};
\ No newline at end of file
+#pragma once
+
+/**
+ *  This is where all the collision detection and manifold generation code
+ *  lives. Classes that implements the shape visitor interface should be
+ *  calling helper functions here, instead of implementing its own collision
+ *  detection method.
+ *
+ *  The scene does not go through the visitors anymore, pairs are grouped
+ *  by their shape pair type and every group is run through the matching
+ *  GenerateManifold overload directly.
+ */
+
+#include <array>
+#include <vector>
+
+#include "obb.hpp"
+#include "circle.hpp"
+
+#include "manifold.hpp"
+#include "broadphase.hpp"
+#include "jobsystem.hpp"
+
+// What the narrowphase reads about the body behind a shape. The scene fills
+// it straight from the arrays of the body store, the visitors go through
+// the body view of the shape.
+struct CollisionBody
+{
+    uint32_t index;
+    linalg::aliases::float2 position;
+    const BodyTransformCache* transform;
+};
+
+class CollisionHelper
+{
+public:
+    // the smallest piece of pairs the parallel narrowphase hands out, fewer
+    // pairs than this are not worth splitting up
+    static constexpr size_t k_parallelChunkSize = 128u;
+
+    // index of a (shape type of first, shape type of second) pair
+    static constexpr size_t k_shapePairCount = 
+        static_cast<size_t>(ShapeType::Count) * static_cast<size_t>(ShapeType::Count);
+
+    typedef Manifold (*CollideFunction)(const Shape& _a, const Shape& _b);
+
+    static constexpr size_t GetShapePairIndex(ShapeType _a, ShapeType _b)
+    {
+        return static_cast<size_t>(_a) * static_cast<size_t>(ShapeType::Count) + static_cast<size_t>(_b);
+    }
+
+    static inline CollisionBody GetCollisionBody(const BodyStore& _bodies, uint32_t _index)
+    {
+        return CollisionBody{ _index, _bodies.GetPosition(_index), &_bodies.m_transforms[_index] };
+    }
+    static CollisionBody GetCollisionBody(const Shape& _shape);
+
+    // AABB to AABB (both oriented)
+    static Manifold GenerateManifold(
+        const OBB& _a, const CollisionBody& _bodyA, const OBB& _b, const CollisionBody& _bodyB);
+    // AABB to Circle
+    static Manifold GenerateManifold(
+        const OBB& _a, const CollisionBody& _bodyA, const Circle& _b, const CollisionBody& _bodyB);
+    // Circle to Circle
+    static Manifold GenerateManifold(
+        const Circle& _a, const CollisionBody& _bodyA, const Circle& _b, const CollisionBody& _bodyB);
+
+    // the same, with the bodies looked up through the views of the shapes
+    template <typename A, typename B>
+    static inline Manifold GenerateManifold(const A& _a, const B& _b)
+    {
+        return GenerateManifold(_a, GetCollisionBody(_a), _b, GetCollisionBody(_b));
+    }
+
+    // Same result as '_a.accept(_b)', looked up from a table indexed by the
+    // shape types instead of two virtual calls.
+    static Manifold Collide(const Shape& _a, const Shape& _b);
+
+    // Stable counting sort of '_pairs' by shape pair type into '_sorted',
+    // '_batchOffsets[k]' is where the pairs of type k begin.
+    static void SortPairsByShapeType(
+        const BodyStore& _bodies,
+        const std::vector<BodyPair>& _pairs,
+        std::vector<BodyPair>& _sorted,
+        std::array<size_t, k_shapePairCount + 1>& _batchOffsets);
+
+    // Run a batch of pairs of the same shape pair type, hits are appended
+    // to '_manifolds', which should have room for '_count' more records.
+    static void CollideBatch(
+        size_t _shapePairIndex,
+        const BodyStore& _bodies,
+        const BodyPair* _pairs, size_t _count,
+        std::vector<Manifold>& _manifolds);
+
+    // The same as running CollideBatch() for every batch of '_sorted', but
+    // the pairs are split into pieces that run on '_jobs' (if there is one).
+    // Each thread appends to its own buffer, and the buffers are merged in
+    // piece order, so '_manifolds' ends up the same for any number of threads.
+    static void CollideParallel(
+        JobSystem* _jobs,
+        const BodyStore& _bodies,
+        const std::vector<BodyPair>& _sorted,
+        const std::array<size_t, k_shapePairCount + 1>& _batchOffsets,
+        OrderedBuffers<Manifold>& _buffers,
+        std::vector<Manifold>& _manifolds);
+
+private:
+    static const CollideFunction s_collideTable[k_shapePairCount];
+};
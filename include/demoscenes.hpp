@@ -0,0 +1,46 @@
+#pragma once
+
+/**
+ *  Procedurally built scenes, shared by the demo and the headless runner.
+ *  Every builder adds its bodies (and joints) to a scene that may already
+ *  hold others, so they can be combined. Nothing here needs a renderer.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "linalg.h"
+
+#include "scene.hpp"
+
+class DemoScenes
+{
+    typedef linalg::aliases::float2 float2;
+public:
+    // a static box of '_size' centered at '_position'
+    static std::shared_ptr<RigidBody2D> AddFloor(SceneBase& _scene, float2 _position, float2 _size);
+
+    // '_count' columns of '_height' unit boxes on a floor
+    static void AddBoxStacks(SceneBase& _scene, int _count, int _height);
+    // '_count' pyramids with '_base' unit boxes in their bottom row
+    static void AddPyramids(SceneBase& _scene, int _count, int _base);
+    // Boxes on a half circle of '_length' around '_center' held together by
+    // spring joints, the first and last box are static. This is the bridge
+    // of the demo.
+    static void AddSpringBridge(SceneBase& _scene, float2 _center, size_t _boxCount, float _length, float _stiffness);
+    // A chain of boxes going down to the left from '_top', held together by
+    // distance joints, only the first box is static. This is the chain of
+    // the demo.
+    static void AddDistanceChain(SceneBase& _scene, float2 _top, size_t _boxCount, float _length, float _deltaTime);
+    // '_count' circles of random size over a floor, falling from a column
+    // that is taller the more of them there are
+    static void AddCircleRain(SceneBase& _scene, int _count, uint32_t _seed);
+
+    // The named scenes of the headless runner, '_size' scales them (stacks,
+    // pyramids, bridges, chains or hundreds of circles). Returns false for
+    // an unknown name.
+    static bool Build(SceneBase& _scene, const std::string& _name, int _size, float _deltaTime);
+    static const std::vector<std::string>& GetNames();
+};
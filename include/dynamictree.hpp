@@ -0,0 +1,182 @@
+#pragma once
+
+/**
+ *  A dynamic bounding volume tree, heavily based on b2DynamicTree from
+ *  Box2D by Erin Catto. Leaves store a fattened AABB so a proxy only has
+ *  to be re-inserted once it moves out of it, and internal nodes are
+ *  kept balanced with tree rotations.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include "aabb.hpp"
+
+class DynamicTree
+{
+    typedef linalg::aliases::float2 float2;
+public:
+    static constexpr int32_t k_nullNode = -1;
+
+private:
+    struct Node
+    {
+        AABB bounds;
+        // user data of leaves, the body index in our case
+        uint32_t userData;
+
+        int32_t parent;
+        int32_t child0;
+        int32_t child1;
+        // leaf = 0, free node = -1
+        int32_t height;
+
+        inline bool IsLeaf() const { return child0 == k_nullNode; }
+    };
+
+    // a stack that lives on the function stack until it grows too deep,
+    // so queries do not allocate
+    class TraversalStack
+    {
+    private:
+        int32_t m_inline[128];
+        std::vector<int32_t> m_heap;
+        int32_t* m_data;
+        size_t m_capacity;
+        size_t m_size;
+
+    public:
+        TraversalStack() : m_data(m_inline), m_capacity(128u), m_size(0u) {}
+        TraversalStack(const TraversalStack&) = delete;
+        TraversalStack& operator=(const TraversalStack&) = delete;
+
+        inline void Push(int32_t _value)
+        {
+            if(m_size == m_capacity)
+            {
+                m_heap.assign(m_data, m_data + m_size);
+                m_heap.resize(m_capacity * 2);
+                m_data = m_heap.data();
+                m_capacity *= 2;
+            }
+            m_data[m_size++] = _value;
+        }
+        inline int32_t Pop() { return m_data[--m_size]; }
+        inline bool Empty() const { return m_size == 0u; }
+    };
+
+    std::vector<Node> m_nodes;
+    int32_t m_root;
+    int32_t m_freeList;
+    float m_margin;
+
+    int32_t AllocateNode();
+    void FreeNode(int32_t _node);
+
+    void InsertLeaf(int32_t _leaf);
+    void RemoveLeaf(int32_t _leaf);
+    void RefitAncestors(int32_t _node);
+    int32_t Balance(int32_t _node);
+
+public:
+    explicit DynamicTree(float _margin = 0.2f)
+        : m_nodes(), m_root(k_nullNode), m_freeList(k_nullNode), m_margin(_margin)
+        {}
+
+    // returns the proxy id, which stays valid until DestroyProxy
+    int32_t CreateProxy(const AABB& _bounds, uint32_t _userData);
+    void DestroyProxy(int32_t _proxy);
+    // re-insert the proxy only if '_bounds' is no longer inside its fat
+    // bounds, returns true if that happened
+    bool MoveProxy(int32_t _proxy, const AABB& _bounds);
+    void Clear();
+
+    inline const AABB& GetFatBounds(int32_t _proxy) const { return m_nodes[_proxy].bounds; }
+    inline uint32_t GetUserData(int32_t _proxy) const { return m_nodes[_proxy].userData; }
+    inline void SetUserData(int32_t _proxy, uint32_t _userData) { m_nodes[_proxy].userData = _userData; }
+    inline int32_t GetHeight() const { return (m_root == k_nullNode) ? 0 : m_nodes[m_root].height; }
+    inline float GetMargin() const { return m_margin; }
+
+    // calls '_callback(proxy)' for every leaf whose fat bounds overlap
+    // '_bounds', the callback returns false to stop the query
+    template <typename Callback>
+    void Query(const AABB& _bounds, Callback&& _callback) const
+    {
+        TraversalStack stack;
+        if(m_root != k_nullNode)
+            stack.Push(m_root);
+
+        while(stack.Empty() == false)
+        {
+            const int32_t index = stack.Pop();
+            const Node& node = m_nodes[index];
+            if(node.bounds.Overlaps(_bounds) == false)
+                continue;
+
+            if(node.IsLeaf())
+            {
+                if(_callback(index) == false)
+                    return;
+            }
+            else
+            {
+                stack.Push(node.child0);
+                stack.Push(node.child1);
+            }
+        }
+    }
+
+    // calls '_callback(proxy, maxFraction)' for every leaf whose fat bounds
+    // are crossed by the segment [_from, _to]. The callback returns the new
+    // max fraction to clip the segment with, 0 to stop the ray cast.
+    template <typename Callback>
+    void RayCast(const float2& _from, const float2& _to, Callback&& _callback) const
+    {
+        const float2 direction = _to - _from;
+        // a vector perpendicular to the segment, for the separating axis test
+        const float2 perpendicular(-direction.y, direction.x);
+        const float2 absPerpendicular = linalg::abs(perpendicular);
+
+        float maxFraction = 1.0f;
+        AABB segmentBounds{ linalg::min(_from, _to), linalg::max(_from, _to) };
+
+        TraversalStack stack;
+        if(m_root != k_nullNode)
+            stack.Push(m_root);
+
+        while(stack.Empty() == false)
+        {
+            const int32_t index = stack.Pop();
+            const Node& node = m_nodes[index];
+            if(node.bounds.Overlaps(segmentBounds) == false)
+                continue;
+
+            // |dot(v, p1 - c)| > dot(|v|, h) means the line misses the box
+            const float2 center = node.bounds.GetCenter();
+            const float2 halfSize = node.bounds.GetSize() * 0.5f;
+            const float separation =
+                std::abs(linalg::dot(perpendicular, _from - center)) - linalg::dot(absPerpendicular, halfSize);
+            if(separation > 0.0f)
+                continue;
+
+            if(node.IsLeaf())
+            {
+                const float fraction = _callback(index, maxFraction);
+                if(fraction == 0.0f)
+                    return;
+
+                if(fraction > 0.0f && fraction < maxFraction)
+                {
+                    maxFraction = fraction;
+                    const float2 end = _from + maxFraction * direction;
+                    segmentBounds = AABB{ linalg::min(_from, end), linalg::max(_from, end) };
+                }
+            }
+            else
+            {
+                stack.Push(node.child0);
+                stack.Push(node.child1);
+            }
+        }
+    }
+};
@@ -1,50 +1,175 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
 #include "rigidbody2D.hpp"
+#include "integratorkernels.hpp"
+#include "jobsystem.hpp"
 
-class Scene;
+class Integrator;
+class Broadphase;
+class Solver;
+template <typename IntegratorPolicy, typename BroadphasePolicy, typename SolverPolicy>
+class BasicScene;
+typedef BasicScene<Integrator, Broadphase, Solver> Scene;
+
+// Every integrator can be called through Integrate(Scene&), and has an
+// Integrate() template for scenes that fix it as their policy, see
+// BasicScene. The template takes the scene as it is, the runge kutta
+// integrator calls its Solve() directly.
 
 class Integrator
 {
 protected:
     typedef linalg::aliases::float2 float2;
 
+    // smaller pieces of bodies are not worth a task
+    static constexpr size_t k_bodyGrain = 256u;
+
+    // instruction set of the per body loops, see IntegratorKernels
+    SimdLevel m_simdLevel;
+
+    // '_kernel' over every body of the store
+    static inline void RunKernel(IntegratorKernels::Kernel _kernel, BodyStore& _bodies, JobSystem* _jobs, float _deltaTime)
+    {
+        const float2 gravity(0.0f, -9.8f);
+        ParallelFor(_jobs, _bodies.Size(), [&](size_t _begin, size_t _end, size_t)
+        {
+            _kernel(_bodies, static_cast<uint32_t>(_begin), static_cast<uint32_t>(_end), _deltaTime, gravity);
+        }, k_bodyGrain);
+    }
+
 public:
+    Integrator() : m_simdLevel(IntegratorKernels::GetSupportedLevel()) {}
+    virtual ~Integrator() = default;
+
 	virtual void Integrate(Scene& scene) = 0;
+
+    // Every level gives the same result, this is for benchmarks (and for
+    // ruling out a kernel). Levels the cpu does not support fall back to
+    // the best one it does.
+    inline void SetSimdLevel(SimdLevel _level) { m_simdLevel = std::min(_level, IntegratorKernels::GetSupportedLevel()); }
+    inline SimdLevel GetSimdLevel() const { return m_simdLevel; }
 };
 
-class ExplicitEulerIntegrator : public Integrator
+class ExplicitEulerIntegrator final : public Integrator
 {
 public:
     virtual void Integrate(Scene& scene) override;
+
+    template <typename SceneType>
+    inline void Integrate(SceneType& _scene)
+    {
+        // the loop itself is IntegratorKernels::ExplicitEuler (or a vector
+        // version of it)
+        RunKernel(IntegratorKernels::Get(IntegratorKernels::Method::ExplicitEuler, m_simdLevel),
+            _scene.m_store, _scene.m_jobs.get(), _scene.m_deltaTime);
+
+        // TODO : we might need to add gravity somewhere.
+        // maybe define the gravity vector in scene class.
+    }
 };
 
-class SymplecticEulerIntegrator : public Integrator
+class SymplecticEulerIntegrator final : public Integrator
 {
 public:
 	virtual void Integrate(Scene& scene) override;
+
+    template <typename SceneType>
+    inline void Integrate(SceneType& _scene)
+    {
+        RunKernel(IntegratorKernels::Get(IntegratorKernels::Method::SymplecticEuler, m_simdLevel),
+            _scene.m_store, _scene.m_jobs.get(), _scene.m_deltaTime);
+    }
 };
 
-class NewtonIntegrator : public Integrator
+class NewtonIntegrator final : public Integrator
 {
 public:
     virtual void Integrate(Scene& scene) override;
+
+    template <typename SceneType>
+    inline void Integrate(SceneType& _scene)
+    {
+        RunKernel(IntegratorKernels::Get(IntegratorKernels::Method::Newton, m_simdLevel),
+            _scene.m_store, _scene.m_jobs.get(), _scene.m_deltaTime);
+    }
+};
+
+// How often the runge kutta integrator runs collision detection and the
+// solver during a step, on top of the Solve() of Scene::Step().
+enum class ContactMode
+{
+    // before every one of the four stages, the broadphase included
+    EveryStage,
+    // before every stage too, but with the pairs the broadphase found in
+    // Scene::Step(), bodies only move a little during a step
+    ReusePairs,
+    // only the Solve() of Scene::Step(), the stages see gravity and the
+    // velocities the solver left, this costs about what the euler
+    // integrators do
+    OncePerStep
 };
 
-class RungeKuttaFourthIntegrator : public Integrator
+class RungeKuttaFourthIntegrator final : public Integrator
 {
 private:
-    struct StateStep
+    // one array per field, like the body store
+    struct State
     {
-        float2 position;
-        float2 velocity;
+        std::vector<float> positionX, positionY;
+        std::vector<float> velocityX, velocityY;
+        std::vector<float> orientation;
+        std::vector<float> angularVelocity;
 
-		float orientation;
-		float angularVelocity;
+        void Resize(size_t _count);
     };
 
+    ContactMode m_contactMode;
+
+    // The buffers are kept across steps, so a step does not allocate once
+    // the body count stopped growing.
+    // the state at the start of the step
+    State m_start;
+    // k1 + 2 k2 + 2 k3 + k4, summed up while the stages run
+    State m_sum;
+    // the bodies integrated this step, a body woken during the step waits
+    // for the next one (it has no start state)
+    std::vector<uint8_t> m_isActive;
+
+    // Evaluates the derivative of the current state of the bodies in
+    // [_begin, _end) for stage '_stage' (0 to 3) and adds it to the sum.
+    // The first three stages move the bodies to where the next one is
+    // evaluated, the last one moves them to the end of the step.
+    void RunStage(BodyStore& _bodies, size_t _begin, size_t _end, float _deltaTime, int _stage);
+    // keeps the start state of the bodies integrated this step
+    void BeginStep(BodyStore& _bodies, JobSystem* _jobs);
+    // RunStage() over every body
+    void RunStage(BodyStore& _bodies, JobSystem* _jobs, float _deltaTime, int _stage);
+
 public:
+    explicit RungeKuttaFourthIntegrator(ContactMode _contactMode = ContactMode::EveryStage)
+        : m_contactMode(_contactMode), m_start(), m_sum(), m_isActive()
+        {}
+
     virtual void Integrate(Scene& scene) override;
+
+    template <typename SceneType>
+    inline void Integrate(SceneType& _scene)
+    {
+        BeginStep(_scene.m_store, _scene.m_jobs.get());
+        for (int stage = 0; stage < 4; ++stage)
+        {
+            if (m_contactMode == ContactMode::EveryStage)
+                _scene.Solve(false);
+            else if (m_contactMode == ContactMode::ReusePairs)
+                _scene.Solve(true);
+
+            RunStage(_scene.m_store, _scene.m_jobs.get(), _scene.m_deltaTime, stage);
+        }
+    }
+
+    inline void SetContactMode(ContactMode _contactMode) { m_contactMode = _contactMode; }
+    inline ContactMode GetContactMode() const { return m_contactMode; }
 };
\ No newline at end of file
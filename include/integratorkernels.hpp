@@ -0,0 +1,53 @@
+#pragma once
+
+/**
+ *  The per body loops of the euler style integrators, over a range of dense
+ *  indices of a body store. Each loop has a scalar reference and SSE / AVX2
+ *  versions that work on 4 / 8 bodies at once, straight from the arrays of
+ *  the store. Bodies that are static or sleeping are masked out instead of
+ *  branched on, and the vector versions do exactly the operations of the
+ *  scalar one, in the same order, so they give bit-identical results.
+ *
+ *  The instruction set is picked at runtime, from what the cpu supports.
+ */
+
+#include <cstdint>
+
+#include "linalg.h"
+
+#include "bodystore.hpp"
+
+enum class SimdLevel
+{
+    Scalar,
+    SSE,
+    AVX2
+};
+
+class IntegratorKernels
+{
+    typedef linalg::aliases::float2 float2;
+public:
+    enum class Method
+    {
+        ExplicitEuler,
+        SymplecticEuler,
+        Newton
+    };
+
+    // integrates the bodies in [_begin, _end)
+    typedef void (*Kernel)(BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, float2 _gravity);
+
+    // the best level the cpu (and the compiler) supports
+    static SimdLevel GetSupportedLevel();
+    static const char* GetName(SimdLevel _level);
+
+    // the kernel of '_method' for '_level', levels that are not supported
+    // fall back to the best supported one below them
+    static Kernel Get(Method _method, SimdLevel _level);
+
+    // scalar references
+    static void ExplicitEuler(BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, float2 _gravity);
+    static void SymplecticEuler(BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, float2 _gravity);
+    static void Newton(BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, float2 _gravity);
+};
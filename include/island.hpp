@@ -0,0 +1,80 @@
+#pragma once
+
+/**
+ *  Islands of bodies, used to put resting bodies to sleep. Every step the
+ *  bodies that touch each other (or are held together by a joint) are
+ *  grouped with union-find. Static bodies never join an island, they do not
+ *  pass motion on from one body to another, so two piles on the same floor
+ *  are two islands.
+ *
+ *  Once every body of an island has been slower than the thresholds for
+ *  'timeToSleep' seconds, the whole island goes to sleep : its bodies are
+ *  not integrated, pairs without an awake body skip the narrowphase, and
+ *  the solver never sees them. A sleeping island is only ever woken as a
+ *  whole, when one of its bodies touches (or is joined to) an awake body,
+ *  or when a setter of RigidBody2D is called on one of them.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include "bodystore.hpp"
+#include "broadphase.hpp"
+
+struct SleepSettings
+{
+    // off by default, the scene then behaves exactly like it did before
+    bool enabled = false;
+    // a body is slow enough to sleep below both of these
+    float linearTolerance = 0.05f;  // m/s
+    float angularTolerance = 0.05f; // rad/s
+    // seconds an island has to stay slow before it goes to sleep
+    float timeToSleep = 0.5f;
+};
+
+class IslandManager
+{
+private:
+    // union-find over the dense body indices, rebuilt every Update()
+    std::vector<uint32_t> m_parent;
+    // per union-find root, the shortest sleep time of its bodies and the
+    // sleeping island its bodies are put in
+    std::vector<float> m_minSleepTime;
+    std::vector<uint32_t> m_islandOfRoot;
+
+    // bodies of every sleeping island, as handles since dense indices
+    // change when bodies are removed. Woken islands are left empty and
+    // their ids are reused.
+    std::vector<std::vector<BodyHandle>> m_islands;
+    std::vector<uint32_t> m_freeIslands;
+    size_t m_sleepingBodyCount;
+
+    uint32_t Find(uint32_t _body);
+    void Union(uint32_t _a, uint32_t _b);
+
+public:
+    IslandManager()
+        : m_parent(), m_minSleepTime(), m_islandOfRoot(), m_islands(), m_freeIslands(),
+          m_sleepingBodyCount(0u)
+        {}
+
+    // wakes the islands asked for by BodyStore::Wake(), returns true if
+    // any body was woken
+    bool WakeRequested(BodyStore& _bodies);
+    void WakeIsland(BodyStore& _bodies, uint32_t _island);
+    void WakeAll(BodyStore& _bodies);
+    // Rebuilds the sleeping islands from the island ids in the store, for a
+    // store that was filled array by array. The ids have to be below the
+    // body count.
+    void Restore(const BodyStore& _bodies);
+
+    // Groups the bodies by '_links' (pairs of dense indices), wakes sleeping
+    // islands linked to an awake body, advances the sleep timers of awake
+    // bodies and puts islands that were slow for long enough to sleep.
+    void Update(
+        BodyStore& _bodies, const std::vector<BodyPair>& _links,
+        float _deltaTime, const SleepSettings& _settings);
+
+    inline size_t GetSleepingBodyCount() const { return m_sleepingBodyCount; }
+    inline size_t GetSleepingIslandCount() const { return m_islands.size() - m_freeIslands.size(); }
+};
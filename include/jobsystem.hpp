@@ -0,0 +1,272 @@
+#pragma once
+
+/**
+ *  A work stealing scheduler shared by every stage of a scene. Every thread
+ *  has a deque of its own, it pushes and pops work at the back and idle
+ *  threads steal from the front of the others, where the largest pieces
+ *  are.
+ *
+ *  ParallelFor() pushes the whole range as a single task. Whoever runs a
+ *  range splits it in halves, keeps one and pushes the other, until it is
+ *  down to the grain size, so a range is only cut as fine as the threads
+ *  that show up for it need. Submit() runs jobs once the jobs they depend
+ *  on are done.
+ *
+ *  Thread 0 is the thread that calls into the system from outside (the one
+ *  running the scene), it works on the tasks while it waits. Only one such
+ *  thread should use a system at a time. The other threads are owned by the
+ *  system, or run on threads of the host application through an Executor.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// work given to JobSystem::Submit(), kept alive by its handles
+class Job
+{
+    friend class JobSystem;
+private:
+    std::function<void()> m_function;
+    // jobs it still waits for, plus one until Submit() is done with it
+    std::atomic<int> m_pending;
+    std::atomic<bool> m_isDone;
+    std::exception_ptr m_exception;
+
+    std::mutex m_mutex;
+    // jobs that depend on this one
+    std::vector<std::shared_ptr<Job>> m_continuations;
+
+public:
+    Job() : m_function(), m_pending(1), m_isDone(false), m_exception(), m_mutex(), m_continuations() {}
+
+    inline bool IsDone() const { return m_isDone.load(std::memory_order_acquire); }
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+// Counters of the parallel loops run while a JobStats is set on a system.
+// Wall time is measured on the calling thread, work time is the sum of the
+// time every thread spent inside the loop bodies.
+struct JobStats
+{
+    std::atomic<uint64_t> loops{ 0u };
+    std::atomic<uint64_t> tasks{ 0u };
+    std::atomic<uint64_t> steals{ 0u };
+    std::atomic<uint64_t> wallNs{ 0u };
+    std::atomic<uint64_t> workNs{ 0u };
+
+    void Reset();
+
+    inline double GetWallMs() const { return wallNs.load() * 1e-6; }
+    inline double GetWorkMs() const { return workNs.load() * 1e-6; }
+    // wall time beyond a perfect split of the work over '_threadCount'
+    // threads, that is splitting, stealing, waking up and waiting
+    inline double GetOverheadMs(size_t _threadCount) const
+    {
+        return GetWallMs() - GetWorkMs() / static_cast<double>(_threadCount);
+    }
+};
+
+class JobSystem
+{
+public:
+    // (begin, end, thread index), the thread index is in [0, GetThreadCount())
+    typedef std::function<void(size_t, size_t, size_t)> RangeFunction;
+    // runs the given worker loop on a thread of the host, the loop returns
+    // once the system is destroyed
+    typedef std::function<void(std::function<void()>)> Executor;
+
+    // makes the stats of the loops in a scope go to '_stats', does nothing
+    // without a system
+    class ScopedStats
+    {
+    private:
+        JobSystem* m_system;
+        JobStats* m_previous;
+
+    public:
+        ScopedStats(JobSystem* _system, JobStats* _stats)
+            : m_system(_system), m_previous(_system ? _system->m_stats : nullptr)
+        {
+            if(m_system != nullptr)
+                m_system->m_stats = _stats;
+        }
+        ~ScopedStats()
+        {
+            if(m_system != nullptr)
+                m_system->m_stats = m_previous;
+        }
+    };
+
+private:
+    struct Loop
+    {
+        const RangeFunction* function;
+        size_t grain;
+        // items not done yet
+        std::atomic<size_t> remaining;
+        JobStats* stats;
+        std::mutex mutex;
+        std::exception_ptr exception;
+    };
+
+    // either a range of a loop or a job
+    struct Task
+    {
+        Loop* loop;
+        size_t begin, end;
+        JobHandle job;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        uint32_t random;
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+
+    // tasks in all of the deques, idle threads sleep while it is 0
+    std::atomic<size_t> m_queued;
+    std::atomic<size_t> m_sleeping;
+    std::atomic<bool> m_isStopping;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+
+    // worker loops handed to an executor that did not return yet
+    size_t m_running;
+    std::condition_variable m_exited;
+
+    JobStats* m_stats;
+
+    size_t GetCurrentThread() const;
+
+    void Push(size_t _thread, Task&& _task);
+    bool Pop(size_t _thread, Task& _task);
+    bool Steal(size_t _thread, Task& _task);
+    // runs one task from the own deque or a stolen one, if there is any
+    bool RunOne(size_t _thread);
+    void Execute(size_t _thread, Task& _task);
+    void RunJob(size_t _thread, const JobHandle& _job);
+    void WorkerLoop(size_t _thread);
+    void Start(size_t _threadCount, const Executor& _executor);
+
+public:
+    // '_threadCount' includes the calling thread, 0 means one per core
+    explicit JobSystem(size_t _threadCount = 0u);
+    // the other threads are started by '_executor', which is called
+    // '_threadCount - 1' times
+    JobSystem(size_t _threadCount, const Executor& _executor);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    inline size_t GetThreadCount() const { return m_workers.size(); }
+
+    // Calls '_function' over pieces of [0, _count) and returns once all of
+    // them are done. Pieces are never smaller than '_grain' items (except
+    // at the end), a grain of 0 picks one from the count and the number of
+    // threads. Throws the first exception thrown by '_function'.
+    void ParallelFor(size_t _count, const RangeFunction& _function, size_t _grain = 0u);
+
+    // runs '_function' once every job in '_dependencies' is done
+    JobHandle Submit(std::function<void()> _function, const std::vector<JobHandle>& _dependencies = {});
+    // works on other tasks until '_job' is done, throws what the job threw
+    void Wait(const JobHandle& _job);
+
+    inline JobStats* GetStats() const { return m_stats; }
+};
+
+// ParallelFor() on '_jobs', or a plain call over the whole range without one
+// (which calls '_function' as it is, no std::function is made for it)
+template <typename Function>
+inline void ParallelFor(JobSystem* _jobs, size_t _count, const Function& _function, size_t _grain = 0u)
+{
+    if(_jobs == nullptr)
+    {
+        if(_count > 0u)
+            _function(0u, _count, 0u);
+        return;
+    }
+    _jobs->ParallelFor(_count, _function, _grain);
+}
+
+// Per thread output of a parallel loop whose results have to come out in
+// loop order, see ParallelCollect(). Kept by the caller so that the buffers
+// keep their capacity.
+template <typename T>
+struct OrderedBuffers
+{
+    struct Piece
+    {
+        size_t begin;
+        size_t thread;
+        size_t from, to;
+
+        inline bool operator<(const Piece& _other) const { return begin < _other.begin; }
+    };
+
+    std::vector<std::vector<T>> items;
+    std::vector<std::vector<Piece>> pieces;
+    std::vector<Piece> merged;
+};
+
+// Runs '_function(begin, end, output)' over [0, _count), every thread
+// appending to a buffer of its own, then appends the buffers to '_out' in
+// the order of the ranges. '_out' ends up the same as for one plain call
+// over the whole range, whichever thread ran which piece.
+template <typename T, typename Function>
+void ParallelCollect(
+    JobSystem* _jobs, size_t _count, size_t _grain,
+    OrderedBuffers<T>& _buffers, std::vector<T>& _out, Function&& _function)
+{
+    if(_jobs == nullptr || _jobs->GetThreadCount() == 1u)
+    {
+        if(_count > 0u)
+            _function(0u, _count, _out);
+        return;
+    }
+
+    const size_t threadCount = _jobs->GetThreadCount();
+    _buffers.items.resize(threadCount);
+    _buffers.pieces.resize(threadCount);
+    for(size_t i = 0; i < threadCount; ++i)
+    {
+        _buffers.items[i].clear();
+        _buffers.pieces[i].clear();
+    }
+
+    _jobs->ParallelFor(_count, [&](size_t _begin, size_t _end, size_t _thread)
+    {
+        std::vector<T>& items = _buffers.items[_thread];
+        const size_t from = items.size();
+        _function(_begin, _end, items);
+        _buffers.pieces[_thread].push_back(
+            typename OrderedBuffers<T>::Piece{ _begin, _thread, from, items.size() });
+    }, _grain);
+
+    _buffers.merged.clear();
+    for(const auto& pieces : _buffers.pieces)
+        _buffers.merged.insert(_buffers.merged.end(), pieces.begin(), pieces.end());
+    std::sort(_buffers.merged.begin(), _buffers.merged.end());
+
+    for(const auto& piece : _buffers.merged)
+    {
+        const std::vector<T>& items = _buffers.items[piece.thread];
+        _out.insert(_out.end(), items.begin() + piece.from, items.begin() + piece.to);
+    }
+}
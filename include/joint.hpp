@@ -14,8 +14,13 @@ class Joint
 protected:
     typedef linalg::aliases::float2 float2;
 public:
+    virtual ~Joint() = default;
+
     virtual void ApplyConstriant() const = 0;
-    virtual void Render() const = 0;
+
+    // the bodies this joint acts on, they always share an island
+    virtual size_t GetBodyCount() const = 0;
+    virtual const std::shared_ptr<RigidBody2D>& GetBody(size_t _index) const = 0;
 };
 
 class SpringJoint : public Joint
@@ -36,7 +41,15 @@ public:
         {}
 
     virtual void ApplyConstriant() const override;
-    virtual void Render() const override;
+
+    virtual size_t GetBodyCount() const override { return 2u; }
+    virtual const std::shared_ptr<RigidBody2D>& GetBody(size_t _index) const override
+    {
+        return (_index == 0u) ? m_body0 : m_body1;
+    }
+
+    inline float GetRestLength() const { return m_restLength; }
+    inline float GetStiffness() const { return m_stiffness; }
 };
 
 class DistanceJoint : public Joint
@@ -55,5 +68,13 @@ public:
         {}
     
     virtual void ApplyConstriant() const override;
-    virtual void Render() const override;
+
+    virtual size_t GetBodyCount() const override { return 2u; }
+    virtual const std::shared_ptr<RigidBody2D>& GetBody(size_t _index) const override
+    {
+        return (_index == 0u) ? m_body0 : m_body1;
+    }
+
+    inline float GetRestLength() const { return m_restLength; }
+    inline float GetDeltaTime() const { return m_deltaTime; }
 };
\ No newline at end of file
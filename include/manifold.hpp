@@ -1,30 +1,61 @@
 #pragma once
 
-#include "rigidbody2D.hpp"
+#include <array>
+#include <cstdint>
+#include <type_traits>
 
+#include "linalg.h"
+
+class BodyStore;
+
+// Identifies a contact point by the features that produced it, so that it
+// can be matched with the same point of the previous step. Box pairs use
+// the reference face and the incident vertex, single point contacts use 0.
+inline constexpr uint32_t MakeContactId(uint32_t _referenceFace, uint32_t _incidentVertex, bool _flip)
+{
+    return (_flip ? (1u << 16) : 0u) | (_referenceFace << 8) | _incidentVertex;
+}
+
+// The contact record of one colliding pair. Bodies are referred to by their
+// dense index in the body store, which does not change during a step, so
+// the record is plain data and can be copied around and kept in a buffer
+// that is reused across steps without touching any reference count.
 class Manifold
 {
     typedef linalg::aliases::float2 float2;
 public:
-    std::shared_ptr<RigidBody2D> m_body0, m_body1;
+    uint32_t m_body0, m_body1;
     int m_contactPointCount;
     std::array<float2, 2> m_contactPoints;
     float2 m_normal;
     float m_penetration;
 
     bool m_isHit;
+    // feature ids of the contact points, see MakeContactId()
+    std::array<uint32_t, 2> m_contactIds;
 
 public:
 
+    Manifold() = default;
     Manifold(
-        const std::shared_ptr<RigidBody2D>& _body0, 
-        const std::shared_ptr<RigidBody2D>& _body1,
+        uint32_t _body0, 
+        uint32_t _body1,
         int _contactPointCount,
         std::array<float2, 2> _contactPoints,
         float2 _normal,
         float _penetration,
-        bool _isHit);
+        bool _isHit,
+        std::array<uint32_t, 2> _contactIds = {})
+        : m_body0(_body0), m_body1(_body1), m_contactPointCount(_contactPointCount),
+          m_contactPoints(_contactPoints), 
+          m_normal(_normal), m_penetration(_penetration), m_isHit(_isHit),
+          m_contactIds(_contactIds)
+        {}
+
+    // both work on the arrays of the store the two bodies live in
+    void Resolve(BodyStore& _bodies) const;
+    void PositionalCorrection(BodyStore& _bodies) const;
+};
 
-    void Resolve() const;
-    void PositionalCorrection() const;
-};
\ No newline at end of file
+static_assert(std::is_trivially_copyable<Manifold>::value, "Manifold has to stay plain data");
+static_assert(sizeof(Manifold) <= 64, "Manifold should fit in a cache line");
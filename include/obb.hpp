@@ -13,31 +13,40 @@ class OBB : public Shape, public std::enable_shared_from_this<OBB>
 private:
     float2 m_extent;
 
-    float2 GetSupportPoint(const float2& dir) const;
+    // helper functions for helping collision detection and manifold generation,
+    // they only need the world space vertices and normals of the boxes
 
-    // helper functions for helping collision detection and manifold generation
+    static float2 GetSupportPoint(const BodyTransformCache& cache, const float2& dir);
 
     static float FindAxisLeastPenetration(
         size_t& faceIndexPtr, 
-        const OBB& A, 
-        const OBB& B);
+        const BodyTransformCache& A, 
+        const BodyTransformCache& B);
     
+    // 'incidentIndex' is set to the index of the first vertex of the face
     static std::array<float2, 2> FindIncidentFace( 
-        const OBB& RefPoly, 
-        const OBB& IncPoly, 
-        size_t referenceIndex);
+        const BodyTransformCache& RefPoly, 
+        const BodyTransformCache& IncPoly, 
+        size_t referenceIndex,
+        size_t& incidentIndex);
 
     static size_t Clip(float2 normal, float clipped, std::array<float2, 2> face);
 
 public:
-    OBB(float2 _extent) : m_extent(_extent) {}
+    OBB(float2 _extent) : Shape(ShapeType::OBB), m_extent(_extent) {}
 
     virtual Manifold accept(const ShapeVisitor<Manifold>& visitor) const override;
 
     virtual Manifold visitAABB(const OBB& _shape) const override;
     virtual Manifold visitCircle(const Circle& _shape) const override;
 
-    virtual void Render() const override;
+    virtual AABB GetAABB() const override;
+    virtual void UpdateTransformCache(const float2& _position, BodyTransformCache& _cache) const override;
+    virtual bool RayCast(
+        const float2& _from, const float2& _to,
+        float& _fraction, float2& _normal) const override;
+
+    inline float2 GetExtent() const { return m_extent; }
 
     inline size_t GetVertexCount() const { return 4u; }
 
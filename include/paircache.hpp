@@ -0,0 +1,119 @@
+#pragma once
+
+/**
+ *  Persistent data of touching body pairs, kept from one step to the next.
+ *  Pairs are keyed by the handle slots of their two bodies (so the key does
+ *  not change when other bodies are removed) and live in an open addressing
+ *  table with linear probing. Removal shifts later entries of the probe run
+ *  back instead of leaving tombstones.
+ *
+ *  Every Scene::Solve() is one frame : BeginFrame(), Touch() for every pair
+ *  that has contact points, EndFrame(). A pair that was touched in a frame
+ *  but not in the one before has just begun, one that was not touched has
+ *  ended and is dropped. The table only grows, so once it is large enough
+ *  a frame does not allocate.
+ */
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "bodystore.hpp"
+
+enum class ContactState : uint8_t
+{
+    Begin = 0,
+    Persist,
+    End
+};
+
+class PairCache
+{
+public:
+    struct Entry
+    {
+        // lower slot in the high half, empty entries use k_emptyKey
+        uint64_t key;
+        // first frame of the current run of frames the pair touched in
+        uint32_t touchingSince;
+        uint32_t lastTouched;
+        ContactState state;
+
+        // contact points of the last frame and the total impulses a solver
+        // applied to them, matched again by id in the next frame
+        int pointCount;
+        std::array<uint32_t, 2> ids;
+        std::array<float, 2> normalImpulse;
+        std::array<float, 2> tangentImpulse;
+
+        inline uint32_t GetSlot0() const { return static_cast<uint32_t>(key >> 32); }
+        inline uint32_t GetSlot1() const { return static_cast<uint32_t>(key & 0xffffffffu); }
+    };
+
+    static constexpr uint64_t k_emptyKey = ~0ull;
+    static constexpr uint32_t k_invalidEntry = 0xffffffffu;
+
+private:
+    std::vector<Entry> m_entries;
+    uint32_t m_mask;
+    uint32_t m_count;
+    uint32_t m_frame;
+
+    // keys of the pairs that began in the current frame, and copies of the
+    // entries that ended in it
+    std::vector<uint64_t> m_begun;
+    std::vector<Entry> m_ended;
+
+    static inline uint32_t Hash(uint64_t _key)
+    {
+        // the finalizer of MurmurHash3
+        _key ^= _key >> 33;
+        _key *= 0xff51afd7ed558ccdull;
+        _key ^= _key >> 33;
+        _key *= 0xc4ceb9fe1a85ec53ull;
+        _key ^= _key >> 33;
+        return static_cast<uint32_t>(_key);
+    }
+
+    void Grow(uint32_t _capacity);
+    void RemoveAt(uint32_t _index);
+
+public:
+    PairCache() : m_entries(), m_mask(0u), m_count(0u), m_frame(0u), m_begun(), m_ended() {}
+
+    static inline uint64_t MakeKey(BodyHandle _a, BodyHandle _b)
+    {
+        return (_a.index < _b.index) ?
+            ((static_cast<uint64_t>(_a.index) << 32) | _b.index) :
+            ((static_cast<uint64_t>(_b.index) << 32) | _a.index);
+    }
+
+    // makes room for '_pairCount' touching pairs, so that entry indices
+    // returned by Touch() stay valid until EndFrame()
+    void BeginFrame(size_t _pairCount);
+    // the entry of a pair touching in this frame, created if it is new
+    uint32_t Touch(uint64_t _key);
+    // keeps a pair that was not tested in this frame (because its bodies
+    // sleep) touching, without creating it if it is not in the cache
+    void Keep(uint64_t _key);
+    // drops the pairs that were not touched in this frame
+    void EndFrame();
+    // drops every pair of a body that is about to be removed, they are
+    // reported as ended in the current frame
+    void RemoveBody(BodyHandle _body);
+    void Clear();
+
+    // k_invalidEntry if the pair is not in the cache
+    uint32_t Find(uint64_t _key) const;
+    inline Entry& GetEntry(uint32_t _index) { return m_entries[_index]; }
+    inline const Entry& GetEntry(uint32_t _index) const { return m_entries[_index]; }
+
+    inline size_t GetCount() const { return m_count; }
+    inline size_t GetCapacity() const { return m_entries.size(); }
+    inline uint32_t GetFrame() const { return m_frame; }
+    // number of frames the pair has been touching for, including this one
+    inline uint32_t GetTouchingFrames(const Entry& _entry) const { return m_frame - _entry.touchingSince + 1u; }
+
+    inline const std::vector<uint64_t>& GetBegunPairs() const { return m_begun; }
+    inline const std::vector<Entry>& GetEndedPairs() const { return m_ended; }
+};
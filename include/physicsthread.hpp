@@ -0,0 +1,239 @@
+#pragma once
+
+/**
+ *  Stepping a scene on a thread of its own, so a slow step does not hold up
+ *  drawing and a slow frame does not hold up stepping.
+ *
+ *  The physics thread runs the same fixed step accumulator loop as the demo
+ *  (real time in, clamped, whole steps out). After the steps of an update
+ *  it writes what drawing needs (the pose of every body before and after
+ *  the last step, the joints, the contacts) into a RenderFrame and
+ *  publishes it through a TripleBuffer. Neither side ever waits for the
+ *  other : the physics thread always has a slot of its own to write, the
+ *  reader keeps the slot it holds until it asks for a newer one.
+ *
+ *  The reader gets the latest published frame and draws the bodies in
+ *  between the two poses, by how far the time left in the accumulator (plus
+ *  the time since publishing) is into the next step.
+ *
+ *  Inputs (InputEvent, see replay.hpp) are posted to a bounded single
+ *  producer, single consumer ring, the physics thread does them right
+ *  before its next step. A full ring drops the input and counts it.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "linalg.h"
+
+#include "replay.hpp"
+#include "scene.hpp"
+#include "shape.hpp"
+
+// Three slots, one written by a single writer, one held by a single reader,
+// and the one in between holding the latest published value. Publish() and
+// Acquire() swap a slot with the one in between, nothing else is shared.
+template <typename T>
+class TripleBuffer
+{
+private:
+    static constexpr uint32_t k_indexMask = 3u;
+    // set while the slot in between was published and not acquired yet
+    static constexpr uint32_t k_newBit = 4u;
+
+    std::array<T, 3> m_slots;
+    std::atomic<uint32_t> m_middle;
+    // of the writer
+    uint32_t m_back;
+    // of the reader
+    uint32_t m_front;
+
+public:
+    TripleBuffer() : m_slots(), m_middle(1u), m_back(0u), m_front(2u) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // the writer fills this, then publishes it
+    inline T& GetBack() { return m_slots[m_back]; }
+    inline void Publish()
+    {
+        m_back = m_middle.exchange(m_back | k_newBit, std::memory_order_acq_rel) & k_indexMask;
+    }
+
+    // takes the latest published value if there is one newer than the front,
+    // true if there was
+    inline bool Acquire()
+    {
+        if((m_middle.load(std::memory_order_relaxed) & k_newBit) == 0u)
+            return false;
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & k_indexMask;
+        return true;
+    }
+    inline const T& GetFront() const { return m_slots[m_front]; }
+};
+
+// A bounded ring for one thread pushing and one thread popping. The counts
+// only grow, a slot is 'count & (capacity - 1)'.
+template <typename T>
+class SpscQueue
+{
+private:
+    std::vector<T> m_slots;
+    size_t m_mask;
+    // apart so the two threads do not write the same cache line
+    alignas(64) std::atomic<uint64_t> m_pushed;
+    alignas(64) std::atomic<uint64_t> m_popped;
+
+public:
+    // the capacity is rounded up to a power of two
+    explicit SpscQueue(size_t _capacity)
+        : m_slots(), m_mask(0u), m_pushed(0u), m_popped(0u)
+    {
+        size_t capacity = 1u;
+        while(capacity < std::max<size_t>(_capacity, 1u))
+            capacity *= 2u;
+        m_slots.resize(capacity);
+        m_mask = capacity - 1u;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // false if the ring is full
+    inline bool TryPush(const T& _value)
+    {
+        const uint64_t pushed = m_pushed.load(std::memory_order_relaxed);
+        if(pushed - m_popped.load(std::memory_order_acquire) > m_mask)
+            return false;
+        m_slots[pushed & m_mask] = _value;
+        m_pushed.store(pushed + 1u, std::memory_order_release);
+        return true;
+    }
+
+    // false if the ring is empty
+    inline bool TryPop(T& _value)
+    {
+        const uint64_t popped = m_popped.load(std::memory_order_relaxed);
+        if(popped == m_pushed.load(std::memory_order_acquire))
+            return false;
+        _value = m_slots[popped & m_mask];
+        m_popped.store(popped + 1u, std::memory_order_release);
+        return true;
+    }
+
+    inline size_t GetCapacity() const { return m_slots.size(); }
+};
+
+struct FrameBody
+{
+    ShapeType type;
+    // the radius (x) of a circle, the extent of a box
+    linalg::aliases::float2 size;
+    // before and after the last step, the same for a body spawned right
+    // before it
+    linalg::aliases::float2 previousPosition;
+    linalg::aliases::float2 position;
+    float previousOrientation;
+    float orientation;
+};
+
+enum class FrameJointType : uint8_t
+{
+    Spring,
+    Distance,
+    Other
+};
+
+struct FrameJoint
+{
+    FrameJointType type;
+    // dense indices of the bodies of the frame
+    uint32_t body0;
+    uint32_t body1;
+};
+
+// what the physics thread publishes after an update
+struct RenderFrame
+{
+    // steps done
+    uint64_t step = 0u;
+    float deltaTime = 0.0f;
+    // seconds left in the accumulator after the last step, and when
+    // (Clock::NowNs()) that was
+    float accumulator = 0.0f;
+    uint64_t publishNs = 0u;
+    bool isSleeping = false;
+    bool isDrawingContacts = false;
+
+    std::vector<FrameBody> bodies;
+    std::vector<FrameJoint> joints;
+    // of the last step, only when drawing them
+    std::vector<ContactPoint> contacts;
+
+    // how far '_nowNs' is into the step after this frame, in [0, 1], to
+    // blend the poses of the bodies by
+    float GetAlpha(uint64_t _nowNs) const;
+};
+
+class PhysicsThread
+{
+private:
+    std::shared_ptr<Scene> m_scene;
+    float m_accumulateUpperBound;
+
+    TripleBuffer<RenderFrame> m_frames;
+    SpscQueue<InputEvent> m_inputs;
+    std::atomic<bool> m_isDrawingContacts;
+    std::atomic<bool> m_isStopping;
+    std::atomic<uint64_t> m_stepCount;
+    std::atomic<uint64_t> m_droppedInputs;
+    std::atomic<uint64_t> m_failedInputs;
+    std::thread m_thread;
+
+    // of the physics thread : the poses before the step being taken
+    std::vector<float> m_previousX, m_previousY, m_previousOrientation;
+
+    void Loop();
+    void ApplyInputs();
+    void Publish(float _accumulator, uint64_t _nowNs);
+
+public:
+    // '_scene' belongs to the thread from Start() to Stop(), nothing else
+    // may touch it in between. '_accumulateUpperBound' clamps the time
+    // stepped after a stall, see the main loop of the demo.
+    explicit PhysicsThread(const std::shared_ptr<Scene>& _scene, float _accumulateUpperBound = 0.1f,
+        size_t _inputCapacity = 256u);
+    // stops the thread
+    ~PhysicsThread();
+
+    PhysicsThread(const PhysicsThread&) = delete;
+    PhysicsThread& operator=(const PhysicsThread&) = delete;
+
+    // publishes the scene as it is, then starts stepping it
+    void Start();
+    // waits for the step in flight, the scene is the caller's again after
+    void Stop();
+    inline bool IsRunning() const { return m_thread.joinable(); }
+
+    // From one thread at a time. The input is done right before the next
+    // step, its 'step' is ignored. False (and counted) if the ring is full.
+    bool Post(const InputEvent& _event);
+    // taken by the physics thread at its next step
+    inline void SetDrawContacts(bool _enabled) { m_isDrawingContacts.store(_enabled, std::memory_order_relaxed); }
+
+    // From one thread at a time. The latest published frame, it stays valid
+    // and unchanged until the next call.
+    const RenderFrame& GetLatestFrame();
+
+    inline uint64_t GetStepCount() const { return m_stepCount.load(std::memory_order_relaxed); }
+    // inputs dropped because the ring was full, and inputs the scene threw
+    // for (a body that is gone)
+    inline uint64_t GetDroppedInputCount() const { return m_droppedInputs.load(std::memory_order_relaxed); }
+    inline uint64_t GetFailedInputCount() const { return m_failedInputs.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,210 @@
+#pragma once
+
+/**
+ *  Scoped timers and counters for the stages of a step. A scene with a
+ *  profiler makes it the current one for the length of Step(), and every
+ *  PROFILE_SCOPE() and PROFILE_COUNT() reached meanwhile, on any thread of
+ *  the job system, adds to the stats of that step. Without a current
+ *  profiler a scope costs a load and a branch.
+ *
+ *  Building with RIGIDBODY2D_PROFILE set to 0 (make PROFILE=0) removes the
+ *  scopes and counters at compile time, a profiler then never sees a step.
+ *
+ *  The stats of the last step are kept as a StepStats. A trace of every
+ *  scope can be streamed to a file as well, in the chrome trace format
+ *  (chrome://tracing or https://ui.perfetto.dev).
+ *
+ *  One profiled step can run at a time in a process.
+ */
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "clock.hpp"
+
+#ifndef RIGIDBODY2D_PROFILE
+#define RIGIDBODY2D_PROFILE 1
+#endif
+
+enum class ProfileZone : uint8_t
+{
+    Step,
+    Transforms,
+    Broadphase,
+    Narrowphase,
+    // one per shape pair type, in the order of
+    // CollisionHelper::GetShapePairIndex()
+    NarrowphaseOBBOBB,
+    NarrowphaseOBBCircle,
+    NarrowphaseCircleOBB,
+    NarrowphaseCircleCircle,
+    Solver,
+    // what a solver does before its iterations (coloring, pre step)
+    SolverSetup,
+    SolverIteration,
+    PositionalCorrection,
+    Joints,
+    Integrate,
+    Count
+};
+
+enum class ProfileCounter : uint8_t
+{
+    // candidate pairs found by the broadphase
+    BroadphasePairs,
+    // pairs run through the narrowphase
+    PairsTested,
+    // manifolds with at least one contact point
+    Hits,
+    ContactPoints,
+    SolverIterations,
+    Count
+};
+
+// Time and calls of every zone and the counters of a step (or of several,
+// see Profiler::GetTotal()). Zones nest, the time of the narrowphase
+// includes the time of its shape pair types for example. Time of a zone
+// that runs on several threads at once is summed over the threads.
+struct StepStats
+{
+    static constexpr size_t k_zoneCount = static_cast<size_t>(ProfileZone::Count);
+    static constexpr size_t k_counterCount = static_cast<size_t>(ProfileCounter::Count);
+
+    // steps these stats are about
+    uint64_t steps;
+    std::array<uint64_t, k_zoneCount> zoneNs;
+    std::array<uint32_t, k_zoneCount> zoneCalls;
+    std::array<uint64_t, k_counterCount> counters;
+
+    StepStats() : steps(0u), zoneNs(), zoneCalls(), counters() {}
+
+    void Add(const StepStats& _other);
+
+    inline double GetZoneMs(ProfileZone _zone) const { return zoneNs[static_cast<size_t>(_zone)] * 1e-6; }
+    inline uint32_t GetZoneCalls(ProfileZone _zone) const { return zoneCalls[static_cast<size_t>(_zone)]; }
+    inline uint64_t GetCounter(ProfileCounter _counter) const { return counters[static_cast<size_t>(_counter)]; }
+};
+
+class Profiler
+{
+public:
+    // makes '_profiler' (if not null) the current one until the end of the
+    // scope, which ends the step
+    class StepScope
+    {
+    private:
+        Profiler* m_profiler;
+        uint64_t m_start;
+
+    public:
+        explicit StepScope(Profiler* _profiler);
+        ~StepScope();
+
+        StepScope(const StepScope&) = delete;
+        StepScope& operator=(const StepScope&) = delete;
+    };
+
+private:
+    struct TraceEvent
+    {
+        ProfileZone zone;
+        uint32_t thread;
+        uint64_t startNs;
+        uint64_t endNs;
+    };
+
+    static std::atomic<Profiler*> s_current;
+
+    // the step that is running, added to by any thread
+    std::array<std::atomic<uint64_t>, StepStats::k_zoneCount> m_zoneNs;
+    std::array<std::atomic<uint32_t>, StepStats::k_zoneCount> m_zoneCalls;
+    std::array<std::atomic<uint64_t>, StepStats::k_counterCount> m_counters;
+
+    StepStats m_last;
+    StepStats m_total;
+
+    // the trace file, the events of a step are written when it ends
+    FILE* m_trace;
+    bool m_isFirstEvent;
+    uint64_t m_traceOrigin;
+    std::mutex m_eventMutex;
+    std::vector<TraceEvent> m_events;
+
+    void BeginStep();
+    void EndStep();
+    void WriteEvents();
+
+public:
+    Profiler();
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    static const char* GetName(ProfileZone _zone);
+    static const char* GetName(ProfileCounter _counter);
+
+    // the stats of the last step that ran with this profiler
+    inline const StepStats& GetLastStep() const { return m_last; }
+    // every step since the last reset
+    inline const StepStats& GetTotal() const { return m_total; }
+    inline void ResetTotal() { m_total = StepStats(); }
+
+    // Streams every scope of the coming steps to '_path' as chrome trace
+    // events, with the counters of each step as counter events, until
+    // StopTrace() or the end of the profiler. Throws if the file can not
+    // be opened.
+    void StartTrace(const std::string& _path);
+    void StopTrace();
+    inline bool IsTracing() const { return m_trace != nullptr; }
+
+    static inline Profiler* GetCurrent() { return s_current.load(std::memory_order_relaxed); }
+
+    // for the macros below
+    void AddZone(ProfileZone _zone, uint64_t _startNs, uint64_t _endNs);
+    inline void AddCount(ProfileCounter _counter, uint64_t _value)
+    {
+        m_counters[static_cast<size_t>(_counter)].fetch_add(_value, std::memory_order_relaxed);
+    }
+};
+
+// times the scope it lives in, if there is a current profiler
+class ProfileScope
+{
+private:
+    Profiler* m_profiler;
+    ProfileZone m_zone;
+    uint64_t m_start;
+
+public:
+    explicit ProfileScope(ProfileZone _zone)
+        : m_profiler(Profiler::GetCurrent()), m_zone(_zone),
+          m_start(m_profiler != nullptr ? Clock::NowNs() : 0u)
+        {}
+    ~ProfileScope()
+    {
+        if(m_profiler != nullptr)
+            m_profiler->AddZone(m_zone, m_start, Clock::NowNs());
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#if RIGIDBODY2D_PROFILE
+#define RIGIDBODY2D_PROFILE_CONCAT_(a, b) a##b
+#define RIGIDBODY2D_PROFILE_CONCAT(a, b) RIGIDBODY2D_PROFILE_CONCAT_(a, b)
+#define PROFILE_STEP(_profiler) Profiler::StepScope RIGIDBODY2D_PROFILE_CONCAT(profileStep, __LINE__)(_profiler)
+#define PROFILE_SCOPE(_zone) ProfileScope RIGIDBODY2D_PROFILE_CONCAT(profileScope, __LINE__)(_zone)
+#define PROFILE_COUNT(_counter, _value) \
+    do { if(Profiler* profiler = Profiler::GetCurrent()) profiler->AddCount((_counter), (_value)); } while(false)
+#else
+#define PROFILE_STEP(_profiler) ((void)0)
+#define PROFILE_SCOPE(_zone) ((void)0)
+#define PROFILE_COUNT(_counter, _value) ((void)0)
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+
+/**
+ *  Drawing of a scene with legacy OpenGL. This is the only part of the
+ *  engine that needs freeglut, the physics core builds without it and only
+ *  the demo links it (see the makefile).
+ */
+
+class Shape;
+class Joint;
+class SceneBase;
+struct RenderFrame;
+
+class Renderer
+{
+public:
+    static void RenderShape(const Shape& _shape);
+    // spring joints are drawn red, distance joints green
+    static void RenderJoint(const Joint& _joint);
+    // every shape and joint, and the contacts of the last step if the scene
+    // keeps them
+    static void RenderScene(const SceneBase& _scene);
+    // a frame published by a PhysicsThread, the bodies '_alpha' of the way
+    // from their pose before the last step to the one after it
+    static void RenderInterpolated(const RenderFrame& _frame, float _alpha);
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+/**
+ *  Recording what is done to a scene from outside between steps (bodies
+ *  spawned, removed, pushed around), replaying it, and checking that a
+ *  run gives exactly the states an earlier one did.
+ *
+ *  An InputRecorder does the inputs on a scene and keeps them, keyed by the
+ *  number of steps done before them. Bodies are named by their dense index
+ *  at the time, which a replay of the same inputs on the same starting
+ *  scene gives back. Start from a scene that is built the same way, or
+ *  from a snapshot saved before its first step (see SceneSnapshot), and a
+ *  ReplayDriver does every input again before the step it was done at.
+ *
+ *  A step of the same binary gives the same bits for any number of threads
+ *  : the parallel stages collect their results in an order that does not
+ *  depend on which thread ran what. StateHashWriter streams a hash of the
+ *  whole body state after every step, with a hash per body, and a
+ *  StateHashVerifier reads such a file back while another run steps and
+ *  reports the first step and body that differ.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "linalg.h"
+
+#include "scene.hpp"
+
+enum class InputType : uint8_t
+{
+    SpawnCircle,
+    SpawnBox,
+    RemoveBody,
+    SetPosition,
+    SetVelocity,
+    SetAngularVelocity,
+    AddForce,
+    SetSleeping,
+    Count
+};
+
+struct InputEvent
+{
+    // steps done before the input
+    uint64_t step;
+    InputType type;
+    // dense index of the body, for the inputs on a body
+    uint32_t body;
+    // the position of a spawn, the velocity, the force
+    linalg::aliases::float2 value;
+    // the radius (x) of a circle, the size of a box
+    linalg::aliases::float2 size;
+    // the angular velocity, or whether sleeping is on
+    float scalar;
+};
+
+class InputRecording
+{
+private:
+    std::vector<InputEvent> m_events;
+    // steps recorded, inputs are at steps before this
+    uint64_t m_stepCount;
+
+public:
+    static constexpr uint32_t k_version = 1u;
+
+    InputRecording() : m_events(), m_stepCount(0u) {}
+
+    // inputs have to come in the order of their steps
+    void Add(const InputEvent& _event);
+    inline void SetStepCount(uint64_t _count) { m_stepCount = _count; }
+
+    inline const std::vector<InputEvent>& GetEvents() const { return m_events; }
+    inline uint64_t GetStepCount() const { return m_stepCount; }
+
+    // throw if the file can not be written or read, or is not a recording
+    // of this version
+    void Save(const std::string& _path) const;
+    static InputRecording Load(const std::string& _path);
+
+    // does one input on '_scene', throws for bodies it does not have
+    static void Apply(Scene& _scene, const InputEvent& _event);
+};
+
+class InputRecorder
+{
+private:
+    Scene& m_scene;
+    InputRecording m_recording;
+    uint64_t m_step;
+
+    uint32_t IndexOf(const std::shared_ptr<RigidBody2D>& _body) const;
+    void Record(const InputEvent& _event);
+
+public:
+    explicit InputRecorder(Scene& _scene) : m_scene(_scene), m_recording(), m_step(0u) {}
+
+    std::shared_ptr<RigidBody2D> SpawnCircle(linalg::aliases::float2 _position, float _radius);
+    std::shared_ptr<RigidBody2D> SpawnBox(linalg::aliases::float2 _position, linalg::aliases::float2 _size);
+    void RemoveBody(const std::shared_ptr<RigidBody2D>& _body);
+    void SetPosition(const std::shared_ptr<RigidBody2D>& _body, linalg::aliases::float2 _position);
+    void SetVelocity(const std::shared_ptr<RigidBody2D>& _body, linalg::aliases::float2 _velocity);
+    void SetAngularVelocity(const std::shared_ptr<RigidBody2D>& _body, float _angularVelocity);
+    void AddForce(const std::shared_ptr<RigidBody2D>& _body, linalg::aliases::float2 _force);
+    void SetSleeping(bool _enabled);
+
+    // steps the scene, inputs after this belong to the next step
+    void Step();
+
+    inline uint64_t GetStep() const { return m_step; }
+    inline const InputRecording& GetRecording() const { return m_recording; }
+};
+
+class ReplayDriver
+{
+private:
+    Scene& m_scene;
+    const InputRecording& m_recording;
+    size_t m_next;
+    uint64_t m_step;
+
+public:
+    // '_scene' has to be where the recording started, '_recording' has to
+    // outlive the driver
+    ReplayDriver(Scene& _scene, const InputRecording& _recording)
+        : m_scene(_scene), m_recording(_recording), m_next(0u), m_step(0u)
+        {}
+
+    // does the inputs of the current step, then steps the scene
+    void Step();
+
+    inline uint64_t GetStep() const { return m_step; }
+    inline bool IsDone() const { return m_step >= m_recording.GetStepCount(); }
+};
+
+class StateHasher
+{
+public:
+    // Hash of every body field (bits, so -0 and 0 differ), the handle and
+    // whether the body is awake, for the bodies in dense order. Puts the
+    // hash of every body in '_bodyHashes' if given.
+    static uint64_t Hash(const BodyStore& _store, std::vector<uint32_t>* _bodyHashes = nullptr);
+};
+
+class StateHashWriter
+{
+private:
+    FILE* m_file;
+    std::vector<uint32_t> m_bodyHashes;
+
+public:
+    // throws if the file can not be written
+    explicit StateHashWriter(const std::string& _path);
+    ~StateHashWriter();
+
+    StateHashWriter(const StateHashWriter&) = delete;
+    StateHashWriter& operator=(const StateHashWriter&) = delete;
+
+    // the state after '_step' steps were done
+    void Add(uint64_t _step, const BodyStore& _store);
+    void Close();
+};
+
+class StateHashVerifier
+{
+private:
+    FILE* m_file;
+    std::vector<uint32_t> m_bodyHashes;
+    std::vector<uint32_t> m_referenceHashes;
+    bool m_hasDiverged;
+    uint64_t m_checkedCount;
+    std::string m_report;
+
+public:
+    // throws if the file can not be read or is not a hash file
+    explicit StateHashVerifier(const std::string& _path);
+    ~StateHashVerifier();
+
+    StateHashVerifier(const StateHashVerifier&) = delete;
+    StateHashVerifier& operator=(const StateHashVerifier&) = delete;
+
+    // Compares the state after '_step' steps with the reference, false
+    // from the first difference on. Steps have to come in the order they
+    // were written.
+    bool Check(uint64_t _step, const BodyStore& _store);
+
+    inline bool HasDiverged() const { return m_hasDiverged; }
+    inline uint64_t GetCheckedCount() const { return m_checkedCount; }
+    // what differed first, empty if nothing did
+    inline const std::string& GetReport() const { return m_report; }
+};
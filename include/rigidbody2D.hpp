@@ -1,62 +1,66 @@
 #pragma once
 
 #include "linalg.h"
+#include "bodystore.hpp"
 
 #include <memory>
 
 class Shape;
 
+// A view of one body in a BodyStore. The data itself lives in the arrays
+// of the store, this only keeps a handle to it, so the view stays valid
+// when other bodies are removed (the dense index is looked up on every
+// access). Using a view of a removed body throws.
+// Views must not outlive the scene (and so the store) they came from.
 class RigidBody2D
 {
     typedef linalg::aliases::float2 float2;
 private:
-    float2 m_position;
+    BodyStore* m_store;
+    BodyHandle m_handle;
 
-private:
-    float2 m_velocity;
-    float2 m_force;
-
-    float m_restitution;
-    float m_mass;
-	float m_invMass;
-
-    float m_staticFriction;
-    float m_dynamicFriction;
-
-    // Angular components
-    float m_orientation; // radians
-    float m_angularVelocity;
-    float m_torque;
-    float m_inertia; // moment of inertia
-	float m_invInertia; // inverse of inertia
-
-    std::shared_ptr<Shape> m_shape;
+    inline uint32_t Index() const { return m_store->GetIndex(m_handle); }
 
 public:
-	RigidBody2D(
-		std::shared_ptr<Shape> _shape, float2 _position, float _restitution,
-		float _mass, float _staticFriction, float _dynamicFriction)
-		: m_position(_position), m_velocity(float2(0, 0)), m_force(float2(0, 0))
-		, m_restitution(_restitution), m_mass(_mass), m_invMass((m_mass == 0.0f) ? 0.0f : (1.0f / m_mass))
-		, m_staticFriction(_staticFriction), m_dynamicFriction(_dynamicFriction)
-		, m_orientation(0.0f), m_angularVelocity(0.0f), m_torque(0.0f), m_inertia(1.0f)
-		, m_invInertia((m_inertia == 0.0f) ? 0.0f : (1.0f / m_inertia))
-		, m_shape(std::move(_shape))
-	{}
-
-    inline std::shared_ptr<Shape> GetShape() const { return m_shape; }
-    inline float2 GetPosition() const { return m_position; }
-    inline float2 GetVelocity() const { return m_velocity; }
-	inline float2 GetForce() const { return m_force; }
-    inline float GetOrientation() const { return m_orientation; }
-	inline float GetAngularVelocity() const { return m_angularVelocity; }
-	inline float GetTorque() const { return m_torque; }
-
-	inline float GetMass() const { return m_mass; }
-	inline float GetInvMass() const { return m_invMass; }
-
-	inline float GetInertia() const { return m_inertia; }
-	inline float GetInvInertia() const { return m_invInertia; }
+    RigidBody2D(BodyStore* _store, BodyHandle _handle)
+        : m_store(_store), m_handle(_handle)
+    {}
+
+    inline BodyHandle GetHandle() const { return m_handle; }
+    // the dense index in the store, only stable until a body is removed
+    inline uint32_t GetIndex() const { return Index(); }
+    // false once the body was removed from its scene
+    inline bool IsValid() const { return m_store->IsValid(m_handle); }
+
+    inline const std::shared_ptr<Shape>& GetShape() const { return m_store->m_shapes[Index()]; }
+    inline float2 GetPosition() const { return m_store->GetPosition(Index()); }
+    inline float2 GetVelocity() const { return m_store->GetVelocity(Index()); }
+	inline float2 GetForce() const { return m_store->GetForce(Index()); }
+    inline float GetOrientation() const { return m_store->m_orientation[Index()]; }
+	inline float GetAngularVelocity() const { return m_store->m_angularVelocity[Index()]; }
+	inline float GetTorque() const { return m_store->m_torque[Index()]; }
+
+	inline float GetMass() const { return m_store->m_mass[Index()]; }
+	inline float GetInvMass() const { return m_store->m_invMass[Index()]; }
+
+	inline float GetInertia() const { return m_store->m_inertia[Index()]; }
+	inline float GetInvInertia() const { return m_store->m_invInertia[Index()]; }
+
+	inline float GetRestitution() const { return m_store->m_restitution[Index()]; }
+	inline float GetStaticFriction() const { return m_store->m_staticFriction[Index()]; }
+	inline float GetDynamicFriction() const { return m_store->m_dynamicFriction[Index()]; }
+
+	// false while the body sleeps, it is not integrated or tested then
+	inline bool IsAwake() const { return m_store->IsAwake(Index()); }
+
+	inline const BodyTransformCache& GetTransformCache() const { return m_store->m_transforms[Index()]; }
+	inline bool IsTransformDirty() const { return m_store->m_transformDirty[Index()] != 0u; }
+	// recompute the cached world space data from the current transform
+	void UpdateTransformCache() { m_store->UpdateTransform(Index()); }
+
+	// Every setter below wakes a sleeping body (and its island) in the
+	// next step, bodies that are already awake are left as they are.
+	void Wake() { m_store->Wake(Index()); }
 
     // notice that we do not do negative mass testing here
     void SetMass(float _mass)
@@ -66,34 +70,36 @@ public:
 			SetStatic();
 			return;
 		}
-		m_mass = _mass;
-		m_invMass = (m_mass == 0.0f) ? 0.0f : (1 / m_mass);
+		const uint32_t index = Index();
+		m_store->m_mass[index] = _mass;
+		m_store->m_invMass[index] = 1 / _mass;
+		m_store->Wake(index);
 	}
 
 	void SetStatic()
 	{
-		m_mass = 0.0f;
-		m_invMass = 0.0f;
-		m_inertia = 0.0f;
-		m_invInertia = 0.0f;
+		const uint32_t index = Index();
+		m_store->Wake(index);
+		m_store->m_mass[index] = 0.0f;
+		m_store->m_invMass[index] = 0.0f;
+		m_store->m_inertia[index] = 0.0f;
+		m_store->m_invInertia[index] = 0.0f;
 	}
 
-	void SetPosition(float2 _pos) { m_position = _pos; }
-	void AddPosition(float2 _pos) { m_position += _pos; }
-
-    void SetVelocity(float2 _velo) { m_velocity = _velo; }
-    void AddVelocity(float2 _velo) { m_velocity += _velo; }
+	void SetPosition(float2 _pos) { const uint32_t index = Index(); m_store->SetPosition(index, _pos); m_store->Wake(index); }
+	void AddPosition(float2 _pos) { const uint32_t index = Index(); m_store->AddPosition(index, _pos); m_store->Wake(index); }
 
-    void SetForce(float2 _force) { m_force = _force; }
-    void AddForce(float2 _force) { m_force += _force; }
+    void SetVelocity(float2 _velo) { const uint32_t index = Index(); m_store->SetVelocity(index, _velo); m_store->Wake(index); }
+    void AddVelocity(float2 _velo) { const uint32_t index = Index(); m_store->AddVelocity(index, _velo); m_store->Wake(index); }
 
-	void SetOrientation(float _ori) { m_orientation = _ori; }
-	void AddOrientation(float _ori) { m_orientation += _ori; }
+    void SetForce(float2 _force) { const uint32_t index = Index(); m_store->SetForce(index, _force); m_store->Wake(index); }
+    void AddForce(float2 _force) { const uint32_t index = Index(); m_store->AddForce(index, _force); m_store->Wake(index); }
 
-	void SetAngularVelocity(float _angVel) { m_angularVelocity = _angVel; }
-	void AddAngularVelocity(float _angVel) { m_angularVelocity += _angVel; }
+	void SetOrientation(float _ori) { const uint32_t index = Index(); m_store->SetOrientation(index, _ori); m_store->Wake(index); }
+	void AddOrientation(float _ori) { const uint32_t index = Index(); m_store->AddOrientation(index, _ori); m_store->Wake(index); }
 
-	void SetTorque(float _torque) { m_torque = _torque; }
+	void SetAngularVelocity(float _angVel) { const uint32_t index = Index(); m_store->m_angularVelocity[index] = _angVel; m_store->Wake(index); }
+	void AddAngularVelocity(float _angVel) { const uint32_t index = Index(); m_store->m_angularVelocity[index] += _angVel; m_store->Wake(index); }
 
-	friend class Manifold;
-};
\ No newline at end of file
+	void SetTorque(float _torque) { const uint32_t index = Index(); m_store->m_torque[index] = _torque; m_store->Wake(index); }
+};
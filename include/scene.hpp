@@ -1,42 +1,281 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <type_traits>
 #include <vector>
 
+#include "bodystore.hpp"
 #include "rigidbody2D.hpp"
 #include "joint.hpp"
 #include "integrator.hpp"
+#include "solver.hpp"
+#include "paircache.hpp"
 #include "manifold.hpp"
+#include "broadphase.hpp"
+#include "collision.hpp"
+#include "island.hpp"
+#include "jobsystem.hpp"
+#include "profiler.hpp"
+#include "trajectory.hpp"
 
-class Scene : public std::enable_shared_from_this<Scene>
+// a contact point found by the last step, published for debug drawing
+struct ContactPoint
+{
+    linalg::aliases::float2 position;
+    linalg::aliases::float2 normal;
+    float penetration;
+};
+
+// result of Scene::RayCast, the closest body hit by the segment
+struct RayCastHit
+{
+    std::shared_ptr<RigidBody2D> body;
+    linalg::aliases::float2 point;
+    linalg::aliases::float2 normal;
+    // in [0, 1], how far along the segment the hit is
+    float fraction;
+};
+
+// the parts of a step that run on the job system, see Scene::GetStageStats()
+enum class SceneStage
+{
+    Transforms,
+    Broadphase,
+    Narrowphase,
+    Solver,
+    Joints,
+    Integrate,
+    Count
+};
+
+// The part of a scene that does not depend on its integrator, broadphase
+// and solver : the bodies, joints, contacts, islands and the stages of a
+// step between the policies. See BasicScene for the rest.
+class SceneBase
 {
     typedef linalg::aliases::float2 float2;
-private:
+protected:
 
     typedef std::shared_ptr<RigidBody2D> BodyRef;
     typedef std::shared_ptr<Joint> JointRef;
+    class StageScope;
 
     float m_deltaTime;
     uint32_t m_iterations;
+    // the body data, integrators and the solver loop over its arrays
+    BodyStore m_store;
+    // views handed out by AddRigidBody(), in the dense order of the store
     std::vector<BodyRef> m_bodies;
     std::vector<JointRef> m_joints;
-    // this field should be updated by Step()
-    mutable std::vector<Manifold> m_manifolds;
+    // contact records of the current step, cleared (not freed) after it
+    std::vector<Manifold> m_manifolds;
+    // touching pairs, kept across steps
+    PairCache m_pairCache;
+    // contact points of the last step, only filled while drawing them
+    std::vector<ContactPoint> m_contacts;
+    bool m_drawContacts;
+    // candidate pairs from the broadphase, kept to reuse its capacity
+    std::vector<BodyPair> m_pairs;
+    // 'm_pairs' holds the active pairs of the Solve() of this step, see
+    // BasicScene::Solve(bool)
+    bool m_hasPairs;
+    // the same pairs grouped by shape pair type, see CollisionHelper
+    std::vector<BodyPair> m_sortedPairs;
+    std::array<size_t, CollisionHelper::k_shapePairCount + 1> m_batchOffsets;
+    // every stage of a step runs on this if there is one
+    std::shared_ptr<JobSystem> m_jobs;
+    OrderedBuffers<Manifold> m_narrowphaseBuffers;
+    std::array<JobStats, static_cast<size_t>(SceneStage::Count)> m_stageStats;
+    // wall time of every stage, only measured while stage timing is on
+    std::array<uint64_t, static_cast<size_t>(SceneStage::Count)> m_stageNs;
+    bool m_isTimingStages;
+    // the innermost timed stage, the runge kutta integrator runs whole
+    // Solve()s inside the integrate stage
+    StageScope* m_openStage;
+    // contact points of the manifolds of the last Solve()
+    size_t m_contactPointCount;
+    // current during Step(), see profiler.hpp
+    std::shared_ptr<Profiler> m_profiler;
+    // gets the bodies at the end of every Step(), see trajectory.hpp
+    std::shared_ptr<TrajectoryRecorder> m_recorder;
 
-    std::shared_ptr<Integrator> m_integrator;
+    // Joints are colored like the manifolds of GraphColoringSolver, no two
+    // joints of a color share a body (static ones included, joints write
+    // forces to them too). Joints that find no free color, or that might
+    // wake a sleeping body, are applied one by one after the colors. The
+    // colors are the order joints are applied in without threads too.
+    static constexpr uint32_t k_maxJointColors = 32u;
+    std::vector<uint32_t> m_jointBodyColors;
+    std::vector<uint8_t> m_jointColors;
+    std::vector<uint32_t> m_coloredJoints;
+    std::array<uint32_t, k_maxJointColors + 2> m_jointColorOffsets;
 
-public:
-    Scene(float _dt, uint32_t _iterations, const std::shared_ptr<Integrator>& _integrator) 
-        : m_deltaTime(_dt), m_iterations(_iterations), m_bodies(), m_joints(),
-          m_manifolds(), m_integrator(_integrator)
+    SleepSettings m_sleepSettings;
+    IslandManager m_islands;
+    // pairs without an awake body, they skip the narrowphase unless one of
+    // their islands is woken during the step
+    std::vector<BodyPair> m_sleepingPairs;
+    std::vector<BodyPair> m_wokenPairs;
+    // pairs of bodies that touched in the last Solve(), for the islands
+    std::vector<BodyPair> m_islandLinks;
+
+    SceneBase(float _dt, uint32_t _iterations)
+        : m_deltaTime(_dt), m_iterations(_iterations), m_store(), m_bodies(), m_joints(),
+          m_manifolds(), m_pairCache(), m_contacts(), m_drawContacts(false), m_pairs(), m_hasPairs(false), m_sortedPairs(), m_batchOffsets(),
+          m_jobs(), m_narrowphaseBuffers(), m_stageStats(), m_stageNs(), m_isTimingStages(false), m_openStage(nullptr), m_contactPointCount(0u), m_profiler(), m_recorder(),
+          m_jointBodyColors(), m_jointColors(), m_coloredJoints(), m_jointColorOffsets(),
+          m_sleepSettings(), m_islands(), m_sleepingPairs(), m_wokenPairs(), m_islandLinks()
           {}
+    ~SceneBase() = default;
 
-    void Step();
-	void Solve();
-	void Integrate();
-    void Render() const;
+public:
+    // views of the bodies point into 'm_store'
+    SceneBase(const SceneBase&) = delete;
+    SceneBase& operator=(const SceneBase&) = delete;
+
+	// refresh the transform cache of bodies that moved since the last call
+	void UpdateTransforms();
+
+    inline float GetDeltaTime() const { return m_deltaTime; }
+    inline uint32_t GetIterations() const { return m_iterations; }
+
+    // Sleeping of resting islands, see IslandManager. Turning it off wakes
+    // every body.
+    void SetSleepSettings(const SleepSettings& _settings);
+    inline const SleepSettings& GetSleepSettings() const { return m_sleepSettings; }
+    inline const IslandManager& GetIslands() const { return m_islands; }
+
+    inline const std::shared_ptr<JobSystem>& GetJobSystem() const { return m_jobs; }
+
+    // time spent in the parallel loops of each stage since the last reset,
+    // only counted while there is a job system
+    inline const JobStats& GetStageStats(SceneStage _stage) const { return m_stageStats[static_cast<size_t>(_stage)]; }
+    // resets the wall times of the stages too
+    void ResetStageStats();
+
+    // Wall time of every stage since the last reset, whether there is a job
+    // system or not. Off by default, it reads the clock twice per stage. A
+    // stage run inside another one (the Solve()s of the runge kutta stages
+    // inside Integrate) is only counted for itself, so the times add up to
+    // no more than the step.
+    inline void SetStageTiming(bool _enabled) { m_isTimingStages = _enabled; }
+    inline bool GetStageTiming() const { return m_isTimingStages; }
+    inline double GetStageMs(SceneStage _stage) const { return m_stageNs[static_cast<size_t>(_stage)] * 1e-6; }
+
+    // Finer timers and counters than the stage timing, with the stats of
+    // every step kept by the profiler (null to stop). Does nothing when
+    // the profiler is compiled out.
+    inline void SetProfiler(const std::shared_ptr<Profiler>& _profiler) { m_profiler = _profiler; }
+    inline const std::shared_ptr<Profiler>& GetProfiler() const { return m_profiler; }
+
+    // Records the poses of the bodies after every Step() (null to stop)
+    inline void SetRecorder(const std::shared_ptr<TrajectoryRecorder>& _recorder) { m_recorder = _recorder; }
+    inline const std::shared_ptr<TrajectoryRecorder>& GetRecorder() const { return m_recorder; }
+
+    inline size_t GetAwakeBodyCount() const { return m_store.Size() - m_islands.GetSleepingBodyCount(); }
+
+    // Drawing contact points and normals needs Step() to keep a copy of
+    // them, so it is off by default and costs nothing then.
+    void SetDrawContacts(bool _enabled);
+    inline bool GetDrawContacts() const { return m_drawContacts; }
+    // read only snapshot of the contacts of the last step (empty if the
+    // drawing of contacts is off)
+    inline const std::vector<ContactPoint>& GetContacts() const { return m_contacts; }
+    // pairs touching in the last step, with the ones that began and ended
+    inline const PairCache& GetPairCache() const { return m_pairCache; }
+    // contact points found by the last Solve(), sleeping pairs not included
+    inline size_t GetContactPointCount() const { return m_contactPointCount; }
     // for a given shape, create a rigidbody and return it for further operation
     std::shared_ptr<RigidBody2D> AddRigidBody(const std::shared_ptr<Shape>& _shape, float2 _position);
+    inline const BodyStore& GetBodyStore() const { return m_store; }
+    inline size_t GetBodyCount() const { return m_store.Size(); }
+    // the view of the body at a dense index, see BodyStore
+    inline const std::shared_ptr<RigidBody2D>& GetBody(uint32_t _index) const { return m_bodies[_index]; }
+    // adding or removing a joint wakes the bodies it is attached to
     void AddJoint(const std::shared_ptr<Joint>& _joint);
+    void RemoveJoint(const std::shared_ptr<Joint>& _joint);
+    inline const std::vector<std::shared_ptr<Joint>>& GetJoints() const { return m_joints; }
+
+protected:
+    // the job stats, the wall time and the profile zone of a stage, for the
+    // scope it lives in
+    class StageScope
+    {
+    private:
+        JobSystem::ScopedStats m_stats;
+#if RIGIDBODY2D_PROFILE
+        ProfileScope m_profile;
+#endif
+        SceneBase& m_scene;
+        uint64_t* m_time;
+        std::chrono::steady_clock::time_point m_start;
+        // the stage this one runs in, and the time of the stages run in this one
+        StageScope* m_parent;
+        uint64_t m_nestedNs;
+
+#if RIGIDBODY2D_PROFILE
+        static constexpr ProfileZone k_stageZones[static_cast<size_t>(SceneStage::Count)] =
+        {
+            ProfileZone::Transforms, ProfileZone::Broadphase, ProfileZone::Narrowphase,
+            ProfileZone::Solver, ProfileZone::Joints, ProfileZone::Integrate,
+        };
+#endif
+
+    public:
+        StageScope(SceneBase& _scene, SceneStage _stage)
+            : m_stats(_scene.m_jobs.get(), _scene.StageStats(_stage)),
+#if RIGIDBODY2D_PROFILE
+              m_profile(k_stageZones[static_cast<size_t>(_stage)]),
+#endif
+              m_scene(_scene),
+              m_time(_scene.m_isTimingStages ? &_scene.m_stageNs[static_cast<size_t>(_stage)] : nullptr),
+              m_start(m_time ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()),
+              m_parent(nullptr), m_nestedNs(0u)
+        {
+            if(m_time != nullptr)
+            {
+                m_parent = _scene.m_openStage;
+                _scene.m_openStage = this;
+            }
+        }
+        ~StageScope()
+        {
+            if(m_time != nullptr)
+            {
+                const uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - m_start).count());
+                *m_time += elapsed - std::min(elapsed, m_nestedNs);
+                if(m_parent != nullptr)
+                    m_parent->m_nestedNs += elapsed;
+                m_scene.m_openStage = m_parent;
+            }
+        }
+    };
+
+    // The stages of Solve() between the broadphase and the solver : sets
+    // aside sleeping pairs, runs the narrowphase and updates the pair
+    // cache. '_reusePairs' tells that 'm_pairs' was split already.
+    void FindContacts(bool _reusePairs);
+    // the stages after the solver, joints and the published contacts
+    void EndSolve();
+    void EndStep();
+
+    // The rest of the scene only needs the broadphase for these, they go
+    // through its virtual interface whatever the policy is.
+    void RemoveRigidBody(const std::shared_ptr<RigidBody2D>& _body, Broadphase& _broadphase);
+    std::vector<std::shared_ptr<RigidBody2D>> QueryRegion(const AABB& _region, const Broadphase& _broadphase) const;
+    bool RayCast(float2 _from, float2 _to, RayCastHit& _hit, const Broadphase& _broadphase) const;
+
+    // narrowphase of '_pairs', appended to 'm_manifolds'
+    void Collide(const std::vector<BodyPair>& _pairs);
+    // wakes sleeping islands touched by the manifolds from '_first' on, and
+    // runs the narrowphase for their pairs, until no island wakes up
+    void WakeTouchedIslands(size_t _first);
+    void UpdateSleeping();
+    void ColorJoints();
+    void ApplyJoints();
+    inline JobStats* StageStats(SceneStage _stage) { return &m_stageStats[static_cast<size_t>(_stage)]; }
 
     // the private here is purely for syntax, it does not affect the friend statement
 private:
@@ -44,4 +283,152 @@ private:
 	friend class SymplecticEulerIntegrator;
 	friend class NewtonIntegrator;
     friend class RungeKuttaFourthIntegrator;
-};
\ No newline at end of file
+    // fills the store of a new scene array by array
+    friend class SceneSnapshot;
+};
+
+// A scene whose integrator, broadphase and solver are fixed by type. With
+// concrete (final) policies every stage of a step is a direct call the
+// compiler can inline, the integrators are inlined down to their per body
+// loop. With the abstract interfaces as policies this is the scene of
+// before, which can switch any of them at runtime, see Scene.
+//
+// A policy left out of the constructor is default constructed, an abstract
+// one falls back to what Scene always used (all pairs, ImpulseSolver).
+template <typename IntegratorPolicy, typename BroadphasePolicy, typename SolverPolicy>
+class BasicScene : public SceneBase, public std::enable_shared_from_this<BasicScene<IntegratorPolicy, BroadphasePolicy, SolverPolicy>>
+{
+    typedef linalg::aliases::float2 float2;
+private:
+    static_assert(std::is_base_of<Integrator, IntegratorPolicy>::value, "IntegratorPolicy has to be an Integrator");
+    static_assert(std::is_base_of<Broadphase, BroadphasePolicy>::value, "BroadphasePolicy has to be a Broadphase");
+    static_assert(std::is_base_of<Solver, SolverPolicy>::value, "SolverPolicy has to be a Solver");
+
+    template <typename Policy, typename Fallback>
+    using DefaultPolicy = typename std::conditional<std::is_abstract<Policy>::value, Fallback, Policy>::type;
+
+    std::shared_ptr<IntegratorPolicy> m_integrator;
+    std::shared_ptr<BroadphasePolicy> m_broadphase;
+    std::shared_ptr<SolverPolicy> m_solver;
+
+public:
+    BasicScene(float _dt, uint32_t _iterations, const std::shared_ptr<IntegratorPolicy>& _integrator,
+        const std::shared_ptr<BroadphasePolicy>& _broadphase = nullptr,
+        const std::shared_ptr<SolverPolicy>& _solver = nullptr,
+        const std::shared_ptr<JobSystem>& _jobs = nullptr)
+        : SceneBase(_dt, _iterations), m_integrator(_integrator),
+          m_broadphase(_broadphase ? _broadphase : std::make_shared<DefaultPolicy<BroadphasePolicy, BruteForceBroadphase>>()),
+          m_solver(_solver ? _solver : std::make_shared<DefaultPolicy<SolverPolicy, ImpulseSolver>>())
+          {
+              SetJobSystem(_jobs);
+          }
+
+    void Step();
+	void Solve() { Solve(false); }
+	void Integrate();
+
+    // Runs every stage of a step on '_jobs' (nullptr to run them on the
+    // calling thread), the broadphase and the solver get it too. Results do
+    // not depend on the number of threads, joints are applied in the order
+    // of their colors (see ApplyJoints()) with or without a job system.
+    void SetJobSystem(const std::shared_ptr<JobSystem>& _jobs)
+    {
+        m_jobs = _jobs;
+        m_broadphase->SetJobSystem(m_jobs);
+        m_solver->SetJobSystem(m_jobs);
+    }
+
+    // the solver can be switched between steps, nullptr goes back to the
+    // default one
+    inline void SetSolver(const std::shared_ptr<SolverPolicy>& _solver)
+    {
+        m_solver = _solver ? _solver : std::make_shared<DefaultPolicy<SolverPolicy, ImpulseSolver>>();
+        m_solver->SetJobSystem(m_jobs);
+    }
+    inline const std::shared_ptr<SolverPolicy>& GetSolver() const { return m_solver; }
+    inline const std::shared_ptr<IntegratorPolicy>& GetIntegrator() const { return m_integrator; }
+    inline const std::shared_ptr<BroadphasePolicy>& GetBroadphase() const { return m_broadphase; }
+
+    // The last body takes the dense index of the removed one, views and
+    // handles of other bodies stay valid. Joints using the body have to be
+    // removed by the caller first.
+    inline void RemoveRigidBody(const std::shared_ptr<RigidBody2D>& _body)
+    {
+        SceneBase::RemoveRigidBody(_body, *m_broadphase);
+    }
+
+    // Spatial queries, these go through the broadphase so a tree based
+    // broadphase does not have to keep a second index around.
+    // bodies whose bounds overlap '_region'
+    inline std::vector<std::shared_ptr<RigidBody2D>> QueryRegion(const AABB& _region) const
+    {
+        return SceneBase::QueryRegion(_region, *m_broadphase);
+    }
+    // the closest body hit by the segment [_from, _to], if any
+    inline bool RayCast(float2 _from, float2 _to, RayCastHit& _hit) const
+    {
+        return SceneBase::RayCast(_from, _to, _hit, *m_broadphase);
+    }
+
+private:
+    // Solve() without the broadphase when '_reusePairs' is set, the pairs
+    // found by the last full Solve() of this step are run through the
+    // narrowphase again (if there was none, this is a full Solve()). Used
+    // by the stages of the runge kutta integrator.
+    void Solve(bool _reusePairs);
+
+    friend class RungeKuttaFourthIntegrator;
+};
+
+// the scene with every policy picked at runtime
+typedef BasicScene<Integrator, Broadphase, Solver> Scene;
+
+template <typename IntegratorPolicy, typename BroadphasePolicy, typename SolverPolicy>
+void BasicScene<IntegratorPolicy, BroadphasePolicy, SolverPolicy>::Step()
+{
+	PROFILE_STEP(m_profiler.get());
+
+	Solve();
+	Integrate();
+	EndStep();
+}
+
+template <typename IntegratorPolicy, typename BroadphasePolicy, typename SolverPolicy>
+void BasicScene<IntegratorPolicy, BroadphasePolicy, SolverPolicy>::Solve(bool _reusePairs)
+{
+	_reusePairs = _reusePairs && m_hasPairs;
+
+	// First : Refresh the world space data of bodies moved by integration,
+	// the broadphase and narrowphase only read from the transform cache
+	{
+		StageScope stage(*this, SceneStage::Transforms);
+		UpdateTransforms();
+	}
+
+	// Then : Find pairs that might collide
+	if (_reusePairs == false)
+	{
+		StageScope stage(*this, SceneStage::Broadphase);
+		m_broadphase->ComputePairs(m_store, m_pairs);
+		PROFILE_COUNT(ProfileCounter::BroadphasePairs, m_pairs.size());
+	}
+
+	// Then : Generate manifolds and find out which pairs touch
+	FindContacts(_reusePairs);
+
+	// Then : Resolve impulses by manifolds (and correct positions)
+	{
+		StageScope stage(*this, SceneStage::Solver);
+		m_solver->Solve(m_store, m_manifolds, m_pairCache, m_deltaTime, m_iterations);
+	}
+
+	EndSolve();
+}
+
+template <typename IntegratorPolicy, typename BroadphasePolicy, typename SolverPolicy>
+void BasicScene<IntegratorPolicy, BroadphasePolicy, SolverPolicy>::Integrate()
+{
+	// integrate, a concrete integrator takes this scene as it is
+	StageScope stage(*this, SceneStage::Integrate);
+	m_integrator->Integrate(*this);
+}
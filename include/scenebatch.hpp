@@ -0,0 +1,110 @@
+#pragma once
+
+/**
+ *  Many small independent worlds stepped together. All worlds share one
+ *  BodyStore, the bodies of a world are a contiguous range of it, so there
+ *  is one set of arrays instead of one scene (with its own buffers, caches
+ *  and policies) per world.
+ *
+ *  Step() hands out ranges of worlds to the job system. A range is stepped
+ *  world by world (transforms, pairs, narrowphase, the loop of
+ *  ImpulseSolver) while its bodies are in cache, then all of its bodies are
+ *  integrated with one call to an integrator kernel, so the vector kernels
+ *  run straight across the borders of the worlds. Worlds never touch each
+ *  other, and a world gives the same bits as a Scene with the same bodies,
+ *  the brute force broadphase, the impulse solver and the same euler
+ *  integrator, for any number of threads.
+ *
+ *  Each world keeps the body fields it started with, ResetWorld() copies
+ *  them back into its range, nothing is allocated.
+ *
+ *  Only bodies are supported, no joints, no sleeping and no runge kutta
+ *  (its stages would need the contacts of every world again).
+ */
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "bodystore.hpp"
+#include "broadphase.hpp"
+#include "collision.hpp"
+#include "integratorkernels.hpp"
+#include "jobsystem.hpp"
+#include "manifold.hpp"
+
+class SceneBase;
+
+class SceneBatch
+{
+private:
+    typedef linalg::aliases::float2 float2;
+
+    struct World
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // what stepping a world needs, one per thread, kept across steps
+    struct Scratch
+    {
+        std::vector<BodyPair> pairs;
+        std::vector<BodyPair> sortedPairs;
+        std::array<size_t, CollisionHelper::k_shapePairCount + 1> batchOffsets;
+        std::vector<Manifold> manifolds;
+    };
+
+    float m_deltaTime;
+    uint32_t m_iterations;
+    IntegratorKernels::Method m_method;
+    SimdLevel m_simdLevel;
+    std::shared_ptr<JobSystem> m_jobs;
+
+    BodyStore m_store;
+    std::vector<World> m_worlds;
+    // the bodies of every world sorted by the left side of their bounds, in
+    // the range of the world, kept across steps since it hardly changes
+    std::vector<uint32_t> m_sweepOrder;
+    // the float fields of every body as its world was added, one array per
+    // field of the table in scenebatch.cpp
+    std::vector<std::vector<float>> m_initial;
+    std::vector<Scratch> m_scratch;
+
+    void StepWorld(const World& _world, Scratch& _scratch);
+    // every overlapping pair of bodies of the world, in the order of the
+    // brute force broadphase
+    void FindPairs(const World& _world, std::vector<BodyPair>& _pairs);
+
+public:
+    SceneBatch(float _dt, uint32_t _iterations,
+        IntegratorKernels::Method _method = IntegratorKernels::Method::SymplecticEuler,
+        const std::shared_ptr<JobSystem>& _jobs = nullptr);
+
+    // Adds a world that starts with the bodies of '_scene' as they are now,
+    // returns its index. The shapes are shared with '_scene', which can go
+    // away afterwards. Throws for scenes with joints.
+    size_t AddWorld(const SceneBase& _scene);
+    void Reserve(size_t _worldCount, size_t _bodyCount);
+
+    // one step of every world
+    void Step();
+
+    // puts the bodies of a world back to how they were added
+    void ResetWorld(size_t _world);
+    void Reset();
+
+    inline void SetJobSystem(const std::shared_ptr<JobSystem>& _jobs) { m_jobs = _jobs; }
+    inline const std::shared_ptr<JobSystem>& GetJobSystem() const { return m_jobs; }
+    // see Integrator::SetSimdLevel()
+    inline void SetSimdLevel(SimdLevel _level) { m_simdLevel = std::min(_level, IntegratorKernels::GetSupportedLevel()); }
+    inline SimdLevel GetSimdLevel() const { return m_simdLevel; }
+
+    inline size_t GetWorldCount() const { return m_worlds.size(); }
+    inline size_t GetBodyCount() const { return m_store.Size(); }
+    // the bodies of a world are [offset, offset + count) of the store
+    inline uint32_t GetWorldOffset(size_t _world) const { return m_worlds[_world].offset; }
+    inline uint32_t GetWorldBodyCount(size_t _world) const { return m_worlds[_world].count; }
+    inline const BodyStore& GetBodyStore() const { return m_store; }
+};
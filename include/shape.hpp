@@ -1,14 +1,27 @@
 #pragma once
 
 #include <memory>
+#include <cstdint>
 
 #include "manifold.hpp"
+#include "aabb.hpp"
 class RigidBody2D;
+struct BodyTransformCache;
 
 // here we need to forward declare all sub-classes of 'Shape'
 class OBB;
 class Circle;
 
+// every concrete shape has a tag, so that collision functions can be looked
+// up from a table instead of going through the visitor
+enum class ShapeType : uint8_t
+{
+    OBB = 0,
+    Circle,
+
+    Count
+};
+
 template <typename R>
 class ShapeVisitor
 {
@@ -19,16 +32,31 @@ public:
 
 class Shape : public ShapeVisitor<Manifold>
 {
+private:
+    const ShapeType m_type;
+
 public:
     std::shared_ptr<RigidBody2D> m_body;
 public:
+    explicit Shape(ShapeType _type) : m_type(_type), m_body() {}
+
+    inline ShapeType GetType() const { return m_type; }
+
     // Here the return type of 'bool' is just a placeholder.
     // We will replace it with a data structure for storing collision data.
     // A so-called 'Manifold'.
     virtual Manifold accept(const ShapeVisitor<Manifold>& visitor) const = 0;
 
-    // Following sections are for rendering, it is more sophisticated to
-    // decouple these two behaviors, but for the sake of convenience, we
-    // will just do it here.
-    virtual void Render() const = 0;
+    // world space bounds of this shape, based on the transform of 'm_body'
+    virtual AABB GetAABB() const = 0;
+    // fill the shape dependent part of the cache (everything but rotation),
+    // '_cache.rotation' is already up to date when this is called
+    virtual void UpdateTransformCache(
+        const linalg::aliases::float2& _position, BodyTransformCache& _cache) const = 0;
+
+    // intersect the segment [_from, _to] with this shape, on a hit the
+    // fraction along the segment and the world space normal are written
+    virtual bool RayCast(
+        const linalg::aliases::float2& _from, const linalg::aliases::float2& _to,
+        float& _fraction, linalg::aliases::float2& _normal) const = 0;
 };
\ No newline at end of file
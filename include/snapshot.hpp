@@ -0,0 +1,48 @@
+#pragma once
+
+/**
+ *  Versioned binary snapshots of a whole Scene : the bodies with their
+ *  shapes, the joints, and what the scene was made with (time step,
+ *  iterations, sleep settings, the kind of integrator, broadphase and
+ *  solver along with their settings).
+ *
+ *  The file is little endian. A fixed size header with a table of section
+ *  offsets is followed by one section per body field, each a plain array
+ *  of one value per body in the layout of the arrays of BodyStore, every
+ *  section starting on a 64 byte boundary. Loading maps the file and
+ *  copies every section into its array in one go, nothing is parsed body
+ *  by body, only the shape and view objects of the scene are made per body.
+ *
+ *  Left out are the caches a scene rebuilds in its next step : the
+ *  transform cache, the broadphase, the touching pairs with the impulses
+ *  the sequential impulse solver warm starts from. Sleeping islands are
+ *  kept (renumbered in the order their first body appears). The body
+ *  arrays round trip bit for bit, and a scene that does not warm start
+ *  steps on exactly like the one that was saved.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "scene.hpp"
+
+class SceneSnapshot
+{
+public:
+    static constexpr uint32_t k_version = 1u;
+
+    // throws for integrators, broadphases, solvers and joints the format
+    // does not know, or if the file can not be written
+    static void Save(const Scene& _scene, const std::string& _path);
+    // Throws if the file can not be read, is not a snapshot of this
+    // version or is inconsistent. The scene runs on '_jobs' if given.
+    static std::shared_ptr<Scene> Load(
+        const std::string& _path, const std::shared_ptr<JobSystem>& _jobs = nullptr);
+    // the same for a snapshot that is already in memory
+    static std::shared_ptr<Scene> Load(
+        const void* _data, size_t _size, const std::shared_ptr<JobSystem>& _jobs = nullptr);
+
+    // bytes Save() writes for '_scene'
+    static size_t GetSize(const Scene& _scene);
+};
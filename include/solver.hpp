@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "linalg.h"
+
+#include "bodystore.hpp"
+#include "manifold.hpp"
+#include "paircache.hpp"
+#include "jobsystem.hpp"
+
+// an interface for contact solvers, a solver turns the manifolds found in
+// a step into changes of velocity (and maybe position) of the bodies. The
+// pair cache already knows every touching pair of this step, a solver can
+// keep per pair data in it for the next one.
+// The scene hands its job system to the solver, solvers that can split
+// their work use it, the others simply ignore it.
+class Solver
+{
+protected:
+    typedef linalg::aliases::float2 float2;
+
+    std::shared_ptr<JobSystem> m_jobs;
+
+public:
+    virtual ~Solver() = default;
+
+    inline void SetJobSystem(const std::shared_ptr<JobSystem>& _jobs) { m_jobs = _jobs; }
+    inline const std::shared_ptr<JobSystem>& GetJobSystem() const { return m_jobs; }
+
+	virtual void Solve(
+		BodyStore& _bodies, const std::vector<Manifold>& _manifolds, PairCache& _pairs,
+		float _deltaTime, uint32_t _iterations) = 0;
+};
+
+// What the scene always did : every iteration computes the whole impulse of
+// every manifold from scratch, then positions are corrected once.
+class ImpulseSolver final : public Solver
+{
+public:
+	virtual void Solve(
+		BodyStore& _bodies, const std::vector<Manifold>& _manifolds, PairCache& _pairs,
+		float _deltaTime, uint32_t _iterations) override;
+};
+
+// The loop of ImpulseSolver, run on the job system of the scene. Manifolds
+// are greedily colored so that no two manifolds of one color share a dynamic
+// body, static bodies are only read by Manifold::Resolve() so the floor does
+// not tie everything together. Every color is one parallel loop, the next
+// color starts once it is done. The order manifolds are resolved in is not
+// the one of ImpulseSolver, so results differ from it a little, but they
+// are the same for any number of threads (and without a job system, when
+// the colors are run on the calling thread).
+class GraphColoringSolver final : public Solver
+{
+private:
+    // colors are tracked as a bit mask per body, manifolds that find no
+    // free color (and the ones between two static bodies, which write to
+    // both) go to an extra group that a single thread resolves
+    static constexpr uint32_t k_maxColors = 32u;
+    static constexpr uint32_t k_overflow = k_maxColors;
+    // below this the threads would mostly wait on each other
+    static constexpr size_t k_minParallelManifolds = 256u;
+    // the smallest piece of a color handed to a thread
+    static constexpr size_t k_minGrain = 64u;
+
+    // per body, the colors already taken by its manifolds
+    std::vector<uint32_t> m_bodyColors;
+    std::vector<uint8_t> m_manifoldColors;
+    // manifold indices grouped by color (in manifold order inside a color),
+    // color k is [m_colorOffsets[k], m_colorOffsets[k + 1]), the overflow
+    // group comes last
+    std::vector<uint32_t> m_colored;
+    std::array<uint32_t, k_maxColors + 2> m_colorOffsets;
+    uint32_t m_colorCount;
+
+    void Color(const BodyStore& _bodies, const std::vector<Manifold>& _manifolds);
+    // resolves (or corrects the positions of) every color in turn, on
+    // '_jobs' if it is not null
+    void RunColors(
+        JobSystem* _jobs, BodyStore& _bodies, const std::vector<Manifold>& _manifolds,
+        bool _isPositional) const;
+
+public:
+    GraphColoringSolver()
+        : m_bodyColors(), m_manifoldColors(), m_colored(), m_colorOffsets(),
+          m_colorCount(0u)
+        {}
+
+	virtual void Solve(
+		BodyStore& _bodies, const std::vector<Manifold>& _manifolds, PairCache& _pairs,
+		float _deltaTime, uint32_t _iterations) override;
+
+    // colors used by the last Solve(), and how many manifolds overflowed
+    inline uint32_t GetColorCount() const { return m_colorCount; }
+    inline size_t GetOverflowCount() const { return m_colorOffsets[k_overflow + 1] - m_colorOffsets[k_overflow]; }
+};
+
+// Sequential impulses in the style of Box2D Lite. Every contact point keeps
+// the total impulse applied to it during the step and only that total is
+// clamped (non negative for the normal, inside the friction cone for the
+// tangent), so later iterations can take back some of an earlier impulse.
+// Effective masses are computed once per step, and the totals of the last
+// step are applied up front (warm starting), matched by contact id. The
+// totals are kept in the pair cache of the scene.
+// Penetration is removed with a velocity bias instead of moving bodies.
+class SequentialImpulseSolver final : public Solver
+{
+private:
+    struct PointConstraint
+    {
+        float2 ra, rb;
+        float normalMass;
+        float tangentMass;
+        float bias;
+        float normalImpulse;
+        float tangentImpulse;
+        uint32_t id;
+    };
+
+    struct ContactConstraint
+    {
+        uint32_t body0, body1;
+        // entry of the pair in the pair cache
+        uint32_t cacheEntry;
+        float2 normal;
+        float2 tangent;
+        float friction;
+        int pointCount;
+        PointConstraint points[2];
+    };
+
+    // fraction of the penetration (beyond the slop) removed per step
+    float m_baumgarte;
+    float m_slop;
+    bool m_warmStarting;
+
+    std::vector<ContactConstraint> m_constraints;
+
+    void PreStep(
+        BodyStore& _bodies, const std::vector<Manifold>& _manifolds, const PairCache& _pairs,
+        float _deltaTime);
+    void WarmStart(BodyStore& _bodies);
+    void SolveVelocities(BodyStore& _bodies);
+    void StoreImpulses(PairCache& _pairs);
+
+public:
+    explicit SequentialImpulseSolver(bool _warmStarting = true, float _baumgarte = 0.2f, float _slop = 0.01f)
+        : m_baumgarte(_baumgarte), m_slop(_slop), m_warmStarting(_warmStarting),
+          m_constraints()
+        {}
+
+	virtual void Solve(
+		BodyStore& _bodies, const std::vector<Manifold>& _manifolds, PairCache& _pairs,
+		float _deltaTime, uint32_t _iterations) override;
+
+    inline bool GetWarmStarting() const { return m_warmStarting; }
+    inline float GetBaumgarte() const { return m_baumgarte; }
+    inline float GetSlop() const { return m_slop; }
+};
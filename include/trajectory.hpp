@@ -0,0 +1,159 @@
+#pragma once
+
+/**
+ *  Recording the position and orientation of every body for every step,
+ *  small enough for long runs, and reading any step of it back.
+ *
+ *  The recorder is set on a scene and gets the bodies at the end of every
+ *  Step(). It only copies the three arrays into a slot of a bounded ring
+ *  and returns, a writer thread does the rest. When the ring is full the
+ *  step is dropped (and counted) instead of waiting for the writer.
+ *
+ *  The file is a header and a stream of chunks, one per recorded step.
+ *  Values are quantized to the precision of the settings. A keyframe holds
+ *  every body, the chunks in between only the change since the last chunk,
+ *  for the bodies that moved (a bitmap tells which), each value zigzag
+ *  encoded and bit packed with the width the largest change of the chunk
+ *  needs. A keyframe is written every 'keyframeInterval' steps and whenever
+ *  the number of bodies changes. Bodies are recorded by dense index, so
+ *  removing a body moves the last one into its place.
+ *
+ *  The reader scans the chunk headers once, then rebuilds any step from the
+ *  keyframe before it. Reading forward continues from the last step read.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "linalg.h"
+
+#include "bodystore.hpp"
+
+struct RecorderSettings
+{
+    // largest error of a recorded position, in meters, and of an angle,
+    // in radians, is half of these
+    float positionPrecision = 1e-3f;
+    float anglePrecision = 1e-4f;
+    uint32_t keyframeInterval = 120u;
+    // steps the ring holds while the writer is busy
+    size_t bufferFrames = 64u;
+};
+
+struct TrajectoryPose
+{
+    linalg::aliases::float2 position;
+    float orientation;
+};
+
+class TrajectoryRecorder
+{
+private:
+    struct Frame
+    {
+        uint64_t step;
+        std::vector<float> positionX, positionY, orientation;
+    };
+
+    RecorderSettings m_settings;
+    FILE* m_file;
+    uint64_t m_step;
+
+    // single producer (Record()), single consumer (the writer) ring, the
+    // counts only grow, a slot is 'count % size'
+    std::vector<Frame> m_frames;
+    std::atomic<uint64_t> m_produced;
+    std::atomic<uint64_t> m_consumed;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_bytes;
+    std::atomic<bool> m_isStopping;
+    std::atomic<bool> m_isGood;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::thread m_writer;
+
+    // of the writer : the quantized values of the last chunk
+    std::vector<int32_t> m_last[3];
+    uint64_t m_lastKeyframe;
+    bool m_hasKeyframe;
+    std::vector<uint8_t> m_payload;
+
+    void WriterLoop();
+    void Encode(const Frame& _frame);
+
+public:
+    // throws if '_path' can not be opened
+    explicit TrajectoryRecorder(const std::string& _path, const RecorderSettings& _settings = RecorderSettings());
+    // writes what is left in the ring
+    ~TrajectoryRecorder();
+
+    TrajectoryRecorder(const TrajectoryRecorder&) = delete;
+    TrajectoryRecorder& operator=(const TrajectoryRecorder&) = delete;
+
+    // called by the scene at the end of every step
+    void Record(const BodyStore& _bodies);
+    // waits for the writer to write every recorded step, then closes the file
+    void Close();
+
+    inline const RecorderSettings& GetSettings() const { return m_settings; }
+    // steps seen, written or about to be, and dropped because the ring was full
+    inline uint64_t GetStepCount() const { return m_step; }
+    inline uint64_t GetDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+    // bytes written so far
+    inline uint64_t GetByteCount() const { return m_bytes.load(std::memory_order_relaxed); }
+    // false after a failed write
+    inline bool IsGood() const { return m_isGood.load(std::memory_order_relaxed); }
+};
+
+class TrajectoryReader
+{
+private:
+    struct Chunk
+    {
+        uint64_t step;
+        uint64_t offset;
+        uint32_t bodyCount;
+        uint32_t payloadSize;
+        bool isKeyframe;
+    };
+
+    FILE* m_file;
+    float m_positionPrecision;
+    float m_anglePrecision;
+    std::vector<Chunk> m_chunks;
+
+    // the decoded state of chunk 'm_current' (or none)
+    size_t m_current;
+    std::vector<int32_t> m_state[3];
+    std::vector<uint8_t> m_payload;
+
+    void Decode(size_t _chunk);
+
+public:
+    // throws if '_path' is not a trajectory, a truncated last chunk (of a
+    // recording that did not close) is left out
+    explicit TrajectoryReader(const std::string& _path);
+    ~TrajectoryReader();
+
+    TrajectoryReader(const TrajectoryReader&) = delete;
+    TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+    // recorded steps, without the dropped ones
+    inline size_t GetFrameCount() const { return m_chunks.size(); }
+    // the step number of a frame, steps are counted from 0 by the recorder
+    inline uint64_t GetStep(size_t _frame) const { return m_chunks[_frame].step; }
+    inline size_t GetBodyCount(size_t _frame) const { return m_chunks[_frame].bodyCount; }
+    inline float GetPositionPrecision() const { return m_positionPrecision; }
+    inline float GetAnglePrecision() const { return m_anglePrecision; }
+
+    // the frame of a step, false if the step was not recorded
+    bool FindFrame(uint64_t _step, size_t& _frame) const;
+    // the bodies of a frame, '_poses' is resized to its body count
+    void ReadFrame(size_t _frame, std::vector<TrajectoryPose>& _poses);
+};
@@ -28,6 +28,11 @@ project "Rigidbody2D"
         "src/**.cpp"
     }
 
+    removefiles
+    {
+        "src/headless.cpp"
+    }
+
     includedirs
     {
         "include",
@@ -51,6 +56,49 @@ project "Rigidbody2D"
     }
 
     -- everything under this filter only applies to windows
+    filter "system:windows"
+        cppdialect "C++17"
+        systemversion "latest"
+
+        defines
+        {
+            "PLATFORM_WINDOWS",
+            "_USE_MATH_DEFINES"
+        }
+
+    filter  "configurations:Debug"
+        symbols "On"
+    
+    filter { "configurations:Release" }
+        optimize "On"
+
+-- the physics without a window, links no GL
+project "Headless"
+    location "."
+    kind "ConsoleApp"
+    language "C++"
+    staticruntime "off"
+
+    targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+    objdir ("bin-int/" .. outputdir .. "/%{prj.name}")
+
+    files
+    {
+        "include/**.hpp",
+        "src/**.cpp"
+    }
+
+    removefiles
+    {
+        "src/main.cpp",
+        "src/render/**.cpp"
+    }
+
+    includedirs
+    {
+        "include"
+    }
+
     filter "system:windows"
         cppdialect "C++17"
         systemversion "latest"
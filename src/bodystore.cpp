@@ -0,0 +1,111 @@
+#include "bodystore.hpp"
+
+#include "shape.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+BodyHandle BodyStore::Create(
+    const std::shared_ptr<Shape>& _shape, float2 _position, float _restitution,
+    float _mass, float _staticFriction, float _dynamicFriction)
+{
+    uint32_t slot;
+    if(m_freeSlot != BodyHandle::k_invalidIndex)
+    {
+        slot = m_freeSlot;
+        m_freeSlot = m_slots[slot].index;
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(m_slots.size());
+        m_slots.push_back(Slot{ 0u, 0u });
+    }
+
+    // grow every array by one zeroed entry, then fill in what is not zero
+    const uint32_t index = static_cast<uint32_t>(Size());
+    ForEachArray([](auto& _array) { _array.emplace_back(); });
+
+    m_slots[slot].index = index;
+    m_slotOfIndex[index] = slot;
+
+    m_positionX[index] = _position.x;
+    m_positionY[index] = _position.y;
+    m_mass[index] = _mass;
+    m_invMass[index] = (_mass == 0.0f) ? 0.0f : (1.0f / _mass);
+    // a body of mass 0 is static and does not rotate either, as after
+    // RigidBody2D::SetStatic()
+    m_inertia[index] = (_mass == 0.0f) ? 0.0f : 1.0f;
+    m_invInertia[index] = (_mass == 0.0f) ? 0.0f : 1.0f;
+    m_restitution[index] = _restitution;
+    m_staticFriction[index] = _staticFriction;
+    m_dynamicFriction[index] = _dynamicFriction;
+    m_shapes[index] = _shape;
+    m_transformDirty[index] = 1u;
+    m_sleepingIsland[index] = k_awake;
+
+    return BodyHandle{ slot, m_slots[slot].generation };
+}
+
+uint32_t BodyStore::Destroy(BodyHandle _handle)
+{
+    const uint32_t index = GetIndex(_handle);
+    const uint32_t last = static_cast<uint32_t>(Size() - 1);
+
+    // the slot of the last body now points at the hole it is moved into
+    m_slots[m_slotOfIndex[last]].index = index;
+    ForEachArray([index, last](auto& _array)
+    {
+        if(index != last)
+            _array[index] = std::move(_array[last]);
+        _array.pop_back();
+    });
+
+    // bump the generation so that every handle to this slot goes stale
+    Slot& slot = m_slots[_handle.index];
+    ++slot.generation;
+    slot.index = m_freeSlot;
+    m_freeSlot = _handle.index;
+
+    return index;
+}
+
+void BodyStore::Reserve(size_t _count)
+{
+    ForEachArray([_count](auto& _array) { _array.reserve(_count); });
+}
+
+void BodyStore::Allocate(size_t _count)
+{
+    if(Size() != 0u || m_slots.empty() == false)
+    {
+        throw std::runtime_error("Error : BodyStore::Allocate : The store is not empty!");
+    }
+
+    ForEachArray([_count](auto& _array) { _array.resize(_count); });
+    m_slots.resize(_count);
+    for(size_t i = 0; i < _count; ++i)
+    {
+        m_slots[i] = Slot{ static_cast<uint32_t>(i), 0u };
+        m_slotOfIndex[i] = static_cast<uint32_t>(i);
+    }
+    std::fill(m_transformDirty.begin(), m_transformDirty.end(), 1u);
+    std::fill(m_sleepingIsland.begin(), m_sleepingIsland.end(), k_awake);
+}
+
+uint32_t BodyStore::GetIndex(BodyHandle _handle) const
+{
+    if(IsValid(_handle) == false)
+    {
+        throw std::runtime_error("Error : BodyStore : Using a handle of a removed body!");
+    }
+    return m_slots[_handle.index].index;
+}
+
+void BodyStore::UpdateTransform(uint32_t _index)
+{
+    BodyTransformCache& cache = m_transforms[_index];
+    cache.rotation = getRotationMatrix(m_orientation[_index]);
+    m_shapes[_index]->UpdateTransformCache(GetPosition(_index), cache);
+    m_transformDirty[_index] = 0u;
+}
@@ -0,0 +1,502 @@
+#include "broadphase.hpp"
+
+#include "shape.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // copying bounds is cheap, smaller pieces are not worth a task
+    constexpr size_t k_parallelGrain = 1024u;
+}
+
+void Broadphase::UpdateBounds(const BodyStore& _bodies)
+{
+    m_bounds.resize(_bodies.Size());
+    ParallelFor(m_jobs.get(), _bodies.Size(), [&](size_t _begin, size_t _end, size_t)
+    {
+        for(size_t i = _begin; i < _end; ++i)
+        {
+            m_bounds[i] = _bodies.m_transforms[i].bounds;
+        }
+    }, k_parallelGrain);
+}
+
+void Broadphase::RemoveBody(uint32_t _index, uint32_t _movedFrom)
+{
+    // keep the bounds in step with the store for queries until the next
+    // update, unless bodies were added since the last one
+    if(m_bounds.size() == _movedFrom + 1u)
+    {
+        m_bounds[_index] = m_bounds[_movedFrom];
+        m_bounds.pop_back();
+    }
+    else
+    {
+        m_bounds.clear();
+    }
+}
+
+void Broadphase::RemapPairs(std::unordered_set<uint64_t>& _pairs, uint32_t _index, uint32_t _movedFrom)
+{
+    std::vector<uint64_t> relabeled;
+    for(auto it = _pairs.begin(); it != _pairs.end();)
+    {
+        const uint32_t first = static_cast<uint32_t>(*it >> 32);
+        const uint32_t second = static_cast<uint32_t>(*it & 0xffffffffu);
+
+        if(first == _index || second == _index)
+        {
+            it = _pairs.erase(it);
+        }
+        else if(first == _movedFrom || second == _movedFrom)
+        {
+            relabeled.push_back(PairKey(_index, (first == _movedFrom) ? second : first));
+            it = _pairs.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    _pairs.insert(relabeled.begin(), relabeled.end());
+}
+
+void Broadphase::Query(const AABB& _region, std::vector<uint32_t>& _result) const
+{
+    for(uint32_t i = 0; i < m_bounds.size(); ++i)
+    {
+        if(m_bounds[i].Overlaps(_region))
+            _result.push_back(i);
+    }
+}
+
+void Broadphase::RayCast(const float2& _from, const float2& _to, std::vector<uint32_t>& _result) const
+{
+    // the bounds of the segment are good enough for a candidate list
+    Query(AABB{ linalg::min(_from, _to), linalg::max(_from, _to) }, _result);
+}
+
+void BruteForceBroadphase::ComputePairs(
+    const BodyStore& _bodies,
+    std::vector<BodyPair>& _pairs)
+{
+    UpdateBounds(_bodies);
+
+    _pairs.clear();
+    // rows get shorter towards the end, the small default grain evens
+    // that out
+    ParallelCollect(m_jobs.get(), m_bounds.size(), 0u, m_pairBuffers, _pairs,
+        [&](size_t _begin, size_t _end, std::vector<BodyPair>& _out)
+    {
+        for(uint32_t i = static_cast<uint32_t>(_begin); i < _end; ++i)
+        {
+            for(uint32_t j = i + 1; j < m_bounds.size(); ++j)
+            {
+                if(m_bounds[i].Overlaps(m_bounds[j]))
+                    _out.push_back(BodyPair{ i, j });
+            }
+        }
+    });
+}
+
+float UniformGridBroadphase::ComputeMedianCellSize()
+{
+    m_sizeScratch.resize(m_bounds.size());
+    for(size_t i = 0; i < m_bounds.size(); ++i)
+    {
+        const float2 size = m_bounds[i].GetSize();
+        m_sizeScratch[i] = std::max(size.x, size.y);
+    }
+
+    auto median = m_sizeScratch.begin() + m_sizeScratch.size() / 2;
+    std::nth_element(m_sizeScratch.begin(), median, m_sizeScratch.end());
+
+    // twice the typical size, so most bodies cover at most 2x2 cells
+    const float cellSize = 2.0f * (*median);
+    return (cellSize > 0.0f) ? cellSize : 1.0f;
+}
+
+void UniformGridBroadphase::ComputePairs(
+    const BodyStore& _bodies,
+    std::vector<BodyPair>& _pairs)
+{
+    UpdateBounds(_bodies);
+
+    _pairs.clear();
+    if(m_bounds.empty())
+        return;
+
+    m_activeCellSize = (m_cellSize > 0.0f) ? m_cellSize : ComputeMedianCellSize();
+    const float invCellSize = 1.0f / m_activeCellSize;
+
+    // bucket every body into each cell it touches
+    m_cellRanges.resize(m_bounds.size());
+    m_entries.clear();
+    for(uint32_t i = 0; i < m_bounds.size(); ++i)
+    {
+        CellRange& range = m_cellRanges[i];
+        range.minX = static_cast<int32_t>(std::floor(m_bounds[i].min.x * invCellSize));
+        range.minY = static_cast<int32_t>(std::floor(m_bounds[i].min.y * invCellSize));
+        range.maxX = static_cast<int32_t>(std::floor(m_bounds[i].max.x * invCellSize));
+        range.maxY = static_cast<int32_t>(std::floor(m_bounds[i].max.y * invCellSize));
+
+        for(int32_t y = range.minY; y <= range.maxY; ++y)
+        {
+            for(int32_t x = range.minX; x <= range.maxX; ++x)
+            {
+                const uint64_t key =
+                    (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) |
+                    static_cast<uint64_t>(static_cast<uint32_t>(y));
+                m_entries.push_back(CellEntry{ key, i });
+            }
+        }
+    }
+
+    std::sort(m_entries.begin(), m_entries.end());
+
+    // pair up bodies within each occupied cell
+    size_t cellBegin = 0u;
+    while(cellBegin < m_entries.size())
+    {
+        size_t cellEnd = cellBegin + 1;
+        while(cellEnd < m_entries.size() && m_entries[cellEnd].key == m_entries[cellBegin].key)
+            ++cellEnd;
+
+        const int32_t cellX = static_cast<int32_t>(m_entries[cellBegin].key >> 32);
+        const int32_t cellY = static_cast<int32_t>(m_entries[cellBegin].key & 0xffffffffu);
+
+        for(size_t a = cellBegin; a < cellEnd; ++a)
+        {
+            for(size_t b = a + 1; b < cellEnd; ++b)
+            {
+                // entries are sorted by body inside a cell, so i < j
+                const uint32_t i = m_entries[a].body;
+                const uint32_t j = m_entries[b].body;
+
+                if(m_bounds[i].Overlaps(m_bounds[j]) == false)
+                    continue;
+
+                // two bodies can share more than one cell, only report the
+                // pair from the lowest cell they share to avoid duplicates
+                const int32_t sharedX = std::max(m_cellRanges[i].minX, m_cellRanges[j].minX);
+                const int32_t sharedY = std::max(m_cellRanges[i].minY, m_cellRanges[j].minY);
+                if(sharedX != cellX || sharedY != cellY)
+                    continue;
+
+                _pairs.push_back(BodyPair{ i, j });
+            }
+        }
+
+        cellBegin = cellEnd;
+    }
+
+    std::sort(_pairs.begin(), _pairs.end());
+}
+
+void SweepAndPruneBroadphase::ComputePairs(
+    const BodyStore& _bodies,
+    std::vector<BodyPair>& _pairs)
+{
+    UpdateBounds(_bodies);
+
+    const size_t newProxyCount = m_bounds.size() - std::min(m_bounds.size(), m_proxyCount);
+    // adding a lot of bodies at once makes insertion sort quadratic, so
+    // just start over in that case (this also covers the first step)
+    if(m_bounds.size() < m_proxyCount || newProxyCount > 16u)
+    {
+        Rebuild();
+    }
+    else
+    {
+        // refresh the endpoint values of existing proxies
+        for(int axis = 0; axis < 2; ++axis)
+        {
+            for(Endpoint& endpoint : m_endpoints[axis])
+            {
+                const AABB& bounds = m_bounds[endpoint.GetBody()];
+                endpoint.value = endpoint.IsMax() ? bounds.max[axis] : bounds.min[axis];
+            }
+        }
+
+        // append new proxies, insertion sort will move them into place
+        for(uint32_t i = static_cast<uint32_t>(m_proxyCount); i < m_bounds.size(); ++i)
+        {
+            for(int axis = 0; axis < 2; ++axis)
+            {
+                m_endpoints[axis].push_back(Endpoint{ m_bounds[i].min[axis], (i << 1) });
+                m_endpoints[axis].push_back(Endpoint{ m_bounds[i].max[axis], (i << 1) | 1u });
+            }
+        }
+        m_proxyCount = m_bounds.size();
+
+        InsertionSort(m_endpoints[0]);
+        InsertionSort(m_endpoints[1]);
+    }
+
+    _pairs.clear();
+    _pairs.reserve(m_overlaps.size());
+    for(uint64_t key : m_overlaps)
+    {
+        _pairs.push_back(BodyPair{ 
+            static_cast<uint32_t>(key >> 32), 
+            static_cast<uint32_t>(key & 0xffffffffu) });
+    }
+    std::sort(_pairs.begin(), _pairs.end());
+}
+
+void SweepAndPruneBroadphase::RemoveBody(uint32_t _index, uint32_t _movedFrom)
+{
+    Broadphase::RemoveBody(_index, _movedFrom);
+
+    // bodies were added since the last update, let them all be inserted
+    // again by the next one
+    if(m_proxyCount != _movedFrom + 1u)
+    {
+        m_endpoints[0].clear();
+        m_endpoints[1].clear();
+        m_overlaps.clear();
+        m_proxyCount = 0u;
+        return;
+    }
+
+    // removing endpoints keeps the lists sorted, the moved body only needs
+    // its new index
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        std::vector<Endpoint>& endpoints = m_endpoints[axis];
+        endpoints.erase(
+            std::remove_if(endpoints.begin(), endpoints.end(),
+                [_index](const Endpoint& endpoint) { return endpoint.GetBody() == _index; }),
+            endpoints.end());
+
+        for(Endpoint& endpoint : endpoints)
+        {
+            if(endpoint.GetBody() == _movedFrom)
+                endpoint.data = (_index << 1) | (endpoint.data & 1u);
+        }
+    }
+
+    RemapPairs(m_overlaps, _index, _movedFrom);
+    --m_proxyCount;
+}
+
+void SweepAndPruneBroadphase::InsertionSort(std::vector<Endpoint>& _endpoints)
+{
+    for(size_t i = 1; i < _endpoints.size(); ++i)
+    {
+        const Endpoint key = _endpoints[i];
+
+        size_t j = i;
+        while(j > 0 && key.IsBefore(_endpoints[j - 1]))
+        {
+            const Endpoint& swapped = _endpoints[j - 1];
+
+            // a min moving past a max means the two intervals start to
+            // overlap on this axis, they are a pair if the other axis agrees
+            if(key.IsMax() == false && swapped.IsMax() == true)
+            {
+                if(m_bounds[key.GetBody()].Overlaps(m_bounds[swapped.GetBody()]))
+                    m_overlaps.insert(PairKey(key.GetBody(), swapped.GetBody()));
+            }
+            // a max moving past a min means the intervals are now separated
+            else if(key.IsMax() == true && swapped.IsMax() == false)
+            {
+                m_overlaps.erase(PairKey(key.GetBody(), swapped.GetBody()));
+            }
+
+            _endpoints[j] = swapped;
+            --j;
+        }
+        _endpoints[j] = key;
+    }
+}
+
+void SweepAndPruneBroadphase::Rebuild()
+{
+    m_proxyCount = m_bounds.size();
+    m_overlaps.clear();
+
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        m_endpoints[axis].clear();
+        for(uint32_t i = 0; i < m_bounds.size(); ++i)
+        {
+            m_endpoints[axis].push_back(Endpoint{ m_bounds[i].min[axis], (i << 1) });
+            m_endpoints[axis].push_back(Endpoint{ m_bounds[i].max[axis], (i << 1) | 1u });
+        }
+        std::sort(m_endpoints[axis].begin(), m_endpoints[axis].end(),
+            [](const Endpoint& a, const Endpoint& b) { return a.IsBefore(b); });
+    }
+
+    // one full sweep along x to find the initial overlaps
+    std::vector<uint32_t> active;
+    for(const Endpoint& endpoint : m_endpoints[0])
+    {
+        const uint32_t body = endpoint.GetBody();
+        if(endpoint.IsMax())
+        {
+            auto it = std::find(active.begin(), active.end(), body);
+            *it = active.back();
+            active.pop_back();
+            continue;
+        }
+
+        for(uint32_t other : active)
+        {
+            if(m_bounds[body].Overlaps(m_bounds[other]))
+                m_overlaps.insert(PairKey(body, other));
+        }
+        active.push_back(body);
+    }
+}
+
+void DynamicTreeBroadphase::CreateProxy(uint32_t _body, bool _isStatic)
+{
+    DynamicTree& tree = _isStatic ? m_staticTree : m_dynamicTree;
+    m_proxies[_body] = Proxy{ tree.CreateProxy(m_bounds[_body], _body), _isStatic };
+    m_moveBuffer.push_back(_body);
+}
+
+void DynamicTreeBroadphase::Clear()
+{
+    m_dynamicTree.Clear();
+    m_staticTree.Clear();
+    m_proxies.clear();
+    m_moveBuffer.clear();
+    m_fatPairs.clear();
+}
+
+void DynamicTreeBroadphase::RemoveBody(uint32_t _index, uint32_t _movedFrom)
+{
+    Broadphase::RemoveBody(_index, _movedFrom);
+
+    // bodies were added since the last update, start over with the next one
+    if(m_proxies.size() != _movedFrom + 1u)
+    {
+        Clear();
+        return;
+    }
+
+    const Proxy removed = m_proxies[_index];
+    (removed.isStatic ? m_staticTree : m_dynamicTree).DestroyProxy(removed.id);
+    if(_index != _movedFrom)
+    {
+        const Proxy moved = m_proxies[_movedFrom];
+        (moved.isStatic ? m_staticTree : m_dynamicTree).SetUserData(moved.id, _index);
+        m_proxies[_index] = moved;
+    }
+    m_proxies.pop_back();
+
+    m_moveBuffer.erase(std::remove(m_moveBuffer.begin(), m_moveBuffer.end(), _index), m_moveBuffer.end());
+    std::replace(m_moveBuffer.begin(), m_moveBuffer.end(), _movedFrom, _index);
+    RemapPairs(m_fatPairs, _index, _movedFrom);
+}
+
+void DynamicTreeBroadphase::ComputePairs(
+    const BodyStore& _bodies,
+    std::vector<BodyPair>& _pairs)
+{
+    UpdateBounds(_bodies);
+
+    // removals are reported through RemoveBody(), a list shorter than the
+    // proxies means we are looking at a different set of bodies
+    if(_bodies.Size() < m_proxies.size())
+        Clear();
+
+    const size_t oldProxyCount = m_proxies.size();
+    m_proxies.resize(_bodies.Size());
+
+    for(uint32_t i = 0; i < _bodies.Size(); ++i)
+    {
+        const bool isStatic = (_bodies.m_invMass[i] == 0.0f);
+        if(i >= oldProxyCount)
+        {
+            CreateProxy(i, isStatic);
+            continue;
+        }
+
+        Proxy& proxy = m_proxies[i];
+        // SetStatic() or SetMass() was called, move it to the other tree
+        if(proxy.isStatic != isStatic)
+        {
+            (proxy.isStatic ? m_staticTree : m_dynamicTree).DestroyProxy(proxy.id);
+            CreateProxy(i, isStatic);
+            continue;
+        }
+
+        if((isStatic ? m_staticTree : m_dynamicTree).MoveProxy(proxy.id, m_bounds[i]))
+            m_moveBuffer.push_back(i);
+    }
+
+    // only moved proxies look for new pairs, dynamic ones query both trees
+    // and static ones only the dynamic tree, so static pairs never show up
+    for(uint32_t body : m_moveBuffer)
+    {
+        const AABB& fatBounds = GetFatBounds(body);
+        m_dynamicTree.Query(fatBounds, [&](int32_t proxy)
+        {
+            const uint32_t other = m_dynamicTree.GetUserData(proxy);
+            if(other != body)
+                m_fatPairs.insert(PairKey(body, other));
+            return true;
+        });
+
+        if(m_proxies[body].isStatic == false)
+        {
+            m_staticTree.Query(fatBounds, [&](int32_t proxy)
+            {
+                m_fatPairs.insert(PairKey(body, m_staticTree.GetUserData(proxy)));
+                return true;
+            });
+        }
+    }
+    m_moveBuffer.clear();
+
+    // drop pairs whose fattened bounds separated, report the ones whose
+    // actual bounds overlap
+    _pairs.clear();
+    for(auto it = m_fatPairs.begin(); it != m_fatPairs.end();)
+    {
+        const uint32_t first = static_cast<uint32_t>(*it >> 32);
+        const uint32_t second = static_cast<uint32_t>(*it & 0xffffffffu);
+
+        const bool bothStatic = m_proxies[first].isStatic && m_proxies[second].isStatic;
+        if(bothStatic || GetFatBounds(first).Overlaps(GetFatBounds(second)) == false)
+        {
+            it = m_fatPairs.erase(it);
+            continue;
+        }
+
+        if(m_bounds[first].Overlaps(m_bounds[second]))
+            _pairs.push_back(BodyPair{ first, second });
+        ++it;
+    }
+
+    std::sort(_pairs.begin(), _pairs.end());
+}
+
+void DynamicTreeBroadphase::Query(const AABB& _region, std::vector<uint32_t>& _result) const
+{
+    for(const DynamicTree* tree : { &m_dynamicTree, &m_staticTree })
+    {
+        tree->Query(_region, [&](int32_t proxy)
+        {
+            _result.push_back(tree->GetUserData(proxy));
+            return true;
+        });
+    }
+}
+
+void DynamicTreeBroadphase::RayCast(const float2& _from, const float2& _to, std::vector<uint32_t>& _result) const
+{
+    for(const DynamicTree* tree : { &m_dynamicTree, &m_staticTree })
+    {
+        tree->RayCast(_from, _to, [&](int32_t proxy, float maxFraction)
+        {
+            _result.push_back(tree->GetUserData(proxy));
+            return maxFraction;
+        });
+    }
+}
@@ -3,8 +3,8 @@
 #include "manifold.hpp"
 #include "obb.hpp"
 #include "collision.hpp"
-
-#include "GL/freeglut.h"
+#include "util.hpp"
+#include "rigidbody2D.hpp"
 
 #include <cmath>
 
@@ -13,6 +13,46 @@ Manifold Circle::accept(const ShapeVisitor<Manifold>& visitor) const
     return visitor.visitCircle(*this);
 }
 
+AABB Circle::GetAABB() const
+{
+    const float2 half_extent(m_radius, m_radius);
+    return AABB{ 
+        m_body->GetPosition() - half_extent, 
+        m_body->GetPosition() + half_extent 
+    };
+}
+
+void Circle::UpdateTransformCache(const float2& _position, BodyTransformCache& _cache) const
+{
+    const float2 half_extent(m_radius, m_radius);
+    _cache.bounds = AABB{ _position - half_extent, _position + half_extent };
+}
+
+bool Circle::RayCast(
+    const float2& _from, const float2& _to,
+    float& _fraction, float2& _normal) const
+{
+    // solve |from + t * d - center|^2 = r^2 for the smallest t in [0, 1]
+    const float2 s = _from - m_body->GetPosition();
+    const float2 d = _to - _from;
+    const float b = linalg::dot(s, d);
+    const float c = linalg::dot(s, s) - m_radius * m_radius;
+    const float rr = linalg::dot(d, d);
+    const float sigma = b * b - rr * c;
+
+    // no real root, or a degenerated segment
+    if(sigma < 0.0f || rr == 0.0f)
+        return false;
+
+    const float a = -(b + std::sqrt(sigma));
+    if(a < 0.0f || a > rr)
+        return false;
+
+    _fraction = a / rr;
+    _normal = safe_normalize(s + _fraction * d);
+    return true;
+}
+
 Manifold Circle::visitAABB(const OBB& _shape) const
 {
     // in impulse engine, the normal is flipped ( * -1 )
@@ -33,80 +73,10 @@ Manifold Circle::visitAABB(const OBB& _shape) const
 
 Manifold Circle::visitCircle(const Circle& _shape) const
 {
-    bool isHit = true;
-    float2 normal = _shape.m_body->GetPosition() - m_body->GetPosition();
-
-    float radius_sum = m_radius + _shape.m_radius;
-    float radius_sum_sqr = radius_sum * radius_sum;
-
-    // length2 returns length square
-    if(linalg::length2(normal) > radius_sum_sqr)
-    {
-        isHit = false;
-    }
-
-    float penetration;
-    float distance = linalg::length(normal);
-    float2 contactPoint;
-    if(distance != 0)
-    {
-        penetration = radius_sum - distance;
-        normal = normal / distance;
-        contactPoint = normal * m_radius + m_body->GetPosition();
-    }
-    else
-    {
-        penetration = m_radius;
-        normal = float2(1, 0);
-        contactPoint = m_body->GetPosition();
-    }
-
-    return Manifold(
-        m_body,
-        _shape.m_body,
-        (isHit == true) ? 1 : 0,
-		{ contactPoint },
-        normal,
-        penetration,
-        isHit
+    auto manifold = CollisionHelper::GenerateManifold(
+        *this,
+        _shape
     );
-}
-
-void Circle::Render() const
-{
-    const size_t k_segments = 20;
 
-    glPushMatrix();
-    glBegin(GL_LINE_LOOP);
-    {
-        float theta = 0.0f;
-        float inc = (float)M_PI * 2.0f / k_segments;
-        for(size_t i = 0; i < k_segments; ++i)
-        {
-            theta += inc;
-            float2 p( std::cos( theta ), std::sin( theta ) );
-            p *= m_radius;
-            p += m_body->GetPosition();
-            glVertex2f( p.x, p.y );
-        }
-    }
-    glEnd( );
-    glPopMatrix();
-
-    glPushMatrix();
-    glPushAttrib(GL_CURRENT_BIT);
-    {
-        glBegin( GL_LINE_STRIP );
-        float c = std::cos( m_body->GetOrientation() );
-        float s = std::sin( m_body->GetOrientation() );
-        float2 r( c, s );
-        r *= m_radius;
-        r = r + m_body->GetPosition();
-        glColor3f(1.0f, 0.0f, 0.0f);
-        glVertex2f( m_body->GetPosition().x, m_body->GetPosition().y );
-        glVertex2f( r.x, r.y );
-        glEnd( );
-    }
-    glPopAttrib();
-    glPopMatrix();
+    return manifold;
 }
\ No newline at end of file
@@ -1,23 +1,378 @@
 #include "collision.hpp"
 
 #include "util.hpp"
+#include "rigidbody2D.hpp"
+#include "profiler.hpp"
 
 #include <algorithm>
 #include <iostream>
 
 #include "linalg.h"
 
-Manifold CollisionHelper::GenerateManifold(const OBB& _a, const Circle& _b)
+namespace
+{
+	// The kernels follow the convention of 'a.accept(b)', which ends up in
+	// 'b.visitXXX(a)', so the second shape is the visiting one.
+	template <typename A, typename B>
+	struct CollideKernel;
+
+	template <>
+	struct CollideKernel<OBB, OBB>
+	{
+		static inline Manifold Run(
+			const OBB& _a, const CollisionBody& _bodyA, const OBB& _b, const CollisionBody& _bodyB)
+		{
+			return CollisionHelper::GenerateManifold(_b, _bodyB, _a, _bodyA);
+		}
+	};
+
+	template <>
+	struct CollideKernel<OBB, Circle>
+	{
+		static inline Manifold Run(
+			const OBB& _a, const CollisionBody& _bodyA, const Circle& _b, const CollisionBody& _bodyB)
+		{
+			return CollisionHelper::GenerateManifold(_a, _bodyA, _b, _bodyB);
+		}
+	};
+
+	template <>
+	struct CollideKernel<Circle, OBB>
+	{
+		static inline Manifold Run(
+			const Circle& _a, const CollisionBody& _bodyA, const OBB& _b, const CollisionBody& _bodyB)
+		{
+			return CollisionHelper::GenerateManifold(_b, _bodyB, _a, _bodyA);
+		}
+	};
+
+	template <>
+	struct CollideKernel<Circle, Circle>
+	{
+		static inline Manifold Run(
+			const Circle& _a, const CollisionBody& _bodyA, const Circle& _b, const CollisionBody& _bodyB)
+		{
+			return CollisionHelper::GenerateManifold(_b, _bodyB, _a, _bodyA);
+		}
+	};
+
+	template <typename A, typename B>
+	Manifold CollideEntry(const Shape& _a, const Shape& _b)
+	{
+		return CollideKernel<A, B>::Run(
+			static_cast<const A&>(_a), CollisionHelper::GetCollisionBody(_a),
+			static_cast<const B&>(_b), CollisionHelper::GetCollisionBody(_b));
+	}
+
+	// the type of the shapes is known for the whole batch, so the kernel
+	// is called directly and can be inlined into the loop
+	template <typename A, typename B>
+	void RunBatch(
+		const BodyStore& _bodies,
+		const BodyPair* _pairs, size_t _count,
+		std::vector<Manifold>& _manifolds)
+	{
+		for (size_t i = 0; i < _count; ++i)
+		{
+			const uint32_t first = _pairs[i].first;
+			const uint32_t second = _pairs[i].second;
+			const A& a = static_cast<const A&>(*_bodies.m_shapes[first]);
+			const B& b = static_cast<const B&>(*_bodies.m_shapes[second]);
+
+			const Manifold manifold = CollideKernel<A, B>::Run(
+				a, CollisionHelper::GetCollisionBody(_bodies, first),
+				b, CollisionHelper::GetCollisionBody(_bodies, second));
+			// put the manifold into resolve queue only if it's a hit
+			if (manifold.m_isHit == true)
+				_manifolds.push_back(manifold);
+		}
+	}
+}
+
+// indexed by GetShapePairIndex(), in the order of 'ShapeType'
+const CollisionHelper::CollideFunction CollisionHelper::s_collideTable[k_shapePairCount] =
+{
+	&CollideEntry<OBB, OBB>,
+	&CollideEntry<OBB, Circle>,
+	&CollideEntry<Circle, OBB>,
+	&CollideEntry<Circle, Circle>,
+};
+
+CollisionBody CollisionHelper::GetCollisionBody(const Shape& _shape)
+{
+	const RigidBody2D& body = *_shape.m_body;
+	return CollisionBody{ body.GetIndex(), body.GetPosition(), &body.GetTransformCache() };
+}
+
+Manifold CollisionHelper::Collide(const Shape& _a, const Shape& _b)
+{
+	return s_collideTable[GetShapePairIndex(_a.GetType(), _b.GetType())](_a, _b);
+}
+
+void CollisionHelper::SortPairsByShapeType(
+	const BodyStore& _bodies,
+	const std::vector<BodyPair>& _pairs,
+	std::vector<BodyPair>& _sorted,
+	std::array<size_t, k_shapePairCount + 1>& _batchOffsets)
+{
+	std::array<size_t, k_shapePairCount> counts = {};
+	for (const BodyPair& pair : _pairs)
+	{
+		++counts[GetShapePairIndex(
+			_bodies.m_shapes[pair.first]->GetType(),
+			_bodies.m_shapes[pair.second]->GetType())];
+	}
+
+	_batchOffsets[0] = 0u;
+	for (size_t k = 0; k < k_shapePairCount; ++k)
+		_batchOffsets[k + 1] = _batchOffsets[k] + counts[k];
+
+	std::array<size_t, k_shapePairCount> cursor;
+	std::copy(_batchOffsets.begin(), _batchOffsets.end() - 1, cursor.begin());
+
+	_sorted.resize(_pairs.size());
+	for (const BodyPair& pair : _pairs)
+	{
+		const size_t type = GetShapePairIndex(
+			_bodies.m_shapes[pair.first]->GetType(),
+			_bodies.m_shapes[pair.second]->GetType());
+		_sorted[cursor[type]++] = pair;
+	}
+}
+
+void CollisionHelper::CollideBatch(
+	size_t _shapePairIndex,
+	const BodyStore& _bodies,
+	const BodyPair* _pairs, size_t _count,
+	std::vector<Manifold>& _manifolds)
+{
+	switch (_shapePairIndex)
+	{
+	case GetShapePairIndex(ShapeType::OBB, ShapeType::OBB):
+		RunBatch<OBB, OBB>(_bodies, _pairs, _count, _manifolds);
+		break;
+	case GetShapePairIndex(ShapeType::OBB, ShapeType::Circle):
+		RunBatch<OBB, Circle>(_bodies, _pairs, _count, _manifolds);
+		break;
+	case GetShapePairIndex(ShapeType::Circle, ShapeType::OBB):
+		RunBatch<Circle, OBB>(_bodies, _pairs, _count, _manifolds);
+		break;
+	case GetShapePairIndex(ShapeType::Circle, ShapeType::Circle):
+		RunBatch<Circle, Circle>(_bodies, _pairs, _count, _manifolds);
+		break;
+	default: break;
+	}
+}
+
+void CollisionHelper::CollideParallel(
+	JobSystem* _jobs,
+	const BodyStore& _bodies,
+	const std::vector<BodyPair>& _sorted,
+	const std::array<size_t, k_shapePairCount + 1>& _batchOffsets,
+	OrderedBuffers<Manifold>& _buffers,
+	std::vector<Manifold>& _manifolds)
+{
+	const size_t count = _sorted.size();
+	// a few pieces per thread, so a thread that got slow pairs does not
+	// hold up the others
+	const size_t threadCount = (_jobs != nullptr) ? _jobs->GetThreadCount() : 1u;
+	const size_t grain = std::max(k_parallelChunkSize, count / (threadCount * 8u) + 1u);
+
+	ParallelCollect(_jobs, count, grain, _buffers, _manifolds,
+		[&](size_t _begin, size_t _end, std::vector<Manifold>& _out)
+	{
+		// a piece can span several batches
+		for (size_t k = 0; k < k_shapePairCount; ++k)
+		{
+			const size_t from = std::max(_begin, _batchOffsets[k]);
+			const size_t to = std::min(_end, _batchOffsets[k + 1]);
+			if (from < to)
+			{
+				PROFILE_SCOPE(static_cast<ProfileZone>(static_cast<size_t>(ProfileZone::NarrowphaseOBBOBB) + k));
+				CollideBatch(k, _bodies, _sorted.data() + from, to - from, _out);
+			}
+		}
+	});
+}
+
+Manifold CollisionHelper::GenerateManifold(
+	const OBB& _a, const CollisionBody& _bodyA, const OBB& _b, const CollisionBody& _bodyB)
+{
+	Manifold dummyManifold = Manifold(_bodyA.index, _bodyB.index, 0, {}, float2(0,0), 0, false);
+
+	// Check for a separating axis with A's face planes
+	size_t faceA = 0u;
+	float penetrationA = OBB::FindAxisLeastPenetration(
+		faceA, *_bodyA.transform, *_bodyB.transform);
+	if(penetrationA >= 0.0f)
+		return dummyManifold;
+
+	// Check for a separating axis with B's face planes
+	size_t faceB = 0u;
+	float penetrationB = OBB::FindAxisLeastPenetration(
+		faceB, *_bodyB.transform, *_bodyA.transform);
+	if(penetrationB >= 0.0f)
+		return dummyManifold;
+
+	size_t referenceIndex = 0u;
+	bool flip; // Always point from a to b
+
+	const BodyTransformCache* RefPoly; // Reference
+	const BodyTransformCache* IncPoly; // Incident
+
+	// Determine which shape contains reference face
+	if(biasGreaterThan( penetrationA, penetrationB ))
+	{
+		RefPoly = _bodyA.transform;
+		IncPoly = _bodyB.transform;
+		referenceIndex = faceA;
+		flip = false;
+	}
+	else
+	{
+		RefPoly = _bodyB.transform;
+		IncPoly = _bodyA.transform;
+		referenceIndex = faceB;
+		flip = true;
+	}
+
+	// World space incident face
+	// float2 incidentFace[2];
+	size_t incidentIndex = 0u;
+	std::array<float2, 2> incidentFace = 
+		OBB::FindIncidentFace( *RefPoly, *IncPoly, referenceIndex, incidentIndex );
+
+	// Clip() works on a copy of the face, so the contact points are always
+	// the two incident vertices, which makes them easy to identify
+	const uint32_t referenceFace = static_cast<uint32_t>(referenceIndex);
+	const std::array<uint32_t, 2> incidentIds = {
+		MakeContactId(referenceFace, static_cast<uint32_t>(incidentIndex), flip),
+		MakeContactId(referenceFace, static_cast<uint32_t>((incidentIndex + 1) % IncPoly->vertices.size()), flip)
+	};
+
+	const std::array<float2, 4>& refVertices = RefPoly->vertices;
+
+	// Setup reference face vertices, already in world space
+	float2 v1 = refVertices[referenceIndex];
+	referenceIndex = 
+		(referenceIndex + 1 == refVertices.size()) 
+		? 0 : referenceIndex + 1;
+	float2 v2 = refVertices[referenceIndex];
+
+	// Calculate reference face side normal in world space
+	float2 sidePlaneNormal = (v2 - v1);
+	sidePlaneNormal = safe_normalize(sidePlaneNormal);
+
+	// Orthogonalize
+	float2 refFaceNormal( sidePlaneNormal.y, -sidePlaneNormal.x );
+
+	// ax + by = c
+	// c is distance from origin
+	float refC = linalg::dot( refFaceNormal, v1 );
+	float negSide = -linalg::dot( sidePlaneNormal, v1 );
+	float posSide =  linalg::dot( sidePlaneNormal, v2 );
+
+	// Clip incident face to reference face side planes
+	if(OBB::Clip( -sidePlaneNormal, negSide, incidentFace ) < 2)
+		return dummyManifold; // Due to floating point error, possible to not have required points
+
+	if(OBB::Clip(  sidePlaneNormal, posSide, incidentFace ) < 2)
+		return dummyManifold; // Due to floating point error, possible to not have required points
+
+	Manifold m = dummyManifold;
+
+	// Flip
+	m.m_normal = flip ? -refFaceNormal : refFaceNormal;
+
+	// Keep points behind reference face
+	int cp = 0; // clipped points behind reference face
+	float separation = linalg::dot( refFaceNormal, incidentFace[0] ) - refC;
+	if(separation <= 0.0f)
+	{
+		m.m_contactPoints[cp] = incidentFace[0];
+		m.m_contactIds[cp] = incidentIds[0];
+		m.m_penetration = -separation;
+		++cp;
+	}
+	else
+		m.m_penetration = 0;
+
+	separation = linalg::dot( refFaceNormal, incidentFace[1] ) - refC;
+	if(separation <= 0.0f)
+	{
+		m.m_contactPoints[cp] = incidentFace[1];
+		m.m_contactIds[cp] = incidentIds[1];
+
+		m.m_penetration += -separation;
+		++cp;
+
+		// Average penetration
+		m.m_penetration /= (float)cp;
+	}
+
+	m.m_contactPointCount = cp;
+
+	// data setup
+	m.m_isHit = true;
+
+	return m;
+}
+
+Manifold CollisionHelper::GenerateManifold(
+	const Circle& _a, const CollisionBody& _bodyA, const Circle& _b, const CollisionBody& _bodyB)
+{
+	bool isHit = true;
+	float2 normal = _bodyB.position - _bodyA.position;
+
+	float radius_sum = _a.m_radius + _b.m_radius;
+	float radius_sum_sqr = radius_sum * radius_sum;
+
+	// length2 returns length square
+	if(linalg::length2(normal) > radius_sum_sqr)
+	{
+		isHit = false;
+	}
+
+	float penetration;
+	float distance = linalg::length(normal);
+	float2 contactPoint;
+	if(distance != 0)
+	{
+		penetration = radius_sum - distance;
+		normal = normal / distance;
+		contactPoint = normal * _a.m_radius + _bodyA.position;
+	}
+	else
+	{
+		penetration = _a.m_radius;
+		normal = float2(1, 0);
+		contactPoint = _bodyA.position;
+	}
+
+	return Manifold(
+		_bodyA.index,
+		_bodyB.index,
+		(isHit == true) ? 1 : 0,
+		{ contactPoint },
+		normal,
+		penetration,
+		isHit
+	);
+}
+
+
+Manifold CollisionHelper::GenerateManifold(
+	const OBB& _a, const CollisionBody& _bodyA, const Circle& _b, const CollisionBody& _bodyB)
 {
 	// do inverse rotation to treat the OBB as AABB
-	float2x2 rotationMatrix = getRotationMatrix(_a.m_body->GetOrientation());
+	const float2x2& rotationMatrix = _bodyA.transform->rotation;
 
 	float2 rotatedCircleCenter =
-		_a.m_body->GetPosition() +
+		_bodyA.position +
 		linalg::mul(linalg::transpose(rotationMatrix)
-			, (_b.m_body->GetPosition() - _a.m_body->GetPosition()));
+			, (_bodyB.position - _bodyA.position));
 
-	auto normal = rotatedCircleCenter - _a.m_body->GetPosition();
+	auto normal = rotatedCircleCenter - _bodyA.position;
 	auto closest = normal;
 
 	float x_half_extent = _a.m_extent.x / 2.0f;
@@ -70,11 +425,11 @@ Manifold CollisionHelper::GenerateManifold(const OBB& _a, const Circle& _b)
 	normal = linalg::mul(rotationMatrix, normal);
 	normal = linalg::normalize(normal);
 
-	float2 contactPoint = (inside == true) ? _b.m_body->GetPosition() : _b.m_body->GetPosition() - _b.m_radius * normal;
+	float2 contactPoint = (inside == true) ? _bodyB.position : _bodyB.position - _b.m_radius * normal;
 
 	return Manifold(
-		_a.m_body,
-		_b.m_body,
+		_bodyA.index,
+		_bodyB.index,
 		(isHit == true) ? 1 : 0,
 		{ contactPoint },
 		normal,
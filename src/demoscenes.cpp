@@ -0,0 +1,164 @@
+#include "demoscenes.hpp"
+
+#include <cmath>
+#include <random>
+
+#include "circle.hpp"
+#include "obb.hpp"
+#include "joint.hpp"
+
+std::shared_ptr<RigidBody2D> DemoScenes::AddFloor(SceneBase& _scene, float2 _position, float2 _size)
+{
+    auto body = _scene.AddRigidBody(std::make_shared<OBB>(_size), _position);
+    // setting an infinite mass
+    body->SetStatic();
+    return body;
+}
+
+void DemoScenes::AddBoxStacks(SceneBase& _scene, int _count, int _height)
+{
+    const float width = _count * 2.0f;
+    AddFloor(_scene, float2(0.0f, -1.0f), float2(width + 10.0f, 2.0f));
+    for(int x = 0; x < _count; ++x)
+    {
+        for(int y = 0; y < _height; ++y)
+        {
+            const float2 position(x * 2.0f - width * 0.5f, y * 1.05f + 0.6f);
+            _scene.AddRigidBody(std::make_shared<OBB>(float2(1.0f, 1.0f)), position);
+        }
+    }
+}
+
+void DemoScenes::AddPyramids(SceneBase& _scene, int _count, int _base)
+{
+    const float spacing = _base * 1.5f + 2.0f;
+    const float width = _count * spacing;
+    AddFloor(_scene, float2(0.0f, -1.0f), float2(width + 10.0f, 2.0f));
+    for(int p = 0; p < _count; ++p)
+    {
+        const float center = p * spacing - (width - spacing) * 0.5f;
+        for(int row = 0; row < _base; ++row)
+        {
+            const int columns = _base - row;
+            for(int k = 0; k < columns; ++k)
+            {
+                const float2 position(center + (k - (columns - 1) * 0.5f) * 1.05f, row * 1.05f + 0.55f);
+                _scene.AddRigidBody(std::make_shared<OBB>(float2(1.0f, 1.0f)), position);
+            }
+        }
+    }
+}
+
+void DemoScenes::AddSpringBridge(SceneBase& _scene, float2 _center, size_t _boxCount, float _length, float _stiffness)
+{
+    const float rest_length = (_length / _boxCount);
+
+    std::vector< std::shared_ptr<RigidBody2D> > boxes;
+    boxes.reserve(_boxCount);
+
+    float theta = 0.0f;
+    float deltaTheta = (float) M_PI / (_boxCount - 1);
+
+    for(size_t i = 0; i < _boxCount; ++i)
+    {
+        auto shape = std::make_shared<OBB>(float2 (1, 1));
+        boxes.push_back(_scene.AddRigidBody(shape, 
+            float2(_center.x + _length * std::cos(theta), _center.y)
+        ));
+        boxes[i]->SetMass(1.0f);
+
+        theta += deltaTheta;
+    }
+
+    boxes[0]->SetMass(0.0f);
+    boxes[_boxCount - 1]->SetMass(0.0f);
+
+    for(size_t i = 1; i < _boxCount; ++i)
+    {
+        std::shared_ptr<SpringJoint> joint = 
+            std::make_shared<SpringJoint>(boxes[i - 1], boxes[i], rest_length, _stiffness);
+        _scene.AddJoint(joint);
+    }
+}
+
+void DemoScenes::AddDistanceChain(SceneBase& _scene, float2 _top, size_t _boxCount, float _length, float _deltaTime)
+{
+    const float rest_length = (_length / _boxCount);
+
+    std::vector< std::shared_ptr<RigidBody2D> > boxes;
+    boxes.reserve(_boxCount);
+
+    for(size_t i = 0; i < _boxCount; ++i)
+    {
+        auto shape = std::make_shared<OBB>(float2 (1, 1));
+        boxes.push_back(_scene.AddRigidBody(shape, 
+            float2( _top.x + -3.0f * i, _top.y - rest_length * i)
+        ));
+        boxes[i]->SetMass(1.0f);
+        boxes[i]->SetVelocity(float2(1.0f, 0.0f));
+    }
+
+    boxes[0]->SetMass(0.0f);
+
+    for(size_t i = 1; i < _boxCount; ++i)
+    {
+        std::shared_ptr<DistanceJoint> joint = 
+            std::make_shared<DistanceJoint>(boxes[i - 1], boxes[i], rest_length * 3.0f, _deltaTime);
+        _scene.AddJoint(joint);
+    }
+}
+
+void DemoScenes::AddCircleRain(SceneBase& _scene, int _count, uint32_t _seed)
+{
+    // about 10 circles per row, the column grows with the count
+    const float width = 40.0f;
+    AddFloor(_scene, float2(0.0f, -1.0f), float2(width + 10.0f, 2.0f));
+
+    std::mt19937 rng(_seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for(int i = 0; i < _count; ++i)
+    {
+        const float2 position((unit(rng) - 0.5f) * width, 5.0f + (i / 10) * 2.0f + unit(rng));
+        auto body = _scene.AddRigidBody(std::make_shared<Circle>(0.3f + unit(rng) * 0.5f), position);
+        body->SetVelocity(float2(unit(rng) - 0.5f, -unit(rng)) * 4.0f);
+    }
+}
+
+bool DemoScenes::Build(SceneBase& _scene, const std::string& _name, int _size, float _deltaTime)
+{
+    if(_name == "stacks")
+    {
+        AddBoxStacks(_scene, _size, 10);
+    }
+    else if(_name == "pyramids")
+    {
+        AddPyramids(_scene, _size, 10);
+    }
+    else if(_name == "bridge")
+    {
+        // the bridge of the demo, side by side
+        for(int i = 0; i < _size; ++i)
+            AddSpringBridge(_scene, float2(i * 60.0f, -18.0f), 21, 25.0f, 100.0f);
+    }
+    else if(_name == "chain")
+    {
+        // the chain of the demo, side by side
+        for(int i = 0; i < _size; ++i)
+            AddDistanceChain(_scene, float2(i * 30.0f - 20.0f, 30.0f), 7, 15.0f, _deltaTime);
+    }
+    else if(_name == "rain")
+    {
+        AddCircleRain(_scene, _size * 100, 1234u);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+const std::vector<std::string>& DemoScenes::GetNames()
+{
+    static const std::vector<std::string> names = { "stacks", "pyramids", "bridge", "chain", "rain" };
+    return names;
+}
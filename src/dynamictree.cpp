@@ -0,0 +1,282 @@
+#include "dynamictree.hpp"
+
+#include <algorithm>
+
+int32_t DynamicTree::AllocateNode()
+{
+    if(m_freeList == k_nullNode)
+    {
+        m_nodes.push_back(Node{});
+        m_nodes.back().height = -1;
+        m_nodes.back().parent = k_nullNode;
+        m_freeList = static_cast<int32_t>(m_nodes.size() - 1);
+    }
+
+    // free nodes use 'parent' as the next pointer of the free list
+    const int32_t index = m_freeList;
+    m_freeList = m_nodes[index].parent;
+
+    Node& node = m_nodes[index];
+    node.parent = k_nullNode;
+    node.child0 = k_nullNode;
+    node.child1 = k_nullNode;
+    node.height = 0;
+    node.userData = 0u;
+    return index;
+}
+
+void DynamicTree::FreeNode(int32_t _node)
+{
+    m_nodes[_node].parent = m_freeList;
+    m_nodes[_node].height = -1;
+    m_freeList = _node;
+}
+
+int32_t DynamicTree::CreateProxy(const AABB& _bounds, uint32_t _userData)
+{
+    const int32_t proxy = AllocateNode();
+
+    const float2 margin(m_margin, m_margin);
+    m_nodes[proxy].bounds = AABB{ _bounds.min - margin, _bounds.max + margin };
+    m_nodes[proxy].userData = _userData;
+
+    InsertLeaf(proxy);
+    return proxy;
+}
+
+void DynamicTree::DestroyProxy(int32_t _proxy)
+{
+    RemoveLeaf(_proxy);
+    FreeNode(_proxy);
+}
+
+bool DynamicTree::MoveProxy(int32_t _proxy, const AABB& _bounds)
+{
+    if(m_nodes[_proxy].bounds.Contains(_bounds))
+        return false;
+
+    RemoveLeaf(_proxy);
+
+    const float2 margin(m_margin, m_margin);
+    m_nodes[_proxy].bounds = AABB{ _bounds.min - margin, _bounds.max + margin };
+
+    InsertLeaf(_proxy);
+    return true;
+}
+
+void DynamicTree::Clear()
+{
+    m_nodes.clear();
+    m_root = k_nullNode;
+    m_freeList = k_nullNode;
+}
+
+void DynamicTree::InsertLeaf(int32_t _leaf)
+{
+    if(m_root == k_nullNode)
+    {
+        m_root = _leaf;
+        m_nodes[m_root].parent = k_nullNode;
+        return;
+    }
+
+    // find the best sibling by walking down with the surface area heuristic
+    // (perimeter in 2D), stop once descending costs more than pairing here
+    const AABB leafBounds = m_nodes[_leaf].bounds;
+    int32_t index = m_root;
+    while(m_nodes[index].IsLeaf() == false)
+    {
+        const Node& node = m_nodes[index];
+
+        const float area = node.bounds.GetPerimeter();
+        const float combinedArea = AABB::Combine(node.bounds, leafBounds).GetPerimeter();
+
+        // cost of creating a new parent for this node and the new leaf
+        const float cost = 2.0f * combinedArea;
+        // minimum cost of pushing the leaf further down the tree
+        const float inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](int32_t child)
+        {
+            const AABB combined = AABB::Combine(leafBounds, m_nodes[child].bounds);
+            if(m_nodes[child].IsLeaf())
+                return combined.GetPerimeter() + inheritanceCost;
+            return (combined.GetPerimeter() - m_nodes[child].bounds.GetPerimeter()) + inheritanceCost;
+        };
+
+        const float cost0 = descendCost(node.child0);
+        const float cost1 = descendCost(node.child1);
+
+        if(cost < cost0 && cost < cost1)
+            break;
+
+        index = (cost0 < cost1) ? node.child0 : node.child1;
+    }
+
+    const int32_t sibling = index;
+
+    // create a new parent for the sibling and the leaf
+    const int32_t oldParent = m_nodes[sibling].parent;
+    const int32_t newParent = AllocateNode();
+    m_nodes[newParent].parent = oldParent;
+    m_nodes[newParent].bounds = AABB::Combine(leafBounds, m_nodes[sibling].bounds);
+    m_nodes[newParent].height = m_nodes[sibling].height + 1;
+    m_nodes[newParent].child0 = sibling;
+    m_nodes[newParent].child1 = _leaf;
+    m_nodes[sibling].parent = newParent;
+    m_nodes[_leaf].parent = newParent;
+
+    if(oldParent != k_nullNode)
+    {
+        if(m_nodes[oldParent].child0 == sibling)
+            m_nodes[oldParent].child0 = newParent;
+        else
+            m_nodes[oldParent].child1 = newParent;
+    }
+    else
+    {
+        m_root = newParent;
+    }
+
+    RefitAncestors(m_nodes[_leaf].parent);
+}
+
+void DynamicTree::RemoveLeaf(int32_t _leaf)
+{
+    if(_leaf == m_root)
+    {
+        m_root = k_nullNode;
+        return;
+    }
+
+    const int32_t parent = m_nodes[_leaf].parent;
+    const int32_t grandParent = m_nodes[parent].parent;
+    const int32_t sibling =
+        (m_nodes[parent].child0 == _leaf) ? m_nodes[parent].child1 : m_nodes[parent].child0;
+
+    // the sibling takes the place of the parent
+    if(grandParent != k_nullNode)
+    {
+        if(m_nodes[grandParent].child0 == parent)
+            m_nodes[grandParent].child0 = sibling;
+        else
+            m_nodes[grandParent].child1 = sibling;
+        m_nodes[sibling].parent = grandParent;
+        FreeNode(parent);
+
+        RefitAncestors(grandParent);
+    }
+    else
+    {
+        m_root = sibling;
+        m_nodes[sibling].parent = k_nullNode;
+        FreeNode(parent);
+    }
+}
+
+void DynamicTree::RefitAncestors(int32_t _node)
+{
+    int32_t index = _node;
+    while(index != k_nullNode)
+    {
+        index = Balance(index);
+
+        Node& node = m_nodes[index];
+        const Node& child0 = m_nodes[node.child0];
+        const Node& child1 = m_nodes[node.child1];
+
+        node.height = 1 + std::max(child0.height, child1.height);
+        node.bounds = AABB::Combine(child0.bounds, child1.bounds);
+
+        index = node.parent;
+    }
+}
+
+/**
+ *  Perform a left or right rotation if node A is imbalanced, the index of
+ *  the node that took A's place is returned.
+ *
+ *          A
+ *        /   \
+ *       B     C
+ *      / \   / \
+ *     D   E F   G
+ */
+int32_t DynamicTree::Balance(int32_t _node)
+{
+    const int32_t iA = _node;
+    Node& A = m_nodes[iA];
+    if(A.IsLeaf() || A.height < 2)
+        return iA;
+
+    const int32_t iB = A.child0;
+    const int32_t iC = A.child1;
+    Node& B = m_nodes[iB];
+    Node& C = m_nodes[iC];
+
+    const int32_t balance = C.height - B.height;
+
+    // swap a node with its parent, 'iUp' is the child being promoted and
+    // 'iStay' the child of A that keeps its place
+    auto rotate = [&](int32_t iUp, int32_t iStay, bool upIsChild1)
+    {
+        Node& up = m_nodes[iUp];
+        const int32_t iX = up.child0;
+        const int32_t iY = up.child1;
+        Node& X = m_nodes[iX];
+        Node& Y = m_nodes[iY];
+        const Node& stay = m_nodes[iStay];
+
+        up.child0 = iA;
+        up.parent = A.parent;
+        A.parent = iUp;
+
+        if(up.parent != k_nullNode)
+        {
+            if(m_nodes[up.parent].child0 == iA)
+                m_nodes[up.parent].child0 = iUp;
+            else
+                m_nodes[up.parent].child1 = iUp;
+        }
+        else
+        {
+            m_root = iUp;
+        }
+
+        // the taller grandchild stays under 'up', the other one moves to A
+        const bool keepX = X.height > Y.height;
+        const int32_t iKeep = keepX ? iX : iY;
+        const int32_t iMove = keepX ? iY : iX;
+        Node& keep = m_nodes[iKeep];
+        Node& move = m_nodes[iMove];
+
+        up.child1 = iKeep;
+        if(upIsChild1)
+            A.child1 = iMove;
+        else
+            A.child0 = iMove;
+        move.parent = iA;
+
+        A.bounds = AABB::Combine(stay.bounds, move.bounds);
+        up.bounds = AABB::Combine(A.bounds, keep.bounds);
+
+        A.height = 1 + std::max(stay.height, move.height);
+        up.height = 1 + std::max(A.height, keep.height);
+    };
+
+    // rotate C up
+    if(balance > 1)
+    {
+        rotate(iC, iB, true);
+        return iC;
+    }
+
+    // rotate B up
+    if(balance < -1)
+    {
+        rotate(iB, iC, false);
+        return iB;
+    }
+
+    return iA;
+}
@@ -0,0 +1,449 @@
+/**
+ *  Runs the physics without a window, for machines that have no display
+ *  (or no GL). Builds one of the scenes of DemoScenes, runs a fixed number
+ *  of steps and writes what it measured as JSON.
+ *
+ *  usage : headless [--scene NAME|all] [--size N] [--steps N] [--warmup N]
+ *                   [--integrator explicit|symplectic|newton|rk4]
+ *                   [--broadphase brute|grid|sap|tree]
+ *                   [--solver impulse|colored|sequential]
+ *                   [--threads N] [--sleep] [--out FILE]
+ *                   [--profile] [--trace FILE]
+ *                   [--load SNAPSHOT] [--replay INPUTS]
+ *                   [--hashes FILE] [--verify FILE]
+ *
+ *  '--threads 0' (the default) runs without a job system, '--out' writes
+ *  to a file instead of the standard output. '--profile' adds the zones and
+ *  counters of profiler.hpp to every run, '--trace' does too and streams
+ *  the measured steps of every run to a chrome trace.
+ *
+ *  '--load' starts from a snapshot (see snapshot.hpp) instead of a scene of
+ *  DemoScenes, with the integrator, broadphase and solver it was saved
+ *  with. '--replay' does the inputs of a recording (see replay.hpp) before
+ *  the steps they were done at, and runs as many steps as it has unless
+ *  '--steps' is given. '--hashes' writes a hash of the bodies after every
+ *  step, warmup included, '--verify' compares them with such a file and
+ *  exits with 2 at the first step that differs.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "scene.hpp"
+#include "integrator.hpp"
+#include "demoscenes.hpp"
+#include "profiler.hpp"
+#include "replay.hpp"
+#include "snapshot.hpp"
+
+namespace
+{
+    constexpr const float deltaTime = 1.0f / 60.0f;
+    constexpr const uint32_t positional_correction_iterations = 10;
+
+    struct Options
+    {
+        std::string scene = "stacks";
+        int size = 10;
+        // 0 : 600, or every step of the replay
+        int steps = 0;
+        int warmup = 0;
+        std::string integrator = "symplectic";
+        std::string broadphase = "tree";
+        std::string solver = "impulse";
+        size_t threads = 0u;
+        bool sleep = false;
+        std::string out;
+        bool profile = false;
+        std::string trace;
+        std::string load;
+        std::string replay;
+        std::string hashes;
+        std::string verify;
+    };
+
+    struct StageName
+    {
+        SceneStage stage;
+        const char* name;
+    };
+
+    const StageName k_stages[] =
+    {
+        { SceneStage::Transforms, "transforms" },
+        { SceneStage::Broadphase, "broadphase" },
+        { SceneStage::Narrowphase, "narrowphase" },
+        { SceneStage::Solver, "solver" },
+        { SceneStage::Joints, "joints" },
+        { SceneStage::Integrate, "integrate" },
+    };
+
+    [[noreturn]] void Fail(const std::string& _message)
+    {
+        std::cerr << "headless : " << _message << std::endl;
+        std::exit(1);
+    }
+
+    Options ParseOptions(int argc, char* argv[])
+    {
+        Options options;
+        for(int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            if(arg == "--sleep")
+            {
+                options.sleep = true;
+                continue;
+            }
+            if(arg == "--profile")
+            {
+                options.profile = true;
+                continue;
+            }
+
+            if(i + 1 >= argc)
+                Fail("missing value for " + arg);
+            const std::string value = argv[++i];
+
+            if(arg == "--scene")
+                options.scene = value;
+            else if(arg == "--size")
+                options.size = std::atoi(value.c_str());
+            else if(arg == "--steps")
+                options.steps = std::atoi(value.c_str());
+            else if(arg == "--warmup")
+                options.warmup = std::atoi(value.c_str());
+            else if(arg == "--integrator")
+                options.integrator = value;
+            else if(arg == "--broadphase")
+                options.broadphase = value;
+            else if(arg == "--solver")
+                options.solver = value;
+            else if(arg == "--threads")
+                options.threads = static_cast<size_t>(std::atoi(value.c_str()));
+            else if(arg == "--out")
+                options.out = value;
+            else if(arg == "--load")
+                options.load = value;
+            else if(arg == "--replay")
+                options.replay = value;
+            else if(arg == "--hashes")
+                options.hashes = value;
+            else if(arg == "--verify")
+                options.verify = value;
+            else if(arg == "--trace")
+            {
+                options.trace = value;
+                options.profile = true;
+            }
+            else
+                Fail("unknown option " + arg);
+        }
+
+        if(options.size <= 0 || options.steps < 0 || options.warmup < 0)
+            Fail("--size and --steps have to be positive");
+        if(options.scene == "all" && (options.load.empty() == false || options.replay.empty() == false ||
+            options.hashes.empty() == false || options.verify.empty() == false))
+            Fail("--load, --replay, --hashes and --verify need a single scene");
+#if RIGIDBODY2D_PROFILE == 0
+        if(options.profile)
+            Fail("--profile and --trace need a build with the profiler (PROFILE=1)");
+#endif
+        return options;
+    }
+
+    std::shared_ptr<Integrator> MakeIntegrator(const std::string& _name)
+    {
+        if(_name == "explicit")
+            return std::make_shared<ExplicitEulerIntegrator>();
+        if(_name == "symplectic")
+            return std::make_shared<SymplecticEulerIntegrator>();
+        if(_name == "newton")
+            return std::make_shared<NewtonIntegrator>();
+        if(_name == "rk4")
+            return std::make_shared<RungeKuttaFourthIntegrator>();
+        Fail("unknown integrator " + _name);
+    }
+
+    std::shared_ptr<Broadphase> MakeBroadphase(const std::string& _name)
+    {
+        if(_name == "brute")
+            return std::make_shared<BruteForceBroadphase>();
+        if(_name == "grid")
+            return std::make_shared<UniformGridBroadphase>();
+        if(_name == "sap")
+            return std::make_shared<SweepAndPruneBroadphase>();
+        if(_name == "tree")
+            return std::make_shared<DynamicTreeBroadphase>();
+        Fail("unknown broadphase " + _name);
+    }
+
+    std::shared_ptr<Solver> MakeSolver(const std::string& _name)
+    {
+        if(_name == "impulse")
+            return std::make_shared<ImpulseSolver>();
+        if(_name == "colored")
+            return std::make_shared<GraphColoringSolver>();
+        if(_name == "sequential")
+            return std::make_shared<SequentialImpulseSolver>();
+        Fail("unknown solver " + _name);
+    }
+
+    // totals over the measured steps, time of nested zones included
+    void AppendProfile(const StepStats& _total, std::string& _json)
+    {
+        char buffer[128];
+        _json += "      \"profile\": {\n        \"zones_ms\": {";
+        for(size_t k = 0; k < StepStats::k_zoneCount; ++k)
+        {
+            const ProfileZone zone = static_cast<ProfileZone>(k);
+            std::snprintf(buffer, sizeof(buffer), "%s \"%s\": %.3f", (k == 0) ? "" : ",",
+                Profiler::GetName(zone), _total.GetZoneMs(zone));
+            _json += buffer;
+        }
+        _json += " },\n        \"counters\": {";
+        for(size_t k = 0; k < StepStats::k_counterCount; ++k)
+        {
+            const ProfileCounter counter = static_cast<ProfileCounter>(k);
+            std::snprintf(buffer, sizeof(buffer), "%s \"%s\": %llu", (k == 0) ? "" : ",",
+                Profiler::GetName(counter), static_cast<unsigned long long>(_total.GetCounter(counter)));
+            _json += buffer;
+        }
+        _json += " }\n      },\n";
+    }
+
+    std::shared_ptr<Scene> MakeScene(const Options& _options, const std::string& _sceneName,
+        const std::shared_ptr<JobSystem>& _jobs)
+    {
+        if(_options.load.empty() == false)
+            return SceneSnapshot::Load(_options.load, _jobs);
+
+        std::shared_ptr<Scene> scene = std::make_shared<Scene>(deltaTime, positional_correction_iterations,
+            MakeIntegrator(_options.integrator), MakeBroadphase(_options.broadphase), MakeSolver(_options.solver), _jobs);
+        if(DemoScenes::Build(*scene, _sceneName, _options.size, deltaTime) == false)
+            Fail("unknown scene " + _sceneName);
+
+        SleepSettings settings = scene->GetSleepSettings();
+        settings.enabled = _options.sleep;
+        scene->SetSleepSettings(settings);
+        return scene;
+    }
+
+    // Steps the scene, doing the inputs of the replay before, and writes
+    // or checks the state hashes after
+    class Stepper
+    {
+    private:
+        Scene& m_scene;
+        ReplayDriver m_driver;
+        std::unique_ptr<StateHashWriter> m_writer;
+        std::unique_ptr<StateHashVerifier> m_verifier;
+
+    public:
+        Stepper(const Options& _options, Scene& _scene, const InputRecording& _recording)
+            : m_scene(_scene), m_driver(_scene, _recording), m_writer(), m_verifier()
+        {
+            if(_options.hashes.empty() == false)
+                m_writer.reset(new StateHashWriter(_options.hashes));
+            if(_options.verify.empty() == false)
+                m_verifier.reset(new StateHashVerifier(_options.verify));
+        }
+
+        void Step()
+        {
+            m_driver.Step();
+            if(m_writer)
+                m_writer->Add(m_driver.GetStep(), m_scene.GetBodyStore());
+            if(m_verifier && m_verifier->Check(m_driver.GetStep(), m_scene.GetBodyStore()) == false)
+            {
+                std::cerr << "headless : diverged at " << m_verifier->GetReport() << std::endl;
+                std::exit(2);
+            }
+        }
+
+        void Close()
+        {
+            if(m_writer)
+                m_writer->Close();
+            if(m_verifier)
+                std::cerr << "headless : " << m_verifier->GetCheckedCount() << " steps identical" << std::endl;
+        }
+    };
+
+    // runs one scene and appends its JSON object to '_json'
+    void Run(const Options& _options, const std::string& _sceneName, const InputRecording& _recording,
+        const std::shared_ptr<JobSystem>& _jobs, const std::shared_ptr<Profiler>& _profiler,
+        std::string& _json)
+    {
+        std::shared_ptr<Scene> scenePointer;
+        std::unique_ptr<Stepper> stepper;
+        try
+        {
+            scenePointer = MakeScene(_options, _sceneName, _jobs);
+            stepper.reset(new Stepper(_options, *scenePointer, _recording));
+        }
+        catch(const std::exception& e)
+        {
+            Fail(e.what());
+        }
+        Scene& scene = *scenePointer;
+
+        for(int s = 0; s < _options.warmup; ++s)
+            stepper->Step();
+
+        scene.ResetStageStats();
+        scene.SetStageTiming(true);
+        if(_profiler)
+        {
+            _profiler->ResetTotal();
+            scene.SetProfiler(_profiler);
+        }
+
+        size_t pairSum = 0u, pairMax = 0u;
+        size_t pointSum = 0u, pointMax = 0u;
+        const auto start = std::chrono::steady_clock::now();
+        for(int s = 0; s < _options.steps; ++s)
+        {
+            stepper->Step();
+
+            const size_t pairs = scene.GetPairCache().GetCount();
+            const size_t points = scene.GetContactPointCount();
+            pairSum += pairs;
+            pointSum += points;
+            pairMax = std::max(pairMax, pairs);
+            pointMax = std::max(pointMax, points);
+        }
+        const double totalMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        try
+        {
+            stepper->Close();
+        }
+        catch(const std::exception& e)
+        {
+            Fail(e.what());
+        }
+
+        char buffer[512];
+        std::snprintf(buffer, sizeof(buffer),
+            "    {\n"
+            "      \"scene\": \"%s\",\n"
+            "      \"bodies\": %zu,\n"
+            "      \"joints\": %zu,\n"
+            "      \"steps\": %d,\n"
+            "      \"total_ms\": %.3f,\n"
+            "      \"ms_per_step\": %.6f,\n"
+            "      \"steps_per_sec\": %.1f,\n",
+            _sceneName.c_str(), scene.GetBodyCount(), scene.GetJoints().size(), _options.steps,
+            totalMs, totalMs / _options.steps, _options.steps / (totalMs * 1e-3));
+        _json += buffer;
+
+        // stage times are totals over the measured steps
+        _json += "      \"stages_ms\": {";
+        for(size_t k = 0; k < sizeof(k_stages) / sizeof(k_stages[0]); ++k)
+        {
+            std::snprintf(buffer, sizeof(buffer), "%s \"%s\": %.3f", (k == 0) ? "" : ",",
+                k_stages[k].name, scene.GetStageMs(k_stages[k].stage));
+            _json += buffer;
+        }
+        _json += " },\n";
+
+        if(_profiler)
+            AppendProfile(_profiler->GetTotal(), _json);
+
+        std::snprintf(buffer, sizeof(buffer),
+            "      \"contacts\": { \"pairs_avg\": %.2f, \"pairs_max\": %zu, \"points_avg\": %.2f, \"points_max\": %zu },\n"
+            "      \"awake_bodies\": %zu\n"
+            "    }",
+            static_cast<double>(pairSum) / _options.steps, pairMax,
+            static_cast<double>(pointSum) / _options.steps, pointMax,
+            scene.GetAwakeBodyCount());
+        _json += buffer;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options = ParseOptions(argc, argv);
+
+    InputRecording recording;
+    if(options.replay.empty() == false)
+    {
+        try
+        {
+            recording = InputRecording::Load(options.replay);
+        }
+        catch(const std::exception& e)
+        {
+            Fail(e.what());
+        }
+    }
+    if(options.steps == 0)
+        options.steps = options.replay.empty() ? 600 : static_cast<int>(recording.GetStepCount()) - options.warmup;
+    if(options.steps <= 0)
+        Fail("the replay has no steps after the warmup");
+
+    std::vector<std::string> scenes;
+    if(options.scene == "all")
+        scenes = DemoScenes::GetNames();
+    else
+        scenes.push_back(options.scene);
+
+    std::shared_ptr<JobSystem> jobs;
+    if(options.threads > 0u)
+        jobs = std::make_shared<JobSystem>(options.threads);
+
+    std::shared_ptr<Profiler> profiler;
+    if(options.profile)
+        profiler = std::make_shared<Profiler>();
+    if(options.trace.empty() == false)
+    {
+        try
+        {
+            profiler->StartTrace(options.trace);
+        }
+        catch(const std::exception& e)
+        {
+            Fail(e.what());
+        }
+    }
+
+    std::string json;
+    char buffer[512];
+    std::snprintf(buffer, sizeof(buffer),
+        "{\n"
+        "  \"config\": { \"size\": %d, \"steps\": %d, \"warmup\": %d, \"dt\": %.6f, \"iterations\": %u,"
+        " \"integrator\": \"%s\", \"broadphase\": \"%s\", \"solver\": \"%s\", \"threads\": %zu, \"sleep\": %s },\n"
+        "  \"runs\": [\n",
+        options.size, options.steps, options.warmup, deltaTime, positional_correction_iterations,
+        options.integrator.c_str(), options.broadphase.c_str(), options.solver.c_str(),
+        jobs ? jobs->GetThreadCount() : 0u, options.sleep ? "true" : "false");
+    json += buffer;
+
+    for(size_t i = 0; i < scenes.size(); ++i)
+    {
+        Run(options, scenes[i], recording, jobs, profiler, json);
+        json += (i + 1 < scenes.size()) ? ",\n" : "\n";
+    }
+    json += "  ]\n}\n";
+
+    if(options.out.empty())
+    {
+        std::fwrite(json.data(), 1, json.size(), stdout);
+        return 0;
+    }
+
+    FILE* file = std::fopen(options.out.c_str(), "w");
+    if(file == nullptr)
+        Fail("can not open " + options.out);
+    std::fwrite(json.data(), 1, json.size(), file);
+    std::fclose(file);
+    return 0;
+}
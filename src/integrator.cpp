@@ -4,235 +4,135 @@
 
 #include "scene.hpp"
 
+// the scenes of these calls pick their integrator at runtime, the
+// templates do the work
+
 void ExplicitEulerIntegrator::Integrate(Scene& scene)
 {
-    // from 2009 Erin Catto http://www.gphysics.com
-    /* 
-	state2->x = state1->x + h * state1->v;
-	state2->v = state1->v - h * gravity;
-    */
-    for(size_t i = 0; i < scene.m_bodies.size(); ++i)
-    {
-        if(scene.m_bodies[i]->GetInvMass() == 0.0f)
-            continue;
-
-        // Linear
-        scene.m_bodies[i]->AddPosition(scene.m_deltaTime * scene.m_bodies[i]->GetVelocity());
-        // delta_v = delta_time * a = delta_time * F / m;
-        scene.m_bodies[i]->AddVelocity(scene.m_deltaTime * (scene.m_bodies[i]->GetForce() / scene.m_bodies[i]->GetMass()));
-        // add gravity
-        scene.m_bodies[i]->AddVelocity(scene.m_deltaTime * float2(0, -9.8f));
-
-        // Rotation
-        scene.m_bodies[i]->AddOrientation(scene.m_bodies[i]->GetAngularVelocity() * scene.m_deltaTime);
-        scene.m_bodies[i]->AddAngularVelocity(scene.m_deltaTime * (scene.m_bodies[i]->GetTorque() * scene.m_bodies[i]->GetInvInertia()));
-
-        scene.m_bodies[i]->SetForce(float2(0, 0));
-        scene.m_bodies[i]->SetTorque(0.0f);
-    }
-
-    // TODO : we might need to add gravity somewhere.
-    // maybe define the gravity vector in scene class.
+    Integrate<Scene>(scene);
 }
 
-
 void SymplecticEulerIntegrator::Integrate(Scene& scene)
 {
-	// from 2009 Erin Catto http://www.gphysics.com
-	/*
-	state2->v = state1->v - h * gravity;
-	state2->x = state1->x + h * state2->v;
-	*/
-	for (size_t i = 0; i < scene.m_bodies.size(); i++)
-	{
-		if (scene.m_bodies[i]->GetInvMass() == 0.0f)
-			continue;
-
-		scene.m_bodies[i]->AddVelocity(scene.m_deltaTime * (scene.m_bodies[i]->GetForce() / scene.m_bodies[i]->GetMass()));
-		scene.m_bodies[i]->AddVelocity(scene.m_deltaTime * float2(0, -9.8f));
-
-		scene.m_bodies[i]->AddPosition(scene.m_deltaTime * scene.m_bodies[i]->GetVelocity());
-
-		// Rotation
-		scene.m_bodies[i]->AddAngularVelocity(scene.m_deltaTime * (scene.m_bodies[i]->GetTorque() * scene.m_bodies[i]->GetInvInertia()));
-		scene.m_bodies[i]->AddOrientation(scene.m_bodies[i]->GetAngularVelocity() * scene.m_deltaTime);
-
-		scene.m_bodies[i]->SetForce(float2(0, 0));
-		scene.m_bodies[i]->SetTorque(0.0f);
-	}
+	Integrate<Scene>(scene);
 }
 
-
 void NewtonIntegrator::Integrate(Scene& scene)
 {
-    // from 2009 Erin Catto http://www.gphysics.com
-    /* 
-	state2->x = state1->x + h * state1->v - 0.5f * h * h * gravity;
-	state2->v = state1->v - h * gravity;
-    */
-
-    const float2 gravity(0.0f, -9.8f);
-
-    for(size_t i = 0; i < scene.m_bodies.size(); ++i)
-    {
-        if(scene.m_bodies[i]->GetInvMass() == 0.0f)
-            continue;
-
-        // Linear
-        scene.m_bodies[i]->AddPosition(scene.m_deltaTime * scene.m_bodies[i]->GetVelocity() + 0.5f * scene.m_deltaTime * scene.m_deltaTime * gravity);
-        // delta_v = delta_time * a = delta_time * F / m;
-        scene.m_bodies[i]->AddVelocity(scene.m_deltaTime * (scene.m_bodies[i]->GetForce() * scene.m_bodies[i]->GetInvMass()));
-        // add gravity
-        scene.m_bodies[i]->AddVelocity(scene.m_deltaTime * float2(0, -9.8f));
-
-        // Rotation
-        scene.m_bodies[i]->AddOrientation(scene.m_bodies[i]->GetAngularVelocity() * scene.m_deltaTime);
-        scene.m_bodies[i]->AddAngularVelocity(scene.m_deltaTime * (scene.m_bodies[i]->GetTorque() * scene.m_bodies[i]->GetInvInertia()));
-
-        scene.m_bodies[i]->SetForce(float2(0, 0));
-        scene.m_bodies[i]->SetTorque(0.0f);
-    }
+    Integrate<Scene>(scene);
 }
 
 void RungeKuttaFourthIntegrator::Integrate(Scene& scene)
 {
-	// this stores the absolute value of position and velocity
-	std::vector<StateStep> currentState(scene.m_bodies.size());
-	// below four arrays store the delta value of each state
-	std::vector<StateStep> deltaK1State(scene.m_bodies.size());
-	std::vector<StateStep> deltaK2State(scene.m_bodies.size());
-	std::vector<StateStep> deltaK3State(scene.m_bodies.size());
-	std::vector<StateStep> deltaK4State(scene.m_bodies.size());
-
-	const float2 gravity(0.0f, -9.8f);
-
-	for (size_t i = 0; i < scene.m_bodies.size(); ++i)
-	{
-		if (scene.m_bodies[i]->GetInvMass() == 0.0f)
-			continue;
-
-		currentState[i].position = scene.m_bodies[i]->GetPosition();
-		currentState[i].velocity = scene.m_bodies[i]->GetVelocity();
-		currentState[i].orientation = scene.m_bodies[i]->GetOrientation();
-		currentState[i].angularVelocity = scene.m_bodies[i]->GetAngularVelocity();
-	}
-
-	scene.Solve();
-
-	for (size_t i = 0; i < scene.m_bodies.size(); ++i)
-	{
-		if (scene.m_bodies[i]->GetInvMass() == 0.0f)
-			continue;
-
-		const float2 acceleration = gravity + scene.m_bodies[i]->GetForce() * scene.m_bodies[i]->GetInvMass();
-		const float angularAcc = scene.m_bodies[i]->GetTorque() * scene.m_bodies[i]->GetInvInertia();
-
-		deltaK1State[i].velocity = acceleration * scene.m_deltaTime;
-		deltaK1State[i].position = scene.m_bodies[i]->GetVelocity() * scene.m_deltaTime;
-		deltaK1State[i].angularVelocity = angularAcc * scene.m_deltaTime;
-		deltaK1State[i].orientation = scene.m_bodies[i]->GetAngularVelocity() * scene.m_deltaTime;
-
-		scene.m_bodies[i]->SetVelocity(currentState[i].velocity + deltaK1State[i].velocity * 0.5f);
-		scene.m_bodies[i]->SetPosition(currentState[i].position + deltaK1State[i].position * 0.5f);
-		scene.m_bodies[i]->SetAngularVelocity(currentState[i].angularVelocity + deltaK1State[i].angularVelocity * 0.5f);
-		scene.m_bodies[i]->SetOrientation(currentState[i].orientation + deltaK1State[i].orientation * 0.5f);
-
-		scene.m_bodies[i]->SetForce(float2(0.0f, 0.0f));
-		scene.m_bodies[i]->SetTorque(0.0f);
-	}
-
-	scene.Solve();
-
-	for (size_t i = 0; i < scene.m_bodies.size(); ++i)
-	{
-		if (scene.m_bodies[i]->GetInvMass() == 0.0f)
-			continue;
-
-		const float2 acceleration = gravity + scene.m_bodies[i]->GetForce() * scene.m_bodies[i]->GetInvMass();
-		const float angularAcc = scene.m_bodies[i]->GetTorque() * scene.m_bodies[i]->GetInvInertia();
-
-		deltaK2State[i].velocity = acceleration * scene.m_deltaTime;
-		deltaK2State[i].position = scene.m_bodies[i]->GetVelocity() * scene.m_deltaTime;
-		deltaK2State[i].angularVelocity = angularAcc * scene.m_deltaTime;
-		deltaK2State[i].orientation = scene.m_bodies[i]->GetAngularVelocity() * scene.m_deltaTime;
-
-		scene.m_bodies[i]->SetVelocity(currentState[i].velocity + deltaK2State[i].velocity * 0.5f);
-		scene.m_bodies[i]->SetPosition(currentState[i].position + deltaK2State[i].position * 0.5f);
-		scene.m_bodies[i]->SetAngularVelocity(currentState[i].angularVelocity + deltaK2State[i].angularVelocity * 0.5f);
-		scene.m_bodies[i]->SetOrientation(currentState[i].orientation + deltaK2State[i].orientation * 0.5f);
+	Integrate<Scene>(scene);
+}
 
-		scene.m_bodies[i]->SetForce(float2(0.0f, 0.0f));
-		scene.m_bodies[i]->SetTorque(0.0f);
-	}
+void RungeKuttaFourthIntegrator::State::Resize(size_t _count)
+{
+	positionX.resize(_count);
+	positionY.resize(_count);
+	velocityX.resize(_count);
+	velocityY.resize(_count);
+	orientation.resize(_count);
+	angularVelocity.resize(_count);
+}
 
-	scene.Solve();
+void RungeKuttaFourthIntegrator::RunStage(BodyStore& _bodies, size_t _begin, size_t _end, float _deltaTime, int _stage)
+{
+	const float2 gravity(0.0f, -9.8f);
+	// where the next stage is evaluated, from the start of the step
+	const float scale = (_stage < 2) ? 0.5f : 1.0f;
+	// k1 + 2 k2 + 2 k3 + k4
+	const float weight = (_stage == 1 || _stage == 2) ? 2.0f : 1.0f;
 
-	for (size_t i = 0; i < scene.m_bodies.size(); ++i)
+	for (size_t i = _begin; i < _end; ++i)
 	{
-		if (scene.m_bodies[i]->GetInvMass() == 0.0f)
+		if (m_isActive[i] == 0u)
 			continue;
 
-		const float2 acceleration = gravity + scene.m_bodies[i]->GetForce() * scene.m_bodies[i]->GetInvMass();
-		const float angularAcc = scene.m_bodies[i]->GetTorque() * scene.m_bodies[i]->GetInvInertia();
-
-		deltaK3State[i].velocity = acceleration * scene.m_deltaTime;
-		deltaK3State[i].position = scene.m_bodies[i]->GetVelocity() * scene.m_deltaTime;
-		deltaK3State[i].angularVelocity = angularAcc * scene.m_deltaTime;
-		deltaK3State[i].orientation = scene.m_bodies[i]->GetAngularVelocity() * scene.m_deltaTime;
-
-		scene.m_bodies[i]->SetVelocity(currentState[i].velocity + deltaK3State[i].velocity);
-		scene.m_bodies[i]->SetPosition(currentState[i].position + deltaK3State[i].position);
-		scene.m_bodies[i]->SetAngularVelocity(currentState[i].angularVelocity + deltaK3State[i].angularVelocity);
-		scene.m_bodies[i]->SetOrientation(currentState[i].orientation + deltaK3State[i].orientation);
-
-		scene.m_bodies[i]->SetForce(float2(0.0f, 0.0f));
-		scene.m_bodies[i]->SetTorque(0.0f);
+		// the derivative of the current state
+		const float2 acceleration = gravity + _bodies.GetForce(i) * _bodies.m_invMass[i];
+		const float angularAcc = _bodies.m_torque[i] * _bodies.m_invInertia[i];
+
+		const float2 deltaVelocity = acceleration * _deltaTime;
+		const float2 deltaPosition = _bodies.GetVelocity(i) * _deltaTime;
+		const float deltaAngularVelocity = angularAcc * _deltaTime;
+		const float deltaOrientation = _bodies.m_angularVelocity[i] * _deltaTime;
+
+		// summed up in the order of the formula, so that the result is
+		// rounded like 'k1 + 2 * k2 + 2 * k3 + k4' is
+		if (_stage == 0)
+		{
+			m_sum.positionX[i] = deltaPosition.x;
+			m_sum.positionY[i] = deltaPosition.y;
+			m_sum.velocityX[i] = deltaVelocity.x;
+			m_sum.velocityY[i] = deltaVelocity.y;
+			m_sum.orientation[i] = deltaOrientation;
+			m_sum.angularVelocity[i] = deltaAngularVelocity;
+		}
+		else
+		{
+			m_sum.positionX[i] = m_sum.positionX[i] + weight * deltaPosition.x;
+			m_sum.positionY[i] = m_sum.positionY[i] + weight * deltaPosition.y;
+			m_sum.velocityX[i] = m_sum.velocityX[i] + weight * deltaVelocity.x;
+			m_sum.velocityY[i] = m_sum.velocityY[i] + weight * deltaVelocity.y;
+			m_sum.orientation[i] = m_sum.orientation[i] + weight * deltaOrientation;
+			m_sum.angularVelocity[i] = m_sum.angularVelocity[i] + weight * deltaAngularVelocity;
+		}
+
+		const float2 startPosition(m_start.positionX[i], m_start.positionY[i]);
+		const float2 startVelocity(m_start.velocityX[i], m_start.velocityY[i]);
+		if (_stage < 3)
+		{
+			_bodies.SetVelocity(i, startVelocity + deltaVelocity * scale);
+			_bodies.SetPosition(i, startPosition + deltaPosition * scale);
+			_bodies.m_angularVelocity[i] = m_start.angularVelocity[i] + deltaAngularVelocity * scale;
+			_bodies.SetOrientation(i, m_start.orientation[i] + deltaOrientation * scale);
+		}
+		else
+		{
+			// final integration
+			_bodies.SetPosition(i, startPosition + float2(m_sum.positionX[i], m_sum.positionY[i]) / 6.0f);
+			_bodies.SetVelocity(i, startVelocity + float2(m_sum.velocityX[i], m_sum.velocityY[i]) / 6.0f);
+			_bodies.SetOrientation(i, m_start.orientation[i] + m_sum.orientation[i] / 6.0f);
+			_bodies.m_angularVelocity[i] = m_start.angularVelocity[i] + m_sum.angularVelocity[i] / 6.0f;
+		}
+
+		_bodies.SetForce(i, float2(0.0f, 0.0f));
+		_bodies.m_torque[i] = 0.0f;
 	}
+}
 
-	scene.m_deltaTime = scene.m_deltaTime;
-	scene.Solve();
+void RungeKuttaFourthIntegrator::BeginStep(BodyStore& _bodies, JobSystem* _jobs)
+{
+	const size_t count = _bodies.Size();
+	m_start.Resize(count);
+	m_sum.Resize(count);
+	m_isActive.resize(count);
 
-	for (size_t i = 0; i < scene.m_bodies.size(); ++i)
+	// this stores the absolute value of position and velocity
+	ParallelFor(_jobs, count, [&](size_t _begin, size_t _end, size_t)
 	{
-		if (scene.m_bodies[i]->GetInvMass() == 0.0f)
-			continue;
-
-		const float2 acceleration = gravity + scene.m_bodies[i]->GetForce() * scene.m_bodies[i]->GetInvMass();
-		const float angularAcc = scene.m_bodies[i]->GetTorque() * scene.m_bodies[i]->GetInvInertia();
-
-		deltaK4State[i].velocity = acceleration * scene.m_deltaTime;
-		deltaK4State[i].position = scene.m_bodies[i]->GetVelocity() * scene.m_deltaTime;
-		deltaK4State[i].angularVelocity = angularAcc * scene.m_deltaTime;
-		deltaK4State[i].orientation = scene.m_bodies[i]->GetAngularVelocity() * scene.m_deltaTime;
-	}
+		for (uint32_t i = static_cast<uint32_t>(_begin); i < _end; ++i)
+		{
+			m_isActive[i] = _bodies.IsActive(i) ? 1u : 0u;
+			if (m_isActive[i] == 0u)
+				continue;
+
+			m_start.positionX[i] = _bodies.m_positionX[i];
+			m_start.positionY[i] = _bodies.m_positionY[i];
+			m_start.velocityX[i] = _bodies.m_velocityX[i];
+			m_start.velocityY[i] = _bodies.m_velocityY[i];
+			m_start.orientation[i] = _bodies.m_orientation[i];
+			m_start.angularVelocity[i] = _bodies.m_angularVelocity[i];
+		}
+	}, k_bodyGrain);
+}
 
-	// final integration
-	for (size_t i = 0; i < scene.m_bodies.size(); ++i)
+void RungeKuttaFourthIntegrator::RunStage(BodyStore& _bodies, JobSystem* _jobs, float _deltaTime, int _stage)
+{
+	ParallelFor(_jobs, _bodies.Size(), [&](size_t _begin, size_t _end, size_t)
 	{
-		if (scene.m_bodies[i]->GetInvMass() == 0.0f)
-			continue;
-
-		float2 deltaPos =
-			(deltaK1State[i].position + 2.0f * deltaK2State[i].position +
-				2.0f * deltaK3State[i].position + deltaK4State[i].position) / 6.0f;
-		scene.m_bodies[i]->SetPosition(currentState[i].position + deltaPos);
-
-		float2 deltaVel =
-			(deltaK1State[i].velocity + 2.0f * deltaK2State[i].velocity +
-				2.0f * deltaK3State[i].velocity + deltaK4State[i].velocity) / 6.0f;
-		scene.m_bodies[i]->SetVelocity(currentState[i].velocity + deltaVel);
-
-		float deltaOri =
-			(deltaK1State[i].orientation + 2.0f * deltaK2State[i].orientation +
-				2.0f * deltaK3State[i].orientation + deltaK4State[i].orientation) / 6.0f;
-		scene.m_bodies[i]->SetOrientation(currentState[i].orientation + deltaOri);
-
-		float deltaAngVel =
-			(deltaK1State[i].angularVelocity + 2.0f * deltaK2State[i].angularVelocity +
-				2.0f * deltaK3State[i].angularVelocity + deltaK4State[i].angularVelocity) / 6.0f;
-		scene.m_bodies[i]->SetAngularVelocity(currentState[i].angularVelocity + deltaAngVel);
-
-		scene.m_bodies[i]->SetForce(float2(0, 0));
-		scene.m_bodies[i]->SetTorque(0.0f);
-	}
+		RunStage(_bodies, _begin, _end, _deltaTime, _stage);
+	}, k_bodyGrain);
 }
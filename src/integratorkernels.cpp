@@ -0,0 +1,475 @@
+#include "integratorkernels.hpp"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RIGIDBODY2D_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+void IntegratorKernels::ExplicitEuler(BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, float2 _gravity)
+{
+    // from 2009 Erin Catto http://www.gphysics.com
+    /*
+	state2->x = state1->x + h * state1->v;
+	state2->v = state1->v - h * gravity;
+    */
+    const float dt = _deltaTime;
+    for(uint32_t i = _begin; i < _end; ++i)
+    {
+        if(_bodies.IsActive(i) == false)
+            continue;
+
+        // Linear
+        _bodies.m_positionX[i] += dt * _bodies.m_velocityX[i];
+        _bodies.m_positionY[i] += dt * _bodies.m_velocityY[i];
+        // delta_v = delta_time * a = delta_time * F / m;
+        _bodies.m_velocityX[i] += dt * (_bodies.m_forceX[i] / _bodies.m_mass[i]);
+        _bodies.m_velocityY[i] += dt * (_bodies.m_forceY[i] / _bodies.m_mass[i]);
+        // add gravity
+        _bodies.m_velocityX[i] += dt * _gravity.x;
+        _bodies.m_velocityY[i] += dt * _gravity.y;
+
+        // Rotation
+        _bodies.m_orientation[i] += _bodies.m_angularVelocity[i] * dt;
+        _bodies.m_angularVelocity[i] += dt * (_bodies.m_torque[i] * _bodies.m_invInertia[i]);
+
+        _bodies.m_forceX[i] = 0.0f;
+        _bodies.m_forceY[i] = 0.0f;
+        _bodies.m_torque[i] = 0.0f;
+        _bodies.m_transformDirty[i] = 1u;
+    }
+}
+
+void IntegratorKernels::SymplecticEuler(BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, float2 _gravity)
+{
+    // from 2009 Erin Catto http://www.gphysics.com
+    /*
+	state2->v = state1->v - h * gravity;
+	state2->x = state1->x + h * state2->v;
+    */
+    const float dt = _deltaTime;
+    for(uint32_t i = _begin; i < _end; ++i)
+    {
+        if(_bodies.IsActive(i) == false)
+            continue;
+
+        _bodies.m_velocityX[i] += dt * (_bodies.m_forceX[i] / _bodies.m_mass[i]);
+        _bodies.m_velocityY[i] += dt * (_bodies.m_forceY[i] / _bodies.m_mass[i]);
+        _bodies.m_velocityX[i] += dt * _gravity.x;
+        _bodies.m_velocityY[i] += dt * _gravity.y;
+
+        _bodies.m_positionX[i] += dt * _bodies.m_velocityX[i];
+        _bodies.m_positionY[i] += dt * _bodies.m_velocityY[i];
+
+        // Rotation
+        _bodies.m_angularVelocity[i] += dt * (_bodies.m_torque[i] * _bodies.m_invInertia[i]);
+        _bodies.m_orientation[i] += _bodies.m_angularVelocity[i] * dt;
+
+        _bodies.m_forceX[i] = 0.0f;
+        _bodies.m_forceY[i] = 0.0f;
+        _bodies.m_torque[i] = 0.0f;
+        _bodies.m_transformDirty[i] = 1u;
+    }
+}
+
+void IntegratorKernels::Newton(BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, float2 _gravity)
+{
+    // from 2009 Erin Catto http://www.gphysics.com
+    /*
+	state2->x = state1->x + h * state1->v - 0.5f * h * h * gravity;
+	state2->v = state1->v - h * gravity;
+    */
+    const float dt = _deltaTime;
+    const float2 gravityOffset = 0.5f * dt * dt * _gravity;
+    for(uint32_t i = _begin; i < _end; ++i)
+    {
+        if(_bodies.IsActive(i) == false)
+            continue;
+
+        // Linear
+        _bodies.m_positionX[i] += dt * _bodies.m_velocityX[i] + gravityOffset.x;
+        _bodies.m_positionY[i] += dt * _bodies.m_velocityY[i] + gravityOffset.y;
+        // delta_v = delta_time * a = delta_time * F / m;
+        _bodies.m_velocityX[i] += dt * (_bodies.m_forceX[i] * _bodies.m_invMass[i]);
+        _bodies.m_velocityY[i] += dt * (_bodies.m_forceY[i] * _bodies.m_invMass[i]);
+        // add gravity
+        _bodies.m_velocityX[i] += dt * _gravity.x;
+        _bodies.m_velocityY[i] += dt * _gravity.y;
+
+        // Rotation
+        _bodies.m_orientation[i] += _bodies.m_angularVelocity[i] * dt;
+        _bodies.m_angularVelocity[i] += dt * (_bodies.m_torque[i] * _bodies.m_invInertia[i]);
+
+        _bodies.m_forceX[i] = 0.0f;
+        _bodies.m_forceY[i] = 0.0f;
+        _bodies.m_torque[i] = 0.0f;
+        _bodies.m_transformDirty[i] = 1u;
+    }
+}
+
+#ifdef RIGIDBODY2D_X86_SIMD
+
+// The vector kernels below repeat the scalar ones lane by lane. Inactive
+// lanes still compute (a static body divides by a mass of 0), the results
+// are thrown away by the mask before anything is stored. No fused multiply
+// add is used, so every lane rounds exactly like the scalar code does.
+namespace
+{
+#define RIGIDBODY2D_SSE __attribute__((target("sse2")))
+#define RIGIDBODY2D_AVX2 __attribute__((target("avx2")))
+
+    // ---- SSE, 4 bodies ----
+
+    RIGIDBODY2D_SSE inline __m128 ActiveMask4(const BodyStore& _bodies, uint32_t _i)
+    {
+        const __m128i island = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_bodies.m_sleepingIsland[_i]));
+        const __m128 isAwake = _mm_castsi128_ps(
+            _mm_cmpeq_epi32(island, _mm_set1_epi32(static_cast<int>(BodyStore::k_awake))));
+        // like '!=', true for NaN
+        const __m128 isDynamic = _mm_cmpneq_ps(_mm_loadu_ps(&_bodies.m_invMass[_i]), _mm_setzero_ps());
+        return _mm_and_ps(isAwake, isDynamic);
+    }
+
+    // '_value' in the active lanes, what '_to' held before in the others
+    RIGIDBODY2D_SSE inline void Store4(float* _to, __m128 _value, __m128 _mask)
+    {
+        const __m128 old = _mm_loadu_ps(_to);
+        _mm_storeu_ps(_to, _mm_or_ps(_mm_and_ps(_mask, _value), _mm_andnot_ps(_mask, old)));
+    }
+
+    // the scalar kernel sets the dirty flag and clears the forces of the
+    // active bodies
+    RIGIDBODY2D_SSE inline void Finish4(BodyStore& _bodies, uint32_t _i, __m128 _mask, int _bits)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        Store4(&_bodies.m_forceX[_i], zero, _mask);
+        Store4(&_bodies.m_forceY[_i], zero, _mask);
+        Store4(&_bodies.m_torque[_i], zero, _mask);
+        for(uint32_t k = 0; k < 4u; ++k)
+        {
+            if(_bits & (1 << k))
+                _bodies.m_transformDirty[_i + k] = 1u;
+        }
+    }
+
+    RIGIDBODY2D_SSE void ExplicitEulerSSE(
+        BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, linalg::aliases::float2 _gravity)
+    {
+        const __m128 dt = _mm_set1_ps(_deltaTime);
+        const __m128 gravityX = _mm_set1_ps(_gravity.x);
+        const __m128 gravityY = _mm_set1_ps(_gravity.y);
+
+        uint32_t i = _begin;
+        for(; i + 4u <= _end; i += 4u)
+        {
+            const __m128 mask = ActiveMask4(_bodies, i);
+            const int bits = _mm_movemask_ps(mask);
+            if(bits == 0)
+                continue;
+
+            const __m128 px = _mm_loadu_ps(&_bodies.m_positionX[i]);
+            const __m128 py = _mm_loadu_ps(&_bodies.m_positionY[i]);
+            __m128 vx = _mm_loadu_ps(&_bodies.m_velocityX[i]);
+            __m128 vy = _mm_loadu_ps(&_bodies.m_velocityY[i]);
+            const __m128 mass = _mm_loadu_ps(&_bodies.m_mass[i]);
+            const __m128 orientation = _mm_loadu_ps(&_bodies.m_orientation[i]);
+            const __m128 angularVelocity = _mm_loadu_ps(&_bodies.m_angularVelocity[i]);
+
+            Store4(&_bodies.m_positionX[i], _mm_add_ps(px, _mm_mul_ps(dt, vx)), mask);
+            Store4(&_bodies.m_positionY[i], _mm_add_ps(py, _mm_mul_ps(dt, vy)), mask);
+            vx = _mm_add_ps(vx, _mm_mul_ps(dt, _mm_div_ps(_mm_loadu_ps(&_bodies.m_forceX[i]), mass)));
+            vy = _mm_add_ps(vy, _mm_mul_ps(dt, _mm_div_ps(_mm_loadu_ps(&_bodies.m_forceY[i]), mass)));
+            vx = _mm_add_ps(vx, _mm_mul_ps(dt, gravityX));
+            vy = _mm_add_ps(vy, _mm_mul_ps(dt, gravityY));
+            Store4(&_bodies.m_velocityX[i], vx, mask);
+            Store4(&_bodies.m_velocityY[i], vy, mask);
+
+            Store4(&_bodies.m_orientation[i], _mm_add_ps(orientation, _mm_mul_ps(angularVelocity, dt)), mask);
+            const __m128 angularAcc = _mm_mul_ps(_mm_loadu_ps(&_bodies.m_torque[i]), _mm_loadu_ps(&_bodies.m_invInertia[i]));
+            Store4(&_bodies.m_angularVelocity[i], _mm_add_ps(angularVelocity, _mm_mul_ps(dt, angularAcc)), mask);
+
+            Finish4(_bodies, i, mask, bits);
+        }
+        IntegratorKernels::ExplicitEuler(_bodies, i, _end, _deltaTime, _gravity);
+    }
+
+    RIGIDBODY2D_SSE void SymplecticEulerSSE(
+        BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, linalg::aliases::float2 _gravity)
+    {
+        const __m128 dt = _mm_set1_ps(_deltaTime);
+        const __m128 gravityX = _mm_set1_ps(_gravity.x);
+        const __m128 gravityY = _mm_set1_ps(_gravity.y);
+
+        uint32_t i = _begin;
+        for(; i + 4u <= _end; i += 4u)
+        {
+            const __m128 mask = ActiveMask4(_bodies, i);
+            const int bits = _mm_movemask_ps(mask);
+            if(bits == 0)
+                continue;
+
+            const __m128 mass = _mm_loadu_ps(&_bodies.m_mass[i]);
+            __m128 vx = _mm_loadu_ps(&_bodies.m_velocityX[i]);
+            __m128 vy = _mm_loadu_ps(&_bodies.m_velocityY[i]);
+            vx = _mm_add_ps(vx, _mm_mul_ps(dt, _mm_div_ps(_mm_loadu_ps(&_bodies.m_forceX[i]), mass)));
+            vy = _mm_add_ps(vy, _mm_mul_ps(dt, _mm_div_ps(_mm_loadu_ps(&_bodies.m_forceY[i]), mass)));
+            vx = _mm_add_ps(vx, _mm_mul_ps(dt, gravityX));
+            vy = _mm_add_ps(vy, _mm_mul_ps(dt, gravityY));
+            Store4(&_bodies.m_velocityX[i], vx, mask);
+            Store4(&_bodies.m_velocityY[i], vy, mask);
+
+            Store4(&_bodies.m_positionX[i], _mm_add_ps(_mm_loadu_ps(&_bodies.m_positionX[i]), _mm_mul_ps(dt, vx)), mask);
+            Store4(&_bodies.m_positionY[i], _mm_add_ps(_mm_loadu_ps(&_bodies.m_positionY[i]), _mm_mul_ps(dt, vy)), mask);
+
+            const __m128 angularAcc = _mm_mul_ps(_mm_loadu_ps(&_bodies.m_torque[i]), _mm_loadu_ps(&_bodies.m_invInertia[i]));
+            const __m128 angularVelocity = _mm_add_ps(_mm_loadu_ps(&_bodies.m_angularVelocity[i]), _mm_mul_ps(dt, angularAcc));
+            Store4(&_bodies.m_angularVelocity[i], angularVelocity, mask);
+            Store4(&_bodies.m_orientation[i], _mm_add_ps(_mm_loadu_ps(&_bodies.m_orientation[i]), _mm_mul_ps(angularVelocity, dt)), mask);
+
+            Finish4(_bodies, i, mask, bits);
+        }
+        IntegratorKernels::SymplecticEuler(_bodies, i, _end, _deltaTime, _gravity);
+    }
+
+    RIGIDBODY2D_SSE void NewtonSSE(
+        BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, linalg::aliases::float2 _gravity)
+    {
+        const linalg::aliases::float2 gravityOffset = 0.5f * _deltaTime * _deltaTime * _gravity;
+        const __m128 dt = _mm_set1_ps(_deltaTime);
+        const __m128 gravityX = _mm_set1_ps(_gravity.x);
+        const __m128 gravityY = _mm_set1_ps(_gravity.y);
+        const __m128 offsetX = _mm_set1_ps(gravityOffset.x);
+        const __m128 offsetY = _mm_set1_ps(gravityOffset.y);
+
+        uint32_t i = _begin;
+        for(; i + 4u <= _end; i += 4u)
+        {
+            const __m128 mask = ActiveMask4(_bodies, i);
+            const int bits = _mm_movemask_ps(mask);
+            if(bits == 0)
+                continue;
+
+            const __m128 invMass = _mm_loadu_ps(&_bodies.m_invMass[i]);
+            __m128 vx = _mm_loadu_ps(&_bodies.m_velocityX[i]);
+            __m128 vy = _mm_loadu_ps(&_bodies.m_velocityY[i]);
+            const __m128 orientation = _mm_loadu_ps(&_bodies.m_orientation[i]);
+            const __m128 angularVelocity = _mm_loadu_ps(&_bodies.m_angularVelocity[i]);
+
+            Store4(&_bodies.m_positionX[i], _mm_add_ps(_mm_loadu_ps(&_bodies.m_positionX[i]), _mm_add_ps(_mm_mul_ps(dt, vx), offsetX)), mask);
+            Store4(&_bodies.m_positionY[i], _mm_add_ps(_mm_loadu_ps(&_bodies.m_positionY[i]), _mm_add_ps(_mm_mul_ps(dt, vy), offsetY)), mask);
+            vx = _mm_add_ps(vx, _mm_mul_ps(dt, _mm_mul_ps(_mm_loadu_ps(&_bodies.m_forceX[i]), invMass)));
+            vy = _mm_add_ps(vy, _mm_mul_ps(dt, _mm_mul_ps(_mm_loadu_ps(&_bodies.m_forceY[i]), invMass)));
+            vx = _mm_add_ps(vx, _mm_mul_ps(dt, gravityX));
+            vy = _mm_add_ps(vy, _mm_mul_ps(dt, gravityY));
+            Store4(&_bodies.m_velocityX[i], vx, mask);
+            Store4(&_bodies.m_velocityY[i], vy, mask);
+
+            Store4(&_bodies.m_orientation[i], _mm_add_ps(orientation, _mm_mul_ps(angularVelocity, dt)), mask);
+            const __m128 angularAcc = _mm_mul_ps(_mm_loadu_ps(&_bodies.m_torque[i]), _mm_loadu_ps(&_bodies.m_invInertia[i]));
+            Store4(&_bodies.m_angularVelocity[i], _mm_add_ps(angularVelocity, _mm_mul_ps(dt, angularAcc)), mask);
+
+            Finish4(_bodies, i, mask, bits);
+        }
+        IntegratorKernels::Newton(_bodies, i, _end, _deltaTime, _gravity);
+    }
+
+    // ---- AVX2, 8 bodies ----
+
+    RIGIDBODY2D_AVX2 inline __m256 ActiveMask8(const BodyStore& _bodies, uint32_t _i)
+    {
+        const __m256i island = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&_bodies.m_sleepingIsland[_i]));
+        const __m256 isAwake = _mm256_castsi256_ps(
+            _mm256_cmpeq_epi32(island, _mm256_set1_epi32(static_cast<int>(BodyStore::k_awake))));
+        // like '!=', true for NaN
+        const __m256 isDynamic = _mm256_cmp_ps(_mm256_loadu_ps(&_bodies.m_invMass[_i]), _mm256_setzero_ps(), _CMP_NEQ_UQ);
+        return _mm256_and_ps(isAwake, isDynamic);
+    }
+
+    RIGIDBODY2D_AVX2 inline void Store8(float* _to, __m256 _value, __m256 _mask)
+    {
+        _mm256_storeu_ps(_to, _mm256_blendv_ps(_mm256_loadu_ps(_to), _value, _mask));
+    }
+
+    RIGIDBODY2D_AVX2 inline void Finish8(BodyStore& _bodies, uint32_t _i, __m256 _mask, int _bits)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        Store8(&_bodies.m_forceX[_i], zero, _mask);
+        Store8(&_bodies.m_forceY[_i], zero, _mask);
+        Store8(&_bodies.m_torque[_i], zero, _mask);
+        for(uint32_t k = 0; k < 8u; ++k)
+        {
+            if(_bits & (1 << k))
+                _bodies.m_transformDirty[_i + k] = 1u;
+        }
+    }
+
+    RIGIDBODY2D_AVX2 void ExplicitEulerAVX2(
+        BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, linalg::aliases::float2 _gravity)
+    {
+        const __m256 dt = _mm256_set1_ps(_deltaTime);
+        const __m256 gravityX = _mm256_set1_ps(_gravity.x);
+        const __m256 gravityY = _mm256_set1_ps(_gravity.y);
+
+        uint32_t i = _begin;
+        for(; i + 8u <= _end; i += 8u)
+        {
+            const __m256 mask = ActiveMask8(_bodies, i);
+            const int bits = _mm256_movemask_ps(mask);
+            if(bits == 0)
+                continue;
+
+            const __m256 px = _mm256_loadu_ps(&_bodies.m_positionX[i]);
+            const __m256 py = _mm256_loadu_ps(&_bodies.m_positionY[i]);
+            __m256 vx = _mm256_loadu_ps(&_bodies.m_velocityX[i]);
+            __m256 vy = _mm256_loadu_ps(&_bodies.m_velocityY[i]);
+            const __m256 mass = _mm256_loadu_ps(&_bodies.m_mass[i]);
+            const __m256 orientation = _mm256_loadu_ps(&_bodies.m_orientation[i]);
+            const __m256 angularVelocity = _mm256_loadu_ps(&_bodies.m_angularVelocity[i]);
+
+            Store8(&_bodies.m_positionX[i], _mm256_add_ps(px, _mm256_mul_ps(dt, vx)), mask);
+            Store8(&_bodies.m_positionY[i], _mm256_add_ps(py, _mm256_mul_ps(dt, vy)), mask);
+            vx = _mm256_add_ps(vx, _mm256_mul_ps(dt, _mm256_div_ps(_mm256_loadu_ps(&_bodies.m_forceX[i]), mass)));
+            vy = _mm256_add_ps(vy, _mm256_mul_ps(dt, _mm256_div_ps(_mm256_loadu_ps(&_bodies.m_forceY[i]), mass)));
+            vx = _mm256_add_ps(vx, _mm256_mul_ps(dt, gravityX));
+            vy = _mm256_add_ps(vy, _mm256_mul_ps(dt, gravityY));
+            Store8(&_bodies.m_velocityX[i], vx, mask);
+            Store8(&_bodies.m_velocityY[i], vy, mask);
+
+            Store8(&_bodies.m_orientation[i], _mm256_add_ps(orientation, _mm256_mul_ps(angularVelocity, dt)), mask);
+            const __m256 angularAcc = _mm256_mul_ps(_mm256_loadu_ps(&_bodies.m_torque[i]), _mm256_loadu_ps(&_bodies.m_invInertia[i]));
+            Store8(&_bodies.m_angularVelocity[i], _mm256_add_ps(angularVelocity, _mm256_mul_ps(dt, angularAcc)), mask);
+
+            Finish8(_bodies, i, mask, bits);
+        }
+        IntegratorKernels::ExplicitEuler(_bodies, i, _end, _deltaTime, _gravity);
+    }
+
+    RIGIDBODY2D_AVX2 void SymplecticEulerAVX2(
+        BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, linalg::aliases::float2 _gravity)
+    {
+        const __m256 dt = _mm256_set1_ps(_deltaTime);
+        const __m256 gravityX = _mm256_set1_ps(_gravity.x);
+        const __m256 gravityY = _mm256_set1_ps(_gravity.y);
+
+        uint32_t i = _begin;
+        for(; i + 8u <= _end; i += 8u)
+        {
+            const __m256 mask = ActiveMask8(_bodies, i);
+            const int bits = _mm256_movemask_ps(mask);
+            if(bits == 0)
+                continue;
+
+            const __m256 mass = _mm256_loadu_ps(&_bodies.m_mass[i]);
+            __m256 vx = _mm256_loadu_ps(&_bodies.m_velocityX[i]);
+            __m256 vy = _mm256_loadu_ps(&_bodies.m_velocityY[i]);
+            vx = _mm256_add_ps(vx, _mm256_mul_ps(dt, _mm256_div_ps(_mm256_loadu_ps(&_bodies.m_forceX[i]), mass)));
+            vy = _mm256_add_ps(vy, _mm256_mul_ps(dt, _mm256_div_ps(_mm256_loadu_ps(&_bodies.m_forceY[i]), mass)));
+            vx = _mm256_add_ps(vx, _mm256_mul_ps(dt, gravityX));
+            vy = _mm256_add_ps(vy, _mm256_mul_ps(dt, gravityY));
+            Store8(&_bodies.m_velocityX[i], vx, mask);
+            Store8(&_bodies.m_velocityY[i], vy, mask);
+
+            Store8(&_bodies.m_positionX[i], _mm256_add_ps(_mm256_loadu_ps(&_bodies.m_positionX[i]), _mm256_mul_ps(dt, vx)), mask);
+            Store8(&_bodies.m_positionY[i], _mm256_add_ps(_mm256_loadu_ps(&_bodies.m_positionY[i]), _mm256_mul_ps(dt, vy)), mask);
+
+            const __m256 angularAcc = _mm256_mul_ps(_mm256_loadu_ps(&_bodies.m_torque[i]), _mm256_loadu_ps(&_bodies.m_invInertia[i]));
+            const __m256 angularVelocity = _mm256_add_ps(_mm256_loadu_ps(&_bodies.m_angularVelocity[i]), _mm256_mul_ps(dt, angularAcc));
+            Store8(&_bodies.m_angularVelocity[i], angularVelocity, mask);
+            Store8(&_bodies.m_orientation[i], _mm256_add_ps(_mm256_loadu_ps(&_bodies.m_orientation[i]), _mm256_mul_ps(angularVelocity, dt)), mask);
+
+            Finish8(_bodies, i, mask, bits);
+        }
+        IntegratorKernels::SymplecticEuler(_bodies, i, _end, _deltaTime, _gravity);
+    }
+
+    RIGIDBODY2D_AVX2 void NewtonAVX2(
+        BodyStore& _bodies, uint32_t _begin, uint32_t _end, float _deltaTime, linalg::aliases::float2 _gravity)
+    {
+        const linalg::aliases::float2 gravityOffset = 0.5f * _deltaTime * _deltaTime * _gravity;
+        const __m256 dt = _mm256_set1_ps(_deltaTime);
+        const __m256 gravityX = _mm256_set1_ps(_gravity.x);
+        const __m256 gravityY = _mm256_set1_ps(_gravity.y);
+        const __m256 offsetX = _mm256_set1_ps(gravityOffset.x);
+        const __m256 offsetY = _mm256_set1_ps(gravityOffset.y);
+
+        uint32_t i = _begin;
+        for(; i + 8u <= _end; i += 8u)
+        {
+            const __m256 mask = ActiveMask8(_bodies, i);
+            const int bits = _mm256_movemask_ps(mask);
+            if(bits == 0)
+                continue;
+
+            const __m256 invMass = _mm256_loadu_ps(&_bodies.m_invMass[i]);
+            __m256 vx = _mm256_loadu_ps(&_bodies.m_velocityX[i]);
+            __m256 vy = _mm256_loadu_ps(&_bodies.m_velocityY[i]);
+            const __m256 orientation = _mm256_loadu_ps(&_bodies.m_orientation[i]);
+            const __m256 angularVelocity = _mm256_loadu_ps(&_bodies.m_angularVelocity[i]);
+
+            Store8(&_bodies.m_positionX[i], _mm256_add_ps(_mm256_loadu_ps(&_bodies.m_positionX[i]), _mm256_add_ps(_mm256_mul_ps(dt, vx), offsetX)), mask);
+            Store8(&_bodies.m_positionY[i], _mm256_add_ps(_mm256_loadu_ps(&_bodies.m_positionY[i]), _mm256_add_ps(_mm256_mul_ps(dt, vy), offsetY)), mask);
+            vx = _mm256_add_ps(vx, _mm256_mul_ps(dt, _mm256_mul_ps(_mm256_loadu_ps(&_bodies.m_forceX[i]), invMass)));
+            vy = _mm256_add_ps(vy, _mm256_mul_ps(dt, _mm256_mul_ps(_mm256_loadu_ps(&_bodies.m_forceY[i]), invMass)));
+            vx = _mm256_add_ps(vx, _mm256_mul_ps(dt, gravityX));
+            vy = _mm256_add_ps(vy, _mm256_mul_ps(dt, gravityY));
+            Store8(&_bodies.m_velocityX[i], vx, mask);
+            Store8(&_bodies.m_velocityY[i], vy, mask);
+
+            Store8(&_bodies.m_orientation[i], _mm256_add_ps(orientation, _mm256_mul_ps(angularVelocity, dt)), mask);
+            const __m256 angularAcc = _mm256_mul_ps(_mm256_loadu_ps(&_bodies.m_torque[i]), _mm256_loadu_ps(&_bodies.m_invInertia[i]));
+            Store8(&_bodies.m_angularVelocity[i], _mm256_add_ps(angularVelocity, _mm256_mul_ps(dt, angularAcc)), mask);
+
+            Finish8(_bodies, i, mask, bits);
+        }
+        IntegratorKernels::Newton(_bodies, i, _end, _deltaTime, _gravity);
+    }
+
+#undef RIGIDBODY2D_SSE
+#undef RIGIDBODY2D_AVX2
+}
+
+#endif
+
+SimdLevel IntegratorKernels::GetSupportedLevel()
+{
+#ifdef RIGIDBODY2D_X86_SIMD
+    // checked once, this also makes sure the os saves the avx registers
+    static const SimdLevel level =
+        __builtin_cpu_supports("avx2") ? SimdLevel::AVX2 :
+        __builtin_cpu_supports("sse2") ? SimdLevel::SSE : SimdLevel::Scalar;
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const char* IntegratorKernels::GetName(SimdLevel _level)
+{
+    switch(_level)
+    {
+    case SimdLevel::SSE: return "sse";
+    case SimdLevel::AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+IntegratorKernels::Kernel IntegratorKernels::Get(Method _method, SimdLevel _level)
+{
+    _level = std::min(_level, GetSupportedLevel());
+
+    // indexed by [method][level]
+    static const Kernel kernels[3][3] =
+    {
+#ifdef RIGIDBODY2D_X86_SIMD
+        { &IntegratorKernels::ExplicitEuler, &ExplicitEulerSSE, &ExplicitEulerAVX2 },
+        { &IntegratorKernels::SymplecticEuler, &SymplecticEulerSSE, &SymplecticEulerAVX2 },
+        { &IntegratorKernels::Newton, &NewtonSSE, &NewtonAVX2 },
+#else
+        { &IntegratorKernels::ExplicitEuler, nullptr, nullptr },
+        { &IntegratorKernels::SymplecticEuler, nullptr, nullptr },
+        { &IntegratorKernels::Newton, nullptr, nullptr },
+#endif
+    };
+    return kernels[static_cast<size_t>(_method)][static_cast<size_t>(_level)];
+}
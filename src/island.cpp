@@ -0,0 +1,177 @@
+#include "island.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+uint32_t IslandManager::Find(uint32_t _body)
+{
+    // path halving
+    while(m_parent[_body] != _body)
+    {
+        m_parent[_body] = m_parent[m_parent[_body]];
+        _body = m_parent[_body];
+    }
+    return _body;
+}
+
+void IslandManager::Union(uint32_t _a, uint32_t _b)
+{
+    const uint32_t rootA = Find(_a);
+    const uint32_t rootB = Find(_b);
+    // the lower index becomes the root, so islands do not depend on the
+    // order of the links
+    if(rootA < rootB)
+        m_parent[rootB] = rootA;
+    else if(rootB < rootA)
+        m_parent[rootA] = rootB;
+}
+
+bool IslandManager::WakeRequested(BodyStore& _bodies)
+{
+    if(_bodies.m_wokenIslands.empty())
+        return false;
+
+    const size_t sleeping = m_sleepingBodyCount;
+    for(uint32_t island : _bodies.m_wokenIslands)
+        WakeIsland(_bodies, island);
+    _bodies.m_wokenIslands.clear();
+    return m_sleepingBodyCount != sleeping;
+}
+
+void IslandManager::WakeIsland(BodyStore& _bodies, uint32_t _island)
+{
+    // an island can be asked to wake up more than once
+    if(_island >= m_islands.size() || m_islands[_island].empty())
+        return;
+
+    std::vector<BodyHandle>& island = m_islands[_island];
+    for(BodyHandle handle : island)
+    {
+        if(_bodies.IsValid(handle) == false)
+            continue;
+
+        const uint32_t index = _bodies.GetIndex(handle);
+        _bodies.m_sleepingIsland[index] = BodyStore::k_awake;
+        _bodies.m_sleepTime[index] = 0.0f;
+    }
+
+    m_sleepingBodyCount -= island.size();
+    island.clear();
+    m_freeIslands.push_back(_island);
+}
+
+void IslandManager::WakeAll(BodyStore& _bodies)
+{
+    for(uint32_t island = 0; island < m_islands.size(); ++island)
+        WakeIsland(_bodies, island);
+    _bodies.m_wokenIslands.clear();
+}
+
+void IslandManager::Restore(const BodyStore& _bodies)
+{
+    m_islands.clear();
+    m_freeIslands.clear();
+    m_sleepingBodyCount = 0u;
+
+    for(uint32_t i = 0; i < _bodies.Size(); ++i)
+    {
+        const uint32_t island = _bodies.m_sleepingIsland[i];
+        if(island == BodyStore::k_awake)
+            continue;
+
+        if(island >= m_islands.size())
+            m_islands.resize(island + 1u);
+        m_islands[island].push_back(_bodies.GetHandle(i));
+        ++m_sleepingBodyCount;
+    }
+
+    for(uint32_t island = 0; island < m_islands.size(); ++island)
+    {
+        if(m_islands[island].empty())
+            m_freeIslands.push_back(island);
+    }
+}
+
+void IslandManager::Update(
+    BodyStore& _bodies, const std::vector<BodyPair>& _links,
+    float _deltaTime, const SleepSettings& _settings)
+{
+    // setters called since the start of the step (by joints for example),
+    // handled now so that no request can refer to an island made below
+    WakeRequested(_bodies);
+
+    const uint32_t count = static_cast<uint32_t>(_bodies.Size());
+    m_parent.resize(count);
+    std::iota(m_parent.begin(), m_parent.end(), 0u);
+
+    for(const BodyPair& link : _links)
+    {
+        const uint32_t a = link.first;
+        const uint32_t b = link.second;
+        if(_bodies.m_invMass[a] == 0.0f || _bodies.m_invMass[b] == 0.0f)
+            continue;
+
+        Union(a, b);
+
+        // an awake body wakes up the whole island it is linked to
+        if(_bodies.IsAwake(a) != _bodies.IsAwake(b))
+            WakeIsland(_bodies, _bodies.m_sleepingIsland[_bodies.IsAwake(a) ? b : a]);
+    }
+
+    const float linearToleranceSqr = _settings.linearTolerance * _settings.linearTolerance;
+    m_minSleepTime.assign(count, FLT_MAX);
+    m_islandOfRoot.assign(count, BodyStore::k_awake);
+
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        if(_bodies.IsActive(i) == false)
+            continue;
+
+        const float speedSqr =
+            _bodies.m_velocityX[i] * _bodies.m_velocityX[i] +
+            _bodies.m_velocityY[i] * _bodies.m_velocityY[i];
+        if(speedSqr > linearToleranceSqr || std::abs(_bodies.m_angularVelocity[i]) > _settings.angularTolerance)
+            _bodies.m_sleepTime[i] = 0.0f;
+        else
+            _bodies.m_sleepTime[i] += _deltaTime;
+
+        float& minSleepTime = m_minSleepTime[Find(i)];
+        minSleepTime = std::min(minSleepTime, _bodies.m_sleepTime[i]);
+    }
+
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        if(_bodies.IsActive(i) == false)
+            continue;
+
+        const uint32_t root = Find(i);
+        if(m_minSleepTime[root] < _settings.timeToSleep)
+            continue;
+
+        uint32_t& island = m_islandOfRoot[root];
+        if(island == BodyStore::k_awake)
+        {
+            if(m_freeIslands.empty())
+            {
+                island = static_cast<uint32_t>(m_islands.size());
+                m_islands.emplace_back();
+            }
+            else
+            {
+                island = m_freeIslands.back();
+                m_freeIslands.pop_back();
+            }
+        }
+
+        m_islands[island].push_back(_bodies.GetHandle(i));
+        ++m_sleepingBodyCount;
+
+        _bodies.m_sleepingIsland[i] = island;
+        _bodies.SetVelocity(i, linalg::aliases::float2(0.0f, 0.0f));
+        _bodies.SetForce(i, linalg::aliases::float2(0.0f, 0.0f));
+        _bodies.m_angularVelocity[i] = 0.0f;
+        _bodies.m_torque[i] = 0.0f;
+    }
+}
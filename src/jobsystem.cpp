@@ -0,0 +1,337 @@
+#include "jobsystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    // the system and index of the thread a worker loop runs on
+    thread_local const JobSystem* t_system = nullptr;
+    thread_local size_t t_thread = 0u;
+
+    // how often an idle thread looks for work again before it sleeps
+    constexpr int k_spinCount = 64;
+
+    inline uint64_t NowNs()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+}
+
+void JobStats::Reset()
+{
+    loops = 0u;
+    tasks = 0u;
+    steals = 0u;
+    wallNs = 0u;
+    workNs = 0u;
+}
+
+JobSystem::JobSystem(size_t _threadCount)
+    : m_workers(), m_threads(), m_queued(0u), m_sleeping(0u), m_isStopping(false),
+      m_sleepMutex(), m_wake(), m_running(0u), m_exited(), m_stats(nullptr)
+{
+    Start(_threadCount, nullptr);
+}
+
+JobSystem::JobSystem(size_t _threadCount, const Executor& _executor)
+    : m_workers(), m_threads(), m_queued(0u), m_sleeping(0u), m_isStopping(false),
+      m_sleepMutex(), m_wake(), m_running(0u), m_exited(), m_stats(nullptr)
+{
+    Start(_threadCount, _executor);
+}
+
+void JobSystem::Start(size_t _threadCount, const Executor& _executor)
+{
+    if(_threadCount == 0u)
+        _threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for(size_t i = 0; i < _threadCount; ++i)
+    {
+        m_workers.push_back(std::make_unique<Worker>());
+        m_workers.back()->random = static_cast<uint32_t>(i * 2654435761u + 1u);
+    }
+
+    // thread 0 is whoever calls in
+    for(size_t thread = 1; thread < _threadCount; ++thread)
+    {
+        if(_executor == nullptr)
+        {
+            m_threads.emplace_back(&JobSystem::WorkerLoop, this, thread);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            ++m_running;
+        }
+        _executor([this, thread]()
+        {
+            WorkerLoop(thread);
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            --m_running;
+            m_exited.notify_all();
+        });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_isStopping = true;
+    }
+    m_wake.notify_all();
+
+    for(std::thread& thread : m_threads)
+        thread.join();
+
+    // loops on threads of the host can not be joined, wait for them to leave
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_exited.wait(lock, [this]() { return m_running == 0u; });
+}
+
+size_t JobSystem::GetCurrentThread() const
+{
+    return (t_system == this) ? t_thread : 0u;
+}
+
+void JobSystem::Push(size_t _thread, Task&& _task)
+{
+    {
+        Worker& worker = *m_workers[_thread];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(_task));
+    }
+    m_queued.fetch_add(1u);
+
+    // a sleeping thread either saw the count above, or is already waiting
+    // (it holds the lock from its check until then)
+    if(m_sleeping.load() > 0u)
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_wake.notify_one();
+    }
+}
+
+bool JobSystem::Pop(size_t _thread, Task& _task)
+{
+    Worker& worker = *m_workers[_thread];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if(worker.tasks.empty())
+        return false;
+
+    _task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    m_queued.fetch_sub(1u);
+    return true;
+}
+
+bool JobSystem::Steal(size_t _thread, Task& _task)
+{
+    const size_t count = m_workers.size();
+    if(count == 1u)
+        return false;
+
+    // start at a random victim so that thieves do not all go for the same
+    uint32_t& random = m_workers[_thread]->random;
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+
+    const size_t start = random % count;
+    for(size_t k = 0; k < count; ++k)
+    {
+        const size_t victim = (start + k) % count;
+        if(victim == _thread)
+            continue;
+
+        Worker& worker = *m_workers[victim];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if(worker.tasks.empty())
+            continue;
+
+        // the front holds the largest pieces
+        _task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        m_queued.fetch_sub(1u);
+
+        if(_task.loop != nullptr && _task.loop->stats != nullptr)
+            _task.loop->stats->steals.fetch_add(1u, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+bool JobSystem::RunOne(size_t _thread)
+{
+    Task task;
+    if(Pop(_thread, task) == false && Steal(_thread, task) == false)
+        return false;
+
+    Execute(_thread, task);
+    return true;
+}
+
+void JobSystem::Execute(size_t _thread, Task& _task)
+{
+    if(_task.job != nullptr)
+    {
+        RunJob(_thread, _task.job);
+        return;
+    }
+
+    // hand the upper halves to whoever comes for them
+    Loop& loop = *_task.loop;
+    while(_task.end - _task.begin > loop.grain)
+    {
+        const size_t middle = _task.begin + (_task.end - _task.begin) / 2u;
+        Push(_thread, Task{ &loop, middle, _task.end, nullptr });
+        _task.end = middle;
+    }
+
+    const uint64_t start = (loop.stats != nullptr) ? NowNs() : 0u;
+    try
+    {
+        (*loop.function)(_task.begin, _task.end, _thread);
+    }
+    catch(...)
+    {
+        std::lock_guard<std::mutex> lock(loop.mutex);
+        if(loop.exception == nullptr)
+            loop.exception = std::current_exception();
+    }
+    if(loop.stats != nullptr)
+    {
+        loop.stats->tasks.fetch_add(1u, std::memory_order_relaxed);
+        loop.stats->workNs.fetch_add(NowNs() - start, std::memory_order_relaxed);
+    }
+
+    // the loop (on the stack of the caller) can be gone right after this
+    loop.remaining.fetch_sub(_task.end - _task.begin, std::memory_order_acq_rel);
+}
+
+void JobSystem::RunJob(size_t _thread, const JobHandle& _job)
+{
+    try
+    {
+        _job->m_function();
+    }
+    catch(...)
+    {
+        _job->m_exception = std::current_exception();
+    }
+
+    std::vector<JobHandle> continuations;
+    {
+        std::lock_guard<std::mutex> lock(_job->m_mutex);
+        _job->m_isDone.store(true, std::memory_order_release);
+        continuations.swap(_job->m_continuations);
+    }
+
+    for(JobHandle& continuation : continuations)
+    {
+        if(continuation->m_pending.fetch_sub(1) == 1)
+            Push(_thread, Task{ nullptr, 0u, 0u, std::move(continuation) });
+    }
+}
+
+void JobSystem::WorkerLoop(size_t _thread)
+{
+    t_system = this;
+    t_thread = _thread;
+
+    while(m_isStopping.load() == false)
+    {
+        if(RunOne(_thread))
+            continue;
+
+        // look again for a while before going to sleep, the next loop of a
+        // step is usually only a few microseconds away
+        for(int i = 0; i < k_spinCount && m_queued.load() == 0u && m_isStopping.load() == false; ++i)
+            std::this_thread::yield();
+        if(m_queued.load() > 0u)
+            continue;
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleeping.fetch_add(1u);
+        m_wake.wait(lock, [this]() { return m_queued.load() > 0u || m_isStopping.load(); });
+        m_sleeping.fetch_sub(1u);
+    }
+
+    t_system = nullptr;
+}
+
+void JobSystem::ParallelFor(size_t _count, const RangeFunction& _function, size_t _grain)
+{
+    if(_count == 0u)
+        return;
+
+    const size_t thread = GetCurrentThread();
+    const size_t threadCount = m_workers.size();
+    // a few pieces per thread, so that a slow piece does not hold up the rest
+    const size_t grain = (_grain > 0u) ? _grain : std::max<size_t>(1u, _count / (threadCount * 8u));
+
+    JobStats* stats = m_stats;
+    const uint64_t start = (stats != nullptr) ? NowNs() : 0u;
+    if(stats != nullptr)
+        stats->loops.fetch_add(1u, std::memory_order_relaxed);
+
+    Loop loop;
+    loop.function = &_function;
+    loop.grain = grain;
+    loop.remaining.store(_count, std::memory_order_relaxed);
+    loop.stats = stats;
+
+    Task task{ &loop, 0u, _count, nullptr };
+    if(threadCount == 1u || _count <= grain)
+        loop.grain = _count;
+    Execute(thread, task);
+
+    // help out (with this loop or anything else) until every piece is done
+    while(loop.remaining.load(std::memory_order_acquire) != 0u)
+    {
+        if(RunOne(thread) == false)
+            std::this_thread::yield();
+    }
+
+    if(stats != nullptr)
+        stats->wallNs.fetch_add(NowNs() - start, std::memory_order_relaxed);
+
+    if(loop.exception != nullptr)
+        std::rethrow_exception(loop.exception);
+}
+
+JobHandle JobSystem::Submit(std::function<void()> _function, const std::vector<JobHandle>& _dependencies)
+{
+    JobHandle job = std::make_shared<Job>();
+    job->m_function = std::move(_function);
+
+    for(const JobHandle& dependency : _dependencies)
+    {
+        std::lock_guard<std::mutex> lock(dependency->m_mutex);
+        if(dependency->m_isDone.load(std::memory_order_acquire))
+            continue;
+        dependency->m_continuations.push_back(job);
+        job->m_pending.fetch_add(1);
+    }
+
+    // drop the hold of Submit() itself, the job might be ready already
+    if(job->m_pending.fetch_sub(1) == 1)
+        Push(GetCurrentThread(), Task{ nullptr, 0u, 0u, job });
+    return job;
+}
+
+void JobSystem::Wait(const JobHandle& _job)
+{
+    const size_t thread = GetCurrentThread();
+    while(_job->IsDone() == false)
+    {
+        if(RunOne(thread) == false)
+            std::this_thread::yield();
+    }
+
+    if(_job->m_exception != nullptr)
+        std::rethrow_exception(_job->m_exception);
+}
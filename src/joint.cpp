@@ -1,7 +1,5 @@
 #include "joint.hpp"
 
-#include "GL/freeglut.h"
-
 #include "rigidbody2D.hpp"
 #include "util.hpp"
 
@@ -22,28 +20,11 @@ void SpringJoint::ApplyConstriant() const
     m_body1->AddForce( (vec0to1 + damper) * -1 );
 }
 
-void SpringJoint::Render() const
-{
-    glPushMatrix();
-    glPushAttrib(GL_CURRENT_BIT);
-    {
-        glBegin(GL_LINES);
-        // red for spring joint
-        glColor3f(1, 0, 0);
-        glVertex2f( m_body0->GetPosition().x, m_body0->GetPosition().y );
-        glVertex2f( m_body1->GetPosition().x, m_body1->GetPosition().y );
-        glEnd();
-    }
-    glPopAttrib();
-    glPopMatrix();
-}
-
 void DistanceJoint::ApplyConstriant() const
 {
     // Reference :
     // https://wildbunny.co.uk/blog/2011/04/06/physics-engines-for-dummies/
 
-
     float distance = safe_distance(m_body0->GetPosition(), m_body1->GetPosition());
     // distance joint is for maintaining the distance difference of two
     // bodies lesser than a length, so ignore it if the length is already lesser
@@ -72,20 +53,4 @@ void DistanceJoint::ApplyConstriant() const
 
     m_body0->AddVelocity(impulse * m_body0->GetInvMass());
     m_body1->AddVelocity(-1 * impulse * m_body1->GetInvMass());
-}
-
-void DistanceJoint::Render() const
-{
-    glPushMatrix();
-    glPushAttrib(GL_CURRENT_BIT);
-    {
-        glBegin(GL_LINES);
-        // green for distance joint
-        glColor3f(0, 1, 0);
-        glVertex2f( m_body0->GetPosition().x, m_body0->GetPosition().y );
-        glVertex2f( m_body1->GetPosition().x, m_body1->GetPosition().y );
-        glEnd();
-    }
-    glPopAttrib();
-    glPopMatrix();
 }
\ No newline at end of file
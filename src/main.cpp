@@ -1,7 +1,9 @@
 #include <iostream>
+#include <memory>
 #include <chrono>
 #include <algorithm>
 #include <cmath>
+#include <string>
 #include <vector>
 
 #include <GL/freeglut.h>
@@ -14,6 +16,11 @@
 #include "obb.hpp"
 #include "integrator.hpp"
 #include "joint.hpp"
+#include "physicsthread.hpp"
+#include "demoscenes.hpp"
+#include "renderer.hpp"
+#include "replay.hpp"
+#include "snapshot.hpp"
 
 namespace
 {
@@ -30,6 +37,15 @@ namespace
 	auto scene = std::make_shared<Scene>(
 		deltaTime, positional_correction_iterations, integrator);
 
+    // while recording ('r'), the inputs go through this, see replay.hpp
+    std::unique_ptr<InputRecorder> recorder;
+    const char* const replay_snapshot_path = "replay.snapshot";
+    const char* const replay_inputs_path = "replay.inputs";
+
+    // while stepping on a thread of its own ('t' or --threaded), the scene
+    // belongs to it, drawing and inputs go through this, see physicsthread.hpp
+    std::unique_ptr<PhysicsThread> physics;
+
     int screen_width = 800;
 	int screen_height = 800;
 
@@ -52,7 +68,13 @@ private:
 			0, 0, -1,
 			0, 1, 0);
 
-        scene->Render();
+        if(physics)
+        {
+            const RenderFrame& frame = physics->GetLatestFrame();
+            Renderer::RenderInterpolated(frame, frame.GetAlpha(Clock::NowNs()));
+        }
+        else
+            Renderer::RenderScene(*scene);
 
         glutSwapBuffers();
         glutPostRedisplay();
@@ -61,6 +83,13 @@ private:
 public:
     static void MainLoop()
     {
+        // the physics thread keeps its own accumulator
+        if(physics)
+        {
+            RenderScene();
+            return;
+        }
+
         accumulator += (float)Clock::Elapsed();
         Clock::Reset();
 
@@ -71,7 +100,10 @@ public:
         accumulator = std::clamp(accumulator, 0.0f, accumulate_upper_bound);
         while(accumulator >= deltaTime)
         {
-            scene->Step();
+            if(recorder)
+                recorder->Step();
+            else
+                scene->Step();
 
             accumulator -= deltaTime;
         }
@@ -95,6 +127,89 @@ public:
         gluOrtho2D(-ortho_size.x, ortho_size.x, -ortho_size.y, ortho_size.y);
     }
 
+    static void Keyboard(unsigned char key, int x, int y)
+    {
+        // toggle drawing of contact points and normals
+        if(key == 'c')
+        {
+            if(physics)
+                physics->SetDrawContacts(!physics->GetLatestFrame().isDrawingContacts);
+            else
+                scene->SetDrawContacts(!scene->GetDrawContacts());
+        }
+        // toggle sleeping of resting islands
+        if(key == 's')
+        {
+            if(physics)
+            {
+                const float enabled = physics->GetLatestFrame().isSleeping ? 0.0f : 1.0f;
+                physics->Post(InputEvent{ 0u, InputType::SetSleeping, 0u, float2(0.0f, 0.0f), float2(0.0f, 0.0f), enabled });
+            }
+            else if(recorder)
+                recorder->SetSleeping(!scene->GetSleepSettings().enabled);
+            else
+            {
+                SleepSettings settings = scene->GetSleepSettings();
+                settings.enabled = !settings.enabled;
+                scene->SetSleepSettings(settings);
+            }
+        }
+        // start recording the inputs from the current scene, or stop and
+        // save them, "headless --load replay.snapshot --replay replay.inputs"
+        // runs them again
+        if(key == 'r')
+        {
+            if(physics)
+            {
+                std::cout << "stop the physics thread ('t') to record" << std::endl;
+                return;
+            }
+            try
+            {
+                if(recorder == nullptr)
+                {
+                    SceneSnapshot::Save(*scene, replay_snapshot_path);
+                    recorder.reset(new InputRecorder(*scene));
+                    std::cout << "recording inputs" << std::endl;
+                }
+                else
+                {
+                    recorder->GetRecording().Save(replay_inputs_path);
+                    std::cout << "recorded " << recorder->GetRecording().GetEvents().size() << " inputs over "
+                        << recorder->GetStep() << " steps to " << replay_inputs_path << std::endl;
+                    recorder.reset();
+                }
+            }
+            catch(const std::exception& e)
+            {
+                std::cerr << e.what() << std::endl;
+                recorder.reset();
+            }
+        }
+        // step on a thread of its own, or back on this one
+        if(key == 't')
+        {
+            if(recorder)
+            {
+                std::cout << "stop recording ('r') to change threads" << std::endl;
+                return;
+            }
+            if(physics == nullptr)
+            {
+                physics.reset(new PhysicsThread(scene, accumulate_upper_bound));
+                physics->Start();
+                std::cout << "stepping on the physics thread" << std::endl;
+            }
+            else
+            {
+                physics.reset();
+                Clock::Reset();
+                accumulator = 0.0f;
+                std::cout << "stepping on the main thread" << std::endl;
+            }
+        }
+    }
+
     static void Mouse(int button, int state, int x, int y)
     {
         if(button == GLUT_LEFT_BUTTON && state == GLUT_DOWN)
@@ -102,6 +217,16 @@ public:
             float2 ortho_size((float)screen_width / 20.0f, (float)screen_height / 20.0f);
             float2 position = float2( (float)x / 10.0f - ortho_size.x, (float)y / -10.0f + ortho_size.y );
 
+            if(physics)
+            {
+                physics->Post(InputEvent{ 0u, InputType::SpawnCircle, 0u, position, float2(3.0f, 0.0f), 0.0f });
+                return;
+            }
+            if(recorder)
+            {
+                recorder->SpawnCircle(position, 3.0f);
+                return;
+            }
             std::shared_ptr<Circle> shape = std::make_shared<Circle>(
                 3.0f
             );
@@ -112,14 +237,25 @@ public:
             float2 ortho_size((float)screen_width / 20.0f, (float)screen_height / 20.0f);
             float2 position = float2( (float)x / 10.0f - ortho_size.x, (float)y / -10.0f + ortho_size.y );
 
-            std::shared_ptr<OBB> shape = std::make_shared<OBB>(
+            const float2 size =
                 //float2 (3, 3)
 #ifdef _MSC_VER
-				float2(((float)rand() / (RAND_MAX)) * 5 + 3, ((float)rand() / (RAND_MAX)) * 5 + 3)
+				float2(((float)rand() / (RAND_MAX)) * 5 + 3, ((float)rand() / (RAND_MAX)) * 5 + 3);
 #else
-                float2( drand48() * 5 + 3, drand48() * 5 + 3 )
+                float2( drand48() * 5 + 3, drand48() * 5 + 3 );
 #endif
-            );
+            if(physics)
+            {
+                physics->Post(InputEvent{ 0u, InputType::SpawnBox, 0u, position, size, 0.0f });
+                return;
+            }
+            // the size is random, the recording keeps it
+            if(recorder)
+            {
+                recorder->SpawnBox(position, size);
+                return;
+            }
+            std::shared_ptr<OBB> shape = std::make_shared<OBB>(size);
             auto body = scene->AddRigidBody(shape, position);
         }
     }
@@ -135,12 +271,16 @@ int main(int argc, char* argv[])
     glutCreateWindow("PhyEngine");
     glutDisplayFunc(GLUTCallback::MainLoop);
     glutMouseFunc(GLUTCallback::Mouse);
+    glutKeyboardFunc(GLUTCallback::Keyboard);
     glutReshapeFunc(GLUTCallback::Reshape);
 
     // NOTE : please do not use glutTimerFunc.
     // We need you to practice on designing the loop itself,
     // resolving the different update rate of physics and rendering.
 
+    // press 'c' to turn this off
+    scene->SetDrawContacts(true);
+
     // fill in the scene
     // floor
     {
@@ -186,63 +326,17 @@ int main(int argc, char* argv[])
         auto body = scene->AddRigidBody(shape, float2(-5, 20));
         body->SetVelocity(float2(8, 5));
     }
-    {
-        const size_t box_size = 21;
-		const float length = 25.0f;
-		const float rest_length = (length / box_size);
-
-        std::vector< std::shared_ptr<RigidBody2D> > boxes;
-        boxes.reserve(box_size);
-
-        float theta = 0.0f;
-        float deltaTheta = (float) M_PI / (box_size - 1);
-
-        for(size_t i = 0; i < box_size; ++i)
-        {
-            auto shape = std::make_shared<OBB>(float2 (1, 1));
-            boxes.push_back(scene->AddRigidBody(shape, 
-                float2(length * std::cos(theta), -18.0f)
-            ));
-			boxes[i]->SetMass(1.0f);
-
-            theta += deltaTheta;
-        }
-
-        boxes[0]->SetMass(0.0f);
-        boxes[box_size - 1]->SetMass(0.0f);
+    // a bridge of boxes held by springs, and a chain held by distance joints
+    DemoScenes::AddSpringBridge(*scene, float2(0.0f, -18.0f), 21, 25.0f, 100.0f);
+    DemoScenes::AddDistanceChain(*scene, float2(-20.0f, 30.0f), 7, 15.0f, deltaTime);
 
-        for(size_t i = 1; i < box_size; ++i)
-        {
-            std::shared_ptr<SpringJoint> disJoint = 
-                std::make_shared<SpringJoint>(boxes[i - 1], boxes[i], rest_length, 100.0f);
-            scene->AddJoint(disJoint);
-        }
-    }
+    // glutInit() took the arguments of its own out already
+    for(int i = 1; i < argc; ++i)
     {
-        const size_t box_size = 7;
-		const float length = 15.0f;
-		const float rest_length = (length / box_size);
-
-        std::vector< std::shared_ptr<RigidBody2D> > boxes;
-        boxes.reserve(box_size);
-
-        for(size_t i = 0; i < box_size; ++i)
-        {
-            auto shape = std::make_shared<OBB>(float2 (1, 1));
-            boxes.push_back(scene->AddRigidBody(shape, 
-                float2( -20.0f + -3.0f * i, 30 - rest_length * i)
-            ));
-			boxes[i]->SetMass(1.0f);
-            boxes[i]->SetVelocity(float2(1.0f, 0.0f));
-        }
-
-        boxes[0]->SetMass(0.0f);
-
-        for(size_t i = 1; i < box_size; ++i)
+        if(std::string(argv[i]) == "--threaded")
         {
-            std::shared_ptr<DistanceJoint> disJoint = 
-                std::make_shared<DistanceJoint>(boxes[i - 1], boxes[i], rest_length * 3.0f, deltaTime);
-            scene->AddJoint(disJoint);
+            physics.reset(new PhysicsThread(scene, accumulate_upper_bound));
+            physics->Start();
         }
     }
     
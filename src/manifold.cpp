@@ -1,53 +1,62 @@
 #include "manifold.hpp"
 
+#include "bodystore.hpp"
 #include "util.hpp"
 
 #include <iostream>
 
-Manifold::Manifold(
-    const std::shared_ptr<RigidBody2D>& _body0, 
-    const std::shared_ptr<RigidBody2D>& _body1,
-    int _contactPointCount,
-    std::array<float2, 2> _contactPoints,
-    float2 _normal,
-    float _penetration,
-    bool _isHit)
-    : m_body0(_body0), m_body1(_body1), m_contactPointCount(_contactPointCount),
-      m_contactPoints(_contactPoints), 
-      m_normal(_normal), m_penetration(_penetration), m_isHit(_isHit)
-    {}
-
-void Manifold::Resolve() const
+namespace
+{
+    // Static bodies (inverse mass 0) are only read, nothing is added to
+    // them. SetStatic(), SetMass(0) and creating a body of mass 0 zero the
+    // inverse inertia too, so a static body never turns. Several manifolds
+    // sharing the floor can then be resolved at the same time, see
+    // GraphColoringSolver.
+    inline void ApplyImpulse(
+        BodyStore& _bodies, uint32_t _body, float _invMass, float _invInertia,
+        const linalg::aliases::float2& _r, const linalg::aliases::float2& _impulse)
+    {
+        if(_invMass == 0.0f)
+            return;
+        _bodies.AddVelocity(_body, _invMass * _impulse);
+        _bodies.m_angularVelocity[_body] += _invInertia * linalg::cross(_r, _impulse);
+    }
+}
+
+void Manifold::Resolve(BodyStore& _bodies) const
 {
     if(m_isHit == false)
     {
         return;
     }
 
-	const float inv_mass_a = m_body0->GetInvMass();
-	const float inv_mass_b = m_body1->GetInvMass();
+    const uint32_t a = m_body0;
+    const uint32_t b = m_body1;
+
+	const float inv_mass_a = _bodies.m_invMass[a];
+	const float inv_mass_b = _bodies.m_invMass[b];
 	if (inv_mass_a == 0.0f && inv_mass_b == 0.0f)
     {
-        m_body0->SetVelocity(float2(0.0f, 0.0f));
-        m_body1->SetVelocity(float2(0.0f, 0.0f));
+        _bodies.SetVelocity(a, float2(0.0f, 0.0f));
+        _bodies.SetVelocity(b, float2(0.0f, 0.0f));
 		return;
     }
 
     for(int i = 0; i < m_contactPointCount; ++i)
     {
-        float2 ra = (m_contactPoints[i] - m_body0->GetPosition());
-        float2 rb = (m_contactPoints[i] - m_body1->GetPosition());
+        float2 ra = (m_contactPoints[i] - _bodies.GetPosition(a));
+        float2 rb = (m_contactPoints[i] - _bodies.GetPosition(b));
 
-        //float2 rv = m_body1->m_velocity - m_body0->m_velocity;
+        //float2 rv = _bodies.GetVelocity(b) - _bodies.GetVelocity(a);
         float2 rv = 
-            m_body1->m_velocity + linalg::cross(m_body1->m_angularVelocity, rb)
-            - m_body0->m_velocity - linalg::cross(m_body0->m_angularVelocity, ra);
+            _bodies.GetVelocity(b) + linalg::cross(_bodies.m_angularVelocity[b], rb)
+            - _bodies.GetVelocity(a) - linalg::cross(_bodies.m_angularVelocity[a], ra);
 
         float velAlongNormal = linalg::dot(rv, m_normal);
         if(velAlongNormal > 0.0f)
             return;
         
-        float e = std::min(m_body0->m_restitution, m_body1->m_restitution);
+        float e = std::min(_bodies.m_restitution[a], _bodies.m_restitution[b]);
         // Determine if we should perform a resting collision or not
         // The idea is if the only thing moving this object is gravity,
         // then the collision should be performed without any restitution
@@ -57,8 +66,8 @@ void Manifold::Resolve() const
         if( linalg::length2(rv) < linalg::length2( 1.0f / 1000.0f * float2(0, -9.8f) ) + 0.0001f )
             e = 0.0f;
 
-        const float inv_inertia_a = m_body0->GetInvInertia();
-        const float inv_inertia_b = m_body1->GetInvInertia();
+        const float inv_inertia_a = _bodies.m_invInertia[a];
+        const float inv_inertia_b = _bodies.m_invInertia[b];
 
         float raCrossN = linalg::cross( ra, m_normal );
         float rbCrossN = linalg::cross( rb, m_normal );
@@ -72,19 +81,17 @@ void Manifold::Resolve() const
         // Apply impulse
         float2 impulse = m_normal * j;
         
-        m_body0->m_velocity += inv_mass_a * -impulse;
-        m_body1->m_velocity += inv_mass_b * impulse;
-        m_body0->m_angularVelocity += inv_inertia_a * linalg::cross(ra, -impulse);
-        m_body1->m_angularVelocity += inv_inertia_b * linalg::cross(rb, impulse);
+        ApplyImpulse(_bodies, a, inv_mass_a, inv_inertia_a, ra, -impulse);
+        ApplyImpulse(_bodies, b, inv_mass_b, inv_inertia_b, rb, impulse);
 
         /**
          *  The following section will be handling frictions.
          */
         // Re-calculate relative velocity after normal impulse is applied.
-        //float2 rv_after_impulse = m_body1->m_velocity - m_body0->m_velocity;
+        //float2 rv_after_impulse = _bodies.GetVelocity(b) - _bodies.GetVelocity(a);
         float2 rv_after_impulse = 
-            m_body1->m_velocity + linalg::cross(m_body1->m_angularVelocity, rb)
-            - m_body0->m_velocity - linalg::cross(m_body0->m_angularVelocity, ra);
+            _bodies.GetVelocity(b) + linalg::cross(_bodies.m_angularVelocity[b], rb)
+            - _bodies.GetVelocity(a) - linalg::cross(_bodies.m_angularVelocity[a], ra);
         // Solve for the tangent vector
         float2 tangent = 
             rv_after_impulse - linalg::dot(rv_after_impulse, m_normal) * m_normal;
@@ -102,8 +109,8 @@ void Manifold::Resolve() const
         }
 
         // Coulumb's law
-        const float sf = std::sqrt(m_body0->m_staticFriction * m_body1->m_staticFriction);
-        const float df = std::sqrt(m_body0->m_dynamicFriction * m_body1->m_dynamicFriction);
+        const float sf = std::sqrt(_bodies.m_staticFriction[a] * _bodies.m_staticFriction[b]);
+        const float df = std::sqrt(_bodies.m_dynamicFriction[a] * _bodies.m_dynamicFriction[b]);
 
         float2 tangentImpulse;
         if(std::abs( jt ) < j * sf)
@@ -116,20 +123,21 @@ void Manifold::Resolve() const
         }
 
         // Apply friction impulse
-        m_body0->m_velocity += inv_mass_a * -tangentImpulse;
-        m_body1->m_velocity += inv_mass_b * tangentImpulse;
-        m_body0->m_angularVelocity += inv_inertia_a * linalg::cross(ra, -tangentImpulse);
-        m_body1->m_angularVelocity += inv_inertia_b * linalg::cross(rb, tangentImpulse);
+        ApplyImpulse(_bodies, a, inv_mass_a, inv_inertia_a, ra, -tangentImpulse);
+        ApplyImpulse(_bodies, b, inv_mass_b, inv_inertia_b, rb, tangentImpulse);
     }
 }
 
-void Manifold::PositionalCorrection() const
+void Manifold::PositionalCorrection(BodyStore& _bodies) const
 {
     const float percent = 0.4f; // usually 20% to 80%
     const float slop = 0.01f; // usually 0.01 to 0.1
 
-	const float inv_mass_a = m_body0->GetInvMass();
-	const float inv_mass_b = m_body1->GetInvMass();
+    const uint32_t a = m_body0;
+    const uint32_t b = m_body1;
+
+	const float inv_mass_a = _bodies.m_invMass[a];
+	const float inv_mass_b = _bodies.m_invMass[b];
 
     if(inv_mass_a == 0.0f && inv_mass_b == 0.0f)
         return;
@@ -138,6 +146,8 @@ void Manifold::PositionalCorrection() const
         (std::max( m_penetration - slop, 0.0f ) / (inv_mass_a + inv_mass_b))
         * percent * m_normal;
 
-    m_body0->m_position -= inv_mass_a * correction;
-    m_body1->m_position += inv_mass_b * correction;
+    if(inv_mass_a != 0.0f)
+        _bodies.AddPosition(a, -inv_mass_a * correction);
+    if(inv_mass_b != 0.0f)
+        _bodies.AddPosition(b, inv_mass_b * correction);
 }
\ No newline at end of file
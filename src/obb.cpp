@@ -4,22 +4,77 @@
 #include "circle.hpp"
 #include "collision.hpp"
 #include "util.hpp"
+#include "rigidbody2D.hpp"
 
 #include <vector>
 #include <algorithm>
 #include <iostream>
 
-#include "GL/freeglut.h"
+bool OBB::RayCast(
+    const float2& _from, const float2& _to,
+    float& _fraction, float2& _normal) const
+{
+    // do the slab test in local space, where the box is an AABB
+    const float2x2 rotationMatrix = getRotationMatrix(m_body->GetOrientation());
+    const float2x2 invRotationMatrix = linalg::transpose(rotationMatrix);
+    const float2 from = linalg::mul(invRotationMatrix, _from - m_body->GetPosition());
+    const float2 direction = linalg::mul(invRotationMatrix, _to - _from);
+    const float2 half_extent = m_extent / 2.0f;
+
+    float enter = 0.0f;
+    float exit = 1.0f;
+    float2 normal(0.0f, 0.0f);
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        if(std::abs(direction[axis]) < 1e-9f)
+        {
+            // parallel to this slab, it has to start inside of it
+            if(std::abs(from[axis]) > half_extent[axis])
+                return false;
+            continue;
+        }
+
+        const float invDirection = 1.0f / direction[axis];
+        float t0 = (-half_extent[axis] - from[axis]) * invDirection;
+        float t1 = ( half_extent[axis] - from[axis]) * invDirection;
+        float sign = -1.0f;
+        if(t0 > t1)
+        {
+            std::swap(t0, t1);
+            sign = 1.0f;
+        }
+
+        if(t0 > enter)
+        {
+            enter = t0;
+            normal = float2(0.0f, 0.0f);
+            normal[axis] = sign;
+        }
+        exit = std::min(exit, t1);
+
+        if(enter > exit)
+            return false;
+    }
 
-OBB::float2 OBB::GetSupportPoint(const float2& dir) const
+    // starting inside the box does not count as a hit
+    if(normal == float2(0.0f, 0.0f))
+        return false;
+
+    _fraction = enter;
+    _normal = linalg::mul(rotationMatrix, normal);
+    return true;
+}
+
+OBB::float2 OBB::GetSupportPoint(const BodyTransformCache& cache, const float2& dir)
 {
     // init as max
     float bestProjection = -1e9f;
     float2 bestVertex = float2(0.0f, 0.0f);
 
-    std::array<float2, 4> vertices = GetLocalSpaceVertices();
+    // world space vertices, so 'dir' is in world space as well
+    const std::array<float2, 4>& vertices = cache.vertices;
 
-    for(size_t i = 0; i < GetVertexCount(); ++i)
+    for(size_t i = 0; i < vertices.size(); ++i)
     {
         float2 v = vertices[i];
         float projection = linalg::dot( v, dir );
@@ -39,44 +94,64 @@ Manifold OBB::accept(const ShapeVisitor<Manifold>& visitor) const
     return visitor.visitAABB(*this);
 }
 
+AABB OBB::GetAABB() const
+{
+    // the half size of a rotated box projected on world axes is |R| * h
+    const float2x2 rotationMatrix = getRotationMatrix(m_body->GetOrientation());
+    const float2 half_extent = m_extent / 2.0f;
+    const float2 world_half_extent(
+        std::abs(rotationMatrix[0][0]) * half_extent.x + std::abs(rotationMatrix[1][0]) * half_extent.y,
+        std::abs(rotationMatrix[0][1]) * half_extent.x + std::abs(rotationMatrix[1][1]) * half_extent.y
+    );
+
+    return AABB{ 
+        m_body->GetPosition() - world_half_extent, 
+        m_body->GetPosition() + world_half_extent 
+    };
+}
+
+void OBB::UpdateTransformCache(const float2& _position, BodyTransformCache& _cache) const
+{
+    const std::array<float2, 4> vertices = GetLocalSpaceVertices();
+    const std::array<float2, 4> normals = GetLocalSpaceNormals();
+
+    float2 minimum = float2(1e9f, 1e9f);
+    float2 maximum = float2(-1e9f, -1e9f);
+    for(size_t i = 0; i < GetVertexCount(); ++i)
+    {
+        _cache.vertices[i] = linalg::mul(_cache.rotation, vertices[i]) + _position;
+        _cache.normals[i] = linalg::mul(_cache.rotation, normals[i]);
+
+        minimum = linalg::min(minimum, _cache.vertices[i]);
+        maximum = linalg::max(maximum, _cache.vertices[i]);
+    }
+    _cache.bounds = AABB{ minimum, maximum };
+}
+
 //////////////
 
 float OBB::FindAxisLeastPenetration(
     size_t& faceIndexPtr, 
-    const OBB& A, 
-    const OBB& B)
+    const BodyTransformCache& A, 
+    const BodyTransformCache& B)
 {
     float bestDistance = -1e9f;
     size_t bestIndex = 0u;
 
-    std::array<float2, 4> vertices = A.GetLocalSpaceVertices();
-    std::array<float2, 4> normals = A.GetLocalSpaceNormals();
-
-    float2x2 rotMatrixOfA = getRotationMatrix(A.m_body->GetOrientation());
-    float2x2 rotMatrixOfB = getRotationMatrix(B.m_body->GetOrientation());
-
-    for(size_t i = 0; i < A.GetVertexCount(); ++i)
+    // everything is done in world space with the cached data, which gives
+    // the same distances as transforming into B's model space
+    for(size_t i = 0; i < A.vertices.size(); ++i)
     {
         // Retrieve a face normal from A
-        float2 n = normals[i];
-        float2 nw = linalg::mul(rotMatrixOfA, n);
-
-        // Transform face normal into B's model space
-        // Mat2 buT = B.u.Transpose( );
-        float2x2 invRotMatrixOfB = linalg::transpose(rotMatrixOfB);
-        n = linalg::mul(invRotMatrixOfB, nw);
+        const float2 n = A.normals[i];
 
         // Retrieve support point from B along -n
-        float2 s = B.GetSupportPoint( -n );
+        const float2 s = GetSupportPoint( B, -n );
 
-        // Retrieve vertex on face from A, transform into
-        // B's model space
-        float2 v = vertices[i];
-        v = linalg::mul(rotMatrixOfA, v) + A.m_body->GetPosition();
-        v -= B.m_body->GetPosition();
-        v = linalg::mul(invRotMatrixOfB, v);
+        // Retrieve vertex on face from A
+        const float2 v = A.vertices[i];
 
-        // Compute penetration distance (in B's model space)
+        // Compute penetration distance
         float d = linalg::dot( n, s - v );
 
         // Store greatest distance
@@ -92,34 +167,20 @@ float OBB::FindAxisLeastPenetration(
 }
 
 std::array<float2, 2> OBB::FindIncidentFace( 
-    const OBB& RefPoly, 
-    const OBB& IncPoly, 
-    size_t referenceIndex)
+    const BodyTransformCache& RefPoly, 
+    const BodyTransformCache& IncPoly, 
+    size_t referenceIndex,
+    size_t& incidentIndex)
 {
-    // const std::array<float2, 4> refVertices = RefPoly.GetLocalSpaceVertices();
-    const std::array<float2, 4> refNormals = RefPoly.GetLocalSpaceNormals();
-    const std::array<float2, 4> incVertices = IncPoly.GetLocalSpaceVertices();
-    const std::array<float2, 4> incNormals = IncPoly.GetLocalSpaceNormals();
-
-    float2 referenceNormal = refNormals[referenceIndex];
-
-    const float2x2 rotMatrixOfRef = 
-        getRotationMatrix(RefPoly.m_body->GetOrientation());
-    const float2x2 rotMatrixOfInc = 
-        getRotationMatrix(IncPoly.m_body->GetOrientation());
-    const float2x2 invRotMatrixOfInc = 
-        linalg::transpose(getRotationMatrix(IncPoly.m_body->GetOrientation()));
-
-    // Calculate normal in incident's frame of reference
-    referenceNormal = linalg::mul(rotMatrixOfRef, referenceNormal); // To world space
-    referenceNormal = linalg::mul(invRotMatrixOfInc, referenceNormal); // To incident's model space
+    // reference normal in world space
+    const float2 referenceNormal = RefPoly.normals[referenceIndex];
 
     // Find most anti-normal face on incident polygon
 	size_t incidentFace = 0u;
     float minDot = 1e9f;
-    for(size_t i = 0; i < IncPoly.GetVertexCount(); ++i)
+    for(size_t i = 0; i < IncPoly.normals.size(); ++i)
     {
-        float dot = linalg::dot(referenceNormal, incNormals[i]);
+        float dot = linalg::dot(referenceNormal, IncPoly.normals[i]);
         if(dot < minDot)
         {
             minDot = dot;
@@ -129,17 +190,14 @@ std::array<float2, 2> OBB::FindIncidentFace(
 
     std::array<float2, 2> vertexPosArray;
     // Assign face vertices for incidentFace
-    vertexPosArray[0] = 
-        linalg::mul(rotMatrixOfInc, incVertices[incidentFace])
-         + IncPoly.m_body->GetPosition();
+    incidentIndex = incidentFace;
+    vertexPosArray[0] = IncPoly.vertices[incidentFace];
 
     incidentFace = 
-        incidentFace + 1 >= IncPoly.GetVertexCount() ? 
+        incidentFace + 1 >= IncPoly.vertices.size() ? 
         0 : incidentFace + 1;
 
-    vertexPosArray[1] = 
-        linalg::mul(rotMatrixOfInc, incVertices[incidentFace])
-         + IncPoly.m_body->GetPosition();
+    vertexPosArray[1] = IncPoly.vertices[incidentFace];
 
     return vertexPosArray;
 }
@@ -187,123 +245,12 @@ size_t OBB::Clip(float2 normal, float clipped, std::array<float2, 2> face)
 
 Manifold OBB::visitAABB(const OBB& _shape) const
 {
-    //return Manifold(m_body, _shape.m_body, 0, {}, float2(0,0), 0, false);
-    Manifold dummyManifold = Manifold(m_body, _shape.m_body, 0, {}, float2(0,0), 0, false);
-
-    // Check for a separating axis with A's face planes
-    size_t faceA = 0u;
-    float penetrationA = FindAxisLeastPenetration(
-        faceA, *this, _shape);
-    if(penetrationA >= 0.0f)
-        return dummyManifold;
-
-    // Check for a separating axis with B's face planes
-    size_t faceB = 0u;
-    float penetrationB = FindAxisLeastPenetration(
-        faceB, _shape, *this);
-    if(penetrationB >= 0.0f)
-        return dummyManifold;
-
-    size_t referenceIndex = 0u;
-    bool flip; // Always point from a to b
-
-    const OBB* RefPoly; // Reference
-    const OBB* IncPoly; // Incident
-
-    // Determine which shape contains reference face
-    if(biasGreaterThan( penetrationA, penetrationB ))
-    {
-        RefPoly = this;
-        IncPoly = &_shape;
-        referenceIndex = faceA;
-        flip = false;
-    }
-    else
-    {
-        RefPoly = &_shape;
-        IncPoly = this;
-        referenceIndex = faceB;
-        flip = true;
-    }
-
-    // World space incident face
-    // float2 incidentFace[2];
-    std::array<float2, 2> incidentFace = 
-        FindIncidentFace( *RefPoly, *IncPoly, referenceIndex );
-
-    const std::array<float2, 4> refVertices = RefPoly->GetLocalSpaceVertices();
-    
-    const float2x2 rotMatrixOfRef = 
-        getRotationMatrix(RefPoly->m_body->GetOrientation());
-
-    // Setup reference face vertices
-    float2 v1 = refVertices[referenceIndex];
-    referenceIndex = 
-        (referenceIndex + 1 == RefPoly->GetVertexCount()) 
-        ? 0 : referenceIndex + 1;
-    float2 v2 = refVertices[referenceIndex];
-
-    // Transform vertices to world space
-    v1 = 
-        linalg::mul(rotMatrixOfRef, v1) + RefPoly->m_body->GetPosition();
-    v2 = 
-        linalg::mul(rotMatrixOfRef, v2) + RefPoly->m_body->GetPosition();
-
-    // Calculate reference face side normal in world space
-    float2 sidePlaneNormal = (v2 - v1);
-    sidePlaneNormal = safe_normalize(sidePlaneNormal);
-
-    // Orthogonalize
-    float2 refFaceNormal( sidePlaneNormal.y, -sidePlaneNormal.x );
-
-    // ax + by = c
-    // c is distance from origin
-    float refC = linalg::dot( refFaceNormal, v1 );
-    float negSide = -linalg::dot( sidePlaneNormal, v1 );
-    float posSide =  linalg::dot( sidePlaneNormal, v2 );
-
-    // Clip incident face to reference face side planes
-    if(Clip( -sidePlaneNormal, negSide, incidentFace ) < 2)
-        return dummyManifold; // Due to floating point error, possible to not have required points
-
-    if(Clip(  sidePlaneNormal, posSide, incidentFace ) < 2)
-        return dummyManifold; // Due to floating point error, possible to not have required points
-
-    Manifold m = dummyManifold;
-
-    // Flip
-    m.m_normal = flip ? -refFaceNormal : refFaceNormal;
-
-    // Keep points behind reference face
-    int cp = 0; // clipped points behind reference face
-    float separation = linalg::dot( refFaceNormal, incidentFace[0] ) - refC;
-    if(separation <= 0.0f)
-    {
-        m.m_contactPoints[cp] = incidentFace[0];
-        m.m_penetration = -separation;
-        ++cp;
-    }
-    else
-        m.m_penetration = 0;
-
-    separation = linalg::dot( refFaceNormal, incidentFace[1] ) - refC;
-    if(separation <= 0.0f)
-    {
-        m.m_contactPoints[cp] = incidentFace[1];
-
-        m.m_penetration += -separation;
-        ++cp;
-
-        // Average penetration
-        m.m_penetration /= (float)cp;
-    }
-
-    m.m_contactPointCount = cp;
-
-    // data setup
-    m.m_isHit = true;
+    auto manifold = CollisionHelper::GenerateManifold(
+        *this,
+        _shape
+    );
 
-    return m;
+    return manifold;
 }
 
 Manifold OBB::visitCircle(const Circle& _shape) const
@@ -314,35 +261,4 @@ Manifold OBB::visitCircle(const Circle& _shape) const
     );
 
     return manifold;
-}
-
-void OBB::Render() const
-{
-    glPushMatrix();
-
-    glTranslatef(m_body->GetPosition().x, m_body->GetPosition().y, 0);
-    glRotatef(radianToDegree(m_body->GetOrientation()), 0, 0, 1);
-
-    glBegin(GL_LINE_LOOP);
-    {
-        float2 half_extent = m_extent / 2.0f;
-
-        glVertex2f(0 - half_extent[0], 0 - half_extent[1]);
-        glVertex2f(0 - half_extent[0], 0 + half_extent[1]);
-        glVertex2f(0 + half_extent[0], 0 + half_extent[1]);
-        glVertex2f(0 + half_extent[0], 0 - half_extent[1]);
-    }
-    glEnd();
-
-    glBegin(GL_POINTS);
-    {
-        glPushMatrix();
-
-        glVertex2f(0, 0);
-
-        glPopMatrix();
-    }
-    glEnd();
-
-    glPopMatrix();
 }
\ No newline at end of file
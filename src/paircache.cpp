@@ -0,0 +1,172 @@
+#include "paircache.hpp"
+
+#include <algorithm>
+
+void PairCache::Grow(uint32_t _capacity)
+{
+    std::vector<Entry> old;
+    old.swap(m_entries);
+
+    Entry empty = {};
+    empty.key = k_emptyKey;
+    m_entries.assign(_capacity, empty);
+    m_mask = _capacity - 1u;
+
+    for(const Entry& entry : old)
+    {
+        if(entry.key == k_emptyKey)
+            continue;
+
+        uint32_t index = Hash(entry.key) & m_mask;
+        while(m_entries[index].key != k_emptyKey)
+            index = (index + 1u) & m_mask;
+        m_entries[index] = entry;
+    }
+}
+
+void PairCache::RemoveAt(uint32_t _index)
+{
+    // move later entries of the probe run into the hole, as long as that
+    // does not put them in front of their home slot
+    uint32_t hole = _index;
+    uint32_t index = _index;
+    while(true)
+    {
+        index = (index + 1u) & m_mask;
+        if(m_entries[index].key == k_emptyKey)
+            break;
+
+        const uint32_t home = Hash(m_entries[index].key) & m_mask;
+        if(((index - home) & m_mask) >= ((index - hole) & m_mask))
+        {
+            m_entries[hole] = m_entries[index];
+            hole = index;
+        }
+    }
+
+    m_entries[hole].key = k_emptyKey;
+    --m_count;
+}
+
+void PairCache::BeginFrame(size_t _pairCount)
+{
+    ++m_frame;
+    m_begun.clear();
+    m_ended.clear();
+
+    // keep the load factor at most one half, even if every pair is new
+    const size_t needed = (m_count + _pairCount) * 2u;
+    if(needed > m_entries.size())
+    {
+        size_t capacity = std::max<size_t>(m_entries.size(), 16u);
+        while(capacity < needed)
+            capacity *= 2u;
+        Grow(static_cast<uint32_t>(capacity));
+    }
+}
+
+uint32_t PairCache::Touch(uint64_t _key)
+{
+    uint32_t index = Hash(_key) & m_mask;
+    while(true)
+    {
+        Entry& entry = m_entries[index];
+        if(entry.key == _key)
+        {
+            // ended pairs are dropped, so an entry from before this frame
+            // was touching in the last one
+            if(entry.lastTouched != m_frame)
+                entry.state = ContactState::Persist;
+            entry.lastTouched = m_frame;
+            return index;
+        }
+
+        if(entry.key == k_emptyKey)
+        {
+            entry = Entry{};
+            entry.key = _key;
+            entry.touchingSince = m_frame;
+            entry.lastTouched = m_frame;
+            entry.state = ContactState::Begin;
+            ++m_count;
+
+            m_begun.push_back(_key);
+            return index;
+        }
+
+        index = (index + 1u) & m_mask;
+    }
+}
+
+void PairCache::Keep(uint64_t _key)
+{
+    const uint32_t index = Find(_key);
+    if(index == k_invalidEntry)
+        return;
+
+    Entry& entry = m_entries[index];
+    if(entry.lastTouched != m_frame)
+        entry.state = ContactState::Persist;
+    entry.lastTouched = m_frame;
+}
+
+void PairCache::EndFrame()
+{
+    uint32_t index = 0u;
+    while(index < m_entries.size())
+    {
+        Entry& entry = m_entries[index];
+        if(entry.key == k_emptyKey || entry.lastTouched == m_frame)
+        {
+            ++index;
+            continue;
+        }
+
+        m_ended.push_back(entry);
+        m_ended.back().state = ContactState::End;
+        // another entry might have been moved here, look at it again
+        RemoveAt(index);
+    }
+}
+
+void PairCache::RemoveBody(BodyHandle _body)
+{
+    uint32_t index = 0u;
+    while(index < m_entries.size())
+    {
+        Entry& entry = m_entries[index];
+        if(entry.key == k_emptyKey || (entry.GetSlot0() != _body.index && entry.GetSlot1() != _body.index))
+        {
+            ++index;
+            continue;
+        }
+
+        m_ended.push_back(entry);
+        m_ended.back().state = ContactState::End;
+        RemoveAt(index);
+    }
+}
+
+void PairCache::Clear()
+{
+    for(Entry& entry : m_entries)
+        entry.key = k_emptyKey;
+    m_count = 0u;
+    m_begun.clear();
+    m_ended.clear();
+}
+
+uint32_t PairCache::Find(uint64_t _key) const
+{
+    if(m_entries.empty())
+        return k_invalidEntry;
+
+    uint32_t index = Hash(_key) & m_mask;
+    while(m_entries[index].key != k_emptyKey)
+    {
+        if(m_entries[index].key == _key)
+            return index;
+        index = (index + 1u) & m_mask;
+    }
+    return k_invalidEntry;
+}
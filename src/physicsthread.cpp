@@ -0,0 +1,189 @@
+#include "physicsthread.hpp"
+
+#include <chrono>
+#include <exception>
+
+#include "circle.hpp"
+#include "clock.hpp"
+#include "joint.hpp"
+#include "obb.hpp"
+
+namespace
+{
+    typedef linalg::aliases::float2 float2;
+}
+
+float RenderFrame::GetAlpha(uint64_t _nowNs) const
+{
+    if(deltaTime <= 0.0f)
+        return 1.0f;
+    const float sincePublish = _nowNs > publishNs ? static_cast<float>((_nowNs - publishNs) * 1e-9) : 0.0f;
+    return std::clamp((accumulator + sincePublish) / deltaTime, 0.0f, 1.0f);
+}
+
+PhysicsThread::PhysicsThread(const std::shared_ptr<Scene>& _scene, float _accumulateUpperBound, size_t _inputCapacity)
+    : m_scene(_scene), m_accumulateUpperBound(_accumulateUpperBound),
+    m_frames(), m_inputs(_inputCapacity), m_isDrawingContacts(_scene->GetDrawContacts()),
+    m_isStopping(false), m_stepCount(0u), m_droppedInputs(0u), m_failedInputs(0u), m_thread(),
+    m_previousX(), m_previousY(), m_previousOrientation()
+{
+}
+
+PhysicsThread::~PhysicsThread()
+{
+    Stop();
+}
+
+void PhysicsThread::Start()
+{
+    if(IsRunning())
+        return;
+
+    // the first frame has no step before it, both poses are the current one
+    const BodyStore& store = m_scene->GetBodyStore();
+    m_previousX = store.m_positionX;
+    m_previousY = store.m_positionY;
+    m_previousOrientation = store.m_orientation;
+    Publish(0.0f, Clock::NowNs());
+
+    m_isStopping.store(false, std::memory_order_relaxed);
+    m_thread = std::thread(&PhysicsThread::Loop, this);
+}
+
+void PhysicsThread::Stop()
+{
+    if(IsRunning() == false)
+        return;
+
+    m_isStopping.store(true, std::memory_order_relaxed);
+    m_thread.join();
+    // inputs posted too late for a step are still done, nothing posted is lost
+    ApplyInputs();
+}
+
+bool PhysicsThread::Post(const InputEvent& _event)
+{
+    if(m_inputs.TryPush(_event))
+        return true;
+    m_droppedInputs.fetch_add(1u, std::memory_order_relaxed);
+    return false;
+}
+
+const RenderFrame& PhysicsThread::GetLatestFrame()
+{
+    m_frames.Acquire();
+    return m_frames.GetFront();
+}
+
+void PhysicsThread::Loop()
+{
+    const float deltaTime = m_scene->GetDeltaTime();
+    float accumulator = 0.0f;
+    uint64_t last = Clock::NowNs();
+
+    while(m_isStopping.load(std::memory_order_relaxed) == false)
+    {
+        const uint64_t now = Clock::NowNs();
+        accumulator += static_cast<float>((now - last) * 1e-9);
+        last = now;
+
+        // same clamp as the demo, a stall does not turn into a burst of steps
+        accumulator = std::clamp(accumulator, 0.0f, m_accumulateUpperBound);
+        if(accumulator < deltaTime)
+        {
+            std::this_thread::sleep_for(std::chrono::duration<float>(deltaTime - accumulator));
+            continue;
+        }
+
+        while(accumulator >= deltaTime)
+        {
+            const bool isDrawingContacts = m_isDrawingContacts.load(std::memory_order_relaxed);
+            if(m_scene->GetDrawContacts() != isDrawingContacts)
+                m_scene->SetDrawContacts(isDrawingContacts);
+            ApplyInputs();
+
+            const BodyStore& store = m_scene->GetBodyStore();
+            m_previousX = store.m_positionX;
+            m_previousY = store.m_positionY;
+            m_previousOrientation = store.m_orientation;
+
+            m_scene->Step();
+            m_stepCount.fetch_add(1u, std::memory_order_relaxed);
+            accumulator -= deltaTime;
+        }
+        Publish(accumulator, now);
+    }
+}
+
+void PhysicsThread::ApplyInputs()
+{
+    InputEvent event;
+    while(m_inputs.TryPop(event))
+    {
+        event.step = m_stepCount.load(std::memory_order_relaxed);
+        try
+        {
+            InputRecording::Apply(*m_scene, event);
+        }
+        catch(const std::exception&)
+        {
+            // the body it was meant for is gone, there is no one to tell
+            m_failedInputs.fetch_add(1u, std::memory_order_relaxed);
+        }
+    }
+}
+
+void PhysicsThread::Publish(float _accumulator, uint64_t _nowNs)
+{
+    RenderFrame& frame = m_frames.GetBack();
+    const BodyStore& store = m_scene->GetBodyStore();
+
+    frame.step = m_stepCount.load(std::memory_order_relaxed);
+    frame.deltaTime = m_scene->GetDeltaTime();
+    frame.accumulator = _accumulator;
+    frame.publishNs = _nowNs;
+    frame.isSleeping = m_scene->GetSleepSettings().enabled;
+    frame.isDrawingContacts = m_scene->GetDrawContacts();
+
+    // the slot is reused, its vectors keep their capacity
+    frame.bodies.resize(store.Size());
+    for(size_t i = 0; i < store.Size(); ++i)
+    {
+        const Shape& shape = *store.m_shapes[i];
+        FrameBody& body = frame.bodies[i];
+        body.type = shape.GetType();
+        if(body.type == ShapeType::Circle)
+            body.size = float2(static_cast<const Circle&>(shape).GetRadius(), 0.0f);
+        else if(body.type == ShapeType::OBB)
+            body.size = static_cast<const OBB&>(shape).GetExtent();
+        else
+            body.size = float2(0.0f, 0.0f);
+
+        // the previous poses were taken after the inputs of the step, so
+        // they are in the same dense order
+        body.previousPosition = float2(m_previousX[i], m_previousY[i]);
+        body.previousOrientation = m_previousOrientation[i];
+        body.position = float2(store.m_positionX[i], store.m_positionY[i]);
+        body.orientation = store.m_orientation[i];
+    }
+
+    frame.joints.clear();
+    for(const std::shared_ptr<Joint>& joint : m_scene->GetJoints())
+    {
+        if(joint->GetBodyCount() < 2u || joint->GetBody(0)->IsValid() == false || joint->GetBody(1)->IsValid() == false)
+            continue;
+
+        FrameJointType type = FrameJointType::Other;
+        if(dynamic_cast<const SpringJoint*>(joint.get()) != nullptr)
+            type = FrameJointType::Spring;
+        else if(dynamic_cast<const DistanceJoint*>(joint.get()) != nullptr)
+            type = FrameJointType::Distance;
+        frame.joints.push_back(FrameJoint{ type, joint->GetBody(0)->GetIndex(), joint->GetBody(1)->GetIndex() });
+    }
+
+    frame.contacts.clear();
+    if(frame.isDrawingContacts)
+        frame.contacts.insert(frame.contacts.end(), m_scene->GetContacts().begin(), m_scene->GetContacts().end());
+
+    m_frames.Publish();
+}
@@ -0,0 +1,199 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    // small ids for the trace, in the order threads first record a scope
+    std::atomic<uint32_t> s_nextThread{ 0u };
+    thread_local uint32_t t_thread = ~0u;
+
+    inline uint32_t GetThreadId()
+    {
+        if(t_thread == ~0u)
+            t_thread = s_nextThread.fetch_add(1u);
+        return t_thread;
+    }
+
+    const char* const k_zoneNames[] =
+    {
+        "step",
+        "transforms",
+        "broadphase",
+        "narrowphase",
+        "narrowphase obb obb",
+        "narrowphase obb circle",
+        "narrowphase circle obb",
+        "narrowphase circle circle",
+        "solver",
+        "solver setup",
+        "solver iteration",
+        "positional correction",
+        "joints",
+        "integrate",
+    };
+    static_assert(sizeof(k_zoneNames) / sizeof(k_zoneNames[0]) == StepStats::k_zoneCount, "a zone has no name");
+
+    const char* const k_counterNames[] =
+    {
+        "broadphase pairs",
+        "pairs tested",
+        "hits",
+        "contact points",
+        "solver iterations",
+    };
+    static_assert(sizeof(k_counterNames) / sizeof(k_counterNames[0]) == StepStats::k_counterCount, "a counter has no name");
+}
+
+std::atomic<Profiler*> Profiler::s_current{ nullptr };
+
+void StepStats::Add(const StepStats& _other)
+{
+    steps += _other.steps;
+    for(size_t k = 0; k < k_zoneCount; ++k)
+    {
+        zoneNs[k] += _other.zoneNs[k];
+        zoneCalls[k] += _other.zoneCalls[k];
+    }
+    for(size_t k = 0; k < k_counterCount; ++k)
+        counters[k] += _other.counters[k];
+}
+
+Profiler::StepScope::StepScope(Profiler* _profiler)
+    : m_profiler(_profiler), m_start(0u)
+{
+    if(m_profiler == nullptr)
+        return;
+
+    m_profiler->BeginStep();
+    s_current.store(m_profiler, std::memory_order_relaxed);
+    m_start = Clock::NowNs();
+}
+
+Profiler::StepScope::~StepScope()
+{
+    if(m_profiler == nullptr)
+        return;
+
+    m_profiler->AddZone(ProfileZone::Step, m_start, Clock::NowNs());
+    s_current.store(nullptr, std::memory_order_relaxed);
+    m_profiler->EndStep();
+}
+
+Profiler::Profiler()
+    : m_zoneNs(), m_zoneCalls(), m_counters(), m_last(), m_total(),
+      m_trace(nullptr), m_isFirstEvent(true), m_traceOrigin(0u), m_eventMutex(), m_events()
+{
+    BeginStep();
+}
+
+Profiler::~Profiler()
+{
+    StopTrace();
+}
+
+const char* Profiler::GetName(ProfileZone _zone)
+{
+    return k_zoneNames[static_cast<size_t>(_zone)];
+}
+
+const char* Profiler::GetName(ProfileCounter _counter)
+{
+    return k_counterNames[static_cast<size_t>(_counter)];
+}
+
+void Profiler::BeginStep()
+{
+    for(size_t k = 0; k < StepStats::k_zoneCount; ++k)
+    {
+        m_zoneNs[k].store(0u, std::memory_order_relaxed);
+        m_zoneCalls[k].store(0u, std::memory_order_relaxed);
+    }
+    for(size_t k = 0; k < StepStats::k_counterCount; ++k)
+        m_counters[k].store(0u, std::memory_order_relaxed);
+}
+
+void Profiler::EndStep()
+{
+    // every task of the step is done by now, the job system joined them
+    m_last.steps = 1u;
+    for(size_t k = 0; k < StepStats::k_zoneCount; ++k)
+    {
+        m_last.zoneNs[k] = m_zoneNs[k].load(std::memory_order_relaxed);
+        m_last.zoneCalls[k] = m_zoneCalls[k].load(std::memory_order_relaxed);
+    }
+    for(size_t k = 0; k < StepStats::k_counterCount; ++k)
+        m_last.counters[k] = m_counters[k].load(std::memory_order_relaxed);
+    m_total.Add(m_last);
+
+    if(m_trace != nullptr)
+        WriteEvents();
+}
+
+void Profiler::AddZone(ProfileZone _zone, uint64_t _startNs, uint64_t _endNs)
+{
+    const size_t k = static_cast<size_t>(_zone);
+    m_zoneNs[k].fetch_add(_endNs - _startNs, std::memory_order_relaxed);
+    m_zoneCalls[k].fetch_add(1u, std::memory_order_relaxed);
+
+    if(m_trace != nullptr)
+    {
+        const uint32_t thread = GetThreadId();
+        std::lock_guard<std::mutex> lock(m_eventMutex);
+        m_events.push_back(TraceEvent{ _zone, thread, _startNs, _endNs });
+    }
+}
+
+void Profiler::StartTrace(const std::string& _path)
+{
+    StopTrace();
+
+    m_trace = std::fopen(_path.c_str(), "w");
+    if(m_trace == nullptr)
+        throw std::runtime_error("Error : Profiler::StartTrace : Can not open " + _path + "!");
+
+    m_isFirstEvent = true;
+    m_traceOrigin = Clock::NowNs();
+    std::fputs("[\n", m_trace);
+}
+
+void Profiler::StopTrace()
+{
+    if(m_trace == nullptr)
+        return;
+
+    std::fputs("\n]\n", m_trace);
+    std::fclose(m_trace);
+    m_trace = nullptr;
+    m_events.clear();
+}
+
+void Profiler::WriteEvents()
+{
+    // timestamps of the trace format are in microseconds
+    auto micros = [this](uint64_t _ns) { return (_ns - m_traceOrigin) * 1e-3; };
+
+    uint64_t stepEnd = m_traceOrigin;
+    for(const TraceEvent& event : m_events)
+    {
+        std::fprintf(m_trace,
+            "%s{\"name\":\"%s\",\"cat\":\"physics\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+            m_isFirstEvent ? "" : ",\n", GetName(event.zone), micros(event.startNs),
+            (event.endNs - event.startNs) * 1e-3, event.thread);
+        m_isFirstEvent = false;
+        stepEnd = std::max(stepEnd, event.endNs);
+    }
+    m_events.clear();
+
+    // the counters of the step, as a graph over the steps
+    std::fprintf(m_trace, "%s{\"name\":\"counters\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{",
+        m_isFirstEvent ? "" : ",\n", micros(stepEnd));
+    for(size_t k = 0; k < StepStats::k_counterCount; ++k)
+    {
+        std::fprintf(m_trace, "%s\"%s\":%llu", (k == 0) ? "" : ",", k_counterNames[k],
+            static_cast<unsigned long long>(m_last.counters[k]));
+    }
+    std::fputs("}}", m_trace);
+    m_isFirstEvent = false;
+}
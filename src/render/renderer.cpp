@@ -0,0 +1,231 @@
+#include "renderer.hpp"
+
+#include "GL/freeglut.h"
+
+#include "scene.hpp"
+#include "physicsthread.hpp"
+#include "circle.hpp"
+#include "obb.hpp"
+#include "joint.hpp"
+#include "util.hpp"
+
+#include <cmath>
+
+namespace
+{
+    typedef linalg::aliases::float3 float3;
+
+    // blended positions of the bodies of a frame, kept across frames
+    std::vector<float2> interpolated_positions;
+
+    void RenderCircle(float radius, float2 position, float orientation)
+    {
+        const size_t k_segments = 20;
+
+        glPushMatrix();
+        glBegin(GL_LINE_LOOP);
+        {
+            float theta = 0.0f;
+            float inc = (float)M_PI * 2.0f / k_segments;
+            for(size_t i = 0; i < k_segments; ++i)
+            {
+                theta += inc;
+                float2 p( std::cos( theta ), std::sin( theta ) );
+                p *= radius;
+                p += position;
+                glVertex2f( p.x, p.y );
+            }
+        }
+        glEnd( );
+        glPopMatrix();
+
+        glPushMatrix();
+        glPushAttrib(GL_CURRENT_BIT);
+        {
+            glBegin( GL_LINE_STRIP );
+            float c = std::cos( orientation );
+            float s = std::sin( orientation );
+            float2 r( c, s );
+            r *= radius;
+            r = r + position;
+            glColor3f(1.0f, 0.0f, 0.0f);
+            glVertex2f( position.x, position.y );
+            glVertex2f( r.x, r.y );
+            glEnd( );
+        }
+        glPopAttrib();
+        glPopMatrix();
+    }
+
+    void RenderOBB(float2 extent, float2 position, float orientation)
+    {
+        glPushMatrix();
+
+        glTranslatef(position.x, position.y, 0);
+        glRotatef(radianToDegree(orientation), 0, 0, 1);
+
+        glBegin(GL_LINE_LOOP);
+        {
+            float2 half_extent = extent / 2.0f;
+
+            glVertex2f(0 - half_extent[0], 0 - half_extent[1]);
+            glVertex2f(0 - half_extent[0], 0 + half_extent[1]);
+            glVertex2f(0 + half_extent[0], 0 + half_extent[1]);
+            glVertex2f(0 + half_extent[0], 0 - half_extent[1]);
+        }
+        glEnd();
+
+        glBegin(GL_POINTS);
+        {
+            glPushMatrix();
+
+            glVertex2f(0, 0);
+
+            glPopMatrix();
+        }
+        glEnd();
+
+        glPopMatrix();
+    }
+
+    void RenderLine(float2 position0, float2 position1, float3 color)
+    {
+        glPushMatrix();
+        glPushAttrib(GL_CURRENT_BIT);
+        {
+            glBegin(GL_LINES);
+            glColor3f(color.x, color.y, color.z);
+            glVertex2f( position0.x, position0.y );
+            glVertex2f( position1.x, position1.y );
+            glEnd();
+        }
+        glPopAttrib();
+        glPopMatrix();
+    }
+
+    void RenderContacts(const std::vector<ContactPoint>& contacts)
+    {
+        for(size_t i = 0; i < contacts.size(); ++i)
+        {
+            const ContactPoint& contact = contacts[i];
+
+            // render contact point
+            glPushAttrib(GL_CURRENT_BIT);
+            glPointSize( 4.0f );
+            glBegin(GL_POINTS);
+            {
+                glPushMatrix();
+                
+                glColor3f(1.0f, 0.0f, 0.0f);
+
+                glVertex2f(contact.position.x, contact.position.y);
+
+                glPopMatrix();
+            }
+            glEnd();
+            glPointSize( 1.0f );
+            glPopAttrib();
+            // render normal
+            glPushAttrib(GL_CURRENT_BIT);
+            glBegin(GL_LINE_STRIP);
+            {
+                glPushMatrix();
+                
+                glColor3f(0.0f, 1.0f, 0.3f);
+
+                glVertex2f(contact.position.x, contact.position.y);
+
+                glVertex2f(contact.position.x + contact.normal.x, 
+                    contact.position.y + contact.normal.y);
+
+                glPopMatrix();
+            }
+            glEnd();
+            glPopAttrib();
+        }
+    }
+}
+
+void Renderer::RenderShape(const Shape& _shape)
+{
+    switch(_shape.GetType())
+    {
+    case ShapeType::OBB:
+        RenderOBB(static_cast<const OBB&>(_shape).GetExtent(),
+            _shape.m_body->GetPosition(), _shape.m_body->GetOrientation());
+        break;
+    case ShapeType::Circle:
+        RenderCircle(static_cast<const Circle&>(_shape).GetRadius(),
+            _shape.m_body->GetPosition(), _shape.m_body->GetOrientation());
+        break;
+    default:
+        break;
+    }
+}
+
+void Renderer::RenderJoint(const Joint& _joint)
+{
+    if(_joint.GetBodyCount() < 2u)
+        return;
+
+    // red for spring joint, green for distance joint
+    float3 color(1.0f, 1.0f, 1.0f);
+    if(dynamic_cast<const SpringJoint*>(&_joint) != nullptr)
+        color = float3(1.0f, 0.0f, 0.0f);
+    else if(dynamic_cast<const DistanceJoint*>(&_joint) != nullptr)
+        color = float3(0.0f, 1.0f, 0.0f);
+
+    RenderLine(_joint.GetBody(0)->GetPosition(), _joint.GetBody(1)->GetPosition(), color);
+}
+
+void Renderer::RenderScene(const SceneBase& _scene)
+{
+    const BodyStore& store = _scene.GetBodyStore();
+    for(size_t i = 0; i < store.Size(); ++i)
+    {
+        RenderShape(*store.m_shapes[i]);
+    }
+    for(const std::shared_ptr<Joint>& joint : _scene.GetJoints())
+    {
+        RenderJoint(*joint);
+    }
+
+    if(_scene.GetDrawContacts() == false)
+        return;
+
+    // contacts are the ones published by the last step, rendering never
+    // runs collision detection on its own
+    RenderContacts(_scene.GetContacts());
+}
+
+void Renderer::RenderInterpolated(const RenderFrame& _frame, float _alpha)
+{
+    // the poses of the bodies blended between the last two steps, orientations
+    // are not wrapped so a plain blend is the shorter way
+    std::vector<float2>& positions = interpolated_positions;
+    positions.resize(_frame.bodies.size());
+    for(size_t i = 0; i < _frame.bodies.size(); ++i)
+    {
+        const FrameBody& body = _frame.bodies[i];
+        positions[i] = linalg::lerp(body.previousPosition, body.position, _alpha);
+        const float orientation = body.previousOrientation + (body.orientation - body.previousOrientation) * _alpha;
+
+        if(body.type == ShapeType::OBB)
+            RenderOBB(body.size, positions[i], orientation);
+        else if(body.type == ShapeType::Circle)
+            RenderCircle(body.size.x, positions[i], orientation);
+    }
+    for(const FrameJoint& joint : _frame.joints)
+    {
+        float3 color(1.0f, 1.0f, 1.0f);
+        if(joint.type == FrameJointType::Spring)
+            color = float3(1.0f, 0.0f, 0.0f);
+        else if(joint.type == FrameJointType::Distance)
+            color = float3(0.0f, 1.0f, 0.0f);
+        RenderLine(positions[joint.body0], positions[joint.body1], color);
+    }
+
+    // contacts are of the last step, they are not blended
+    if(_frame.isDrawingContacts)
+        RenderContacts(_frame.contacts);
+}
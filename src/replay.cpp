@@ -0,0 +1,474 @@
+#include "replay.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "circle.hpp"
+#include "obb.hpp"
+
+namespace
+{
+    typedef linalg::aliases::float2 float2;
+
+    constexpr char k_inputMagic[8] = { 'R', 'B', '2', 'D', 'I', 'N', 'P', 'T' };
+    constexpr char k_hashMagic[8] = { 'R', 'B', '2', 'D', 'H', 'A', 'S', 'H' };
+    constexpr uint32_t k_hashVersion = 1u;
+
+    struct InputHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t recordSize;
+        uint64_t stepCount;
+        uint64_t eventCount;
+    };
+    static_assert(sizeof(InputHeader) == 32, "the input header has padding");
+
+    struct EventRecord
+    {
+        uint64_t step;
+        uint32_t body;
+        uint8_t type;
+        uint8_t padding[3];
+        float value[2];
+        float size[2];
+        float scalar;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(EventRecord) == 40, "the event record has padding");
+
+    struct HashHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(HashHeader) == 16, "the hash header has padding");
+
+    // one per step, followed by the hash of every body
+    struct HashRecord
+    {
+        uint64_t step;
+        uint64_t hash;
+        uint32_t bodyCount;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(HashRecord) == 24, "the hash record has padding");
+
+    std::vector<float> BodyStore::* const k_hashedFields[] =
+    {
+        &BodyStore::m_positionX, &BodyStore::m_positionY,
+        &BodyStore::m_velocityX, &BodyStore::m_velocityY,
+        &BodyStore::m_forceX, &BodyStore::m_forceY,
+        &BodyStore::m_orientation,
+        &BodyStore::m_angularVelocity,
+        &BodyStore::m_torque,
+        &BodyStore::m_mass, &BodyStore::m_invMass,
+        &BodyStore::m_inertia, &BodyStore::m_invInertia,
+        &BodyStore::m_restitution,
+        &BodyStore::m_staticFriction, &BodyStore::m_dynamicFriction,
+        &BodyStore::m_sleepTime,
+    };
+
+    // FNV-1a over 32 bit words, then a finalizer so that close states do
+    // not give close hashes
+    constexpr uint64_t k_offsetBasis = 0xcbf29ce484222325ull;
+    constexpr uint64_t k_prime = 0x100000001b3ull;
+
+    inline uint64_t Combine(uint64_t _hash, uint32_t _word)
+    {
+        return (_hash ^ _word) * k_prime;
+    }
+
+    inline uint64_t Finalize(uint64_t _hash)
+    {
+        _hash ^= _hash >> 33;
+        _hash *= 0xff51afd7ed558ccdull;
+        _hash ^= _hash >> 33;
+        _hash *= 0xc4ceb9fe1a85ec53ull;
+        _hash ^= _hash >> 33;
+        return _hash;
+    }
+
+    inline uint32_t GetBits(float _value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &_value, sizeof(bits));
+        return bits;
+    }
+
+    std::string GetFloatText(float _value)
+    {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%.9g (0x%08x)", _value, GetBits(_value));
+        return buffer;
+    }
+}
+
+void InputRecording::Add(const InputEvent& _event)
+{
+    if(_event.type >= InputType::Count)
+    {
+        throw std::runtime_error("Error : InputRecording::Add : Unknown input type!");
+    }
+    if(m_events.empty() == false && _event.step < m_events.back().step)
+    {
+        throw std::runtime_error("Error : InputRecording::Add : Inputs are out of step order!");
+    }
+    m_events.push_back(_event);
+    m_stepCount = std::max(m_stepCount, _event.step);
+}
+
+void InputRecording::Save(const std::string& _path) const
+{
+    FILE* file = std::fopen(_path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        throw std::runtime_error("Error : InputRecording::Save : Can not open " + _path + "!");
+    }
+
+    InputHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, k_inputMagic, sizeof(k_inputMagic));
+    header.version = k_version;
+    header.recordSize = sizeof(EventRecord);
+    header.stepCount = m_stepCount;
+    header.eventCount = m_events.size();
+
+    std::vector<EventRecord> records(m_events.size());
+    std::memset(records.data(), 0, records.size() * sizeof(EventRecord));
+    for(size_t i = 0; i < m_events.size(); ++i)
+    {
+        const InputEvent& event = m_events[i];
+        EventRecord& record = records[i];
+        record.step = event.step;
+        record.body = event.body;
+        record.type = static_cast<uint8_t>(event.type);
+        record.value[0] = event.value.x;
+        record.value[1] = event.value.y;
+        record.size[0] = event.size.x;
+        record.size[1] = event.size.y;
+        record.scalar = event.scalar;
+    }
+
+    const bool isWritten = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+        std::fwrite(records.data(), sizeof(EventRecord), records.size(), file) == records.size();
+    if(std::fclose(file) != 0 || isWritten == false)
+    {
+        throw std::runtime_error("Error : InputRecording::Save : Can not write " + _path + "!");
+    }
+}
+
+InputRecording InputRecording::Load(const std::string& _path)
+{
+    FILE* file = std::fopen(_path.c_str(), "rb");
+    if(file == nullptr)
+    {
+        throw std::runtime_error("Error : InputRecording::Load : Can not open " + _path + "!");
+    }
+
+    InputHeader header;
+    if(std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, k_inputMagic, sizeof(k_inputMagic)) != 0)
+    {
+        std::fclose(file);
+        throw std::runtime_error("Error : InputRecording::Load : " + _path + " is not an input recording!");
+    }
+    if(header.version != k_version || header.recordSize != sizeof(EventRecord))
+    {
+        std::fclose(file);
+        throw std::runtime_error("Error : InputRecording::Load : Input recording version " +
+            std::to_string(header.version) + " is not supported!");
+    }
+
+    std::vector<EventRecord> records(static_cast<size_t>(header.eventCount));
+    const bool isRead = std::fread(records.data(), sizeof(EventRecord), records.size(), file) == records.size();
+    std::fclose(file);
+    if(isRead == false)
+    {
+        throw std::runtime_error("Error : InputRecording::Load : " + _path + " is truncated!");
+    }
+
+    InputRecording recording;
+    recording.m_events.reserve(records.size());
+    for(const EventRecord& record : records)
+    {
+        InputEvent event;
+        event.step = record.step;
+        event.type = static_cast<InputType>(record.type);
+        event.body = record.body;
+        event.value = float2(record.value[0], record.value[1]);
+        event.size = float2(record.size[0], record.size[1]);
+        event.scalar = record.scalar;
+        recording.Add(event);
+    }
+    if(header.stepCount < recording.m_stepCount)
+    {
+        throw std::runtime_error("Error : InputRecording::Load : " + _path + " has inputs after its last step!");
+    }
+    recording.m_stepCount = header.stepCount;
+    return recording;
+}
+
+void InputRecording::Apply(Scene& _scene, const InputEvent& _event)
+{
+    if(_event.type == InputType::SpawnCircle)
+    {
+        _scene.AddRigidBody(std::make_shared<Circle>(_event.size.x), _event.value);
+        return;
+    }
+    if(_event.type == InputType::SpawnBox)
+    {
+        _scene.AddRigidBody(std::make_shared<OBB>(_event.size), _event.value);
+        return;
+    }
+    if(_event.type == InputType::SetSleeping)
+    {
+        SleepSettings settings = _scene.GetSleepSettings();
+        settings.enabled = _event.scalar != 0.0f;
+        _scene.SetSleepSettings(settings);
+        return;
+    }
+
+    if(_event.body >= _scene.GetBodyCount())
+    {
+        throw std::runtime_error("Error : InputRecording::Apply : No body " + std::to_string(_event.body) +
+            " at step " + std::to_string(_event.step) + "!");
+    }
+    // a copy, removing the body releases the scene's reference
+    const std::shared_ptr<RigidBody2D> body = _scene.GetBody(_event.body);
+    switch(_event.type)
+    {
+    case InputType::RemoveBody: _scene.RemoveRigidBody(body); break;
+    case InputType::SetPosition: body->SetPosition(_event.value); break;
+    case InputType::SetVelocity: body->SetVelocity(_event.value); break;
+    case InputType::SetAngularVelocity: body->SetAngularVelocity(_event.scalar); break;
+    case InputType::AddForce: body->AddForce(_event.value); break;
+    default: throw std::runtime_error("Error : InputRecording::Apply : Unknown input type!");
+    }
+}
+
+uint32_t InputRecorder::IndexOf(const std::shared_ptr<RigidBody2D>& _body) const
+{
+    if(_body == nullptr || _body->IsValid() == false || m_scene.GetBody(_body->GetIndex()) != _body)
+    {
+        throw std::runtime_error("Error : InputRecorder : Body is not in the scene!");
+    }
+    return _body->GetIndex();
+}
+
+void InputRecorder::Record(const InputEvent& _event)
+{
+    // done first, an input the scene throws for is not recorded
+    InputRecording::Apply(m_scene, _event);
+    m_recording.Add(_event);
+}
+
+std::shared_ptr<RigidBody2D> InputRecorder::SpawnCircle(float2 _position, float _radius)
+{
+    Record(InputEvent{ m_step, InputType::SpawnCircle, 0u, _position, float2(_radius, 0.0f), 0.0f });
+    return m_scene.GetBody(static_cast<uint32_t>(m_scene.GetBodyCount() - 1));
+}
+
+std::shared_ptr<RigidBody2D> InputRecorder::SpawnBox(float2 _position, float2 _size)
+{
+    Record(InputEvent{ m_step, InputType::SpawnBox, 0u, _position, _size, 0.0f });
+    return m_scene.GetBody(static_cast<uint32_t>(m_scene.GetBodyCount() - 1));
+}
+
+void InputRecorder::RemoveBody(const std::shared_ptr<RigidBody2D>& _body)
+{
+    Record(InputEvent{ m_step, InputType::RemoveBody, IndexOf(_body), float2(0.0f), float2(0.0f), 0.0f });
+}
+
+void InputRecorder::SetPosition(const std::shared_ptr<RigidBody2D>& _body, float2 _position)
+{
+    Record(InputEvent{ m_step, InputType::SetPosition, IndexOf(_body), _position, float2(0.0f), 0.0f });
+}
+
+void InputRecorder::SetVelocity(const std::shared_ptr<RigidBody2D>& _body, float2 _velocity)
+{
+    Record(InputEvent{ m_step, InputType::SetVelocity, IndexOf(_body), _velocity, float2(0.0f), 0.0f });
+}
+
+void InputRecorder::SetAngularVelocity(const std::shared_ptr<RigidBody2D>& _body, float _angularVelocity)
+{
+    Record(InputEvent{ m_step, InputType::SetAngularVelocity, IndexOf(_body), float2(0.0f), float2(0.0f), _angularVelocity });
+}
+
+void InputRecorder::AddForce(const std::shared_ptr<RigidBody2D>& _body, float2 _force)
+{
+    Record(InputEvent{ m_step, InputType::AddForce, IndexOf(_body), _force, float2(0.0f), 0.0f });
+}
+
+void InputRecorder::SetSleeping(bool _enabled)
+{
+    Record(InputEvent{ m_step, InputType::SetSleeping, 0u, float2(0.0f), float2(0.0f), _enabled ? 1.0f : 0.0f });
+}
+
+void InputRecorder::Step()
+{
+    m_scene.Step();
+    ++m_step;
+    m_recording.SetStepCount(m_step);
+}
+
+void ReplayDriver::Step()
+{
+    const std::vector<InputEvent>& events = m_recording.GetEvents();
+    for(; m_next < events.size() && events[m_next].step <= m_step; ++m_next)
+        InputRecording::Apply(m_scene, events[m_next]);
+
+    m_scene.Step();
+    ++m_step;
+}
+
+uint64_t StateHasher::Hash(const BodyStore& _store, std::vector<uint32_t>* _bodyHashes)
+{
+    const size_t count = _store.Size();
+    if(_bodyHashes != nullptr)
+        _bodyHashes->resize(count);
+
+    uint64_t hash = Combine(k_offsetBasis, static_cast<uint32_t>(count));
+    for(size_t i = 0; i < count; ++i)
+    {
+        const BodyHandle handle = _store.GetHandle(static_cast<uint32_t>(i));
+        uint64_t body = Combine(Combine(k_offsetBasis, handle.index), handle.generation);
+        body = Combine(body, _store.IsAwake(static_cast<uint32_t>(i)) ? 1u : 0u);
+        for(auto field : k_hashedFields)
+            body = Combine(body, GetBits((_store.*field)[i]));
+
+        const uint32_t bodyHash = static_cast<uint32_t>(Finalize(body));
+        if(_bodyHashes != nullptr)
+            (*_bodyHashes)[i] = bodyHash;
+        hash = Combine(hash, bodyHash);
+    }
+    return Finalize(hash);
+}
+
+StateHashWriter::StateHashWriter(const std::string& _path)
+    : m_file(nullptr), m_bodyHashes()
+{
+    m_file = std::fopen(_path.c_str(), "wb");
+    if(m_file == nullptr)
+    {
+        throw std::runtime_error("Error : StateHashWriter : Can not open " + _path + "!");
+    }
+
+    HashHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, k_hashMagic, sizeof(k_hashMagic));
+    header.version = k_hashVersion;
+    if(std::fwrite(&header, sizeof(header), 1, m_file) != 1)
+    {
+        throw std::runtime_error("Error : StateHashWriter : Can not write " + _path + "!");
+    }
+}
+
+StateHashWriter::~StateHashWriter()
+{
+    if(m_file != nullptr)
+        std::fclose(m_file);
+}
+
+void StateHashWriter::Add(uint64_t _step, const BodyStore& _store)
+{
+    HashRecord record;
+    std::memset(&record, 0, sizeof(record));
+    record.step = _step;
+    record.hash = StateHasher::Hash(_store, &m_bodyHashes);
+    record.bodyCount = static_cast<uint32_t>(m_bodyHashes.size());
+
+    if(m_file == nullptr || std::fwrite(&record, sizeof(record), 1, m_file) != 1 ||
+        std::fwrite(m_bodyHashes.data(), sizeof(uint32_t), m_bodyHashes.size(), m_file) != m_bodyHashes.size())
+    {
+        throw std::runtime_error("Error : StateHashWriter::Add : Can not write the hashes of step " +
+            std::to_string(_step) + "!");
+    }
+}
+
+void StateHashWriter::Close()
+{
+    if(m_file != nullptr)
+    {
+        const bool isClosed = std::fclose(m_file) == 0;
+        m_file = nullptr;
+        if(isClosed == false)
+            throw std::runtime_error("Error : StateHashWriter::Close : Can not write the hashes!");
+    }
+}
+
+StateHashVerifier::StateHashVerifier(const std::string& _path)
+    : m_file(nullptr), m_bodyHashes(), m_referenceHashes(), m_hasDiverged(false), m_checkedCount(0u), m_report()
+{
+    m_file = std::fopen(_path.c_str(), "rb");
+    if(m_file == nullptr)
+    {
+        throw std::runtime_error("Error : StateHashVerifier : Can not open " + _path + "!");
+    }
+
+    HashHeader header;
+    if(std::fread(&header, sizeof(header), 1, m_file) != 1 ||
+        std::memcmp(header.magic, k_hashMagic, sizeof(k_hashMagic)) != 0 || header.version != k_hashVersion)
+    {
+        std::fclose(m_file);
+        throw std::runtime_error("Error : StateHashVerifier : " + _path + " is not a hash file of this version!");
+    }
+}
+
+StateHashVerifier::~StateHashVerifier()
+{
+    if(m_file != nullptr)
+        std::fclose(m_file);
+}
+
+bool StateHashVerifier::Check(uint64_t _step, const BodyStore& _store)
+{
+    if(m_hasDiverged)
+        return false;
+
+    HashRecord record;
+    if(std::fread(&record, sizeof(record), 1, m_file) != 1)
+    {
+        m_hasDiverged = true;
+        m_report = "step " + std::to_string(_step) + " : the reference ends before it";
+        return false;
+    }
+    m_referenceHashes.resize(record.bodyCount);
+    if(std::fread(m_referenceHashes.data(), sizeof(uint32_t), record.bodyCount, m_file) != record.bodyCount)
+    {
+        m_hasDiverged = true;
+        m_report = "step " + std::to_string(_step) + " : the reference is truncated";
+        return false;
+    }
+
+    const uint64_t hash = StateHasher::Hash(_store, &m_bodyHashes);
+    if(record.step != _step)
+    {
+        m_hasDiverged = true;
+        m_report = "step " + std::to_string(_step) + " : the reference has step " + std::to_string(record.step) + " here";
+        return false;
+    }
+    ++m_checkedCount;
+    if(hash == record.hash && m_bodyHashes == m_referenceHashes)
+        return true;
+
+    m_hasDiverged = true;
+    m_report = "step " + std::to_string(_step) + " : ";
+    for(size_t i = 0; i < std::min(m_bodyHashes.size(), m_referenceHashes.size()); ++i)
+    {
+        if(m_bodyHashes[i] == m_referenceHashes[i])
+            continue;
+        // the reference only has hashes, the values are this run's
+        const BodyHandle handle = _store.GetHandle(static_cast<uint32_t>(i));
+        m_report += "body " + std::to_string(i) + " (slot " + std::to_string(handle.index) +
+            ") differs, it has position " + GetFloatText(_store.m_positionX[i]) + ", " +
+            GetFloatText(_store.m_positionY[i]) + " velocity " + GetFloatText(_store.m_velocityX[i]) + ", " +
+            GetFloatText(_store.m_velocityY[i]);
+        return false;
+    }
+    m_report += std::to_string(m_bodyHashes.size()) + " bodies where the reference has " +
+        std::to_string(m_referenceHashes.size());
+    return false;
+}
@@ -4,134 +4,326 @@
 #include "shape.hpp"
 #include "integrator.hpp"
 
-#include "GL/freeglut.h"
-
+#include <algorithm>
 #include <iostream>
 
-void Scene::Step()
+namespace
+{
+	// keeps the pairs with an active body in '_pairs' and moves the others
+	// to the end of '_inactive', both in the order they had
+	void SplitActivePairs(const BodyStore& _bodies, std::vector<BodyPair>& _pairs, std::vector<BodyPair>& _inactive)
+	{
+		size_t active = 0u;
+		for (const BodyPair& pair : _pairs)
+		{
+			if (_bodies.IsActive(pair.first) || _bodies.IsActive(pair.second))
+				_pairs[active++] = pair;
+			else
+				_inactive.push_back(pair);
+		}
+		_pairs.resize(active);
+	}
+
+	// fewer joints than this are applied by one thread (in the order of
+	// their colors all the same)
+	constexpr size_t k_minParallelJoints = 64u;
+	// bodies are cheap to update, smaller pieces are not worth a task
+	constexpr size_t k_bodyGrain = 256u;
+	constexpr size_t k_jointGrain = 32u;
+}
+
+void SceneBase::EndStep()
 {
-	Solve();
-	Integrate();
+	// After integrating, the velocities are what the bodies actually moved
+	// by, a resting body leaves the solver with the velocity that cancels
+	// gravity. This is done once per step, the runge kutta integrator calls
+	// Solve() a few times.
+	if (m_sleepSettings.enabled)
+		UpdateSleeping();
+
+	if (m_recorder)
+		m_recorder->Record(m_store);
+
+	m_hasPairs = false;
 }
 
-void Scene::Solve()
+void SceneBase::FindContacts(bool _reusePairs)
 {
-	// First : Generate manifolds
-	for (size_t i = 0; i < m_bodies.size(); ++i)
+	// Set aside pairs where no body moves, bodies changed by the user since
+	// the last step wake their islands first (reused pairs were split
+	// already)
+	if (m_sleepSettings.enabled && _reusePairs == false)
 	{
-		for (size_t j = i + 1; j < m_bodies.size(); ++j)
-		{
-			Manifold manifold =
-				m_bodies[i]->GetShape()->accept(*m_bodies[j]->GetShape());
+		m_islands.WakeRequested(m_store);
 
-			// put the manifold into resolve queue only if it's a hit
-			if (manifold.m_isHit == true)
-				m_manifolds.push_back(manifold);
-		}
+		m_sleepingPairs.clear();
+		SplitActivePairs(m_store, m_pairs, m_sleepingPairs);
+	}
+
+	// Then : Generate manifolds, one batch per shape pair type. The buffer
+	// keeps its capacity across steps, so this only allocates while the
+	// number of pairs keeps growing
+	m_manifolds.reserve(m_pairs.size());
+	{
+		StageScope stage(*this, SceneStage::Narrowphase);
+		Collide(m_pairs);
+
+		if (m_sleepSettings.enabled)
+			WakeTouchedIslands(0u);
+	}
+
+	// Then : Find out which pairs began, kept or stopped touching
+	m_islandLinks.clear();
+	m_contactPointCount = 0u;
+	m_pairCache.BeginFrame(m_manifolds.size());
+	for (size_t i = 0; i < m_manifolds.size(); ++i)
+	{
+		if (m_manifolds[i].m_contactPointCount == 0)
+			continue;
+		m_contactPointCount += m_manifolds[i].m_contactPointCount;
+		m_pairCache.Touch(PairCache::MakeKey(
+			m_store.GetHandle(m_manifolds[i].m_body0), m_store.GetHandle(m_manifolds[i].m_body1)));
+
+		if (m_sleepSettings.enabled)
+			m_islandLinks.push_back(BodyPair{ m_manifolds[i].m_body0, m_manifolds[i].m_body1 });
+	}
+	// sleeping pairs were not tested, they still touch like they did
+	for (const BodyPair& pair : m_sleepingPairs)
+	{
+		m_pairCache.Keep(PairCache::MakeKey(m_store.GetHandle(pair.first), m_store.GetHandle(pair.second)));
+	}
+	m_pairCache.EndFrame();
+
+	PROFILE_COUNT(ProfileCounter::Hits, m_manifolds.size());
+	PROFILE_COUNT(ProfileCounter::ContactPoints, m_contactPointCount);
+}
+
+void SceneBase::EndSolve()
+{
+	// Preprocess : apply joint constraint, unless all of its bodies sleep
+	// (or are static)
+	{
+		StageScope stage(*this, SceneStage::Joints);
+		ApplyJoints();
 	}
 
-	// Then : Resolve impulses by manifolds
-	for (size_t iteration = 0; iteration < m_iterations; ++iteration)
+	// Publish the contacts of this step, only needed for drawing them
+	if (m_drawContacts)
 	{
+		m_contacts.clear();
 		for (size_t i = 0; i < m_manifolds.size(); ++i)
 		{
-			m_manifolds[i].Resolve();
+			for (int k = 0; k < m_manifolds[i].m_contactPointCount; ++k)
+			{
+				m_contacts.push_back(ContactPoint{ 
+					m_manifolds[i].m_contactPoints[k], 
+					m_manifolds[i].m_normal, 
+					m_manifolds[i].m_penetration });
+			}
 		}
 	}
 
-	// Then : Do positional correction
-	for (size_t i = 0; i < m_manifolds.size(); ++i)
+	// Remember to clear the manifolds
+	m_manifolds.clear();
+	m_hasPairs = true;
+}
+
+void SceneBase::Collide(const std::vector<BodyPair>& _pairs)
+{
+	PROFILE_COUNT(ProfileCounter::PairsTested, _pairs.size());
+	CollisionHelper::SortPairsByShapeType(m_store, _pairs, m_sortedPairs, m_batchOffsets);
+	CollisionHelper::CollideParallel(m_jobs.get(), m_store,
+		m_sortedPairs, m_batchOffsets, m_narrowphaseBuffers, m_manifolds);
+}
+
+void SceneBase::ColorJoints()
+{
+	// zero outside of this function, only the entries of joint bodies are
+	// cleared again at the end
+	m_jointBodyColors.resize(m_store.Size(), 0u);
+	m_jointColors.resize(m_joints.size());
+
+	std::array<uint32_t, k_maxJointColors + 1> counts = {};
+	for (size_t i = 0; i < m_joints.size(); ++i)
 	{
-		m_manifolds[i].PositionalCorrection();
+		const Joint& joint = *m_joints[i];
+
+		// a joint that touches a sleeping body wakes it, which is not
+		// something to do from several threads
+		uint32_t used = 0u;
+		bool isSerial = false;
+		for (size_t k = 0; k < joint.GetBodyCount(); ++k)
+		{
+			const uint32_t body = joint.GetBody(k)->GetIndex();
+			used |= m_jointBodyColors[body];
+			isSerial = isSerial || (m_store.IsAwake(body) == false);
+		}
+
+		uint32_t color = k_maxJointColors;
+		if (isSerial == false && used != ~0u)
+		{
+			// the lowest free color
+			color = 0u;
+			while (used & (1u << color))
+				++color;
+
+			for (size_t k = 0; k < joint.GetBodyCount(); ++k)
+				m_jointBodyColors[joint.GetBody(k)->GetIndex()] |= 1u << color;
+		}
+
+		m_jointColors[i] = static_cast<uint8_t>(color);
+		++counts[color];
 	}
 
-	// Preprocess : apply joint constraint
+	// counting sort by color, the serial group last
+	m_jointColorOffsets[0] = 0u;
+	for (uint32_t k = 0; k <= k_maxJointColors; ++k)
+		m_jointColorOffsets[k + 1] = m_jointColorOffsets[k] + counts[k];
+
+	std::array<uint32_t, k_maxJointColors + 1> cursor;
+	std::copy(m_jointColorOffsets.begin(), m_jointColorOffsets.end() - 1, cursor.begin());
+	m_coloredJoints.resize(m_joints.size());
 	for (size_t i = 0; i < m_joints.size(); ++i)
+		m_coloredJoints[cursor[m_jointColors[i]]++] = static_cast<uint32_t>(i);
+
+	for (const JointRef& joint : m_joints)
 	{
-		m_joints[i]->ApplyConstriant();
+		for (size_t k = 0; k < joint->GetBodyCount(); ++k)
+			m_jointBodyColors[joint->GetBody(k)->GetIndex()] = 0u;
 	}
+}
 
-	// Remember to clear the manifolds
-	m_manifolds.clear();
+void SceneBase::ApplyJoints()
+{
+	auto apply = [this](size_t _joint)
+	{
+		const Joint& joint = *m_joints[_joint];
+		bool isActive = false;
+		for (size_t k = 0; k < joint.GetBodyCount(); ++k)
+			isActive = isActive || m_store.IsActive(joint.GetBody(k)->GetIndex());
+
+		if (isActive)
+			joint.ApplyConstriant();
+	};
+
+	if (m_joints.empty())
+		return;
+
+	// Joints add to the forces and velocities of their bodies, a body with
+	// two joints gets a different sum depending on which comes first. So
+	// they are applied in the order of their colors with or without a job
+	// system, and a step gives the same bits for any number of threads.
+	ColorJoints();
+	const bool isParallel = m_jobs != nullptr && m_joints.size() >= k_minParallelJoints;
+	for (uint32_t color = 0; color <= k_maxJointColors; ++color)
+	{
+		const uint32_t begin = m_jointColorOffsets[color];
+		const uint32_t count = m_jointColorOffsets[color + 1] - begin;
+		if (color == k_maxJointColors || isParallel == false)
+		{
+			for (uint32_t i = begin; i < begin + count; ++i)
+				apply(m_coloredJoints[i]);
+			continue;
+		}
+
+		m_jobs->ParallelFor(count, [&](size_t _begin, size_t _end, size_t)
+		{
+			for (size_t i = begin + _begin; i < begin + _end; ++i)
+				apply(m_coloredJoints[i]);
+		}, k_jointGrain);
+	}
 }
 
-void Scene::Integrate()
+void SceneBase::WakeTouchedIslands(size_t _first)
 {
-	// integrate
-	m_integrator->Integrate(*this);
+	while (true)
+	{
+		// a sleeping body touched by an awake one wakes its whole island,
+		// static bodies never sleep so they do not wake anything
+		bool isWoken = false;
+		for (size_t i = _first; i < m_manifolds.size(); ++i)
+		{
+			const Manifold& manifold = m_manifolds[i];
+			if (manifold.m_contactPointCount == 0)
+				continue;
+
+			const uint32_t a = manifold.m_body0;
+			const uint32_t b = manifold.m_body1;
+			if (m_store.IsAwake(a) != m_store.IsAwake(b))
+			{
+				m_islands.WakeIsland(m_store, m_store.m_sleepingIsland[m_store.IsAwake(a) ? b : a]);
+				isWoken = true;
+			}
+		}
+		if (isWoken == false)
+			return;
+
+		// the woken bodies were not tested yet, do it now so the solver
+		// sees their contacts in this step already
+		m_wokenPairs.swap(m_sleepingPairs);
+		m_sleepingPairs.clear();
+		SplitActivePairs(m_store, m_wokenPairs, m_sleepingPairs);
+
+		_first = m_manifolds.size();
+		Collide(m_wokenPairs);
+		// the bodies stay awake for the rest of the step, Solve(true) has
+		// to see these pairs too
+		m_pairs.insert(m_pairs.end(), m_wokenPairs.begin(), m_wokenPairs.end());
+	}
 }
 
-void Scene::Render() const
+void SceneBase::UpdateSleeping()
 {
-    for(size_t i = 0; i < m_bodies.size(); ++i)
-    {
-        m_bodies[i]->GetShape()->Render();
-    }
-    for(size_t i = 0; i < m_joints.size(); ++i)
-    {
-        m_joints[i]->Render();
-    }
+	// joints hold their bodies in one island, like contacts do
+	for (const JointRef& joint : m_joints)
+	{
+		for (size_t k = 1; k < joint->GetBodyCount(); ++k)
+		{
+			m_islandLinks.push_back(BodyPair{ 
+				joint->GetBody(0)->GetIndex(), joint->GetBody(k)->GetIndex() });
+		}
+	}
 
-    for(size_t i = 0; i < m_bodies.size(); ++i)
-    {
-        for(size_t j = i + 1; j < m_bodies.size(); ++j)
-        {
-            Manifold manifold = 
-                m_bodies[i]->GetShape()->accept(*m_bodies[j]->GetShape());
+	m_islands.Update(m_store, m_islandLinks, m_deltaTime, m_sleepSettings);
+}
 
-            if(manifold.m_isHit == true)
-                m_manifolds.push_back(manifold);
-        }
-    }
+void SceneBase::SetSleepSettings(const SleepSettings& _settings)
+{
+	m_sleepSettings = _settings;
+	// woken bodies would miss their pairs in Solve(true)
+	m_hasPairs = false;
+	if (m_sleepSettings.enabled == false)
+		m_islands.WakeAll(m_store);
+}
 
-    for(size_t i = 0; i < m_manifolds.size(); ++i)
-    {
-        if(m_manifolds[i].m_isHit == false)
-            continue;
-        for(int k = 0; k < m_manifolds[i].m_contactPointCount; ++k)
-        {
-            // render contact point
-            glPushAttrib(GL_CURRENT_BIT);
-            glPointSize( 4.0f );
-            glBegin(GL_POINTS);
-            {
-                glPushMatrix();
-                
-                glColor3f(1.0f, 0.0f, 0.0f);
-
-                glVertex2f(m_manifolds[i].m_contactPoints[k].x, 
-                    m_manifolds[i].m_contactPoints[k].y);
-
-                glPopMatrix();
-            }
-            glEnd();
-            glPointSize( 1.0f );
-            glPopAttrib();
-            // render normal
-            glPushAttrib(GL_CURRENT_BIT);
-            glBegin(GL_LINE_STRIP);
-            {
-                glPushMatrix();
-                
-                glColor3f(0.0f, 1.0f, 0.3f);
-
-                glVertex2f(m_manifolds[i].m_contactPoints[k].x, 
-                    m_manifolds[i].m_contactPoints[k].y);
-
-                glVertex2f(m_manifolds[i].m_contactPoints[k].x + m_manifolds[i].m_normal.x, 
-                    m_manifolds[i].m_contactPoints[k].y + m_manifolds[i].m_normal.y);
-
-                glPopMatrix();
-            }
-            glEnd();
-            glPopAttrib();
-        }
-    }
-    
-    m_manifolds.clear();
+void SceneBase::ResetStageStats()
+{
+	for (JobStats& stats : m_stageStats)
+		stats.Reset();
+	m_stageNs.fill(0u);
 }
 
-std::shared_ptr<RigidBody2D> Scene::AddRigidBody(const std::shared_ptr<Shape>& _shape, float2 _position)
+void SceneBase::UpdateTransforms()
+{
+	ParallelFor(m_jobs.get(), m_store.Size(), [this](size_t _begin, size_t _end, size_t)
+	{
+		for (uint32_t i = static_cast<uint32_t>(_begin); i < _end; ++i)
+		{
+			if (m_store.m_transformDirty[i])
+				m_store.UpdateTransform(i);
+		}
+	}, k_bodyGrain);
+}
+
+void SceneBase::SetDrawContacts(bool _enabled)
+{
+    m_drawContacts = _enabled;
+    // drop the old snapshot, it would be stale once drawing is turned on again
+    if(m_drawContacts == false)
+        m_contacts.clear();
+}
+
+std::shared_ptr<RigidBody2D> SceneBase::AddRigidBody(const std::shared_ptr<Shape>& _shape, float2 _position)
 {
     if(_shape->m_body != nullptr)
     {
@@ -140,16 +332,119 @@ std::shared_ptr<RigidBody2D> Scene::AddRigidBody(const std::shared_ptr<Shape>& _
         return nullptr;
     }
 
-    std::shared_ptr<RigidBody2D> body = 
-        std::make_shared<RigidBody2D>(_shape, _position, 0.2f, 1.0f, 0.5f, 0.3f);
+    const BodyHandle handle = m_store.Create(_shape, _position, 0.2f, 1.0f, 0.5f, 0.3f);
+    std::shared_ptr<RigidBody2D> body = std::make_shared<RigidBody2D>(&m_store, handle);
 
     _shape->m_body = body;
 
     m_bodies.push_back(body);
+    m_hasPairs = false;
     return body;
 }
 
-void Scene::AddJoint(const std::shared_ptr<Joint>& _joint)
+void SceneBase::RemoveRigidBody(const std::shared_ptr<RigidBody2D>& _body, Broadphase& _broadphase)
+{
+    if(_body == nullptr || m_store.IsValid(_body->GetHandle()) == false)
+    {
+        throw std::runtime_error("Error : Scene::RemoveRigidBody : Body is not in the scene!");
+    }
+
+    // '_body' might be one of the references released below
+    const BodyHandle handle = _body->GetHandle();
+    const uint32_t index = m_store.GetIndex(handle);
+    const uint32_t last = static_cast<uint32_t>(m_store.Size() - 1);
+
+    // bodies resting on this one should not keep hanging in the air
+    if(m_sleepSettings.enabled)
+    {
+        std::vector<uint32_t> neighbours;
+        _broadphase.Query(m_store.m_shapes[index]->GetAABB(), neighbours);
+        for(uint32_t neighbour : neighbours)
+        {
+            if(neighbour < m_store.Size())
+                m_store.Wake(neighbour);
+        }
+        m_store.Wake(index);
+        m_islands.WakeRequested(m_store);
+    }
+
+    // the shape can be given to a new body again
+    m_store.m_shapes[index]->m_body = nullptr;
+    // its slot is reused by the next body, so its pairs have to go now
+    m_pairCache.RemoveBody(handle);
+    m_store.Destroy(handle);
+
+    // keep the views in the dense order of the store
+    m_bodies[index] = m_bodies[last];
+    m_bodies.pop_back();
+
+    _broadphase.RemoveBody(index, last);
+    m_hasPairs = false;
+}
+
+std::vector<std::shared_ptr<RigidBody2D>> SceneBase::QueryRegion(const AABB& _region, const Broadphase& _broadphase) const
 {
+    std::vector<uint32_t> candidates;
+    _broadphase.Query(_region, candidates);
+
+    // the broadphase answers with the bounds of the last step (or fattened
+    // ones), so check the candidates again with their current bounds
+    std::vector<std::shared_ptr<RigidBody2D>> result;
+    for(uint32_t index : candidates)
+    {
+        if(index < m_bodies.size() && m_store.m_shapes[index]->GetAABB().Overlaps(_region))
+            result.push_back(m_bodies[index]);
+    }
+    return result;
+}
+
+bool SceneBase::RayCast(float2 _from, float2 _to, RayCastHit& _hit, const Broadphase& _broadphase) const
+{
+    std::vector<uint32_t> candidates;
+    _broadphase.RayCast(_from, _to, candidates);
+
+    bool isHit = false;
+    _hit.fraction = 1.0f;
+    for(uint32_t index : candidates)
+    {
+        if(index >= m_bodies.size())
+            continue;
+
+        float fraction;
+        float2 normal;
+        if(m_store.m_shapes[index]->RayCast(_from, _to, fraction, normal) && fraction <= _hit.fraction)
+        {
+            isHit = true;
+            _hit.body = m_bodies[index];
+            _hit.fraction = fraction;
+            _hit.normal = normal;
+        }
+    }
+
+    if(isHit)
+        _hit.point = _from + _hit.fraction * (_to - _from);
+    return isHit;
+}
+
+void SceneBase::AddJoint(const std::shared_ptr<Joint>& _joint)
+{
+    for(size_t k = 0; k < _joint->GetBodyCount(); ++k)
+        _joint->GetBody(k)->Wake();
     m_joints.push_back(_joint);
+}
+
+void SceneBase::RemoveJoint(const std::shared_ptr<Joint>& _joint)
+{
+    auto it = std::find(m_joints.begin(), m_joints.end(), _joint);
+    if(it == m_joints.end())
+    {
+        throw std::runtime_error("Error : Scene::RemoveJoint : Joint is not in the scene!");
+    }
+
+    for(size_t k = 0; k < _joint->GetBodyCount(); ++k)
+    {
+        if(_joint->GetBody(k)->IsValid())
+            _joint->GetBody(k)->Wake();
+    }
+    m_joints.erase(it);
 }
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "scenebatch.hpp"
+
+#include <stdexcept>
+
+#include "scene.hpp"
+#include "shape.hpp"
+
+namespace
+{
+    // the per body fields a world starts with, all that stepping (or the
+    // user) can change
+    std::vector<float> BodyStore::* const k_fields[] =
+    {
+        &BodyStore::m_positionX, &BodyStore::m_positionY,
+        &BodyStore::m_velocityX, &BodyStore::m_velocityY,
+        &BodyStore::m_forceX, &BodyStore::m_forceY,
+        &BodyStore::m_orientation,
+        &BodyStore::m_angularVelocity,
+        &BodyStore::m_torque,
+        &BodyStore::m_mass, &BodyStore::m_invMass,
+        &BodyStore::m_inertia, &BodyStore::m_invInertia,
+        &BodyStore::m_restitution,
+        &BodyStore::m_staticFriction, &BodyStore::m_dynamicFriction,
+        &BodyStore::m_sleepTime,
+    };
+    constexpr size_t k_fieldCount = sizeof(k_fields) / sizeof(k_fields[0]);
+
+    // a range of worlds should have about this many bodies to be worth a
+    // task
+    constexpr size_t k_bodyGrain = 256u;
+}
+
+SceneBatch::SceneBatch(float _dt, uint32_t _iterations, IntegratorKernels::Method _method,
+    const std::shared_ptr<JobSystem>& _jobs)
+    : m_deltaTime(_dt), m_iterations(_iterations), m_method(_method),
+      m_simdLevel(IntegratorKernels::GetSupportedLevel()), m_jobs(_jobs),
+      m_store(), m_worlds(), m_sweepOrder(), m_initial(k_fieldCount), m_scratch()
+{
+}
+
+size_t SceneBatch::AddWorld(const SceneBase& _scene)
+{
+    if(_scene.GetJoints().empty() == false)
+    {
+        throw std::runtime_error("Error : SceneBatch::AddWorld : Joints are not supported!");
+    }
+
+    const BodyStore& bodies = _scene.GetBodyStore();
+    const uint32_t offset = static_cast<uint32_t>(m_store.Size());
+    const uint32_t count = static_cast<uint32_t>(bodies.Size());
+    m_store.Reserve(offset + count);
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        m_store.Create(bodies.m_shapes[i], bodies.GetPosition(i), bodies.m_restitution[i],
+            bodies.m_mass[i], bodies.m_staticFriction[i], bodies.m_dynamicFriction[i]);
+        m_sweepOrder.push_back(offset + i);
+    }
+
+    for(size_t k = 0; k < k_fieldCount; ++k)
+    {
+        const std::vector<float>& from = bodies.*k_fields[k];
+        std::vector<float>& to = m_store.*k_fields[k];
+        std::copy(from.begin(), from.end(), to.begin() + offset);
+        m_initial[k].insert(m_initial[k].end(), from.begin(), from.end());
+    }
+
+    m_worlds.push_back(World{ offset, count });
+    return m_worlds.size() - 1u;
+}
+
+void SceneBatch::Reserve(size_t _worldCount, size_t _bodyCount)
+{
+    m_worlds.reserve(_worldCount);
+    m_store.Reserve(_bodyCount);
+    m_sweepOrder.reserve(_bodyCount);
+    for(std::vector<float>& field : m_initial)
+        field.reserve(_bodyCount);
+}
+
+void SceneBatch::ResetWorld(size_t _world)
+{
+    const World& world = m_worlds[_world];
+    for(size_t k = 0; k < k_fieldCount; ++k)
+    {
+        const float* from = m_initial[k].data() + world.offset;
+        std::copy(from, from + world.count, (m_store.*k_fields[k]).begin() + world.offset);
+    }
+    for(uint32_t i = world.offset; i < world.offset + world.count; ++i)
+    {
+        m_store.m_transformDirty[i] = 1u;
+        m_sweepOrder[i] = i;
+    }
+}
+
+void SceneBatch::Reset()
+{
+    for(size_t w = 0; w < m_worlds.size(); ++w)
+        ResetWorld(w);
+}
+
+void SceneBatch::FindPairs(const World& _world, std::vector<BodyPair>& _pairs)
+{
+    uint32_t* order = m_sweepOrder.data() + _world.offset;
+    const BodyTransformCache* transforms = m_store.m_transforms.data();
+
+    // insertion sort by the left side, the order of the last step is
+    // almost sorted already
+    for(uint32_t i = 1; i < _world.count; ++i)
+    {
+        const uint32_t body = order[i];
+        const float key = transforms[body].bounds.min.x;
+        uint32_t k = i;
+        for(; k > 0 && transforms[order[k - 1]].bounds.min.x > key; --k)
+            order[k] = order[k - 1];
+        order[k] = body;
+    }
+
+    // sweep, then put the pairs in the order the brute force broadphase
+    // finds them in, which is the order the scene would solve them in
+    _pairs.clear();
+    for(uint32_t i = 0; i < _world.count; ++i)
+    {
+        const AABB& bounds = transforms[order[i]].bounds;
+        for(uint32_t k = i + 1; k < _world.count && transforms[order[k]].bounds.min.x <= bounds.max.x; ++k)
+        {
+            if(bounds.Overlaps(transforms[order[k]].bounds))
+                _pairs.push_back(BodyPair{ std::min(order[i], order[k]), std::max(order[i], order[k]) });
+        }
+    }
+    std::sort(_pairs.begin(), _pairs.end());
+}
+
+void SceneBatch::StepWorld(const World& _world, Scratch& _scratch)
+{
+	// First : Refresh the world space data of the bodies moved last step
+	for (uint32_t i = _world.offset; i < _world.offset + _world.count; ++i)
+	{
+		if (m_store.m_transformDirty[i])
+			m_store.UpdateTransform(i);
+	}
+
+	// Then : Find pairs and generate manifolds, one batch per shape pair type
+	FindPairs(_world, _scratch.pairs);
+	CollisionHelper::SortPairsByShapeType(m_store, _scratch.pairs, _scratch.sortedPairs, _scratch.batchOffsets);
+	_scratch.manifolds.clear();
+	_scratch.manifolds.reserve(_scratch.sortedPairs.size());
+	for (size_t k = 0; k < CollisionHelper::k_shapePairCount; ++k)
+	{
+		const size_t begin = _scratch.batchOffsets[k];
+		const size_t count = _scratch.batchOffsets[k + 1] - begin;
+		if (count > 0u)
+			CollisionHelper::CollideBatch(k, m_store, _scratch.sortedPairs.data() + begin, count, _scratch.manifolds);
+	}
+
+	// Then : Resolve impulses by manifolds, and correct positions, like
+	// ImpulseSolver
+	for (uint32_t iteration = 0; iteration < m_iterations; ++iteration)
+	{
+		for (const Manifold& manifold : _scratch.manifolds)
+			manifold.Resolve(m_store);
+	}
+	for (const Manifold& manifold : _scratch.manifolds)
+		manifold.PositionalCorrection(m_store);
+}
+
+void SceneBatch::Step()
+{
+    if(m_worlds.empty())
+        return;
+
+    const size_t threadCount = m_jobs ? m_jobs->GetThreadCount() : 1u;
+    if(m_scratch.size() < threadCount)
+        m_scratch.resize(threadCount);
+
+    const IntegratorKernels::Kernel kernel = IntegratorKernels::Get(m_method, m_simdLevel);
+    const float2 gravity(0.0f, -9.8f);
+    const size_t grain = std::max<size_t>(1u, k_bodyGrain * m_worlds.size() / std::max<size_t>(m_store.Size(), 1u));
+
+    ParallelFor(m_jobs.get(), m_worlds.size(), [&](size_t _begin, size_t _end, size_t _thread)
+    {
+        for(size_t w = _begin; w < _end; ++w)
+            StepWorld(m_worlds[w], m_scratch[_thread]);
+
+        // the worlds of a range are next to each other in the store
+        const uint32_t first = m_worlds[_begin].offset;
+        const uint32_t last = m_worlds[_end - 1].offset + m_worlds[_end - 1].count;
+        kernel(m_store, first, last, m_deltaTime, gravity);
+    }, grain);
+}
@@ -0,0 +1,531 @@
+#include "snapshot.hpp"
+
+#include "circle.hpp"
+#include "obb.hpp"
+#include "joint.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    typedef linalg::aliases::float2 float2;
+
+    constexpr char k_magic[8] = { 'R', 'B', '2', 'D', 'S', 'N', 'A', 'P' };
+    constexpr size_t k_alignment = 64u;
+
+    // the float fields of a body, one section each in this order
+    std::vector<float> BodyStore::* const k_floatFields[] =
+    {
+        &BodyStore::m_positionX, &BodyStore::m_positionY,
+        &BodyStore::m_velocityX, &BodyStore::m_velocityY,
+        &BodyStore::m_forceX, &BodyStore::m_forceY,
+        &BodyStore::m_orientation,
+        &BodyStore::m_angularVelocity,
+        &BodyStore::m_torque,
+        &BodyStore::m_mass, &BodyStore::m_invMass,
+        &BodyStore::m_inertia, &BodyStore::m_invInertia,
+        &BodyStore::m_restitution,
+        &BodyStore::m_staticFriction, &BodyStore::m_dynamicFriction,
+        &BodyStore::m_sleepTime,
+    };
+    constexpr size_t k_floatFieldCount = sizeof(k_floatFields) / sizeof(k_floatFields[0]);
+
+    // the sections after the float fields
+    enum Section : size_t
+    {
+        k_sleepingIslandSection = k_floatFieldCount,
+        k_shapeTypeSection,
+        // OBB extent, or circle radius and 0
+        k_shapeSizeSection,
+        k_jointSection,
+        k_sectionCount
+    };
+
+    enum IntegratorKind : uint8_t { k_explicitEuler, k_symplecticEuler, k_newton, k_rungeKuttaFourth };
+    enum BroadphaseKind : uint8_t { k_bruteForce, k_uniformGrid, k_sweepAndPrune, k_dynamicTree };
+    enum SolverKind : uint8_t { k_impulse, k_graphColoring, k_sequentialImpulse };
+    enum JointKind : uint32_t { k_springJoint, k_distanceJoint };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t fileSize;
+        uint64_t bodyCount;
+        uint64_t jointCount;
+
+        float deltaTime;
+        uint32_t iterations;
+        uint8_t integrator;
+        uint8_t contactMode;
+        uint8_t broadphase;
+        uint8_t solver;
+        // the cell size of the grid or the margin of the tree
+        float broadphaseParameter;
+        float baumgarte;
+        float slop;
+        uint8_t warmStarting;
+        uint8_t sleepEnabled;
+        uint8_t padding[2];
+        float linearTolerance;
+        float angularTolerance;
+        float timeToSleep;
+        uint32_t sectionCount;
+        uint32_t reserved;
+
+        uint64_t sectionOffsets[k_sectionCount];
+    };
+    static_assert(sizeof(Header) == 88 + 8 * k_sectionCount, "the header has padding");
+
+    struct JointRecord
+    {
+        uint32_t kind;
+        uint32_t body0;
+        uint32_t body1;
+        float restLength;
+        // stiffness of a spring, time step of a distance joint
+        float parameter;
+    };
+    static_assert(sizeof(JointRecord) == 20, "the joint record has padding");
+
+    inline bool IsLittleEndian()
+    {
+        const uint32_t value = 1u;
+        uint8_t first;
+        std::memcpy(&first, &value, 1);
+        return first == 1u;
+    }
+
+    inline uint64_t Align(uint64_t _offset)
+    {
+        return (_offset + k_alignment - 1u) & ~static_cast<uint64_t>(k_alignment - 1u);
+    }
+
+    uint64_t GetSectionSize(size_t _section, uint64_t _bodyCount, uint64_t _jointCount)
+    {
+        switch(_section)
+        {
+        case k_sleepingIslandSection: return _bodyCount * sizeof(uint32_t);
+        case k_shapeTypeSection: return _bodyCount * sizeof(uint8_t);
+        case k_shapeSizeSection: return _bodyCount * sizeof(float2);
+        case k_jointSection: return _jointCount * sizeof(JointRecord);
+        default: return _bodyCount * sizeof(float);
+        }
+    }
+
+    // fills the offsets of '_header' from its counts, returns the file size
+    uint64_t Layout(Header& _header)
+    {
+        uint64_t offset = Align(sizeof(Header));
+        uint64_t end = offset;
+        for(size_t k = 0; k < k_sectionCount; ++k)
+        {
+            _header.sectionOffsets[k] = offset;
+            end = offset + GetSectionSize(k, _header.bodyCount, _header.jointCount);
+            offset = Align(end);
+        }
+        return end;
+    }
+
+    Header MakeHeader(const Scene& _scene)
+    {
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, k_magic, sizeof(k_magic));
+        header.version = SceneSnapshot::k_version;
+        header.headerSize = sizeof(Header);
+        header.bodyCount = _scene.GetBodyCount();
+        header.jointCount = _scene.GetJoints().size();
+        header.deltaTime = _scene.GetDeltaTime();
+        header.iterations = _scene.GetIterations();
+
+        const Integrator* integrator = _scene.GetIntegrator().get();
+        if(dynamic_cast<const ExplicitEulerIntegrator*>(integrator) != nullptr)
+            header.integrator = k_explicitEuler;
+        else if(dynamic_cast<const SymplecticEulerIntegrator*>(integrator) != nullptr)
+            header.integrator = k_symplecticEuler;
+        else if(dynamic_cast<const NewtonIntegrator*>(integrator) != nullptr)
+            header.integrator = k_newton;
+        else if(auto rk4 = dynamic_cast<const RungeKuttaFourthIntegrator*>(integrator))
+        {
+            header.integrator = k_rungeKuttaFourth;
+            header.contactMode = static_cast<uint8_t>(rk4->GetContactMode());
+        }
+        else
+            throw std::runtime_error("Error : SceneSnapshot::Save : Unknown integrator!");
+
+        const Broadphase* broadphase = _scene.GetBroadphase().get();
+        if(dynamic_cast<const BruteForceBroadphase*>(broadphase) != nullptr)
+            header.broadphase = k_bruteForce;
+        else if(auto grid = dynamic_cast<const UniformGridBroadphase*>(broadphase))
+        {
+            header.broadphase = k_uniformGrid;
+            header.broadphaseParameter = grid->GetConfiguredCellSize();
+        }
+        else if(dynamic_cast<const SweepAndPruneBroadphase*>(broadphase) != nullptr)
+            header.broadphase = k_sweepAndPrune;
+        else if(auto tree = dynamic_cast<const DynamicTreeBroadphase*>(broadphase))
+        {
+            header.broadphase = k_dynamicTree;
+            header.broadphaseParameter = tree->GetMargin();
+        }
+        else
+            throw std::runtime_error("Error : SceneSnapshot::Save : Unknown broadphase!");
+
+        const Solver* solver = _scene.GetSolver().get();
+        if(dynamic_cast<const ImpulseSolver*>(solver) != nullptr)
+            header.solver = k_impulse;
+        else if(dynamic_cast<const GraphColoringSolver*>(solver) != nullptr)
+            header.solver = k_graphColoring;
+        else if(auto sequential = dynamic_cast<const SequentialImpulseSolver*>(solver))
+        {
+            header.solver = k_sequentialImpulse;
+            header.baumgarte = sequential->GetBaumgarte();
+            header.slop = sequential->GetSlop();
+            header.warmStarting = sequential->GetWarmStarting() ? 1u : 0u;
+        }
+        else
+            throw std::runtime_error("Error : SceneSnapshot::Save : Unknown solver!");
+
+        const SleepSettings& sleep = _scene.GetSleepSettings();
+        header.sleepEnabled = sleep.enabled ? 1u : 0u;
+        header.linearTolerance = sleep.linearTolerance;
+        header.angularTolerance = sleep.angularTolerance;
+        header.timeToSleep = sleep.timeToSleep;
+
+        header.sectionCount = static_cast<uint32_t>(k_sectionCount);
+        header.fileSize = Layout(header);
+        return header;
+    }
+
+    // unmaps (or frees) the file when it goes out of scope
+    class MappedFile
+    {
+    private:
+        const void* m_data;
+        size_t m_size;
+#ifdef _WIN32
+        std::vector<char> m_buffer;
+#endif
+
+    public:
+        explicit MappedFile(const std::string& _path)
+            : m_data(nullptr), m_size(0u)
+        {
+#ifdef _WIN32
+            std::ifstream file(_path, std::ios::binary | std::ios::ate);
+            if(file.is_open() == false)
+                throw std::runtime_error("Error : SceneSnapshot::Load : Can not open " + _path + "!");
+            m_buffer.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(m_buffer.data(), m_buffer.size());
+            m_data = m_buffer.data();
+            m_size = m_buffer.size();
+#else
+            const int file = open(_path.c_str(), O_RDONLY);
+            if(file < 0)
+                throw std::runtime_error("Error : SceneSnapshot::Load : Can not open " + _path + "!");
+
+            struct stat status;
+            if(fstat(file, &status) != 0 || status.st_size <= 0)
+            {
+                close(file);
+                throw std::runtime_error("Error : SceneSnapshot::Load : " + _path + " is empty!");
+            }
+            m_size = static_cast<size_t>(status.st_size);
+
+            void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+            close(file);
+            if(data == MAP_FAILED)
+                throw std::runtime_error("Error : SceneSnapshot::Load : Can not map " + _path + "!");
+            // every section is read once, front to back
+            madvise(data, m_size, MADV_SEQUENTIAL);
+            m_data = data;
+#endif
+        }
+
+        ~MappedFile()
+        {
+#ifndef _WIN32
+            if(m_data != nullptr)
+                munmap(const_cast<void*>(m_data), m_size);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        inline const void* GetData() const { return m_data; }
+        inline size_t GetSize() const { return m_size; }
+    };
+}
+
+size_t SceneSnapshot::GetSize(const Scene& _scene)
+{
+    return static_cast<size_t>(MakeHeader(_scene).fileSize);
+}
+
+void SceneSnapshot::Save(const Scene& _scene, const std::string& _path)
+{
+    if(IsLittleEndian() == false)
+    {
+        throw std::runtime_error("Error : SceneSnapshot::Save : Only little endian hosts are supported!");
+    }
+
+    const Header header = MakeHeader(_scene);
+    const BodyStore& store = _scene.GetBodyStore();
+    const size_t bodyCount = store.Size();
+
+    // the sections that are not a copy of an array of the store
+    std::vector<uint32_t> islands(bodyCount);
+    std::vector<uint8_t> shapeTypes(bodyCount);
+    std::vector<float2> shapeSizes(bodyCount);
+    // island ids are renumbered by first appearance, so saving a loaded
+    // snapshot again gives the same bytes
+    std::vector<uint32_t> islandIds;
+    uint32_t islandCount = 0u;
+    for(size_t i = 0; i < bodyCount; ++i)
+    {
+        const uint32_t island = store.m_sleepingIsland[i];
+        islands[i] = BodyStore::k_awake;
+        if(island != BodyStore::k_awake)
+        {
+            if(island >= islandIds.size())
+                islandIds.resize(island + 1u, BodyStore::k_awake);
+            if(islandIds[island] == BodyStore::k_awake)
+                islandIds[island] = islandCount++;
+            islands[i] = islandIds[island];
+        }
+
+        const Shape& shape = *store.m_shapes[i];
+        shapeTypes[i] = static_cast<uint8_t>(shape.GetType());
+        if(shape.GetType() == ShapeType::OBB)
+            shapeSizes[i] = static_cast<const OBB&>(shape).GetExtent();
+        else
+            shapeSizes[i] = float2(static_cast<const Circle&>(shape).GetRadius(), 0.0f);
+    }
+
+    const std::vector<std::shared_ptr<Joint>>& joints = _scene.GetJoints();
+    std::vector<JointRecord> jointRecords(joints.size());
+    for(size_t i = 0; i < joints.size(); ++i)
+    {
+        JointRecord& record = jointRecords[i];
+        record.body0 = joints[i]->GetBody(0)->GetIndex();
+        record.body1 = joints[i]->GetBody(1)->GetIndex();
+        if(auto spring = dynamic_cast<const SpringJoint*>(joints[i].get()))
+        {
+            record.kind = k_springJoint;
+            record.restLength = spring->GetRestLength();
+            record.parameter = spring->GetStiffness();
+        }
+        else if(auto distance = dynamic_cast<const DistanceJoint*>(joints[i].get()))
+        {
+            record.kind = k_distanceJoint;
+            record.restLength = distance->GetRestLength();
+            record.parameter = distance->GetDeltaTime();
+        }
+        else
+            throw std::runtime_error("Error : SceneSnapshot::Save : Unknown joint!");
+    }
+
+    FILE* file = std::fopen(_path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        throw std::runtime_error("Error : SceneSnapshot::Save : Can not open " + _path + "!");
+    }
+
+    uint64_t position = 0u;
+    bool isGood = true;
+    auto write = [&](const void* _data, uint64_t _offset, uint64_t _size)
+    {
+        static const char zeros[k_alignment] = {};
+        // padding up to the section
+        while(isGood && position < _offset)
+        {
+            const size_t count = static_cast<size_t>(std::min<uint64_t>(_offset - position, k_alignment));
+            isGood = std::fwrite(zeros, 1, count, file) == count;
+            position += count;
+        }
+        if(isGood && _size > 0u)
+            isGood = std::fwrite(_data, 1, static_cast<size_t>(_size), file) == _size;
+        position += _size;
+    };
+
+    write(&header, 0u, sizeof(header));
+    for(size_t k = 0; k < k_floatFieldCount; ++k)
+        write((store.*k_floatFields[k]).data(), header.sectionOffsets[k], bodyCount * sizeof(float));
+    write(islands.data(), header.sectionOffsets[k_sleepingIslandSection], islands.size() * sizeof(uint32_t));
+    write(shapeTypes.data(), header.sectionOffsets[k_shapeTypeSection], shapeTypes.size());
+    write(shapeSizes.data(), header.sectionOffsets[k_shapeSizeSection], shapeSizes.size() * sizeof(float2));
+    write(jointRecords.data(), header.sectionOffsets[k_jointSection], jointRecords.size() * sizeof(JointRecord));
+
+    isGood = (std::fclose(file) == 0) && isGood;
+    if(isGood == false)
+    {
+        throw std::runtime_error("Error : SceneSnapshot::Save : Can not write " + _path + "!");
+    }
+}
+
+std::shared_ptr<Scene> SceneSnapshot::Load(const std::string& _path, const std::shared_ptr<JobSystem>& _jobs)
+{
+    const MappedFile file(_path);
+    return Load(file.GetData(), file.GetSize(), _jobs);
+}
+
+std::shared_ptr<Scene> SceneSnapshot::Load(const void* _data, size_t _size, const std::shared_ptr<JobSystem>& _jobs)
+{
+    if(IsLittleEndian() == false)
+    {
+        throw std::runtime_error("Error : SceneSnapshot::Load : Only little endian hosts are supported!");
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(_data);
+    Header header;
+    if(_size < sizeof(Header))
+    {
+        throw std::runtime_error("Error : SceneSnapshot::Load : Not a snapshot!");
+    }
+    std::memcpy(&header, bytes, sizeof(Header));
+    if(std::memcmp(header.magic, k_magic, sizeof(k_magic)) != 0)
+    {
+        throw std::runtime_error("Error : SceneSnapshot::Load : Not a snapshot!");
+    }
+    if(header.version != k_version || header.headerSize != sizeof(Header) || header.sectionCount != k_sectionCount)
+    {
+        throw std::runtime_error("Error : SceneSnapshot::Load : Snapshot version " +
+            std::to_string(header.version) + " is not supported!");
+    }
+
+    // the offsets have to be the ones this version lays out, which also
+    // keeps every section inside the file
+    Header expected = header;
+    if(header.bodyCount >= BodyStore::k_awake || header.fileSize != _size || Layout(expected) != header.fileSize ||
+        std::memcmp(expected.sectionOffsets, header.sectionOffsets, sizeof(header.sectionOffsets)) != 0)
+    {
+        throw std::runtime_error("Error : SceneSnapshot::Load : The snapshot is truncated or corrupted!");
+    }
+    const size_t bodyCount = static_cast<size_t>(header.bodyCount);
+    const size_t jointCount = static_cast<size_t>(header.jointCount);
+
+    const uint8_t* shapeTypes = bytes + header.sectionOffsets[k_shapeTypeSection];
+    const float2* shapeSizes = reinterpret_cast<const float2*>(bytes + header.sectionOffsets[k_shapeSizeSection]);
+    const uint32_t* islands = reinterpret_cast<const uint32_t*>(bytes + header.sectionOffsets[k_sleepingIslandSection]);
+    const JointRecord* joints = reinterpret_cast<const JointRecord*>(bytes + header.sectionOffsets[k_jointSection]);
+
+    // the policies
+    std::shared_ptr<Integrator> integrator;
+    switch(header.integrator)
+    {
+    case k_explicitEuler: integrator = std::make_shared<ExplicitEulerIntegrator>(); break;
+    case k_symplecticEuler: integrator = std::make_shared<SymplecticEulerIntegrator>(); break;
+    case k_newton: integrator = std::make_shared<NewtonIntegrator>(); break;
+    case k_rungeKuttaFourth:
+        integrator = std::make_shared<RungeKuttaFourthIntegrator>(static_cast<ContactMode>(header.contactMode));
+        break;
+    default: throw std::runtime_error("Error : SceneSnapshot::Load : Unknown integrator!");
+    }
+
+    std::shared_ptr<Broadphase> broadphase;
+    switch(header.broadphase)
+    {
+    case k_bruteForce: broadphase = std::make_shared<BruteForceBroadphase>(); break;
+    case k_uniformGrid: broadphase = std::make_shared<UniformGridBroadphase>(header.broadphaseParameter); break;
+    case k_sweepAndPrune: broadphase = std::make_shared<SweepAndPruneBroadphase>(); break;
+    case k_dynamicTree: broadphase = std::make_shared<DynamicTreeBroadphase>(header.broadphaseParameter); break;
+    default: throw std::runtime_error("Error : SceneSnapshot::Load : Unknown broadphase!");
+    }
+
+    std::shared_ptr<Solver> solver;
+    switch(header.solver)
+    {
+    case k_impulse: solver = std::make_shared<ImpulseSolver>(); break;
+    case k_graphColoring: solver = std::make_shared<GraphColoringSolver>(); break;
+    case k_sequentialImpulse:
+        solver = std::make_shared<SequentialImpulseSolver>(header.warmStarting != 0u, header.baumgarte, header.slop);
+        break;
+    default: throw std::runtime_error("Error : SceneSnapshot::Load : Unknown solver!");
+    }
+
+    // check what would otherwise index out of bounds
+    for(size_t i = 0; i < bodyCount; ++i)
+    {
+        if(shapeTypes[i] >= static_cast<uint8_t>(ShapeType::Count) ||
+            (islands[i] != BodyStore::k_awake && islands[i] >= bodyCount))
+        {
+            throw std::runtime_error("Error : SceneSnapshot::Load : Body " + std::to_string(i) + " is corrupted!");
+        }
+    }
+    for(size_t i = 0; i < jointCount; ++i)
+    {
+        if(joints[i].kind > k_distanceJoint || joints[i].body0 >= bodyCount || joints[i].body1 >= bodyCount)
+        {
+            throw std::runtime_error("Error : SceneSnapshot::Load : Joint " + std::to_string(i) + " is corrupted!");
+        }
+    }
+
+    auto scene = std::make_shared<Scene>(header.deltaTime, header.iterations, integrator, broadphase, solver, _jobs);
+    SleepSettings sleep;
+    sleep.enabled = header.sleepEnabled != 0u;
+    sleep.linearTolerance = header.linearTolerance;
+    sleep.angularTolerance = header.angularTolerance;
+    sleep.timeToSleep = header.timeToSleep;
+    scene->SetSleepSettings(sleep);
+
+    // the arrays of the store, one copy per section
+    BodyStore& store = scene->m_store;
+    store.Allocate(bodyCount);
+    for(size_t k = 0; k < k_floatFieldCount; ++k)
+    {
+        if(bodyCount > 0u)
+            std::memcpy((store.*k_floatFields[k]).data(), bytes + header.sectionOffsets[k], bodyCount * sizeof(float));
+    }
+    if(bodyCount > 0u)
+        std::memcpy(store.m_sleepingIsland.data(), islands, bodyCount * sizeof(uint32_t));
+
+    // the objects of the scene
+    scene->m_bodies.resize(bodyCount);
+    for(size_t i = 0; i < bodyCount; ++i)
+    {
+        std::shared_ptr<Shape> shape;
+        if(shapeTypes[i] == static_cast<uint8_t>(ShapeType::OBB))
+            shape = std::make_shared<OBB>(shapeSizes[i]);
+        else
+            shape = std::make_shared<Circle>(shapeSizes[i].x);
+
+        std::shared_ptr<RigidBody2D> body = std::make_shared<RigidBody2D>(&store, store.GetHandle(static_cast<uint32_t>(i)));
+        shape->m_body = body;
+        store.m_shapes[i] = std::move(shape);
+        scene->m_bodies[i] = std::move(body);
+    }
+    scene->m_islands.Restore(store);
+
+    // added directly, AddJoint() would wake the bodies
+    scene->m_joints.reserve(jointCount);
+    for(size_t i = 0; i < jointCount; ++i)
+    {
+        const JointRecord& record = joints[i];
+        const std::shared_ptr<RigidBody2D>& body0 = scene->m_bodies[record.body0];
+        const std::shared_ptr<RigidBody2D>& body1 = scene->m_bodies[record.body1];
+        if(record.kind == k_springJoint)
+            scene->m_joints.push_back(std::make_shared<SpringJoint>(body0, body1, record.restLength, record.parameter));
+        else
+            scene->m_joints.push_back(std::make_shared<DistanceJoint>(body0, body1, record.restLength, record.parameter));
+    }
+
+    scene->UpdateTransforms();
+    return scene;
+}
@@ -0,0 +1,335 @@
+#include "solver.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void ImpulseSolver::Solve(
+	BodyStore& _bodies, const std::vector<Manifold>& _manifolds, PairCache& _pairs,
+	float _deltaTime, uint32_t _iterations)
+{
+	// Resolve impulses by manifolds
+	for (size_t iteration = 0; iteration < _iterations; ++iteration)
+	{
+		PROFILE_SCOPE(ProfileZone::SolverIteration);
+		for (size_t i = 0; i < _manifolds.size(); ++i)
+		{
+			_manifolds[i].Resolve(_bodies);
+		}
+	}
+	PROFILE_COUNT(ProfileCounter::SolverIterations, _iterations);
+
+	// Then : Do positional correction
+	PROFILE_SCOPE(ProfileZone::PositionalCorrection);
+	for (size_t i = 0; i < _manifolds.size(); ++i)
+	{
+		_manifolds[i].PositionalCorrection(_bodies);
+	}
+}
+
+void GraphColoringSolver::Color(const BodyStore& _bodies, const std::vector<Manifold>& _manifolds)
+{
+	m_bodyColors.assign(_bodies.Size(), 0u);
+	m_manifoldColors.resize(_manifolds.size());
+
+	std::array<uint32_t, k_maxColors + 1> counts = {};
+	m_colorCount = 0u;
+	for (size_t i = 0; i < _manifolds.size(); ++i)
+	{
+		const uint32_t a = _manifolds[i].m_body0;
+		const uint32_t b = _manifolds[i].m_body1;
+		const bool isStaticA = _bodies.m_invMass[a] == 0.0f;
+		const bool isStaticB = _bodies.m_invMass[b] == 0.0f;
+
+		uint32_t color = k_overflow;
+		if (isStaticA == false || isStaticB == false)
+		{
+			const uint32_t used =
+				(isStaticA ? 0u : m_bodyColors[a]) | (isStaticB ? 0u : m_bodyColors[b]);
+			if (used != ~0u)
+			{
+				// the lowest free color
+				color = 0u;
+				while (used & (1u << color))
+					++color;
+
+				if (isStaticA == false)
+					m_bodyColors[a] |= 1u << color;
+				if (isStaticB == false)
+					m_bodyColors[b] |= 1u << color;
+				m_colorCount = std::max(m_colorCount, color + 1u);
+			}
+		}
+
+		m_manifoldColors[i] = static_cast<uint8_t>(color);
+		++counts[color];
+	}
+
+	// counting sort by color, the overflow group last
+	m_colorOffsets[0] = 0u;
+	for (uint32_t k = 0; k <= k_maxColors; ++k)
+		m_colorOffsets[k + 1] = m_colorOffsets[k] + counts[k];
+
+	std::array<uint32_t, k_maxColors + 1> cursor;
+	std::copy(m_colorOffsets.begin(), m_colorOffsets.end() - 1, cursor.begin());
+	m_colored.resize(_manifolds.size());
+	for (size_t i = 0; i < _manifolds.size(); ++i)
+		m_colored[cursor[m_manifoldColors[i]]++] = static_cast<uint32_t>(i);
+}
+
+void GraphColoringSolver::RunColors(
+	JobSystem* _jobs, BodyStore& _bodies, const std::vector<Manifold>& _manifolds,
+	bool _isPositional) const
+{
+	auto run = [&](size_t _begin, size_t _end, size_t)
+	{
+		for (size_t i = _begin; i < _end; ++i)
+		{
+			const Manifold& manifold = _manifolds[m_colored[i]];
+			if (_isPositional)
+				manifold.PositionalCorrection(_bodies);
+			else
+				manifold.Resolve(_bodies);
+		}
+	};
+
+	for (uint32_t color = 0; color < m_colorCount; ++color)
+	{
+		const uint32_t begin = m_colorOffsets[color];
+		const uint32_t count = m_colorOffsets[color + 1] - begin;
+		const size_t grain = (_jobs != nullptr) ? std::max(k_minGrain, count / (_jobs->GetThreadCount() * 4u) + 1u) : 0u;
+		ParallelFor(_jobs, count, [&](size_t _begin, size_t _end, size_t _thread)
+		{
+			run(begin + _begin, begin + _end, _thread);
+		}, grain);
+	}
+
+	// the overflow group shares bodies, it can only run on one thread
+	run(m_colorOffsets[k_overflow], m_colorOffsets[k_overflow + 1], 0u);
+}
+
+void GraphColoringSolver::Solve(
+	BodyStore& _bodies, const std::vector<Manifold>& _manifolds, PairCache& _pairs,
+	float _deltaTime, uint32_t _iterations)
+{
+	{
+		PROFILE_SCOPE(ProfileZone::SolverSetup);
+		Color(_bodies, _manifolds);
+	}
+
+	JobSystem* jobs = m_jobs.get();
+	if (jobs != nullptr && (jobs->GetThreadCount() == 1u || _manifolds.size() < k_minParallelManifolds))
+		jobs = nullptr;
+
+	for (uint32_t iteration = 0; iteration < _iterations; ++iteration)
+	{
+		PROFILE_SCOPE(ProfileZone::SolverIteration);
+		RunColors(jobs, _bodies, _manifolds, false);
+	}
+	PROFILE_COUNT(ProfileCounter::SolverIterations, _iterations);
+
+	PROFILE_SCOPE(ProfileZone::PositionalCorrection);
+	RunColors(jobs, _bodies, _manifolds, true);
+}
+
+void SequentialImpulseSolver::Solve(
+	BodyStore& _bodies, const std::vector<Manifold>& _manifolds, PairCache& _pairs,
+	float _deltaTime, uint32_t _iterations)
+{
+	{
+		PROFILE_SCOPE(ProfileZone::SolverSetup);
+		PreStep(_bodies, _manifolds, _pairs, _deltaTime);
+
+		if (m_warmStarting)
+			WarmStart(_bodies);
+	}
+
+	// the position error is part of the velocity bias here, there is no
+	// positional correction pass
+	for (uint32_t iteration = 0; iteration < _iterations; ++iteration)
+	{
+		PROFILE_SCOPE(ProfileZone::SolverIteration);
+		SolveVelocities(_bodies);
+	}
+	PROFILE_COUNT(ProfileCounter::SolverIterations, _iterations);
+
+	StoreImpulses(_pairs);
+}
+
+void SequentialImpulseSolver::PreStep(
+	BodyStore& _bodies, const std::vector<Manifold>& _manifolds, const PairCache& _pairs,
+	float _deltaTime)
+{
+	// contacts approaching slower than this do not bounce, this plays the
+	// role of the resting check in Manifold::Resolve
+	const float restitutionThreshold = 1.0f;
+	const float invDeltaTime = (_deltaTime > 0.0f) ? 1.0f / _deltaTime : 0.0f;
+
+	m_constraints.clear();
+	for (const Manifold& manifold : _manifolds)
+	{
+		const uint32_t a = manifold.m_body0;
+		const uint32_t b = manifold.m_body1;
+
+		const float inv_mass_a = _bodies.m_invMass[a];
+		const float inv_mass_b = _bodies.m_invMass[b];
+		if (inv_mass_a == 0.0f && inv_mass_b == 0.0f)
+			continue;
+
+		const float inv_inertia_a = _bodies.m_invInertia[a];
+		const float inv_inertia_b = _bodies.m_invInertia[b];
+
+		ContactConstraint constraint;
+		constraint.body0 = a;
+		constraint.body1 = b;
+		constraint.cacheEntry = _pairs.Find(PairCache::MakeKey(_bodies.GetHandle(a), _bodies.GetHandle(b)));
+		constraint.normal = manifold.m_normal;
+		constraint.tangent = float2(manifold.m_normal.y, -manifold.m_normal.x);
+		constraint.friction = std::sqrt(_bodies.m_staticFriction[a] * _bodies.m_staticFriction[b]);
+		constraint.pointCount = manifold.m_contactPointCount;
+
+		const float restitution = std::min(_bodies.m_restitution[a], _bodies.m_restitution[b]);
+
+		// impulses of the same points in the last step, if any
+		const PairCache::Entry* cached = nullptr;
+		if (m_warmStarting && constraint.cacheEntry != PairCache::k_invalidEntry)
+			cached = &_pairs.GetEntry(constraint.cacheEntry);
+
+		for (int i = 0; i < constraint.pointCount; ++i)
+		{
+			PointConstraint& point = constraint.points[i];
+			point.ra = manifold.m_contactPoints[i] - _bodies.GetPosition(a);
+			point.rb = manifold.m_contactPoints[i] - _bodies.GetPosition(b);
+			point.id = manifold.m_contactIds[i];
+
+			const float raCrossN = linalg::cross(point.ra, constraint.normal);
+			const float rbCrossN = linalg::cross(point.rb, constraint.normal);
+			point.normalMass = 1.0f / (inv_mass_a + inv_mass_b
+				+ raCrossN * raCrossN * inv_inertia_a
+				+ rbCrossN * rbCrossN * inv_inertia_b);
+
+			const float raCrossT = linalg::cross(point.ra, constraint.tangent);
+			const float rbCrossT = linalg::cross(point.rb, constraint.tangent);
+			point.tangentMass = 1.0f / (inv_mass_a + inv_mass_b
+				+ raCrossT * raCrossT * inv_inertia_a
+				+ rbCrossT * rbCrossT * inv_inertia_b);
+
+			// push the bodies apart over a few steps
+			point.bias = m_baumgarte * invDeltaTime * std::max(manifold.m_penetration - m_slop, 0.0f);
+
+			// bounce off with the approach speed at the start of the step
+			const float2 rv =
+				_bodies.GetVelocity(b) + linalg::cross(_bodies.m_angularVelocity[b], point.rb)
+				- _bodies.GetVelocity(a) - linalg::cross(_bodies.m_angularVelocity[a], point.ra);
+			const float velAlongNormal = linalg::dot(rv, constraint.normal);
+			if (velAlongNormal < -restitutionThreshold)
+				point.bias = std::max(point.bias, -restitution * velAlongNormal);
+
+			point.normalImpulse = 0.0f;
+			point.tangentImpulse = 0.0f;
+			if (cached == nullptr)
+				continue;
+
+			for (int k = 0; k < cached->pointCount; ++k)
+			{
+				if (cached->ids[k] == point.id)
+				{
+					point.normalImpulse = cached->normalImpulse[k];
+					point.tangentImpulse = cached->tangentImpulse[k];
+					break;
+				}
+			}
+		}
+
+		m_constraints.push_back(constraint);
+	}
+}
+
+void SequentialImpulseSolver::WarmStart(BodyStore& _bodies)
+{
+	for (const ContactConstraint& constraint : m_constraints)
+	{
+		const uint32_t a = constraint.body0;
+		const uint32_t b = constraint.body1;
+		const float inv_mass_a = _bodies.m_invMass[a];
+		const float inv_mass_b = _bodies.m_invMass[b];
+		const float inv_inertia_a = _bodies.m_invInertia[a];
+		const float inv_inertia_b = _bodies.m_invInertia[b];
+
+		for (int i = 0; i < constraint.pointCount; ++i)
+		{
+			const PointConstraint& point = constraint.points[i];
+			const float2 impulse =
+				point.normalImpulse * constraint.normal + point.tangentImpulse * constraint.tangent;
+
+			_bodies.AddVelocity(a, inv_mass_a * -impulse);
+			_bodies.AddVelocity(b, inv_mass_b * impulse);
+			_bodies.m_angularVelocity[a] += inv_inertia_a * linalg::cross(point.ra, -impulse);
+			_bodies.m_angularVelocity[b] += inv_inertia_b * linalg::cross(point.rb, impulse);
+		}
+	}
+}
+
+void SequentialImpulseSolver::SolveVelocities(BodyStore& _bodies)
+{
+	for (ContactConstraint& constraint : m_constraints)
+	{
+		const uint32_t a = constraint.body0;
+		const uint32_t b = constraint.body1;
+		const float inv_mass_a = _bodies.m_invMass[a];
+		const float inv_mass_b = _bodies.m_invMass[b];
+		const float inv_inertia_a = _bodies.m_invInertia[a];
+		const float inv_inertia_b = _bodies.m_invInertia[b];
+
+		auto applyImpulse = [&](const PointConstraint& _point, const float2& _impulse)
+		{
+			_bodies.AddVelocity(a, inv_mass_a * -_impulse);
+			_bodies.AddVelocity(b, inv_mass_b * _impulse);
+			_bodies.m_angularVelocity[a] += inv_inertia_a * linalg::cross(_point.ra, -_impulse);
+			_bodies.m_angularVelocity[b] += inv_inertia_b * linalg::cross(_point.rb, _impulse);
+		};
+		auto relativeVelocity = [&](const PointConstraint& _point)
+		{
+			return _bodies.GetVelocity(b) + linalg::cross(_bodies.m_angularVelocity[b], _point.rb)
+				- _bodies.GetVelocity(a) - linalg::cross(_bodies.m_angularVelocity[a], _point.ra);
+		};
+
+		for (int i = 0; i < constraint.pointCount; ++i)
+		{
+			PointConstraint& point = constraint.points[i];
+
+			// normal impulse, the total is never pulling the bodies together
+			const float velAlongNormal = linalg::dot(relativeVelocity(point), constraint.normal);
+			const float oldNormalImpulse = point.normalImpulse;
+			point.normalImpulse = std::max(oldNormalImpulse + point.normalMass * (point.bias - velAlongNormal), 0.0f);
+			applyImpulse(point, (point.normalImpulse - oldNormalImpulse) * constraint.normal);
+
+			// friction impulse, the total stays inside the friction cone
+			const float velAlongTangent = linalg::dot(relativeVelocity(point), constraint.tangent);
+			const float maxFriction = constraint.friction * point.normalImpulse;
+			const float oldTangentImpulse = point.tangentImpulse;
+			point.tangentImpulse = std::clamp(
+				oldTangentImpulse - point.tangentMass * velAlongTangent, -maxFriction, maxFriction);
+			applyImpulse(point, (point.tangentImpulse - oldTangentImpulse) * constraint.tangent);
+		}
+	}
+}
+
+void SequentialImpulseSolver::StoreImpulses(PairCache& _pairs)
+{
+	for (const ContactConstraint& constraint : m_constraints)
+	{
+		if (constraint.cacheEntry == PairCache::k_invalidEntry)
+			continue;
+
+		PairCache::Entry& cached = _pairs.GetEntry(constraint.cacheEntry);
+		cached.pointCount = constraint.pointCount;
+		for (int i = 0; i < constraint.pointCount; ++i)
+		{
+			const PointConstraint& point = constraint.points[i];
+			cached.ids[i] = point.id;
+			cached.normalImpulse[i] = point.normalImpulse;
+			cached.tangentImpulse[i] = point.tangentImpulse;
+		}
+	}
+}
@@ -0,0 +1,461 @@
+#include "trajectory.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    constexpr char k_magic[8] = { 'R', 'B', '2', 'D', 'T', 'R', 'A', 'J' };
+    constexpr uint32_t k_version = 1u;
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        float positionPrecision;
+        float anglePrecision;
+        uint32_t keyframeInterval;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(FileHeader) == 32, "the file header has padding");
+
+    struct ChunkHeader
+    {
+        uint64_t step;
+        uint32_t bodyCount;
+        uint32_t payloadSize;
+        uint8_t isKeyframe;
+        uint8_t padding[7];
+    };
+    static_assert(sizeof(ChunkHeader) == 24, "the chunk header has padding");
+
+    // position x, position y, orientation
+    constexpr size_t k_channelCount = 3u;
+
+    inline uint64_t ZigZag(int64_t _value)
+    {
+        return (static_cast<uint64_t>(_value) << 1) ^ static_cast<uint64_t>(_value >> 63);
+    }
+
+    inline int64_t UnZigZag(uint64_t _value)
+    {
+        return static_cast<int64_t>(_value >> 1) ^ -static_cast<int64_t>(_value & 1u);
+    }
+
+    inline uint32_t GetBitWidth(uint64_t _value)
+    {
+        uint32_t width = 0u;
+        while(_value != 0u)
+        {
+            ++width;
+            _value >>= 1;
+        }
+        return width;
+    }
+
+    inline int32_t Quantize(float _value, float _inverseStep)
+    {
+        const double scaled = std::nearbyint(static_cast<double>(_value) * _inverseStep);
+        // NaN and values out of range end up at the ends of the range
+        if(!(scaled > std::numeric_limits<int32_t>::min()))
+            return std::numeric_limits<int32_t>::min();
+        if(scaled >= std::numeric_limits<int32_t>::max())
+            return std::numeric_limits<int32_t>::max();
+        return static_cast<int32_t>(scaled);
+    }
+
+    // little endian bit stream, least significant bits first
+    class BitWriter
+    {
+    private:
+        std::vector<uint8_t>& m_out;
+        uint64_t m_bits;
+        uint32_t m_count;
+
+    public:
+        explicit BitWriter(std::vector<uint8_t>& _out) : m_out(_out), m_bits(0u), m_count(0u) {}
+
+        // '_width' up to 64
+        inline void Write(uint64_t _value, uint32_t _width)
+        {
+            while(_width > 0u)
+            {
+                const uint32_t count = std::min(_width, 32u);
+                m_bits |= (_value & ((1ull << count) - 1u)) << m_count;
+                m_count += count;
+                _value = (count == 64u) ? 0u : (_value >> count);
+                _width -= count;
+                while(m_count >= 8u)
+                {
+                    m_out.push_back(static_cast<uint8_t>(m_bits));
+                    m_bits >>= 8;
+                    m_count -= 8u;
+                }
+            }
+        }
+
+        inline void Flush()
+        {
+            if(m_count > 0u)
+                m_out.push_back(static_cast<uint8_t>(m_bits));
+            m_bits = 0u;
+            m_count = 0u;
+        }
+    };
+
+    class BitReader
+    {
+    private:
+        const uint8_t* m_data;
+        size_t m_size;
+        size_t m_position;
+        uint64_t m_bits;
+        uint32_t m_count;
+
+    public:
+        BitReader(const uint8_t* _data, size_t _size)
+            : m_data(_data), m_size(_size), m_position(0u), m_bits(0u), m_count(0u)
+            {}
+
+        inline uint64_t Read(uint32_t _width)
+        {
+            uint64_t value = 0u;
+            uint32_t shift = 0u;
+            while(_width > 0u)
+            {
+                const uint32_t count = std::min(_width, 32u);
+                while(m_count < count)
+                {
+                    if(m_position >= m_size)
+                        throw std::runtime_error("Error : TrajectoryReader : A chunk is corrupted!");
+                    m_bits |= static_cast<uint64_t>(m_data[m_position++]) << m_count;
+                    m_count += 8u;
+                }
+                value |= (m_bits & ((1ull << count) - 1u)) << shift;
+                m_bits >>= count;
+                m_count -= count;
+                shift += count;
+                _width -= count;
+            }
+            return value;
+        }
+    };
+}
+
+TrajectoryRecorder::TrajectoryRecorder(const std::string& _path, const RecorderSettings& _settings)
+    : m_settings(_settings), m_file(nullptr), m_step(0u),
+      m_frames(std::max<size_t>(_settings.bufferFrames, 1u)), m_produced(0u), m_consumed(0u), m_dropped(0u),
+      m_bytes(0u), m_isStopping(false), m_isGood(true), m_mutex(), m_condition(), m_writer(),
+      m_last(), m_lastKeyframe(0u), m_hasKeyframe(false), m_payload()
+{
+    if(m_settings.positionPrecision <= 0.0f || m_settings.anglePrecision <= 0.0f)
+    {
+        throw std::runtime_error("Error : TrajectoryRecorder : The precision has to be positive!");
+    }
+
+    m_file = std::fopen(_path.c_str(), "wb");
+    if(m_file == nullptr)
+    {
+        throw std::runtime_error("Error : TrajectoryRecorder : Can not open " + _path + "!");
+    }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, k_magic, sizeof(k_magic));
+    header.version = k_version;
+    header.headerSize = sizeof(FileHeader);
+    header.positionPrecision = m_settings.positionPrecision;
+    header.anglePrecision = m_settings.anglePrecision;
+    header.keyframeInterval = m_settings.keyframeInterval;
+    if(std::fwrite(&header, sizeof(header), 1, m_file) != 1)
+        m_isGood = false;
+    m_bytes = sizeof(header);
+
+    m_writer = std::thread(&TrajectoryRecorder::WriterLoop, this);
+}
+
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+    Close();
+}
+
+void TrajectoryRecorder::Record(const BodyStore& _bodies)
+{
+    const uint64_t step = m_step++;
+    const uint64_t produced = m_produced.load(std::memory_order_relaxed);
+    if(m_file == nullptr || produced - m_consumed.load(std::memory_order_acquire) >= m_frames.size())
+    {
+        m_dropped.fetch_add(1u, std::memory_order_relaxed);
+        return;
+    }
+
+    // the slot keeps the capacity of its arrays, so this only allocates
+    // while the number of bodies grows
+    Frame& frame = m_frames[produced % m_frames.size()];
+    frame.step = step;
+    frame.positionX.assign(_bodies.m_positionX.begin(), _bodies.m_positionX.end());
+    frame.positionY.assign(_bodies.m_positionY.begin(), _bodies.m_positionY.end());
+    frame.orientation.assign(_bodies.m_orientation.begin(), _bodies.m_orientation.end());
+    m_produced.store(produced + 1u, std::memory_order_release);
+    m_condition.notify_one();
+}
+
+void TrajectoryRecorder::Close()
+{
+    if(m_writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isStopping = true;
+        }
+        m_condition.notify_one();
+        m_writer.join();
+    }
+
+    if(m_file != nullptr)
+    {
+        if(std::fclose(m_file) != 0)
+            m_isGood = false;
+        m_file = nullptr;
+    }
+}
+
+void TrajectoryRecorder::WriterLoop()
+{
+    uint64_t consumed = m_consumed.load(std::memory_order_relaxed);
+    while(true)
+    {
+        if(consumed == m_produced.load(std::memory_order_acquire))
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            // Record() notifies without the lock, so a wake up can be missed,
+            // the timeout only bounds how late the writer notices then
+            m_condition.wait_for(lock, std::chrono::milliseconds(2), [&]()
+            {
+                return m_isStopping.load() || consumed != m_produced.load(std::memory_order_acquire);
+            });
+            if(consumed == m_produced.load(std::memory_order_acquire))
+            {
+                if(m_isStopping.load())
+                    return;
+                continue;
+            }
+        }
+
+        Encode(m_frames[consumed % m_frames.size()]);
+        ++consumed;
+        m_consumed.store(consumed, std::memory_order_release);
+    }
+}
+
+void TrajectoryRecorder::Encode(const Frame& _frame)
+{
+    const size_t count = _frame.positionX.size();
+    const bool isKeyframe = m_hasKeyframe == false || m_last[0].size() != count ||
+        _frame.step - m_lastKeyframe >= m_settings.keyframeInterval;
+
+    // quantize, and find out which bodies moved and how many bits the
+    // largest change of each channel takes
+    const float inversePosition = 1.0f / m_settings.positionPrecision;
+    const float inverseAngle = 1.0f / m_settings.anglePrecision;
+    const std::vector<float>* channels[k_channelCount] = { &_frame.positionX, &_frame.positionY, &_frame.orientation };
+
+    std::vector<uint8_t> moved(isKeyframe ? 0u : (count + 7u) / 8u, 0u);
+    uint64_t largest[k_channelCount] = {};
+    for(size_t c = 0; c < k_channelCount; ++c)
+    {
+        const float inverse = (c == 2u) ? inverseAngle : inversePosition;
+        std::vector<int32_t>& last = m_last[c];
+        last.resize(count, 0);
+        for(size_t i = 0; i < count; ++i)
+        {
+            const int32_t value = Quantize((*channels[c])[i], inverse);
+            const int64_t delta = isKeyframe ? value : (static_cast<int64_t>(value) - last[i]);
+            if(isKeyframe == false && delta != 0)
+                moved[i / 8u] |= static_cast<uint8_t>(1u << (i % 8u));
+            largest[c] = std::max(largest[c], ZigZag(delta));
+        }
+    }
+
+    // Payload : the moved bitmap (not in keyframes), the bit width of each
+    // channel, then the values of every written body channel by channel.
+    // 'm_last' is still the last chunk here, it is updated as values are
+    // written.
+    m_payload.clear();
+    m_payload.insert(m_payload.end(), moved.begin(), moved.end());
+    uint32_t widths[k_channelCount];
+    for(size_t c = 0; c < k_channelCount; ++c)
+    {
+        widths[c] = GetBitWidth(largest[c]);
+        m_payload.push_back(static_cast<uint8_t>(widths[c]));
+    }
+
+    BitWriter writer(m_payload);
+    for(size_t c = 0; c < k_channelCount; ++c)
+    {
+        const float inverse = (c == 2u) ? inverseAngle : inversePosition;
+        std::vector<int32_t>& last = m_last[c];
+        for(size_t i = 0; i < count; ++i)
+        {
+            if(isKeyframe == false && (moved[i / 8u] & (1u << (i % 8u))) == 0u)
+                continue;
+            const int32_t value = Quantize((*channels[c])[i], inverse);
+            const int64_t delta = isKeyframe ? value : (static_cast<int64_t>(value) - last[i]);
+            writer.Write(ZigZag(delta), widths[c]);
+            last[i] = value;
+        }
+    }
+    writer.Flush();
+
+    if(isKeyframe)
+    {
+        m_hasKeyframe = true;
+        m_lastKeyframe = _frame.step;
+    }
+
+    ChunkHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.step = _frame.step;
+    header.bodyCount = static_cast<uint32_t>(count);
+    header.payloadSize = static_cast<uint32_t>(m_payload.size());
+    header.isKeyframe = isKeyframe ? 1u : 0u;
+
+    const bool isWritten = std::fwrite(&header, sizeof(header), 1, m_file) == 1 &&
+        std::fwrite(m_payload.data(), 1, m_payload.size(), m_file) == m_payload.size();
+    if(isWritten == false)
+        m_isGood = false;
+    m_bytes.fetch_add(sizeof(header) + m_payload.size(), std::memory_order_relaxed);
+}
+
+TrajectoryReader::TrajectoryReader(const std::string& _path)
+    : m_file(nullptr), m_positionPrecision(0.0f), m_anglePrecision(0.0f), m_chunks(),
+      m_current(static_cast<size_t>(-1)), m_state(), m_payload()
+{
+    m_file = std::fopen(_path.c_str(), "rb");
+    if(m_file == nullptr)
+    {
+        throw std::runtime_error("Error : TrajectoryReader : Can not open " + _path + "!");
+    }
+
+    FileHeader header;
+    if(std::fread(&header, sizeof(header), 1, m_file) != 1 ||
+        std::memcmp(header.magic, k_magic, sizeof(k_magic)) != 0)
+    {
+        std::fclose(m_file);
+        throw std::runtime_error("Error : TrajectoryReader : " + _path + " is not a trajectory!");
+    }
+    if(header.version != k_version || header.headerSize != sizeof(FileHeader))
+    {
+        std::fclose(m_file);
+        throw std::runtime_error("Error : TrajectoryReader : Trajectory version " +
+            std::to_string(header.version) + " is not supported!");
+    }
+    m_positionPrecision = header.positionPrecision;
+    m_anglePrecision = header.anglePrecision;
+
+    // the chunk table, only the headers are read
+    std::fseek(m_file, 0, SEEK_END);
+    const uint64_t size = static_cast<uint64_t>(std::ftell(m_file));
+    uint64_t offset = sizeof(FileHeader);
+    bool hasKeyframe = false;
+    while(offset + sizeof(ChunkHeader) <= size)
+    {
+        ChunkHeader chunk;
+        std::fseek(m_file, static_cast<long>(offset), SEEK_SET);
+        if(std::fread(&chunk, sizeof(chunk), 1, m_file) != 1)
+            break;
+        const uint64_t end = offset + sizeof(ChunkHeader) + chunk.payloadSize;
+        if(end > size)
+            break;
+
+        // deltas before the first keyframe can not be decoded
+        hasKeyframe = hasKeyframe || chunk.isKeyframe != 0u;
+        if(hasKeyframe)
+        {
+            m_chunks.push_back(Chunk{ chunk.step, offset + sizeof(ChunkHeader),
+                chunk.bodyCount, chunk.payloadSize, chunk.isKeyframe != 0u });
+        }
+        offset = end;
+    }
+}
+
+TrajectoryReader::~TrajectoryReader()
+{
+    if(m_file != nullptr)
+        std::fclose(m_file);
+}
+
+bool TrajectoryReader::FindFrame(uint64_t _step, size_t& _frame) const
+{
+    auto it = std::lower_bound(m_chunks.begin(), m_chunks.end(), _step,
+        [](const Chunk& _chunk, uint64_t _value) { return _chunk.step < _value; });
+    if(it == m_chunks.end() || it->step != _step)
+        return false;
+    _frame = static_cast<size_t>(it - m_chunks.begin());
+    return true;
+}
+
+void TrajectoryReader::Decode(size_t _chunk)
+{
+    const Chunk& chunk = m_chunks[_chunk];
+    m_payload.resize(chunk.payloadSize);
+    std::fseek(m_file, static_cast<long>(chunk.offset), SEEK_SET);
+    if(chunk.payloadSize > 0u && std::fread(m_payload.data(), 1, chunk.payloadSize, m_file) != chunk.payloadSize)
+    {
+        throw std::runtime_error("Error : TrajectoryReader : Can not read a chunk!");
+    }
+
+    const size_t count = chunk.bodyCount;
+    const size_t bitmapSize = chunk.isKeyframe ? 0u : (count + 7u) / 8u;
+    if(m_payload.size() < bitmapSize + k_channelCount ||
+        (chunk.isKeyframe == false && m_state[0].size() != count))
+    {
+        throw std::runtime_error("Error : TrajectoryReader : A chunk is corrupted!");
+    }
+
+    const uint8_t* moved = m_payload.data();
+    const uint8_t* widths = m_payload.data() + bitmapSize;
+    BitReader reader(widths + k_channelCount, m_payload.size() - bitmapSize - k_channelCount);
+    for(size_t c = 0; c < k_channelCount; ++c)
+    {
+        std::vector<int32_t>& state = m_state[c];
+        if(chunk.isKeyframe)
+            state.assign(count, 0);
+        for(size_t i = 0; i < count; ++i)
+        {
+            if(chunk.isKeyframe == false && (moved[i / 8u] & (1u << (i % 8u))) == 0u)
+                continue;
+            state[i] = static_cast<int32_t>(state[i] + UnZigZag(reader.Read(widths[c])));
+        }
+    }
+    m_current = _chunk;
+}
+
+void TrajectoryReader::ReadFrame(size_t _frame, std::vector<TrajectoryPose>& _poses)
+{
+    if(_frame >= m_chunks.size())
+    {
+        throw std::runtime_error("Error : TrajectoryReader::ReadFrame : No frame " + std::to_string(_frame) + "!");
+    }
+
+    // go on from the decoded frame unless there is a keyframe in between
+    size_t keyframe = _frame;
+    while(m_chunks[keyframe].isKeyframe == false)
+        --keyframe;
+    const bool isAhead = m_current != static_cast<size_t>(-1) && m_current >= keyframe && m_current <= _frame;
+    for(size_t chunk = isAhead ? m_current + 1u : keyframe; chunk <= _frame; ++chunk)
+        Decode(chunk);
+
+    _poses.resize(m_state[0].size());
+    for(size_t i = 0; i < _poses.size(); ++i)
+    {
+        _poses[i].position = linalg::aliases::float2(
+            m_state[0][i] * m_positionPrecision, m_state[1][i] * m_positionPrecision);
+        _poses[i].orientation = m_state[2][i] * m_anglePrecision;
+    }
+}